@@ -0,0 +1,150 @@
+#ifndef __GST_PIPEWIRE_DISCONTINUITY_ACCUMULATOR_H__
+#define __GST_PIPEWIRE_DISCONTINUITY_ACCUMULATOR_H__
+
+#include <gst/gst.h>
+
+
+/* Accumulator for timestamp discontinuities between consecutive buffers.
+ *
+ * Some sources produce timestamps with jitter that cancels itself out over
+ * time, for example +1ms, -1ms, +1ms, -1ms etc. Compensating for each one of
+ * these individually (by inserting silence or by clipping data) only produces
+ * glitches. Instead, the accumulator keeps track of the output timeline, which
+ * is where the buffers' data actually ends up when it is played contiguously,
+ * and measures how far each buffer's PTS deviates from that timeline. That
+ * deviation accumulates all discontinuities that were not compensated for so
+ * far. Alternating jitter cancels out in it, while actual gaps and overlaps do
+ * not, no matter how many buffers lie between them. Only if the absolute value
+ * of the deviation exceeds the threshold in at least
+ * DISCONTINUITY_ACCUMULATOR_MIN_NUM_EXCESSES consecutive buffers (in the same
+ * direction) is the discontinuity considered persistent.
+ *
+ * Call discontinuity_accumulator_init() on a DiscontinuityAccumulator instance
+ * before using. Use discontinuity_accumulator_reset() to reset it back to its
+ * initial state, for example after a flush, or if the next buffer's PTS is
+ * not supposed to continue the output timeline.
+ *
+ * For each buffer, call discontinuity_accumulator_check() with its PTS. If it
+ * returns TRUE, the caller has to compensate for the discontinuity that is
+ * written into *discontinuity. A positive value means that there is a gap
+ * between the output timeline and the buffer, which is filled with that much
+ * silence. A negative value means that the beginning of the buffer overlaps
+ * with already played data, and that much has to be clipped from the buffer.
+ * Then, get the (compensated) position of the buffer's remaining data in the
+ * output timeline with discontinuity_accumulator_get_output_pts(), and after
+ * any further clipping, pass that and the duration of the data that is
+ * actually played to discontinuity_accumulator_advance(). If the buffer is
+ * dropped instead, do not call discontinuity_accumulator_advance().
+ */
+
+
+#define DISCONTINUITY_ACCUMULATOR_MIN_NUM_EXCESSES 2
+
+
+typedef struct
+{
+	/* The PTS where the data of the next buffer is expected to begin in
+	 * the output timeline. GST_CLOCK_TIME_NONE if there is no output
+	 * timeline yet (because no buffer was passed since the last reset). */
+	GstClockTime expected_next_pts;
+	/* Deviation of the last checked PTS from the output timeline. */
+	GstClockTimeDiff deviation;
+	guint num_consecutive_excesses;
+}
+DiscontinuityAccumulator;
+
+
+static inline void discontinuity_accumulator_reset(DiscontinuityAccumulator *accumulator)
+{
+	g_assert(accumulator != NULL);
+
+	accumulator->expected_next_pts = GST_CLOCK_TIME_NONE;
+	accumulator->deviation = 0;
+	accumulator->num_consecutive_excesses = 0;
+}
+
+
+static inline void discontinuity_accumulator_init(DiscontinuityAccumulator *accumulator)
+{
+	discontinuity_accumulator_reset(accumulator);
+}
+
+
+static inline gboolean discontinuity_accumulator_check(DiscontinuityAccumulator *accumulator, GstClockTime pts, GstClockTimeDiff threshold, gboolean force, GstClockTimeDiff *discontinuity)
+{
+	GstClockTimeDiff previous_deviation;
+
+	g_assert(accumulator != NULL);
+	g_assert(GST_CLOCK_TIME_IS_VALID(pts));
+	g_assert(discontinuity != NULL);
+
+	*discontinuity = 0;
+
+	if (!GST_CLOCK_TIME_IS_VALID(accumulator->expected_next_pts))
+		return FALSE;
+
+	previous_deviation = accumulator->deviation;
+	accumulator->deviation = GST_CLOCK_DIFF(accumulator->expected_next_pts, pts);
+
+	/* A forced handling must happen right away, even
+	 * if the deviation does not exceed the threshold. */
+	if (G_UNLIKELY(force))
+	{
+		accumulator->num_consecutive_excesses = 0;
+		*discontinuity = accumulator->deviation;
+		return (accumulator->deviation != 0);
+	}
+
+	if (ABS(accumulator->deviation) > threshold)
+	{
+		/* Excesses in alternating directions are jitter, not a persistent
+		 * discontinuity, so only count consecutive ones in the same direction. */
+		if ((accumulator->num_consecutive_excesses > 0) && ((accumulator->deviation > 0) != (previous_deviation > 0)))
+			accumulator->num_consecutive_excesses = 1;
+		else
+			accumulator->num_consecutive_excesses++;
+	}
+	else
+		accumulator->num_consecutive_excesses = 0;
+
+	if (accumulator->num_consecutive_excesses < DISCONTINUITY_ACCUMULATOR_MIN_NUM_EXCESSES)
+		return FALSE;
+
+	/* The count is not reset here. If the compensation succeeds, the next
+	 * deviation is within the threshold, which resets the count. If it
+	 * does not (for example, because the overlap is longer than the buffer,
+	 * so the whole buffer is dropped), the rest is compensated for with
+	 * the next buffer right away. */
+	*discontinuity = accumulator->deviation;
+
+	return TRUE;
+}
+
+
+static inline GstClockTime discontinuity_accumulator_get_output_pts(DiscontinuityAccumulator *accumulator, GstClockTime pts, GstClockTimeDiff compensated_discontinuity)
+{
+	g_assert(accumulator != NULL);
+
+	/* Without an output timeline, the buffer starts a new one at its PTS. */
+	if (!GST_CLOCK_TIME_IS_VALID(accumulator->expected_next_pts))
+		return pts;
+
+	/* Otherwise, the data continues the output timeline, regardless of any
+	 * uncompensated deviation of the PTS from it. If a gap was compensated
+	 * for, the data comes after the inserted silence. If an overlap was
+	 * compensated for, the overlapping data is clipped, so the remaining
+	 * data still continues the output timeline. */
+	return accumulator->expected_next_pts + MAX(compensated_discontinuity, 0);
+}
+
+
+static inline void discontinuity_accumulator_advance(DiscontinuityAccumulator *accumulator, GstClockTime output_pts, GstClockTime duration)
+{
+	g_assert(accumulator != NULL);
+	g_assert(GST_CLOCK_TIME_IS_VALID(output_pts));
+
+	accumulator->expected_next_pts = output_pts + duration;
+}
+
+
+#endif /* __GST_PIPEWIRE_DISCONTINUITY_ACCUMULATOR_H__ */
@@ -43,8 +43,6 @@ G_DEFINE_TYPE(GstPipewireCore, gst_pipewire_core, GST_TYPE_OBJECT)
 
 static void gst_pipewire_core_dispose(GObject *object);
 
-static void gst_pipewire_core_sync_pw_core(GstPipewireCore *self);
-
 static void gst_pipewire_core_on_core_done(void *object, uint32_t id, int sequence_number);
 static void gst_pipewire_core_on_core_error(void *object, uint32_t id, int sequence_number, int res, const char *message);
 
@@ -96,7 +94,7 @@ static void gst_pipewire_core_dispose(GObject *object)
 }
 
 
-static void gst_pipewire_core_sync_pw_core(GstPipewireCore *self)
+void gst_pipewire_core_sync_pw_core(GstPipewireCore *self)
 {
 	/* Must be called with the pw_thread_loop lock held */
 
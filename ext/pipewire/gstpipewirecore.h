@@ -76,6 +76,10 @@ GType gst_pipewire_core_get_type(void);
 GstPipewireCore* gst_pipewire_core_get(int fd);
 void gst_pipewire_core_release(GstPipewireCore *core);
 
+/* Waits until the PipeWire server processed all requests that were sent
+ * before this call. Must be called with the pw_thread_loop lock held. */
+void gst_pipewire_core_sync_pw_core(GstPipewireCore *core);
+
 
 G_END_DECLS
 
@@ -0,0 +1,745 @@
+/* gst-pipewire-extra
+ *
+ * Copyright © 2022 Carlos Rafael Giani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * SECTION:gstpwaudiodeviceprovider
+ * @title: pwaudiodeviceprovider
+ * @short_description: Device provider for PipeWire audio sink nodes
+ *
+ * pwaudiodeviceprovider tracks the audio sink nodes of the PipeWire graph
+ * through the PipeWire registry, and produces a #GstDevice for each one.
+ * The device's caps are the caps that pwaudiosink would otherwise probe
+ * when it starts. The provider probes these once per node and caches them,
+ * so applications can find out what each output supports without having to
+ * instantiate a pwaudiosink for each one.
+ *
+ * gst_device_create_element() returns a pwaudiosink whose target-object-id
+ * property is set to the node's object ID and whose custom-probed-caps property
+ * is set to the device's caps. This allows the sink to start without probing.
+ *
+ * Probing requires setting up test streams, so it takes a while. For this
+ * reason, the provider does the probing in a separate thread while it is
+ * started. Devices show up once their nodes were probed. The probed caps
+ * are cached per node name, since object IDs change when a node is
+ * re-created, for example after a USB device was unplugged and plugged
+ * back in, while the node name usually stays the same.
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#include <pipewire/pipewire.h>
+
+#pragma GCC diagnostic pop
+
+#include "gstpipewirecore.h"
+#include "gstpwaudioformat.h"
+#include "gstpwaudiodeviceprovider.h"
+
+
+GST_DEBUG_CATEGORY(pw_audio_device_provider_debug);
+#define GST_CAT_DEFAULT pw_audio_device_provider_debug
+
+
+#define AUDIO_SINK_MEDIA_CLASS "Audio/Sink"
+
+
+
+
+/********** GstPwAudioDevice **********/
+
+
+struct _GstPwAudioDevice
+{
+	GstDevice parent;
+
+	/*< private >*/
+
+	guint32 object_id;
+};
+
+
+struct _GstPwAudioDeviceClass
+{
+	GstDeviceClass parent_class;
+};
+
+
+G_DEFINE_TYPE(GstPwAudioDevice, gst_pw_audio_device, GST_TYPE_DEVICE)
+
+
+static GstElement* gst_pw_audio_device_create_element(GstDevice *device, gchar const *name);
+static gboolean gst_pw_audio_device_reconfigure_element(GstDevice *device, GstElement *element);
+
+
+static void gst_pw_audio_device_class_init(GstPwAudioDeviceClass *klass)
+{
+	GstDeviceClass *device_class;
+
+	device_class = GST_DEVICE_CLASS(klass);
+
+	device_class->create_element = GST_DEBUG_FUNCPTR(gst_pw_audio_device_create_element);
+	device_class->reconfigure_element = GST_DEBUG_FUNCPTR(gst_pw_audio_device_reconfigure_element);
+}
+
+
+static void gst_pw_audio_device_init(GstPwAudioDevice *self)
+{
+	self->object_id = PW_ID_ANY;
+}
+
+
+static GstDevice* gst_pw_audio_device_new(guint32 object_id, gchar const *node_name, gchar const *node_description, GstCaps *caps)
+{
+	GstPwAudioDevice *device;
+	GstStructure *properties;
+	gchar const *display_name;
+
+	if (node_description != NULL)
+		display_name = node_description;
+	else if (node_name != NULL)
+		display_name = node_name;
+	else
+		display_name = "PipeWire audio sink";
+
+	properties = gst_structure_new(
+		"pipewire-proplist",
+		"object.id", G_TYPE_UINT, (guint)object_id,
+		PW_KEY_MEDIA_CLASS, G_TYPE_STRING, AUDIO_SINK_MEDIA_CLASS,
+		NULL
+	);
+	if (node_name != NULL)
+		gst_structure_set(properties, PW_KEY_NODE_NAME, G_TYPE_STRING, node_name, NULL);
+	if (node_description != NULL)
+		gst_structure_set(properties, PW_KEY_NODE_DESCRIPTION, G_TYPE_STRING, node_description, NULL);
+
+	device = GST_PW_AUDIO_DEVICE_CAST(g_object_new(
+		gst_pw_audio_device_get_type(),
+		"display-name", display_name,
+		"caps", caps,
+		"device-class", AUDIO_SINK_MEDIA_CLASS,
+		"properties", properties,
+		NULL
+	));
+	g_assert(device != NULL);
+
+	device->object_id = object_id;
+
+	gst_structure_free(properties);
+
+	return GST_DEVICE_CAST(device);
+}
+
+
+static GstElement* gst_pw_audio_device_create_element(GstDevice *device, gchar const *name)
+{
+	GstElement *element;
+
+	element = gst_element_factory_make("pwaudiosink", name);
+	if (G_UNLIKELY(element == NULL))
+	{
+		GST_ERROR_OBJECT(device, "could not create pwaudiosink element");
+		return NULL;
+	}
+
+	gst_pw_audio_device_reconfigure_element(device, element);
+
+	return element;
+}
+
+
+static gboolean gst_pw_audio_device_reconfigure_element(GstDevice *device, GstElement *element)
+{
+	GstPwAudioDevice *self = GST_PW_AUDIO_DEVICE(device);
+	GstElementFactory *factory;
+	GstCaps *caps;
+
+	factory = gst_element_get_factory(element);
+	if ((factory == NULL) || (strcmp(GST_OBJECT_NAME(factory), "pwaudiosink") != 0))
+	{
+		GST_DEBUG_OBJECT(self, "element %" GST_PTR_FORMAT " is not a pwaudiosink; cannot reconfigure it", (gpointer)element);
+		return FALSE;
+	}
+
+	/* Setting the caps as the custom probed caps means that the
+	 * sink does not have to probe the node again when it starts. */
+	caps = gst_device_get_caps(device);
+	g_object_set(
+		G_OBJECT(element),
+		"target-object-id", (guint)(self->object_id),
+		"custom-probed-caps", caps,
+		NULL
+	);
+	if (caps != NULL)
+		gst_caps_unref(caps);
+
+	return TRUE;
+}
+
+
+
+
+/********** GstPwAudioDeviceProvider **********/
+
+
+typedef enum
+{
+	GST_PW_AUDIO_DEVICE_PROVIDER_NODE_ADDED,
+	GST_PW_AUDIO_DEVICE_PROVIDER_NODE_REMOVED
+}
+GstPwAudioDeviceProviderNodeEventType;
+
+
+typedef struct
+{
+	GstPwAudioDeviceProviderNodeEventType type;
+	guint32 object_id;
+	/* These are only set in NODE_ADDED events. */
+	gchar *node_name;
+	gchar *node_description;
+}
+GstPwAudioDeviceProviderNodeEvent;
+
+
+struct _GstPwAudioDeviceProvider
+{
+	GstDeviceProvider parent;
+
+	/*< private >*/
+
+	/* Probed caps, keyed by node name. This is kept across start/stop
+	 * cycles. Protected by caps_cache_mutex, since both probe() and
+	 * the probing thread access it. */
+	GHashTable *caps_cache;
+	GMutex caps_cache_mutex;
+
+	GstPipewireCore *pipewire_core;
+	struct pw_registry *registry;
+	struct spa_hook registry_listener;
+	GstPwAudioFormatProbe *format_probe;
+
+	/* Audio sink node additions and removals, as reported by the registry.
+	 * These are processed in the probing thread (while the provider is
+	 * started) or in probe(), never in the PipeWire loop thread, since
+	 * probing blocks until the loop thread is done with the test streams.
+	 * known_node_ids contains the IDs of nodes that were reported as added,
+	 * to be able to filter out the removal of unrelated objects. The queue,
+	 * known_node_ids, and stop_probing_thread are protected by node_events_mutex. */
+	GQueue node_events;
+	GHashTable *known_node_ids;
+	GMutex node_events_mutex;
+	GCond node_events_cond;
+	gboolean stop_probing_thread;
+	GThread *probing_thread;
+
+	/* Devices that were added to the provider, keyed by object ID.
+	 * Only accessed by the probing thread while the provider is started. */
+	GHashTable *devices;
+};
+
+
+struct _GstPwAudioDeviceProviderClass
+{
+	GstDeviceProviderClass parent_class;
+};
+
+
+G_DEFINE_TYPE(GstPwAudioDeviceProvider, gst_pw_audio_device_provider, GST_TYPE_DEVICE_PROVIDER)
+
+
+static void gst_pw_audio_device_provider_finalize(GObject *object);
+
+static GList* gst_pw_audio_device_provider_probe(GstDeviceProvider *provider);
+static gboolean gst_pw_audio_device_provider_start(GstDeviceProvider *provider);
+static void gst_pw_audio_device_provider_stop(GstDeviceProvider *provider);
+
+static gboolean gst_pw_audio_device_provider_connect(GstPwAudioDeviceProvider *self);
+static void gst_pw_audio_device_provider_disconnect(GstPwAudioDeviceProvider *self);
+
+static void gst_pw_audio_device_provider_push_node_event_unlocked(GstPwAudioDeviceProvider *self, GstPwAudioDeviceProviderNodeEventType type, guint32 object_id, gchar const *node_name, gchar const *node_description);
+static void gst_pw_audio_device_provider_free_node_event(GstPwAudioDeviceProviderNodeEvent *node_event);
+static void gst_pw_audio_device_provider_clear_node_events(GstPwAudioDeviceProvider *self);
+
+static GstDevice* gst_pw_audio_device_provider_create_device(GstPwAudioDeviceProvider *self, GstPwAudioDeviceProviderNodeEvent const *node_event);
+static gpointer gst_pw_audio_device_provider_probing_thread(gpointer data);
+
+static void gst_pw_audio_device_provider_registry_global(void *data, uint32_t id, uint32_t permissions, const char *type, uint32_t version, const struct spa_dict *props);
+static void gst_pw_audio_device_provider_registry_global_remove(void *data, uint32_t id);
+
+
+static const struct pw_registry_events registry_events =
+{
+	PW_VERSION_REGISTRY_EVENTS,
+	.global = gst_pw_audio_device_provider_registry_global,
+	.global_remove = gst_pw_audio_device_provider_registry_global_remove,
+};
+
+
+static void gst_pw_audio_device_provider_class_init(GstPwAudioDeviceProviderClass *klass)
+{
+	GObjectClass *object_class;
+	GstDeviceProviderClass *device_provider_class;
+
+	GST_DEBUG_CATEGORY_INIT(pw_audio_device_provider_debug, "pwaudiodeviceprovider", 0, "PipeWire audio device provider");
+
+	object_class = G_OBJECT_CLASS(klass);
+	device_provider_class = GST_DEVICE_PROVIDER_CLASS(klass);
+
+	object_class->finalize = GST_DEBUG_FUNCPTR(gst_pw_audio_device_provider_finalize);
+
+	device_provider_class->probe = GST_DEBUG_FUNCPTR(gst_pw_audio_device_provider_probe);
+	device_provider_class->start = GST_DEBUG_FUNCPTR(gst_pw_audio_device_provider_start);
+	device_provider_class->stop = GST_DEBUG_FUNCPTR(gst_pw_audio_device_provider_stop);
+
+	gst_device_provider_class_set_static_metadata(
+		device_provider_class,
+		"pwaudiodeviceprovider",
+		"Sink/Audio",
+		"Lists PipeWire audio sink nodes along with the formats they support",
+		"Carlos Rafael Giani <crg7475@mailbox.org>"
+	);
+}
+
+
+static void gst_pw_audio_device_provider_init(GstPwAudioDeviceProvider *self)
+{
+	self->caps_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)gst_caps_unref);
+	g_mutex_init(&(self->caps_cache_mutex));
+
+	self->pipewire_core = NULL;
+	self->registry = NULL;
+	self->format_probe = NULL;
+
+	g_queue_init(&(self->node_events));
+	self->known_node_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_mutex_init(&(self->node_events_mutex));
+	g_cond_init(&(self->node_events_cond));
+	self->stop_probing_thread = FALSE;
+	self->probing_thread = NULL;
+
+	self->devices = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)gst_object_unref);
+}
+
+
+static void gst_pw_audio_device_provider_finalize(GObject *object)
+{
+	GstPwAudioDeviceProvider *self = GST_PW_AUDIO_DEVICE_PROVIDER(object);
+
+	g_hash_table_unref(self->caps_cache);
+	g_mutex_clear(&(self->caps_cache_mutex));
+
+	gst_pw_audio_device_provider_clear_node_events(self);
+	g_hash_table_unref(self->known_node_ids);
+	g_mutex_clear(&(self->node_events_mutex));
+	g_cond_clear(&(self->node_events_cond));
+
+	g_hash_table_unref(self->devices);
+
+	G_OBJECT_CLASS(gst_pw_audio_device_provider_parent_class)->finalize(object);
+}
+
+
+static GList* gst_pw_audio_device_provider_probe(GstDeviceProvider *provider)
+{
+	GstPwAudioDeviceProvider *self = GST_PW_AUDIO_DEVICE_PROVIDER(provider);
+	GList *devices = NULL;
+	GstPwAudioDeviceProviderNodeEvent *node_event;
+
+	/* Connect, wait until the registry reported all existing nodes, and
+	 * then create the devices right here, since there is no probing thread
+	 * when this is called. Any node that is added after the sync is ignored,
+	 * since probe() is only supposed to produce a snapshot of the graph. */
+
+	if (!gst_pw_audio_device_provider_connect(self))
+		return NULL;
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+	gst_pipewire_core_sync_pw_core(self->pipewire_core);
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+
+	while (TRUE)
+	{
+		g_mutex_lock(&(self->node_events_mutex));
+		node_event = g_queue_pop_head(&(self->node_events));
+		g_mutex_unlock(&(self->node_events_mutex));
+
+		if (node_event == NULL)
+			break;
+
+		switch (node_event->type)
+		{
+			case GST_PW_AUDIO_DEVICE_PROVIDER_NODE_ADDED:
+			{
+				GstDevice *device = gst_pw_audio_device_provider_create_device(self, node_event);
+				if (device != NULL)
+					devices = g_list_prepend(devices, device);
+				break;
+			}
+
+			case GST_PW_AUDIO_DEVICE_PROVIDER_NODE_REMOVED:
+			{
+				GList *list_elem;
+
+				for (list_elem = devices; list_elem != NULL; list_elem = list_elem->next)
+				{
+					GstPwAudioDevice *device = GST_PW_AUDIO_DEVICE_CAST(list_elem->data);
+					if (device->object_id == node_event->object_id)
+					{
+						gst_object_unref(GST_OBJECT(device));
+						devices = g_list_delete_link(devices, list_elem);
+						break;
+					}
+				}
+
+				break;
+			}
+
+			default:
+				g_assert_not_reached();
+		}
+
+		gst_pw_audio_device_provider_free_node_event(node_event);
+	}
+
+	gst_pw_audio_device_provider_disconnect(self);
+
+	return g_list_reverse(devices);
+}
+
+
+static gboolean gst_pw_audio_device_provider_start(GstDeviceProvider *provider)
+{
+	GstPwAudioDeviceProvider *self = GST_PW_AUDIO_DEVICE_PROVIDER(provider);
+
+	if (!gst_pw_audio_device_provider_connect(self))
+		return FALSE;
+
+	self->stop_probing_thread = FALSE;
+	self->probing_thread = g_thread_new("pwaudiodeviceprovider-probing", gst_pw_audio_device_provider_probing_thread, self);
+
+	GST_DEBUG_OBJECT(self, "started device provider");
+
+	return TRUE;
+}
+
+
+static void gst_pw_audio_device_provider_stop(GstDeviceProvider *provider)
+{
+	GstPwAudioDeviceProvider *self = GST_PW_AUDIO_DEVICE_PROVIDER(provider);
+
+	if (self->probing_thread != NULL)
+	{
+		g_mutex_lock(&(self->node_events_mutex));
+		self->stop_probing_thread = TRUE;
+		g_cond_signal(&(self->node_events_cond));
+		g_mutex_unlock(&(self->node_events_mutex));
+
+		/* The probing thread may currently be probing a node. That can
+		 * take a while, so cancel it to let the thread finish quickly. */
+		gst_pw_audio_format_probe_cancel(self->format_probe);
+
+		g_thread_join(self->probing_thread);
+		self->probing_thread = NULL;
+	}
+
+	gst_pw_audio_device_provider_disconnect(self);
+
+	/* The base class removes the devices from its list after
+	 * this function finishes, so just drop our references. */
+	g_hash_table_remove_all(self->devices);
+
+	GST_DEBUG_OBJECT(self, "stopped device provider");
+}
+
+
+static gboolean gst_pw_audio_device_provider_connect(GstPwAudioDeviceProvider *self)
+{
+	self->pipewire_core = gst_pipewire_core_get(-1);
+	if (G_UNLIKELY(self->pipewire_core == NULL))
+	{
+		GST_ERROR_OBJECT(self, "could not get PipeWire core");
+		return FALSE;
+	}
+
+	self->format_probe = gst_pw_audio_format_probe_new(self->pipewire_core);
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+	self->registry = pw_core_get_registry(self->pipewire_core->core, PW_VERSION_REGISTRY, 0);
+	if (self->registry != NULL)
+		pw_registry_add_listener(self->registry, &(self->registry_listener), &registry_events, self);
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+
+	if (G_UNLIKELY(self->registry == NULL))
+	{
+		GST_ERROR_OBJECT(self, "could not get PipeWire registry");
+		gst_pw_audio_device_provider_disconnect(self);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static void gst_pw_audio_device_provider_disconnect(GstPwAudioDeviceProvider *self)
+{
+	if (self->registry != NULL)
+	{
+		pw_thread_loop_lock(self->pipewire_core->loop);
+		spa_hook_remove(&(self->registry_listener));
+		pw_proxy_destroy((struct pw_proxy *)(self->registry));
+		self->registry = NULL;
+		pw_thread_loop_unlock(self->pipewire_core->loop);
+	}
+
+	if (self->format_probe != NULL)
+	{
+		gst_object_unref(GST_OBJECT(self->format_probe));
+		self->format_probe = NULL;
+	}
+
+	if (self->pipewire_core != NULL)
+	{
+		gst_pipewire_core_release(self->pipewire_core);
+		self->pipewire_core = NULL;
+	}
+
+	/* Events that were not processed yet are irrelevant now, since the
+	 * registry reports all existing nodes again the next time. */
+	gst_pw_audio_device_provider_clear_node_events(self);
+}
+
+
+static void gst_pw_audio_device_provider_push_node_event_unlocked(GstPwAudioDeviceProvider *self, GstPwAudioDeviceProviderNodeEventType type, guint32 object_id, gchar const *node_name, gchar const *node_description)
+{
+	GstPwAudioDeviceProviderNodeEvent *node_event = g_new0(GstPwAudioDeviceProviderNodeEvent, 1);
+
+	node_event->type = type;
+	node_event->object_id = object_id;
+	node_event->node_name = g_strdup(node_name);
+	node_event->node_description = g_strdup(node_description);
+
+	g_queue_push_tail(&(self->node_events), node_event);
+	g_cond_signal(&(self->node_events_cond));
+}
+
+
+static void gst_pw_audio_device_provider_free_node_event(GstPwAudioDeviceProviderNodeEvent *node_event)
+{
+	g_free(node_event->node_name);
+	g_free(node_event->node_description);
+	g_free(node_event);
+}
+
+
+static void gst_pw_audio_device_provider_clear_node_events(GstPwAudioDeviceProvider *self)
+{
+	GstPwAudioDeviceProviderNodeEvent *node_event;
+
+	g_mutex_lock(&(self->node_events_mutex));
+
+	while ((node_event = g_queue_pop_head(&(self->node_events))) != NULL)
+		gst_pw_audio_device_provider_free_node_event(node_event);
+	g_hash_table_remove_all(self->known_node_ids);
+
+	g_mutex_unlock(&(self->node_events_mutex));
+}
+
+
+static GstDevice* gst_pw_audio_device_provider_create_device(GstPwAudioDeviceProvider *self, GstPwAudioDeviceProviderNodeEvent const *node_event)
+{
+	GstCaps *caps = NULL;
+	GstDevice *device;
+
+	if (node_event->node_name != NULL)
+	{
+		g_mutex_lock(&(self->caps_cache_mutex));
+		caps = g_hash_table_lookup(self->caps_cache, node_event->node_name);
+		if (caps != NULL)
+			gst_caps_ref(caps);
+		g_mutex_unlock(&(self->caps_cache_mutex));
+	}
+
+	if (caps != NULL)
+	{
+		GST_DEBUG_OBJECT(
+			self,
+			"using cached caps for node \"%s\" with object ID %" G_GUINT32_FORMAT ": %" GST_PTR_FORMAT,
+			node_event->node_name,
+			node_event->object_id,
+			(gpointer)caps
+		);
+	}
+	else
+	{
+		gboolean cancelled = FALSE;
+
+		GST_DEBUG_OBJECT(self, "probing caps of node \"%s\" with object ID %" G_GUINT32_FORMAT, node_event->node_name, node_event->object_id);
+
+		caps = gst_pw_audio_format_probe_caps(self->format_probe, node_event->object_id, &cancelled);
+
+		if (cancelled)
+		{
+			/* Do not cache or use partially probed caps. */
+			GST_DEBUG_OBJECT(self, "probing got cancelled; not creating device");
+			gst_caps_unref(caps);
+			return NULL;
+		}
+
+		if (gst_caps_is_empty(caps))
+		{
+			/* Not caching this, since the node may just have been
+			 * removed while it was being probed. */
+			GST_DEBUG_OBJECT(self, "node with object ID %" G_GUINT32_FORMAT " supports no formats; not creating device", node_event->object_id);
+			gst_caps_unref(caps);
+			return NULL;
+		}
+
+		if (node_event->node_name != NULL)
+		{
+			g_mutex_lock(&(self->caps_cache_mutex));
+			g_hash_table_insert(self->caps_cache, g_strdup(node_event->node_name), gst_caps_ref(caps));
+			g_mutex_unlock(&(self->caps_cache_mutex));
+		}
+	}
+
+	device = gst_pw_audio_device_new(node_event->object_id, node_event->node_name, node_event->node_description, caps);
+	gst_caps_unref(caps);
+
+	return device;
+}
+
+
+static gpointer gst_pw_audio_device_provider_probing_thread(gpointer data)
+{
+	GstPwAudioDeviceProvider *self = GST_PW_AUDIO_DEVICE_PROVIDER_CAST(data);
+	GstDeviceProvider *provider = GST_DEVICE_PROVIDER_CAST(data);
+	GstPwAudioDeviceProviderNodeEvent *node_event;
+
+	GST_DEBUG_OBJECT(self, "probing thread started");
+
+	while (TRUE)
+	{
+		g_mutex_lock(&(self->node_events_mutex));
+		while (!self->stop_probing_thread && g_queue_is_empty(&(self->node_events)))
+			g_cond_wait(&(self->node_events_cond), &(self->node_events_mutex));
+		node_event = self->stop_probing_thread ? NULL : g_queue_pop_head(&(self->node_events));
+		g_mutex_unlock(&(self->node_events_mutex));
+
+		if (node_event == NULL)
+			break;
+
+		switch (node_event->type)
+		{
+			case GST_PW_AUDIO_DEVICE_PROVIDER_NODE_ADDED:
+			{
+				GstDevice *device = gst_pw_audio_device_provider_create_device(self, node_event);
+				if (device == NULL)
+					break;
+
+				GST_DEBUG_OBJECT(self, "adding device %" GST_PTR_FORMAT " for object ID %" G_GUINT32_FORMAT, (gpointer)device, node_event->object_id);
+
+				g_hash_table_insert(self->devices, GUINT_TO_POINTER(node_event->object_id), gst_object_ref(GST_OBJECT(device)));
+				gst_device_provider_device_add(provider, device);
+
+				break;
+			}
+
+			case GST_PW_AUDIO_DEVICE_PROVIDER_NODE_REMOVED:
+			{
+				GstDevice *device = g_hash_table_lookup(self->devices, GUINT_TO_POINTER(node_event->object_id));
+				if (device == NULL)
+					break;
+
+				GST_DEBUG_OBJECT(self, "removing device %" GST_PTR_FORMAT " for object ID %" G_GUINT32_FORMAT, (gpointer)device, node_event->object_id);
+
+				gst_device_provider_device_remove(provider, device);
+				g_hash_table_remove(self->devices, GUINT_TO_POINTER(node_event->object_id));
+
+				break;
+			}
+
+			default:
+				g_assert_not_reached();
+		}
+
+		gst_pw_audio_device_provider_free_node_event(node_event);
+	}
+
+	GST_DEBUG_OBJECT(self, "probing thread stopped");
+
+	return NULL;
+}
+
+
+static void gst_pw_audio_device_provider_registry_global(void *data, uint32_t id, G_GNUC_UNUSED uint32_t permissions, const char *type, G_GNUC_UNUSED uint32_t version, const struct spa_dict *props)
+{
+	GstPwAudioDeviceProvider *self = GST_PW_AUDIO_DEVICE_PROVIDER_CAST(data);
+	char const *media_class;
+	char const *node_name;
+	char const *node_description;
+
+	if ((strcmp(type, PW_TYPE_INTERFACE_Node) != 0) || (props == NULL))
+		return;
+
+	media_class = spa_dict_lookup(props, PW_KEY_MEDIA_CLASS);
+	if ((media_class == NULL) || (strcmp(media_class, AUDIO_SINK_MEDIA_CLASS) != 0))
+		return;
+
+	node_name = spa_dict_lookup(props, PW_KEY_NODE_NAME);
+	node_description = spa_dict_lookup(props, PW_KEY_NODE_DESCRIPTION);
+	if (node_description == NULL)
+		node_description = spa_dict_lookup(props, PW_KEY_NODE_NICK);
+
+	GST_DEBUG_OBJECT(
+		self,
+		"audio sink node added: object ID %" G_GUINT32_FORMAT " name \"%s\" description \"%s\"",
+		id,
+		GST_STR_NULL(node_name),
+		GST_STR_NULL(node_description)
+	);
+
+	g_mutex_lock(&(self->node_events_mutex));
+	g_hash_table_add(self->known_node_ids, GUINT_TO_POINTER(id));
+	gst_pw_audio_device_provider_push_node_event_unlocked(self, GST_PW_AUDIO_DEVICE_PROVIDER_NODE_ADDED, id, node_name, node_description);
+	g_mutex_unlock(&(self->node_events_mutex));
+}
+
+
+static void gst_pw_audio_device_provider_registry_global_remove(void *data, uint32_t id)
+{
+	GstPwAudioDeviceProvider *self = GST_PW_AUDIO_DEVICE_PROVIDER_CAST(data);
+
+	g_mutex_lock(&(self->node_events_mutex));
+
+	if (g_hash_table_remove(self->known_node_ids, GUINT_TO_POINTER(id)))
+	{
+		GST_DEBUG_OBJECT(self, "audio sink node with object ID %" G_GUINT32_FORMAT " removed", id);
+		gst_pw_audio_device_provider_push_node_event_unlocked(self, GST_PW_AUDIO_DEVICE_PROVIDER_NODE_REMOVED, id, NULL, NULL);
+	}
+
+	g_mutex_unlock(&(self->node_events_mutex));
+}
@@ -1574,6 +1574,10 @@ struct _GstPwAudioFormatProbe
 	GCond cond;
 
 	GstPipewireCore *core;
+	/* If TRUE, the probing stream is an input stream that is linked
+	 * to a capture device instead of an output stream that is linked
+	 * to a playback device. */
+	gboolean capture;
 
 	struct pw_stream *probing_stream;
 	struct spa_hook probing_stream_listener;
@@ -1636,6 +1640,7 @@ static void gst_pw_audio_format_probe_init(GstPwAudioFormatProbe *self)
 	g_cond_init(&(self->cond));
 
 	self->core = NULL;
+	self->capture = FALSE;
 	self->probing_stream = NULL;
 	self->cancelled = FALSE;
 }
@@ -1762,6 +1767,10 @@ static void gst_pw_probing_process_stream(void *data)
 
 	g_assert(pw_buf->buffer != NULL);
 
+	/* Captured data is of no interest while probing. */
+	if (self->capture)
+		goto finish;
+
 	if (G_UNLIKELY(pw_buf->buffer->n_datas == 0))
 	{
 		GST_WARNING_OBJECT(self, "dequeued PipeWire buffer has no data");
@@ -1817,6 +1826,27 @@ GstPwAudioFormatProbe* gst_pw_audio_format_probe_new(GstPipewireCore *core)
 }
 
 
+/**
+ * gst_pw_audio_format_probe_new_for_capture:
+ * @core: (transfer none): a #GstPipewireCore
+ *
+ * Create a new #GstPwAudioFormatProbe that probes what the capture
+ * side of the PipeWire graph can deliver.
+ *
+ * This behaves like gst_pw_audio_format_probe_new(), except that the
+ * probing stream is an input stream, which the session manager links
+ * to a capture device instead of a playback device.
+ *
+ * Returns: (transfer full): new #GstPwAudioFormatProbe instance.
+ */
+GstPwAudioFormatProbe* gst_pw_audio_format_probe_new_for_capture(GstPipewireCore *core)
+{
+	GstPwAudioFormatProbe *pw_audio_format_probe = gst_pw_audio_format_probe_new(core);
+	pw_audio_format_probe->capture = TRUE;
+	return pw_audio_format_probe;
+}
+
+
 /**
  * gst_pw_audio_format_probe_setup:
  * @pw_audio_format_probe: a #GstPwAudioFormatProbe
@@ -1849,8 +1879,8 @@ void gst_pw_audio_format_probe_setup(GstPwAudioFormatProbe *pw_audio_format_prob
 
 	probing_stream_props = pw_properties_new(
 		PW_KEY_MEDIA_TYPE, "Audio",
-		PW_KEY_MEDIA_CATEGORY, "Playback",
-		PW_KEY_APP_NAME, "pwaudiosink",
+		PW_KEY_MEDIA_CATEGORY, pw_audio_format_probe->capture ? "Capture" : "Playback",
+		PW_KEY_APP_NAME, pw_audio_format_probe->capture ? "pwaudiosrc" : "pwaudiosink",
 		PW_KEY_NODE_NAME, stream_name,
 		PW_KEY_NODE_DESCRIPTION, "probing stream",
 		NULL
@@ -1967,7 +1997,7 @@ GstPwAudioFormatProbeResult gst_pw_audio_format_probe_probe_audio_type(GstPwAudi
 	pw_thread_loop_lock(pw_audio_format_probe->core->loop);
 	connect_ret = pw_stream_connect(
 		pw_audio_format_probe->probing_stream,
-		PW_DIRECTION_OUTPUT,
+		pw_audio_format_probe->capture ? PW_DIRECTION_INPUT : PW_DIRECTION_OUTPUT,
 		target_object_id,
 		PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS,
 		pw_audio_format_probe->format_params, 1
@@ -2045,3 +2075,134 @@ void gst_pw_audio_format_probe_cancel(GstPwAudioFormatProbe *pw_audio_format_pro
 	g_cond_signal(&(pw_audio_format_probe->cond));
 	g_mutex_unlock(&(pw_audio_format_probe->mutex));
 }
+
+
+/**
+ * gst_pw_audio_format_probe_caps:
+ * @pw_audio_format_probe: a #GstPwAudioFormatProbe
+ * @target_object_id: Object ID of the PipeWire node to probe
+ * @cancelled: Pointer to a gboolean that is set to TRUE if probing got cancelled
+ *
+ * Probes all audio types with gst_pw_audio_format_probe_probe_audio_type()
+ * and assembles caps out of the templates of the supported types. This
+ * takes care of the probe setup and teardown.
+ *
+ * If a DSD format is supported, the probed DSD format is placed first in
+ * the caps' DSD format list. This ensures that upstream prefers this format
+ * and only uses others if necessary, which helps, since those others require
+ * conversion, while the probed format doesn't.
+ *
+ * If probing is cancelled with gst_pw_audio_format_probe_cancel(), *cancelled
+ * is set to TRUE, and the returned caps only contain what was probed until
+ * then. Otherwise, *cancelled is not modified.
+ *
+ * MT safe. This blocks until all audio types were probed.
+ *
+ * Returns: (transfer full): The probed caps.
+ */
+GstCaps* gst_pw_audio_format_probe_caps(GstPwAudioFormatProbe *pw_audio_format_probe, guint32 target_object_id, gboolean *cancelled)
+{
+	GstCaps *probed_caps;
+	gint audio_type;
+	gboolean probing_cancelled = FALSE;
+
+	g_assert(pw_audio_format_probe != NULL);
+	g_assert(cancelled != NULL);
+
+	probed_caps = gst_caps_new_empty();
+
+	gst_pw_audio_format_probe_setup(pw_audio_format_probe);
+
+	for (audio_type = 0; (audio_type < GST_NUM_PIPEWIRE_AUDIO_TYPES) && !probing_cancelled; ++audio_type)
+	{
+		GstPwAudioFormatProbeResult probing_result;
+		GstPwAudioFormat *probed_details = NULL;
+
+		probing_result = gst_pw_audio_format_probe_probe_audio_type(
+			pw_audio_format_probe,
+			audio_type,
+			target_object_id,
+			&probed_details
+		);
+
+		switch (probing_result)
+		{
+			case GST_PW_AUDIO_FORMAT_PROBE_RESULT_SUPPORTED:
+			{
+				switch (audio_type)
+				{
+					case GST_PIPEWIRE_AUDIO_TYPE_DSD:
+					{
+						GstCaps *caps = gst_pw_audio_format_get_template_caps_for_type(audio_type);
+						GstStructure *s = gst_caps_get_structure(caps, 0);
+						GValue list_value = G_VALUE_INIT;
+						GValue string_value = G_VALUE_INIT;
+						gint format_idx;
+
+						g_value_init(&list_value, GST_TYPE_LIST);
+						g_value_init(&string_value, G_TYPE_STRING);
+
+						/* First add the probed format. */
+						g_value_set_static_string(&string_value, gst_dsd_format_to_string(GST_DSD_INFO_FORMAT(&(probed_details->info.dsd_audio_info))));
+						gst_value_list_append_value(&list_value, &string_value);
+
+						/* Now add the rest. */
+						for (format_idx = GST_DSD_FORMAT_U8; format_idx < GST_NUM_DSD_FORMATS; ++format_idx)
+						{
+							GstDsdFormat dsd_format = (GstDsdFormat)format_idx;
+
+							if (dsd_format == GST_DSD_INFO_FORMAT(&(probed_details->info.dsd_audio_info)))
+								continue;
+
+							g_value_set_static_string(&string_value, gst_dsd_format_to_string(dsd_format));
+							gst_value_list_append_value(&list_value, &string_value);
+						}
+
+						gst_structure_set_value(s, "format", &list_value);
+
+						g_value_unset(&list_value);
+						g_value_unset(&string_value);
+
+						gst_caps_append(probed_caps, caps);
+						break;
+					}
+
+					default:
+						gst_caps_append(probed_caps, gst_pw_audio_format_get_template_caps_for_type(audio_type));
+				}
+
+				break;
+			}
+
+			case GST_PW_AUDIO_FORMAT_PROBE_RESULT_CANCELLED:
+				probing_cancelled = TRUE;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+#if !PW_CHECK_VERSION(0, 3, 57)
+	// This is a workaround. Without this, any DSD playback other than DSD64 fails.
+	// It seems that the ALSA SPA sink node is not correctly reinitialized, and "lingers"
+	// in its DSD64 setup (which is used during probing). This leads to this error in the log:
+	//
+	//   pw.context   | [       context.c:  737 pw_context_debug_port_params()] params Spa:Enum:ParamId:EnumFormat: 0:0 Invalid argument (input format (no more input formats))
+	//
+	// By dummy-probing PCM again, the node is forced to reinitialize.
+	//
+	// Reported as: https://gitlab.freedesktop.org/pipewire/pipewire/-/issues/2625
+	// Fixed in version 0.3.57.
+	gst_pw_audio_format_probe_probe_audio_type(pw_audio_format_probe, GST_PIPEWIRE_AUDIO_TYPE_PCM, target_object_id, NULL);
+#endif
+
+	gst_pw_audio_format_probe_teardown(pw_audio_format_probe);
+
+	GST_DEBUG_OBJECT(pw_audio_format_probe, "probed caps for object ID %" G_GUINT32_FORMAT ": %" GST_PTR_FORMAT, target_object_id, (gpointer)probed_caps);
+
+	if (probing_cancelled)
+		*cancelled = TRUE;
+
+	return probed_caps;
+}
@@ -147,10 +147,12 @@ GstPwAudioFormatProbeResult;
 GType gst_pw_audio_format_probe_get_type(void);
 
 GstPwAudioFormatProbe* gst_pw_audio_format_probe_new(GstPipewireCore *core);
+GstPwAudioFormatProbe* gst_pw_audio_format_probe_new_for_capture(GstPipewireCore *core);
 void gst_pw_audio_format_probe_setup(GstPwAudioFormatProbe *pw_audio_format_probe);
 void gst_pw_audio_format_probe_teardown(GstPwAudioFormatProbe *pw_audio_format_probe);
 GstPwAudioFormatProbeResult gst_pw_audio_format_probe_probe_audio_type(GstPwAudioFormatProbe *pw_audio_format_probe, GstPipewireAudioType audio_type, guint32 target_object_id, GstPwAudioFormat **probed_details);
 void gst_pw_audio_format_probe_cancel(GstPwAudioFormatProbe *pw_audio_format_probe);
+GstCaps* gst_pw_audio_format_probe_caps(GstPwAudioFormatProbe *pw_audio_format_probe, guint32 target_object_id, gboolean *cancelled);
 
 
 G_END_DECLS
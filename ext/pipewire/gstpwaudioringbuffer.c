@@ -42,6 +42,17 @@ G_DEFINE_TYPE(GstPwAudioRingBuffer, gst_pw_audio_ring_buffer, GST_TYPE_OBJECT)
 
 static void gst_pw_audio_ring_buffer_dispose(GObject *object);
 
+static void gst_pw_audio_ring_buffer_clear_cursor(GstPwAudioRingBuffer *ring_buffer, GstPwAudioRingBufferCursor *cursor);
+static void gst_pw_audio_ring_buffer_advance_cursor_write_positions(GstPwAudioRingBuffer *ring_buffer, guint64 num_written_frames);
+static void gst_pw_audio_ring_buffer_update_shared_states(GstPwAudioRingBuffer *ring_buffer);
+static gsize gst_pw_audio_ring_buffer_push_frames_internal(GstPwAudioRingBuffer *ring_buffer, gpointer frames, gsize num_frames, gsize *num_silence_frames_to_prepend, GstClockTime pts);
+static void gst_pw_audio_ring_buffer_write_silence_frames(GstPwAudioRingBuffer *ring_buffer, guint64 write_offset, guint64 const *write_lengths);
+static gboolean gst_pw_audio_ring_buffer_add_run(GstPwAudioRingBuffer *ring_buffer, guint64 start, guint64 end, GstClockTime pts, gboolean is_gap);
+static gboolean gst_pw_audio_ring_buffer_read_cursor_frames(GstPwAudioRingBuffer *ring_buffer, GstPwAudioRingBufferCursor *cursor, guint8 *destination, guint64 num_frames);
+static void gst_pw_audio_ring_buffer_read_delayed_frames(GstPwAudioRingBuffer *ring_buffer, guint8 *destination, guint64 position, guint64 read_offset, guint64 num_frames);
+static guint64 gst_pw_audio_ring_buffer_get_num_writable_frames(GstPwAudioRingBuffer *ring_buffer);
+static void gst_pw_audio_ring_buffer_advance_cursor_oldest_frame_pts(GstPwAudioRingBuffer *ring_buffer, GstPwAudioRingBufferCursor *cursor, GstClockTime duration);
+
 
 static void gst_pw_audio_ring_buffer_class_init(GstPwAudioRingBufferClass *klass)
 {
@@ -65,7 +76,17 @@ static void gst_pw_audio_ring_buffer_init(GstPwAudioRingBuffer *self)
 
 	self->oldest_frame_pts = GST_CLOCK_TIME_NONE;
 
-	self->num_pts_delta_history_entries = 0;
+	self->num_cursors = 0;
+
+	self->total_num_written_frames = 0;
+	self->num_runs = 0;
+
+	self->num_channels = 0;
+	self->channel_sample_size = 0;
+	self->channel_delays = NULL;
+	self->channel_read_offsets = NULL;
+	self->silence_frame = NULL;
+	self->max_channel_delay = 0;
 }
 
 
@@ -74,23 +95,62 @@ static void gst_pw_audio_ring_buffer_dispose(GObject *object)
 	GstPwAudioRingBuffer *self = GST_PW_AUDIO_RING_BUFFER(object);
 
 	g_free(self->buffered_frames);
+	g_free(self->channel_delays);
+	g_free(self->channel_read_offsets);
+	g_free(self->silence_frame);
 
 	G_OBJECT_CLASS(gst_pw_audio_ring_buffer_parent_class)->dispose(object);
 }
 
 
 GstPwAudioRingBuffer* gst_pw_audio_ring_buffer_new(GstPwAudioFormat *format, GstClockTime ring_buffer_length)
+{
+	return gst_pw_audio_ring_buffer_new_with_channel_delays(format, ring_buffer_length, NULL, 0);
+}
+
+
+GstPwAudioRingBuffer* gst_pw_audio_ring_buffer_new_with_channel_delays(
+	GstPwAudioFormat *format,
+	GstClockTime ring_buffer_length,
+	guint const *channel_delays,
+	guint num_channel_delays
+)
 {
 	GstPwAudioRingBuffer* ring_buffer;
 	guint64 num_frames;
+	guint64 max_channel_delay = 0;
+	guint num_channels;
+	guint i;
 
 	g_assert(format != NULL);
 	g_assert(GST_CLOCK_TIME_IS_VALID(ring_buffer_length) && (ring_buffer_length > 0));
+	g_assert((channel_delays != NULL) || (num_channel_delays == 0));
+
+	switch (format->audio_type)
+	{
+		case GST_PIPEWIRE_AUDIO_TYPE_PCM:
+			num_channels = GST_AUDIO_INFO_CHANNELS(&(format->info.pcm_audio_info));
+			break;
+
+		case GST_PIPEWIRE_AUDIO_TYPE_DSD:
+			num_channels = GST_DSD_INFO_CHANNELS(&(format->info.dsd_audio_info));
+			break;
 
+		default:
+			num_channels = 0;
+			break;
+	}
+
+	num_channel_delays = MIN(num_channel_delays, num_channels);
+	for (i = 0; i < num_channel_delays; ++i)
+		max_channel_delay = MAX(max_channel_delay, channel_delays[i]);
+
+	/* The frames that are kept for the delayed
+	 * channels come on top of the ring buffer length. */
 	num_frames = gst_pw_audio_format_calculate_num_frames_from_duration(
 		format,
 		ring_buffer_length
-	);
+	) + max_channel_delay;
 
 	ring_buffer = g_object_new(gst_pw_audio_ring_buffer_get_type(), NULL);
 	g_assert(ring_buffer != NULL);
@@ -110,6 +170,31 @@ GstPwAudioRingBuffer* gst_pw_audio_ring_buffer_new(GstPwAudioFormat *format, Gst
 	ring_buffer->ring_buffer_length = ring_buffer_length;
 	ringbuffer_metrics_init(&(ring_buffer->metrics), num_frames);
 
+	if (max_channel_delay > 0)
+	{
+		ring_buffer->num_channels = num_channels;
+		ring_buffer->channel_sample_size = ring_buffer->stride / num_channels;
+		ring_buffer->channel_delays = g_new0(guint64, num_channels);
+		for (i = 0; i < num_channel_delays; ++i)
+			ring_buffer->channel_delays[i] = channel_delays[i];
+		ring_buffer->channel_read_offsets = g_new0(guint64, num_channels);
+		ring_buffer->silence_frame = g_malloc(ring_buffer->stride);
+		gst_pw_audio_format_write_silence_frames(&(ring_buffer->format), ring_buffer->silence_frame, 1);
+		ring_buffer->max_channel_delay = max_channel_delay;
+
+		GST_DEBUG_OBJECT(
+			ring_buffer,
+			"delaying %u channel(s) by up to %" G_GUINT64_FORMAT " frame(s)",
+			num_channel_delays,
+			max_channel_delay
+		);
+	}
+
+	/* Cursor #0 always exists and is always active. */
+	ring_buffer->num_cursors = 1;
+	gst_pw_audio_ring_buffer_clear_cursor(ring_buffer, &(ring_buffer->cursors[0]));
+	ring_buffer->cursors[0].active = TRUE;
+
 	/* Clear the floating flag. */
 	gst_object_ref_sink(GST_OBJECT(ring_buffer));
 
@@ -125,12 +210,19 @@ error:
 
 void gst_pw_audio_ring_buffer_flush(GstPwAudioRingBuffer *ring_buffer)
 {
+	guint i;
+
 	g_assert(ring_buffer != NULL);
 
 	ringbuffer_metrics_reset(&(ring_buffer->metrics));
 	ring_buffer->current_fill_level = 0;
 	ring_buffer->oldest_frame_pts = GST_CLOCK_TIME_NONE;
-	ring_buffer->num_pts_delta_history_entries = 0;
+	ring_buffer->total_num_written_frames = 0;
+	ring_buffer->num_runs = 0;
+
+	/* Flushing affects all cursors, including inactive ones. */
+	for (i = 0; i < ring_buffer->num_cursors; ++i)
+		gst_pw_audio_ring_buffer_clear_cursor(ring_buffer, &(ring_buffer->cursors[i]));
 }
 
 
@@ -141,14 +233,40 @@ gsize gst_pw_audio_ring_buffer_push_frames(
 	gsize *num_silence_frames_to_prepend,
 	GstClockTime pts
 )
+{
+	g_assert(frames != NULL);
+	return gst_pw_audio_ring_buffer_push_frames_internal(ring_buffer, frames, num_frames, num_silence_frames_to_prepend, pts);
+}
+
+
+gsize gst_pw_audio_ring_buffer_push_gap_frames(
+	GstPwAudioRingBuffer *ring_buffer,
+	gsize num_frames,
+	gsize *num_silence_frames_to_prepend,
+	GstClockTime pts
+)
+{
+	return gst_pw_audio_ring_buffer_push_frames_internal(ring_buffer, NULL, num_frames, num_silence_frames_to_prepend, pts);
+}
+
+
+static gsize gst_pw_audio_ring_buffer_push_frames_internal(
+	GstPwAudioRingBuffer *ring_buffer,
+	gpointer frames,
+	gsize num_frames,
+	gsize *num_silence_frames_to_prepend,
+	GstClockTime pts
+)
 {
 	guint64 write_lengths[2];
 	guint64 write_offset;
 	guint64 num_frames_to_write;
 	guint64 num_silence_frames_to_write = 0;
 
+	/* frames is NULL if gap frames are to be pushed. */
+
 	g_assert(ring_buffer != NULL);
-	g_assert(frames != NULL);
+	g_assert(num_silence_frames_to_prepend != NULL);
 	g_assert(num_frames > 0);
 
 	/* Prepending silence frames is required when there is a gap in the
@@ -173,28 +291,33 @@ gsize gst_pw_audio_ring_buffer_push_frames(
 
 	if (G_UNLIKELY(*num_silence_frames_to_prepend > 0))
 	{
-		num_silence_frames_to_write = ringbuffer_metrics_write(&(ring_buffer->metrics), *num_silence_frames_to_prepend, &write_offset, write_lengths);
+		num_silence_frames_to_write = ringbuffer_metrics_write(
+			&(ring_buffer->metrics),
+			MIN(*num_silence_frames_to_prepend, gst_pw_audio_ring_buffer_get_num_writable_frames(ring_buffer)),
+			&write_offset,
+			write_lengths
+		);
 		g_assert(num_silence_frames_to_write <= *num_silence_frames_to_prepend);
 
-		if (write_lengths[0] > 0)
-		{
-			gst_pw_audio_format_write_silence_frames(
-				&(ring_buffer->format),
-				ring_buffer->buffered_frames + write_offset * ring_buffer->stride,
-				write_lengths[0]
-			);
-		}
-		if (write_lengths[1] > 0)
+		/* The prepended silence frames fill a gap in the timestamped data,
+		 * so they are recorded as a gap run. They only need to be actually
+		 * written if the run list is full, or if channels are delayed. */
+		if (!gst_pw_audio_ring_buffer_add_run(
+			ring_buffer,
+			ring_buffer->total_num_written_frames,
+			ring_buffer->total_num_written_frames + num_silence_frames_to_write,
+			GST_CLOCK_TIME_IS_VALID(pts) ? (pts - MIN(pts, gst_pw_audio_format_calculate_duration_from_num_frames(&(ring_buffer->format), num_silence_frames_to_write))) : GST_CLOCK_TIME_NONE,
+			TRUE
+		) || (ring_buffer->channel_delays != NULL))
 		{
-			gst_pw_audio_format_write_silence_frames(
-				&(ring_buffer->format),
-				ring_buffer->buffered_frames,
-				write_lengths[1]
-			);
+			gst_pw_audio_ring_buffer_write_silence_frames(ring_buffer, write_offset, write_lengths);
 		}
+		ring_buffer->total_num_written_frames += num_silence_frames_to_write;
 
 		*num_silence_frames_to_prepend -= num_silence_frames_to_write;
 
+		gst_pw_audio_ring_buffer_advance_cursor_write_positions(ring_buffer, num_silence_frames_to_write);
+
 		ring_buffer->current_fill_level = gst_pw_audio_format_calculate_duration_from_num_frames(
 			&(ring_buffer->format),
 			ring_buffer->metrics.current_num_buffered_frames
@@ -208,7 +331,12 @@ gsize gst_pw_audio_ring_buffer_push_frames(
 		);
 	}
 
-	num_frames_to_write = ringbuffer_metrics_write(&(ring_buffer->metrics), num_frames, &write_offset, write_lengths);
+	num_frames_to_write = ringbuffer_metrics_write(
+		&(ring_buffer->metrics),
+		MIN(num_frames, gst_pw_audio_ring_buffer_get_num_writable_frames(ring_buffer)),
+		&write_offset,
+		write_lengths
+	);
 	g_assert(num_frames_to_write <= num_frames);
 
 	GST_LOG_OBJECT(
@@ -227,27 +355,52 @@ gsize gst_pw_audio_ring_buffer_push_frames(
 		ring_buffer->metrics.capacity
 	);
 
-	if (write_lengths[0] > 0)
+	if (frames != NULL)
 	{
-		memcpy(
-			ring_buffer->buffered_frames + write_offset * ring_buffer->stride,
-			frames,
-			write_lengths[0] * ring_buffer->stride
+		gst_pw_audio_ring_buffer_add_run(
+			ring_buffer,
+			ring_buffer->total_num_written_frames,
+			ring_buffer->total_num_written_frames + num_frames_to_write,
+			pts,
+			FALSE
 		);
+
+		if (write_lengths[0] > 0)
+		{
+			memcpy(
+				ring_buffer->buffered_frames + write_offset * ring_buffer->stride,
+				frames,
+				write_lengths[0] * ring_buffer->stride
+			);
+		}
+		if (write_lengths[1] > 0)
+		{
+			memcpy(
+				ring_buffer->buffered_frames,
+				((guint8 *)frames) + write_lengths[0] * ring_buffer->stride,
+				write_lengths[1] * ring_buffer->stride
+			);
+		}
 	}
-	if (write_lengths[1] > 0)
+	else
 	{
-		memcpy(
-			ring_buffer->buffered_frames,
-			((guint8 *)frames) + write_lengths[0] * ring_buffer->stride,
-			write_lengths[1] * ring_buffer->stride
-		);
+		/* Delayed channels read gap frames from the memory block after
+		 * the gap run was removed, so they need to be written then. */
+		if (!gst_pw_audio_ring_buffer_add_run(
+			ring_buffer,
+			ring_buffer->total_num_written_frames,
+			ring_buffer->total_num_written_frames + num_frames_to_write,
+			pts,
+			TRUE
+		) || (ring_buffer->channel_delays != NULL))
+		{
+			gst_pw_audio_ring_buffer_write_silence_frames(ring_buffer, write_offset, write_lengths);
+		}
 	}
 
-	ring_buffer->current_fill_level = gst_pw_audio_format_calculate_duration_from_num_frames(
-		&(ring_buffer->format),
-		ring_buffer->metrics.current_num_buffered_frames
-	);
+	ring_buffer->total_num_written_frames += num_frames_to_write;
+
+	gst_pw_audio_ring_buffer_advance_cursor_write_positions(ring_buffer, num_frames_to_write);
 
 	/* Set the oldest_frame_pts. To do this, calculate the PTS of the
 	 * *newest* data - that is, the PTS that is right at the end of the buffer
@@ -258,37 +411,50 @@ gsize gst_pw_audio_ring_buffer_push_frames(
 	 * Only do this if no oldest_frame_pts is set yet. This happens at the
 	 * beginning, before the pw dataloop actually started. Once it is going,
 	 * the code in gst_pw_audio_ring_buffer_retrieve_frames() will take care
-	 * of keeping the oldest_frame_pts up to date. */
-	if (GST_CLOCK_TIME_IS_VALID(pts) && !GST_CLOCK_TIME_IS_VALID(ring_buffer->oldest_frame_pts))
+	 * of keeping the oldest_frame_pts up to date.
+	 * This is done per cursor, since each cursor has its own fill level. */
+	if (GST_CLOCK_TIME_IS_VALID(pts))
 	{
-		GstClockTime newest_pts;
-		GstClockTime oldest_frame_pts;
 		GstClockTime duration;
+		guint i;
 
 		duration = gst_pw_audio_format_calculate_duration_from_num_frames(
 			&(ring_buffer->format),
 			num_frames_to_write
 		);
 
-		newest_pts = pts + duration;
-		/* In some corner cases, newest_pts may be behind current_fill_level
-		 * by just 1 nanosecond due to rounding errors in the conversion from
-		 * frames to nanoseconds. Work around this by using MAX(). */
-		newest_pts = MAX(ring_buffer->current_fill_level, newest_pts);
-		oldest_frame_pts = newest_pts - ring_buffer->current_fill_level;
+		for (i = 0; i < ring_buffer->num_cursors; ++i)
+		{
+			GstPwAudioRingBufferCursor *cursor = &(ring_buffer->cursors[i]);
+			GstClockTime newest_pts;
+			GstClockTime oldest_frame_pts;
 
-		GST_DEBUG_OBJECT(
-			ring_buffer,
-			"set oldest frame pts; newest pts: %" GST_TIME_FORMAT " current fill level: %" GST_TIME_FORMAT
-			" => oldest frame pts: %" GST_TIME_FORMAT,
-			GST_TIME_ARGS(newest_pts),
-			GST_TIME_ARGS(ring_buffer->current_fill_level),
-			GST_TIME_ARGS(oldest_frame_pts)
-		);
+			if (!cursor->active || GST_CLOCK_TIME_IS_VALID(cursor->oldest_frame_pts))
+				continue;
+
+			newest_pts = pts + duration;
+			/* In some corner cases, newest_pts may be behind current_fill_level
+			 * by just 1 nanosecond due to rounding errors in the conversion from
+			 * frames to nanoseconds. Work around this by using MAX(). */
+			newest_pts = MAX(cursor->current_fill_level, newest_pts);
+			oldest_frame_pts = newest_pts - cursor->current_fill_level;
+
+			GST_DEBUG_OBJECT(
+				ring_buffer,
+				"set oldest frame pts of cursor #%u; newest pts: %" GST_TIME_FORMAT " current fill level: %" GST_TIME_FORMAT
+				" => oldest frame pts: %" GST_TIME_FORMAT,
+				i,
+				GST_TIME_ARGS(newest_pts),
+				GST_TIME_ARGS(cursor->current_fill_level),
+				GST_TIME_ARGS(oldest_frame_pts)
+			);
 
-		ring_buffer->oldest_frame_pts = oldest_frame_pts;
+			cursor->oldest_frame_pts = oldest_frame_pts;
+		}
 	}
 
+	gst_pw_audio_ring_buffer_update_shared_states(ring_buffer);
+
 	return num_frames_to_write;
 }
 
@@ -302,35 +468,67 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 	GstClockTimeDiff skew_threshold,
 	GstClockTimeDiff *buffered_frames_to_retrieval_pts_delta
 )
+{
+	return gst_pw_audio_ring_buffer_retrieve_frames_with_cursor(
+		ring_buffer,
+		0,
+		destination,
+		num_frames_to_retrieve,
+		retrieval_pts,
+		ring_buffer_data_pts_shift,
+		skew_threshold,
+		buffered_frames_to_retrieval_pts_delta
+	);
+}
+
+
+GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames_with_cursor(
+	GstPwAudioRingBuffer *ring_buffer,
+	guint cursor_index,
+	gpointer destination,
+	gsize num_frames_to_retrieve,
+	GstClockTime retrieval_pts,
+	GstClockTime ring_buffer_data_pts_shift,
+	GstClockTimeDiff skew_threshold,
+	GstClockTimeDiff *buffered_frames_to_retrieval_pts_delta
+)
 {
 	GstPwAudioRingBufferRetrievalResult retval = GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK;
-	guint64 read_lengths[2];
+	GstPwAudioRingBufferCursor *cursor;
 	guint64 actual_num_frames_to_retrieve;
 	GstClockTime expected_retrieval_duration;
 	GstClockTime actual_retrieval_duration;
 
 	g_assert(ring_buffer != NULL);
+	g_assert(cursor_index < ring_buffer->num_cursors);
+	g_assert(ring_buffer->cursors[cursor_index].active);
 	g_assert(destination != NULL);
 	g_assert(num_frames_to_retrieve > 0);
 	g_assert(GST_CLOCK_TIME_IS_VALID(ring_buffer_data_pts_shift));
 	g_assert(skew_threshold >= 0);
 	g_assert(buffered_frames_to_retrieval_pts_delta != NULL);
 
+	cursor = &(ring_buffer->cursors[cursor_index]);
+
 	*buffered_frames_to_retrieval_pts_delta = 0;
 
-	if (G_UNLIKELY(ring_buffer->metrics.current_num_buffered_frames == 0))
+	cursor->num_last_expired_frames = 0;
+	cursor->last_expired_frames_pts = GST_CLOCK_TIME_NONE;
+	cursor->last_expired_frames_lateness = 0;
+
+	if (G_UNLIKELY(cursor->metrics.current_num_buffered_frames == 0))
 	{
-		g_assert(ring_buffer->current_fill_level == 0);
+		g_assert(cursor->current_fill_level == 0);
 		retval = GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_RING_BUFFER_IS_EMPTY;
 		goto finish;
 	}
 
 	expected_retrieval_duration = gst_pw_audio_format_calculate_duration_from_num_frames(&(ring_buffer->format), num_frames_to_retrieve);
 
-	actual_num_frames_to_retrieve = MIN(num_frames_to_retrieve, ring_buffer->metrics.current_num_buffered_frames);
+	actual_num_frames_to_retrieve = MIN(num_frames_to_retrieve, cursor->metrics.current_num_buffered_frames);
 	actual_retrieval_duration = gst_pw_audio_format_calculate_duration_from_num_frames(&(ring_buffer->format), actual_num_frames_to_retrieve);
 
-	if (GST_CLOCK_TIME_IS_VALID(retrieval_pts) && GST_CLOCK_TIME_IS_VALID(ring_buffer->oldest_frame_pts))
+	if (GST_CLOCK_TIME_IS_VALID(retrieval_pts) && GST_CLOCK_TIME_IS_VALID(cursor->oldest_frame_pts))
 	{
 		/* All required timestamps are valid. We can synchronize
 		 * the retrieval against the oldest_frame_pts. */
@@ -353,8 +551,8 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 		 */
 		GstClockTime retrieval_window_start_pts = retrieval_pts;
 		GstClockTime retrieval_window_end_pts = retrieval_window_start_pts + expected_retrieval_duration;
-		GstClockTime buffered_frames_start_pts = ring_buffer->oldest_frame_pts + ring_buffer_data_pts_shift;
-		GstClockTime buffered_frames_end_pts = buffered_frames_start_pts + ring_buffer->current_fill_level;
+		GstClockTime buffered_frames_start_pts = cursor->oldest_frame_pts + ring_buffer_data_pts_shift;
+		GstClockTime buffered_frames_end_pts = buffered_frames_start_pts + cursor->current_fill_level;
 
 		GST_LOG_OBJECT(
 			ring_buffer,
@@ -369,8 +567,8 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 			GST_TIME_ARGS(retrieval_window_start_pts), GST_TIME_ARGS(retrieval_window_end_pts),
 			GST_TIME_ARGS(buffered_frames_start_pts), GST_TIME_ARGS(buffered_frames_end_pts),
 			ring_buffer->stride,
-			ring_buffer->metrics.current_num_buffered_frames,
-			GST_TIME_ARGS(ring_buffer->current_fill_level),
+			cursor->metrics.current_num_buffered_frames,
+			GST_TIME_ARGS(cursor->current_fill_level),
 			num_frames_to_retrieve,
 			actual_num_frames_to_retrieve,
 			GST_TIME_ARGS(expected_retrieval_duration),
@@ -411,7 +609,7 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 			GST_DEBUG_OBJECT(
 				ring_buffer,
 				"buffered frames window is entirely in the past - all %" G_GUINT64_FORMAT " frames have expired",
-				ring_buffer->metrics.current_num_buffered_frames
+				cursor->metrics.current_num_buffered_frames
 			);
 
 			gst_pw_audio_format_write_silence_frames(
@@ -420,6 +618,10 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 				num_frames_to_retrieve
 			);
 
+			cursor->num_last_expired_frames = cursor->metrics.current_num_buffered_frames;
+			cursor->last_expired_frames_pts = cursor->oldest_frame_pts;
+			cursor->last_expired_frames_lateness = retrieval_window_start_pts - buffered_frames_start_pts;
+
 			retval = GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_DATA_FULLY_IN_THE_PAST;
 			goto reset_to_empty_state;
 		}
@@ -429,8 +631,6 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 			GstClockTime duration_of_expired_buffered_frames = 0;
 			GstClockTimeDiff pts_delta, median_pts_delta;
 			gsize num_frames_with_extra_padding;
-			guint64 read_offset;
-			guint64 total_lengths;
 			gsize num_silence_frames_to_prepend = 0;
 			gsize num_silence_frames_to_append = 0;
 			guint8 *dest_ptr = destination;
@@ -462,30 +662,30 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 			 *
 			 * Once the history has 2 values already, a 3-value median can be computed.
 			 */
-			switch (ring_buffer->num_pts_delta_history_entries)
+			switch (cursor->num_pts_delta_history_entries)
 			{
 				case 0:
-					ring_buffer->pts_delta_history[0] = pts_delta;
-					ring_buffer->num_pts_delta_history_entries++;
+					cursor->pts_delta_history[0] = pts_delta;
+					cursor->num_pts_delta_history_entries++;
 					median_pts_delta = pts_delta;
 					break;
 
 				case 1:
-					ring_buffer->pts_delta_history[1] = pts_delta;
-					ring_buffer->num_pts_delta_history_entries++;
-					median_pts_delta = (pts_delta + ring_buffer->pts_delta_history[0]) / 2;
+					cursor->pts_delta_history[1] = pts_delta;
+					cursor->num_pts_delta_history_entries++;
+					median_pts_delta = (pts_delta + cursor->pts_delta_history[0]) / 2;
 					break;
 
 				case 2:
-					ring_buffer->pts_delta_history[2] = pts_delta;
-					ring_buffer->num_pts_delta_history_entries++;
-					median_pts_delta = calculate_3_value_median(ring_buffer->pts_delta_history);
+					cursor->pts_delta_history[2] = pts_delta;
+					cursor->num_pts_delta_history_entries++;
+					median_pts_delta = calculate_3_value_median(cursor->pts_delta_history);
 					break;
 
 				default:
-					memmove(&(ring_buffer->pts_delta_history[0]), &(ring_buffer->pts_delta_history[1]), sizeof(GstClockTimeDiff) * (GST_PW_AUDIO_RING_BUFFER_PTS_DELTA_HISTORY_SIZE - 1));
-					ring_buffer->pts_delta_history[GST_PW_AUDIO_RING_BUFFER_PTS_DELTA_HISTORY_SIZE - 1] = pts_delta;
-					median_pts_delta = calculate_3_value_median(ring_buffer->pts_delta_history);
+					memmove(&(cursor->pts_delta_history[0]), &(cursor->pts_delta_history[1]), sizeof(GstClockTimeDiff) * (GST_PW_AUDIO_RING_BUFFER_PTS_DELTA_HISTORY_SIZE - 1));
+					cursor->pts_delta_history[GST_PW_AUDIO_RING_BUFFER_PTS_DELTA_HISTORY_SIZE - 1] = pts_delta;
+					median_pts_delta = calculate_3_value_median(cursor->pts_delta_history);
 			}
 
 			/* We need to distinguish between two cases:
@@ -522,12 +722,12 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 			if (median_pts_delta < (-skew_threshold))
 			{
 				silence_length = -median_pts_delta;
-				ring_buffer->num_pts_delta_history_entries = 0;
+				cursor->num_pts_delta_history_entries = 0;
 			}
 			else if (median_pts_delta > (+skew_threshold))
 			{
 				duration_of_expired_buffered_frames = median_pts_delta;
-				ring_buffer->num_pts_delta_history_entries = 0;
+				cursor->num_pts_delta_history_entries = 0;
 			}
 			else
 			{
@@ -598,7 +798,7 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 				gsize advance_amount;
 				gsize num_frames_to_flush = gst_pw_audio_format_calculate_num_frames_from_duration(&(ring_buffer->format), duration_of_expired_buffered_frames);
 
-				g_assert(num_frames_to_flush <= ring_buffer->metrics.current_num_buffered_frames);
+				g_assert(num_frames_to_flush <= cursor->metrics.current_num_buffered_frames);
 
 				GST_DEBUG_OBJECT(
 					ring_buffer,
@@ -609,11 +809,15 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 
 				num_frames_to_flush = MIN(num_frames_to_flush, actual_num_frames_to_retrieve);
 
+				cursor->num_last_expired_frames = num_frames_to_flush;
+				cursor->last_expired_frames_pts = cursor->oldest_frame_pts;
+				cursor->last_expired_frames_lateness = duration_of_expired_buffered_frames;
+
 				/* "Flush" by advancing the read pointer. */
-				advance_amount = ringbuffer_metrics_flush(&(ring_buffer->metrics), num_frames_to_flush);
+				advance_amount = ringbuffer_metrics_flush(&(cursor->metrics), num_frames_to_flush);
 				g_assert(advance_amount == num_frames_to_flush);
 
-				if (GST_CLOCK_TIME_IS_VALID(ring_buffer->oldest_frame_pts))
+				if (GST_CLOCK_TIME_IS_VALID(cursor->oldest_frame_pts))
 				{
 					/* The oldest_frame_pts must be updated by the duration that is _actually_
 					 * flushed. This can be less than the originally requested duration, which
@@ -622,21 +826,21 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 					 * take this into account, oldest_frame_pts is advanced by a too high
 					 * duration, and thus causes a significant sudden drift. */
 					GstClockTime flushed_duration = gst_pw_audio_format_calculate_duration_from_num_frames(&(ring_buffer->format), num_frames_to_flush);
-					GstClockTime updated_pts = ring_buffer->oldest_frame_pts + flushed_duration;
+					GstClockTime previous_pts = cursor->oldest_frame_pts;
+
+					gst_pw_audio_ring_buffer_advance_cursor_oldest_frame_pts(ring_buffer, cursor, flushed_duration);
 
 					GST_DEBUG_OBJECT(
 						ring_buffer,
 						"updating oldest queued data PTS: %" GST_TIME_FORMAT " -> %" GST_TIME_FORMAT " (flushed duration: %" GST_TIME_FORMAT ")",
-						GST_TIME_ARGS(ring_buffer->oldest_frame_pts),
-						GST_TIME_ARGS(updated_pts),
+						GST_TIME_ARGS(previous_pts),
+						GST_TIME_ARGS(cursor->oldest_frame_pts),
 						GST_TIME_ARGS(flushed_duration)
 					);
-
-					ring_buffer->oldest_frame_pts = updated_pts;
 				}
 
 				/* Update these quantities since they were calculated with the now-flushed frames included. */
-				actual_num_frames_to_retrieve = MIN(num_frames_to_retrieve, ring_buffer->metrics.current_num_buffered_frames);
+				actual_num_frames_to_retrieve = MIN(num_frames_to_retrieve, cursor->metrics.current_num_buffered_frames);
 				actual_retrieval_duration = gst_pw_audio_format_calculate_duration_from_num_frames(&(ring_buffer->format), actual_num_frames_to_retrieve);
 			}
 
@@ -673,11 +877,7 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 				*buffered_frames_to_retrieval_pts_delta
 			);
 
-			/* Finally, get the read positions and actually extract frames
-			 * from the ring buffer. */ 
-
-			total_lengths = ringbuffer_metrics_read(&(ring_buffer->metrics), actual_num_frames_to_retrieve, &read_offset, read_lengths);
-			g_assert(total_lengths == actual_num_frames_to_retrieve);
+			/* Finally, actually extract frames from the ring buffer. */
 
 			if (num_silence_frames_to_prepend > 0)
 			{
@@ -690,26 +890,9 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 				dest_ptr += num_silence_frames_to_prepend * ring_buffer->stride;
 			}
 
-			if (read_lengths[0] > 0)
-			{
-				memcpy(
-					dest_ptr,
-					ring_buffer->buffered_frames + read_offset * ring_buffer->stride,
-					read_lengths[0] * ring_buffer->stride
-				);
-
-				dest_ptr += read_lengths[0] * ring_buffer->stride;
-			}
-			if (read_lengths[1] > 0)
-			{
-				memcpy(
-					dest_ptr,
-					ring_buffer->buffered_frames,
-					read_lengths[1] * ring_buffer->stride
-				);
-
-				dest_ptr += read_lengths[1] * ring_buffer->stride;
-			}
+			if (gst_pw_audio_ring_buffer_read_cursor_frames(ring_buffer, cursor, dest_ptr, actual_num_frames_to_retrieve))
+				retval = GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES;
+			dest_ptr += actual_num_frames_to_retrieve * ring_buffer->stride;
 
 			/* Append the silence frames if necessary. */
 			if (num_silence_frames_to_append > 0)
@@ -730,28 +913,8 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 		 * or because synced output is turned off. Behave like a simple buffer in
 		 * these cases. */
 
-		guint64 read_offset;
-		guint64 total_lengths;
-
-		total_lengths = ringbuffer_metrics_read(&(ring_buffer->metrics), actual_num_frames_to_retrieve, &read_offset, read_lengths);
-		g_assert(total_lengths == actual_num_frames_to_retrieve);
-
-		if (read_lengths[0] > 0)
-		{
-			memcpy(
-				destination,
-				ring_buffer->buffered_frames + read_offset * ring_buffer->stride,
-				read_lengths[0] * ring_buffer->stride
-			);
-		}
-		if (read_lengths[1] > 0)
-		{
-			memcpy(
-				((guint8 *)destination) + read_lengths[0] * ring_buffer->stride,
-				ring_buffer->buffered_frames,
-				read_lengths[1] * ring_buffer->stride
-			);
-		}
+		if (gst_pw_audio_ring_buffer_read_cursor_frames(ring_buffer, cursor, destination, actual_num_frames_to_retrieve))
+			retval = GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES;
 
 		if (actual_num_frames_to_retrieve < num_frames_to_retrieve)
 		{
@@ -772,9 +935,9 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 			"expected / actual num frames to retrieve: %" G_GSIZE_FORMAT " / %" G_GSIZE_FORMAT "  "
 			"expected / actual retrieval duration: %" GST_TIME_FORMAT " / %" GST_TIME_FORMAT,
 			ring_buffer->stride,
-			ring_buffer->metrics.read_position, ring_buffer->metrics.write_position,
-			ring_buffer->metrics.current_num_buffered_frames,
-			GST_TIME_ARGS(ring_buffer->current_fill_level),
+			cursor->metrics.read_position, cursor->metrics.write_position,
+			cursor->metrics.current_num_buffered_frames,
+			GST_TIME_ARGS(cursor->current_fill_level),
 			num_frames_to_retrieve,
 			actual_num_frames_to_retrieve,
 			GST_TIME_ARGS(expected_retrieval_duration),
@@ -782,22 +945,506 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 		);
 	}
 
-	if (GST_CLOCK_TIME_IS_VALID(ring_buffer->oldest_frame_pts))
-	{
-		/* Increment the oldest PTS since we just retrieved the oldest frame(s).
-		 * That way, this timestamp remains valid for future retrievals. */
-		ring_buffer->oldest_frame_pts += actual_retrieval_duration;
-	}
+	/* Increment the oldest PTS since we just retrieved the oldest frame(s).
+	 * That way, this timestamp remains valid for future retrievals. If the
+	 * cursor entered a new run, its PTS is used instead. */
+	gst_pw_audio_ring_buffer_advance_cursor_oldest_frame_pts(ring_buffer, cursor, actual_retrieval_duration);
 
-	ring_buffer->current_fill_level = gst_pw_audio_format_calculate_duration_from_num_frames(
+	cursor->current_fill_level = gst_pw_audio_format_calculate_duration_from_num_frames(
 		&(ring_buffer->format),
-		ring_buffer->metrics.current_num_buffered_frames
+		cursor->metrics.current_num_buffered_frames
 	);
 
 finish:
+	gst_pw_audio_ring_buffer_update_shared_states(ring_buffer);
 	return retval;
 
 reset_to_empty_state:
-	gst_pw_audio_ring_buffer_flush(ring_buffer);
+	gst_pw_audio_ring_buffer_clear_cursor(ring_buffer, cursor);
+	/* If this leaves no active cursor with buffered frames, reset the
+	 * entire ring buffer to the empty state (which is its initial state). */
+	{
+		gboolean all_cursors_empty = TRUE;
+		guint i;
+
+		for (i = 0; i < ring_buffer->num_cursors; ++i)
+		{
+			if (ring_buffer->cursors[i].active && (ring_buffer->cursors[i].metrics.current_num_buffered_frames > 0))
+			{
+				all_cursors_empty = FALSE;
+				break;
+			}
+		}
+
+		if (all_cursors_empty)
+			gst_pw_audio_ring_buffer_flush(ring_buffer);
+	}
 	goto finish;
 }
+
+
+gint gst_pw_audio_ring_buffer_add_cursor(GstPwAudioRingBuffer *ring_buffer)
+{
+	guint cursor_index;
+
+	g_assert(ring_buffer != NULL);
+
+	if (G_UNLIKELY(ring_buffer->num_cursors >= GST_PW_AUDIO_RING_BUFFER_MAX_NUM_CURSORS))
+	{
+		GST_ERROR_OBJECT(ring_buffer, "cannot add cursor; maximum number of cursors (%d) reached", GST_PW_AUDIO_RING_BUFFER_MAX_NUM_CURSORS);
+		return -1;
+	}
+
+	cursor_index = ring_buffer->num_cursors;
+	ring_buffer->num_cursors++;
+
+	gst_pw_audio_ring_buffer_clear_cursor(ring_buffer, &(ring_buffer->cursors[cursor_index]));
+	ring_buffer->cursors[cursor_index].active = FALSE;
+
+	GST_DEBUG_OBJECT(ring_buffer, "added cursor #%u", cursor_index);
+
+	return cursor_index;
+}
+
+
+void gst_pw_audio_ring_buffer_set_cursor_active(GstPwAudioRingBuffer *ring_buffer, guint cursor_index, gboolean active)
+{
+	GstPwAudioRingBufferCursor *cursor;
+
+	g_assert(ring_buffer != NULL);
+	g_assert(cursor_index < ring_buffer->num_cursors);
+	g_assert((cursor_index != 0) || active);
+
+	cursor = &(ring_buffer->cursors[cursor_index]);
+
+	if (cursor->active == active)
+		return;
+
+	if (active)
+	{
+		/* Pick up the read state of cursor #0. That way, the newly
+		 * activated cursor starts at the same position in the stream
+		 * as the others instead of starting out with an empty buffer.
+		 * The PTS delta history is not carried over, since it is
+		 * specific to the consumer that uses cursor #0. */
+		memcpy(cursor, &(ring_buffer->cursors[0]), sizeof(GstPwAudioRingBufferCursor));
+		cursor->num_pts_delta_history_entries = 0;
+	}
+
+	cursor->active = active;
+
+	GST_DEBUG_OBJECT(ring_buffer, "%s cursor #%u", active ? "activated" : "deactivated", cursor_index);
+
+	gst_pw_audio_ring_buffer_update_shared_states(ring_buffer);
+}
+
+
+void gst_pw_audio_ring_buffer_set_oldest_frame_pts(GstPwAudioRingBuffer *ring_buffer, GstClockTime oldest_frame_pts)
+{
+	guint i;
+	gboolean can_shift;
+	GstClockTimeDiff pts_shift = 0;
+
+	g_assert(ring_buffer != NULL);
+
+	/* The new value applies to cursor #0. The other active cursors may
+	 * be at different positions in the stream, so they are not simply
+	 * set to the same value. Instead, they and the runs are shifted by
+	 * the same amount as cursor #0. If there is no valid old or new
+	 * value to compute the shift from, that is not possible. */
+	can_shift = GST_CLOCK_TIME_IS_VALID(oldest_frame_pts) && GST_CLOCK_TIME_IS_VALID(ring_buffer->cursors[0].oldest_frame_pts);
+	if (can_shift)
+		pts_shift = GST_CLOCK_DIFF(ring_buffer->cursors[0].oldest_frame_pts, oldest_frame_pts);
+
+	for (i = 0; i < ring_buffer->num_runs; ++i)
+	{
+		GstPwAudioRingBufferRun *run = &(ring_buffer->runs[i]);
+
+		if (!GST_CLOCK_TIME_IS_VALID(run->pts))
+			continue;
+
+		if (can_shift)
+		{
+			GstClockTimeDiff shifted_pts = ((GstClockTimeDiff)(run->pts)) + pts_shift;
+			run->pts = (shifted_pts >= 0) ? ((GstClockTime)shifted_pts) : GST_CLOCK_TIME_NONE;
+		}
+		else
+			run->pts = GST_CLOCK_TIME_NONE;
+	}
+
+	for (i = 0; i < ring_buffer->num_cursors; ++i)
+	{
+		GstPwAudioRingBufferCursor *cursor = &(ring_buffer->cursors[i]);
+
+		if (!cursor->active)
+			continue;
+
+		if (can_shift && GST_CLOCK_TIME_IS_VALID(cursor->oldest_frame_pts))
+		{
+			GstClockTimeDiff shifted_pts = ((GstClockTimeDiff)(cursor->oldest_frame_pts)) + pts_shift;
+			cursor->oldest_frame_pts = (shifted_pts >= 0) ? ((GstClockTime)shifted_pts) : GST_CLOCK_TIME_NONE;
+		}
+		else
+			cursor->oldest_frame_pts = oldest_frame_pts;
+	}
+
+	gst_pw_audio_ring_buffer_update_shared_states(ring_buffer);
+}
+
+
+static void gst_pw_audio_ring_buffer_clear_cursor(GstPwAudioRingBuffer *ring_buffer, GstPwAudioRingBufferCursor *cursor)
+{
+	/* Empty the cursor by moving its read position to the
+	 * write position. This does not affect the other cursors. */
+	memcpy(&(cursor->metrics), &(ring_buffer->metrics), sizeof(ringbuffer_metrics));
+	cursor->metrics.read_position = ring_buffer->metrics.write_position;
+	cursor->metrics.current_num_buffered_frames = 0;
+	cursor->current_fill_level = 0;
+	cursor->oldest_frame_pts = GST_CLOCK_TIME_NONE;
+	cursor->num_pts_delta_history_entries = 0;
+}
+
+
+static void gst_pw_audio_ring_buffer_advance_cursor_write_positions(GstPwAudioRingBuffer *ring_buffer, guint64 num_written_frames)
+{
+	guint i;
+
+	/* The shared metrics were just used for writing frames into the
+	 * memory block. Apply that write to the active cursors. Since the
+	 * shared metrics always cover the slowest active cursor, there is
+	 * guaranteed to be enough room in each cursor for these frames. */
+
+	for (i = 0; i < ring_buffer->num_cursors; ++i)
+	{
+		GstPwAudioRingBufferCursor *cursor = &(ring_buffer->cursors[i]);
+
+		if (!cursor->active)
+			continue;
+
+		cursor->metrics.write_position = ring_buffer->metrics.write_position;
+		cursor->metrics.current_num_buffered_frames += num_written_frames;
+		g_assert(cursor->metrics.current_num_buffered_frames <= cursor->metrics.capacity);
+
+		cursor->current_fill_level = gst_pw_audio_format_calculate_duration_from_num_frames(
+			&(ring_buffer->format),
+			cursor->metrics.current_num_buffered_frames
+		);
+	}
+}
+
+
+static void gst_pw_audio_ring_buffer_update_shared_states(GstPwAudioRingBuffer *ring_buffer)
+{
+	GstPwAudioRingBufferCursor *slowest_cursor = NULL;
+	guint i;
+
+	/* The slowest active cursor is the one with the most buffered frames.
+	 * Its read position marks the beginning of the occupied region in
+	 * the memory block. Since cursor #0 is always active, there is
+	 * always at least one cursor to pick. */
+
+	for (i = 0; i < ring_buffer->num_cursors; ++i)
+	{
+		GstPwAudioRingBufferCursor *cursor = &(ring_buffer->cursors[i]);
+
+		if (!cursor->active)
+			continue;
+
+		if ((slowest_cursor == NULL) || (cursor->metrics.current_num_buffered_frames > slowest_cursor->metrics.current_num_buffered_frames))
+			slowest_cursor = cursor;
+	}
+
+	g_assert(slowest_cursor != NULL);
+
+	ring_buffer->metrics.read_position = slowest_cursor->metrics.read_position;
+	ring_buffer->metrics.current_num_buffered_frames = slowest_cursor->metrics.current_num_buffered_frames;
+	ring_buffer->current_fill_level = slowest_cursor->current_fill_level;
+	ring_buffer->oldest_frame_pts = slowest_cursor->oldest_frame_pts;
+
+	/* Remove runs that were read by all active cursors. */
+	{
+		guint64 oldest_position = ring_buffer->total_num_written_frames - ring_buffer->metrics.current_num_buffered_frames;
+		guint num_expired_runs = 0;
+
+		while ((num_expired_runs < ring_buffer->num_runs) && (ring_buffer->runs[num_expired_runs].end <= oldest_position))
+			num_expired_runs++;
+
+		if (num_expired_runs > 0)
+		{
+			ring_buffer->num_runs -= num_expired_runs;
+			memmove(
+				&(ring_buffer->runs[0]),
+				&(ring_buffer->runs[num_expired_runs]),
+				sizeof(GstPwAudioRingBufferRun) * ring_buffer->num_runs
+			);
+		}
+	}
+}
+
+
+static void gst_pw_audio_ring_buffer_write_silence_frames(GstPwAudioRingBuffer *ring_buffer, guint64 write_offset, guint64 const *write_lengths)
+{
+	if (write_lengths[0] > 0)
+	{
+		gst_pw_audio_format_write_silence_frames(
+			&(ring_buffer->format),
+			ring_buffer->buffered_frames + write_offset * ring_buffer->stride,
+			write_lengths[0]
+		);
+	}
+	if (write_lengths[1] > 0)
+	{
+		gst_pw_audio_format_write_silence_frames(
+			&(ring_buffer->format),
+			ring_buffer->buffered_frames,
+			write_lengths[1]
+		);
+	}
+}
+
+
+static gboolean gst_pw_audio_ring_buffer_add_run(GstPwAudioRingBuffer *ring_buffer, guint64 start, guint64 end, GstClockTime pts, gboolean is_gap)
+{
+	GstPwAudioRingBufferRun *run;
+	GstPwAudioRingBufferRun *last_run = NULL;
+
+	/* Returns FALSE if a new run was needed but the list is full.
+	 * In that case, the caller has to write gap frames into
+	 * memory, since they cannot be tracked as a run. */
+
+	if (start == end)
+		return TRUE;
+
+	/* Frames are always appended at the write side, so a new run
+	 * is either adjacent to the last one, or lies after it. */
+	if (ring_buffer->num_runs > 0)
+	{
+		last_run = &(ring_buffer->runs[ring_buffer->num_runs - 1]);
+		g_assert(last_run->end <= start);
+
+		/* Merge with the last run if it is adjacent, of the same type, and
+		 * if the new frames continue its timeline. That is the case if the
+		 * new frames have no PTS, or if their PTS matches the PTS at the end
+		 * of the last run. Otherwise, a new run is started, so the PTS of
+		 * the new frames is kept. One frame of tolerance is allowed, since
+		 * the conversions between frames and nanoseconds introduce rounding
+		 * errors. */
+		if ((last_run->end == start) && (last_run->is_gap == is_gap))
+		{
+			gboolean continues_timeline = TRUE;
+
+			if (GST_CLOCK_TIME_IS_VALID(pts))
+			{
+				if (GST_CLOCK_TIME_IS_VALID(last_run->pts))
+				{
+					GstClockTime last_run_end_pts = last_run->pts + gst_pw_audio_format_calculate_duration_from_num_frames(&(ring_buffer->format), last_run->end - last_run->start);
+					GstClockTime tolerance = gst_pw_audio_format_calculate_duration_from_num_frames(&(ring_buffer->format), 1);
+					continues_timeline = (ABS(GST_CLOCK_DIFF(last_run_end_pts, pts)) <= (GstClockTimeDiff)tolerance);
+				}
+				else
+					continues_timeline = FALSE;
+			}
+
+			if (continues_timeline)
+			{
+				last_run->end = end;
+				return TRUE;
+			}
+		}
+	}
+
+	/* Frames that are not covered by any run are data frames without
+	 * a known PTS. Consequently, a data run without a PTS only needs
+	 * to be recorded if it extends an existing data run. */
+	if (!is_gap && !GST_CLOCK_TIME_IS_VALID(pts))
+		return TRUE;
+
+	if (G_UNLIKELY(ring_buffer->num_runs >= GST_PW_AUDIO_RING_BUFFER_MAX_NUM_RUNS))
+	{
+		GST_DEBUG_OBJECT(
+			ring_buffer,
+			"cannot add %s run %" G_GUINT64_FORMAT " - %" G_GUINT64_FORMAT "; maximum number of runs (%d) reached",
+			is_gap ? "gap" : "data",
+			start, end,
+			GST_PW_AUDIO_RING_BUFFER_MAX_NUM_RUNS
+		);
+		return FALSE;
+	}
+
+	run = &(ring_buffer->runs[ring_buffer->num_runs]);
+	run->start = start;
+	run->end = end;
+	run->pts = pts;
+	run->is_gap = is_gap;
+	ring_buffer->num_runs++;
+
+	return TRUE;
+}
+
+
+static gboolean gst_pw_audio_ring_buffer_read_cursor_frames(GstPwAudioRingBuffer *ring_buffer, GstPwAudioRingBufferCursor *cursor, guint8 *destination, guint64 num_frames)
+{
+	guint64 read_lengths[2];
+	guint64 read_offset;
+	guint64 total_lengths;
+	guint64 position;
+	guint64 end_position;
+	guint run_index = 0;
+	gboolean only_gap_frames = TRUE;
+
+	/* Reads num_frames frames from the cursor into destination. Frames
+	 * that belong to gap runs are not present in memory, so silence is
+	 * written in their place. Returns TRUE if all read frames were gap
+	 * frames. */
+
+	position = ring_buffer->total_num_written_frames - cursor->metrics.current_num_buffered_frames;
+	end_position = position + num_frames;
+
+	total_lengths = ringbuffer_metrics_read(&(cursor->metrics), num_frames, &read_offset, read_lengths);
+	g_assert(total_lengths == num_frames);
+
+	if (ring_buffer->channel_delays != NULL)
+	{
+		/* Gap frames are present in memory if channels are delayed, so the
+		 * runs need not be looked at. The delayed channels may still carry
+		 * data even if all undelayed frames are gap frames, so this is never
+		 * reported as a retrieval of only gap frames. */
+		if (num_frames > 0)
+			gst_pw_audio_ring_buffer_read_delayed_frames(ring_buffer, destination, position, read_offset, num_frames);
+		return FALSE;
+	}
+
+	while (position < end_position)
+	{
+		guint64 segment_end = end_position;
+		guint64 segment_length;
+		gboolean is_gap = FALSE;
+
+		/* Skip runs that lie entirely before the current position. */
+		while ((run_index < ring_buffer->num_runs) && (ring_buffer->runs[run_index].end <= position))
+			run_index++;
+
+		if (run_index < ring_buffer->num_runs)
+		{
+			GstPwAudioRingBufferRun *run = &(ring_buffer->runs[run_index]);
+
+			if (run->start <= position)
+			{
+				is_gap = run->is_gap;
+				segment_end = MIN(segment_end, run->end);
+			}
+			else
+				segment_end = MIN(segment_end, run->start);
+		}
+
+		/* Also split the segment at the point where the memory block wraps around. */
+		segment_end = MIN(segment_end, position + (ring_buffer->metrics.capacity - read_offset));
+		segment_length = segment_end - position;
+
+		if (is_gap)
+		{
+			gst_pw_audio_format_write_silence_frames(&(ring_buffer->format), destination, segment_length);
+		}
+		else
+		{
+			memcpy(
+				destination,
+				ring_buffer->buffered_frames + read_offset * ring_buffer->stride,
+				segment_length * ring_buffer->stride
+			);
+			only_gap_frames = FALSE;
+		}
+
+		destination += segment_length * ring_buffer->stride;
+		read_offset = (read_offset + segment_length) % ring_buffer->metrics.capacity;
+		position = segment_end;
+	}
+
+	return only_gap_frames && (num_frames > 0);
+}
+
+
+static void gst_pw_audio_ring_buffer_read_delayed_frames(GstPwAudioRingBuffer *ring_buffer, guint8 *destination, guint64 position, guint64 read_offset, guint64 num_frames)
+{
+	guint64 capacity = ring_buffer->metrics.capacity;
+	gsize stride = ring_buffer->stride;
+	gsize sample_size = ring_buffer->channel_sample_size;
+	guint num_channels = ring_buffer->num_channels;
+	guint64 frame;
+	guint channel;
+
+	/* Reads num_frames frames, the first of which is located at the given
+	 * absolute position and at read_offset in the memory block. Each channel's
+	 * samples are read from the frame that lies that channel's delay before.
+	 * That frame was already read by the cursor, but the extra frames in the
+	 * memory block ensure that it was not overwritten yet. Frames before
+	 * absolute position 0 date from before the last flush (or were never
+	 * written at all), so silence is read instead of them. */
+
+	for (channel = 0; channel < num_channels; ++channel)
+		ring_buffer->channel_read_offsets[channel] = (read_offset + capacity - ring_buffer->channel_delays[channel]) % capacity;
+
+	for (frame = 0; frame < num_frames; ++frame)
+	{
+		guint8 *dest_frame = destination + frame * stride;
+
+		for (channel = 0; channel < num_channels; ++channel)
+		{
+			guint64 *channel_read_offset = &(ring_buffer->channel_read_offsets[channel]);
+			guint8 const *source_frame;
+
+			if (G_UNLIKELY((position + frame) < ring_buffer->channel_delays[channel]))
+				source_frame = ring_buffer->silence_frame;
+			else
+				source_frame = ring_buffer->buffered_frames + (*channel_read_offset) * stride;
+
+			memcpy(dest_frame + channel * sample_size, source_frame + channel * sample_size, sample_size);
+
+			if (++(*channel_read_offset) == capacity)
+				*channel_read_offset = 0;
+		}
+	}
+}
+
+
+static guint64 gst_pw_audio_ring_buffer_get_num_writable_frames(GstPwAudioRingBuffer *ring_buffer)
+{
+	/* The max_channel_delay frames that the slowest cursor read last
+	 * must not be overwritten, since delayed channels still read them. */
+	guint64 num_occupied_frames = ring_buffer->metrics.current_num_buffered_frames + ring_buffer->max_channel_delay;
+	return (ring_buffer->metrics.capacity > num_occupied_frames) ? (ring_buffer->metrics.capacity - num_occupied_frames) : 0;
+}
+
+
+static void gst_pw_audio_ring_buffer_advance_cursor_oldest_frame_pts(GstPwAudioRingBuffer *ring_buffer, GstPwAudioRingBufferCursor *cursor, GstClockTime duration)
+{
+	guint64 position;
+	guint i;
+
+	if (cursor->metrics.current_num_buffered_frames > 0)
+	{
+		/* If the cursor is now inside a run with a known PTS, derive the
+		 * oldest frame PTS from that run. This re-anchors the cursor
+		 * after gaps and timestamp discontinuities, instead of letting
+		 * it accumulate durations that no longer match the data. */
+
+		position = ring_buffer->total_num_written_frames - cursor->metrics.current_num_buffered_frames;
+
+		for (i = 0; i < ring_buffer->num_runs; ++i)
+		{
+			GstPwAudioRingBufferRun *run = &(ring_buffer->runs[i]);
+
+			if (run->start > position)
+				break;
+
+			if ((run->end > position) && GST_CLOCK_TIME_IS_VALID(run->pts))
+			{
+				cursor->oldest_frame_pts = run->pts + gst_pw_audio_format_calculate_duration_from_num_frames(&(ring_buffer->format), position - run->start);
+				return;
+			}
+		}
+	}
+
+	if (GST_CLOCK_TIME_IS_VALID(cursor->oldest_frame_pts))
+		cursor->oldest_frame_pts += duration;
+}
@@ -66,6 +66,53 @@
  * provide all requested R frames regardless, then the expired frames are flushed, but no
  * silence frames are appended. Same applies to case #4.
  *
+ * The ring buffer supports multiple independent read cursors. This allows for feeding
+ * several consumers (for example, several pw_streams that connect to different targets)
+ * from one ring buffer, without having to store the audio data multiple times. Each
+ * cursor has its own read position, fill level, oldest frame PTS, and PTS delta history,
+ * so synchronization and drift compensation are done per cursor. Cursor #0 always exists
+ * and is the one that is used by gst_pw_audio_ring_buffer_retrieve_frames(). Additional
+ * cursors are added with gst_pw_audio_ring_buffer_add_cursor(). Since the memory block is
+ * shared, the write side is limited by the slowest active cursor; the fill level that is
+ * returned by gst_pw_audio_ring_buffer_get_current_fill_level() is that of the slowest
+ * active cursor. Inactive cursors do not hold back the write side. When a cursor is
+ * (re)activated, it picks up the read state of cursor #0.
+ *
+ * Frames can be marked as gap frames by pushing them with
+ * gst_pw_audio_ring_buffer_push_gap_frames() (typically done for GstBuffers that have
+ * the GST_BUFFER_FLAG_GAP flag set). Silence frames that are prepended to fill a gap
+ * in the timestamped data are also considered gap frames. If all of the frames that
+ * are produced by a retrieval are silence frames, then the retrieval function returns
+ * GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES instead of
+ * GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK. The caller can use this to mark its
+ * output as empty (for example, by setting SPA_CHUNK_FLAG_EMPTY).
+ *
+ * Gap frames and timestamps are tracked in a small sparse index, which is a list of
+ * "runs". A run covers a range of frames, and is either a gap run or a data run.
+ * Gap frames are not written into the memory block; they still occupy their place
+ * in it (so the fill level still covers them, and the producer is still paced by
+ * them), but the retrieval function expands them into silence frames on the fly.
+ * Runs store the PTS of their first frame. Pushed frames are merged into the last
+ * run only if they are of the same type and continue its timeline (that is, if
+ * their PTS matches the PTS at the end of that run). Otherwise, they begin a new
+ * run with their own PTS. The oldest frame PTS of a cursor is derived from the
+ * PTS of the run it currently reads from.
+ * If the run list is full, new gap frames are written as silence frames instead,
+ * and new data runs aren't recorded (the oldest frame PTS of the cursors is then
+ * simply advanced by the retrieved duration across these frames).
+ *
+ * Each channel can be given a delay in frames with
+ * gst_pw_audio_ring_buffer_new_with_channel_delays(). The retrieval then reads
+ * each channel's samples from the frame that lies that many frames before the
+ * frame that is being retrieved. This is done in the same pass that copies the
+ * frames into the destination, so no separate delay lines are needed. For this
+ * purpose, the memory block is enlarged by the largest delay, and that many
+ * frames that were read last by the slowest cursor are kept from being
+ * overwritten. Gap frames are then written as silence frames, since delayed
+ * channels read them from the memory block after the gap run was removed.
+ * Samples that would lie before the first frame since the last flush are
+ * replaced with silence.
+ *
  * Access is not inherently MT safe. Using synchronization primitives is advised.
  */
 
@@ -90,6 +137,8 @@ typedef struct _GstPwAudioRingBufferClass GstPwAudioRingBufferClass;
 
 
 #define GST_PW_AUDIO_RING_BUFFER_PTS_DELTA_HISTORY_SIZE 3
+#define GST_PW_AUDIO_RING_BUFFER_MAX_NUM_CURSORS 8
+#define GST_PW_AUDIO_RING_BUFFER_MAX_NUM_RUNS 32
 
 
 #define GST_TYPE_PW_AUDIO_RING_BUFFER            (gst_pw_audio_ring_buffer_get_type())
@@ -103,6 +152,7 @@ typedef struct _GstPwAudioRingBufferClass GstPwAudioRingBufferClass;
 typedef enum
 {
 	GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK,
+	GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES,
 	GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_RING_BUFFER_IS_EMPTY,
 	GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_DATA_FULLY_IN_THE_FUTURE,
 	GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_DATA_FULLY_IN_THE_PAST,
@@ -111,6 +161,56 @@ typedef enum
 GstPwAudioRingBufferRetrievalResult;
 
 
+typedef struct
+{
+	/* Inactive cursors are not updated when frames are pushed, and
+	 * are not taken into account when computing the shared metrics. */
+	gboolean active;
+
+	/* Per-cursor view of the ring buffer. The write_position and capacity
+	 * are identical in all cursors; read_position and the number of
+	 * buffered frames are specific to this cursor. */
+	ringbuffer_metrics metrics;
+	GstClockTime current_fill_level;
+
+	/* PTS of the oldest frame that this cursor has not read yet.
+	 * See the oldest_frame_pts field in GstPwAudioRingBuffer. */
+	GstClockTime oldest_frame_pts;
+
+	/* Small PTS delta history used for computing a short 3-number median. */
+	GstClockTimeDiff pts_delta_history[GST_PW_AUDIO_RING_BUFFER_PTS_DELTA_HISTORY_SIZE];
+	gint num_pts_delta_history_entries;
+
+	/* Frames that were discarded by the most recent retrieval because they
+	 * expired (they lay in the past relative to the retrieval PTS). The PTS
+	 * is that of the oldest discarded frame, without the data PTS shift that
+	 * was passed to the retrieval function. The lateness is how far that
+	 * frame lay in the past. */
+	guint64 num_last_expired_frames;
+	GstClockTime last_expired_frames_pts;
+	GstClockTime last_expired_frames_lateness;
+}
+GstPwAudioRingBufferCursor;
+
+
+typedef struct
+{
+	/* Range of frames covered by this run, in absolute frame positions
+	 * (see the total_num_written_frames field in GstPwAudioRingBuffer).
+	 * The end position is exclusive. */
+	guint64 start;
+	guint64 end;
+
+	/* PTS of the first frame in this run. Can be GST_CLOCK_TIME_NONE. */
+	GstClockTime pts;
+
+	/* If TRUE, the frames in this run are not stored in the memory
+	 * block, and are expanded into silence frames during retrieval. */
+	gboolean is_gap;
+}
+GstPwAudioRingBufferRun;
+
+
 struct _GstPwAudioRingBuffer
 {
 	GstObject parent;
@@ -124,6 +224,10 @@ struct _GstPwAudioRingBuffer
 
 	guint8 *buffered_frames;
 
+	/* Shared metrics. These describe the region of the memory block that
+	 * is occupied by frames that have not yet been read by all active
+	 * cursors. In other words, the read position and fill level are those
+	 * of the slowest active cursor. Writes are done using these metrics. */
 	ringbuffer_metrics metrics;
 	GstClockTime ring_buffer_length;
 	GstClockTime current_fill_level;
@@ -136,12 +240,38 @@ struct _GstPwAudioRingBuffer
 	 * (= when the clock reaches this timestamp). The buffered frames may lie
 	 * entirely in the future when this timestamp is queried, or entirely in
 	 * the past etc. gst_pw_audio_ring_buffer_retrieve_buffer() checks for
-	 * these cases and acts depending on the value of this timestamp.*/
+	 * these cases and acts depending on the value of this timestamp.
+	 * Like the shared metrics, this is the value of the slowest active cursor. */
 	GstClockTime oldest_frame_pts;
 
-	/* Small PTS delta history used for computing a short 3-number median. */
-	GstClockTimeDiff pts_delta_history[GST_PW_AUDIO_RING_BUFFER_PTS_DELTA_HISTORY_SIZE];
-	gint num_pts_delta_history_entries;
+	GstPwAudioRingBufferCursor cursors[GST_PW_AUDIO_RING_BUFFER_MAX_NUM_CURSORS];
+	guint num_cursors;
+
+	/* Total number of frames that were written into the ring buffer since
+	 * the last flush. This is used as the basis for absolute frame positions.
+	 * The absolute position of the oldest frame that a cursor has not read
+	 * yet is (total_num_written_frames - cursor_num_buffered_frames). */
+	guint64 total_num_written_frames;
+
+	/* Sparse index of the frames that are still in the ring buffer. Runs are
+	 * sorted by position and do not overlap. Frames that are not covered by
+	 * any run are data frames without a known PTS. */
+	GstPwAudioRingBufferRun runs[GST_PW_AUDIO_RING_BUFFER_MAX_NUM_RUNS];
+	guint num_runs;
+
+	/* Per-channel delays, in frames. channel_delays is NULL if no channel
+	 * is delayed. In that case, the other fields are unused. The memory
+	 * block contains max_channel_delay extra frames (which are included
+	 * in metrics.capacity) for the frames that the delayed channels read
+	 * after the cursors have moved past them. channel_read_offsets is
+	 * scratch space for the retrieval, and silence_frame holds one
+	 * frame of silence for samples that lie before the first frame. */
+	guint num_channels;
+	gsize channel_sample_size;
+	guint64 *channel_delays;
+	guint64 *channel_read_offsets;
+	guint8 *silence_frame;
+	guint64 max_channel_delay;
 };
 
 
@@ -155,6 +285,17 @@ GType gst_pw_audio_ring_buffer_get_type(void);
 
 GstPwAudioRingBuffer* gst_pw_audio_ring_buffer_new(GstPwAudioFormat *format, GstClockTime ring_buffer_length);
 
+/* Variant of gst_pw_audio_ring_buffer_new() that delays channel #i by
+ * channel_delays[i] frames. Channels beyond num_channel_delays are not
+ * delayed, and excess entries are ignored. channel_delays can be NULL
+ * if num_channel_delays is 0. */
+GstPwAudioRingBuffer* gst_pw_audio_ring_buffer_new_with_channel_delays(
+	GstPwAudioFormat *format,
+	GstClockTime ring_buffer_length,
+	guint const *channel_delays,
+	guint num_channel_delays
+);
+
 void gst_pw_audio_ring_buffer_flush(GstPwAudioRingBuffer *ring_buffer);
 
 /* Note that num_silence_frames_to_prepend must always be a valid pointer.
@@ -174,6 +315,16 @@ gsize gst_pw_audio_ring_buffer_push_frames(
 	GstClockTime pts
 );
 
+/* Variant of gst_pw_audio_ring_buffer_push_frames() that pushes gap frames.
+ * No source frames are needed, and nothing is written into the memory block;
+ * the frames are recorded as a gap run instead. */
+gsize gst_pw_audio_ring_buffer_push_gap_frames(
+	GstPwAudioRingBuffer *ring_buffer,
+	gsize num_frames,
+	gsize *num_silence_frames_to_prepend,
+	GstClockTime pts
+);
+
 GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 	GstPwAudioRingBuffer *ring_buffer,
 	gpointer destination,
@@ -184,18 +335,98 @@ GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames(
 	GstClockTimeDiff *buffered_frames_to_retrieval_pts_delta
 );
 
+/* Same as gst_pw_audio_ring_buffer_retrieve_frames(), except that the
+ * frames are retrieved through the cursor with the given index. */
+GstPwAudioRingBufferRetrievalResult gst_pw_audio_ring_buffer_retrieve_frames_with_cursor(
+	GstPwAudioRingBuffer *ring_buffer,
+	guint cursor_index,
+	gpointer destination,
+	gsize num_frames_to_retrieve,
+	GstClockTime retrieval_pts,
+	GstClockTime ring_buffer_data_pts_shift,
+	GstClockTimeDiff skew_threshold,
+	GstClockTimeDiff *buffered_frames_to_retrieval_pts_delta
+);
+
+/* Adds a new read cursor. The new cursor is inactive; see
+ * gst_pw_audio_ring_buffer_set_cursor_active(). Returns the index
+ * of the new cursor, or -1 if the maximum number of cursors
+ * (GST_PW_AUDIO_RING_BUFFER_MAX_NUM_CURSORS) is already reached. */
+gint gst_pw_audio_ring_buffer_add_cursor(GstPwAudioRingBuffer *ring_buffer);
+
+/* Activates / deactivates a cursor. Cursor #0 cannot be deactivated.
+ * When a cursor is activated, its read state is copied from cursor #0. */
+void gst_pw_audio_ring_buffer_set_cursor_active(GstPwAudioRingBuffer *ring_buffer, guint cursor_index, gboolean active);
+
+/* Sets the oldest frame PTS of cursor #0. The other active cursors and
+ * the PTS of the runs are shifted by the same amount. If oldest_frame_pts
+ * or the previous value of cursor #0 is invalid, no shift can be computed;
+ * the run PTS are then invalidated, and the cursors get oldest_frame_pts. */
+void gst_pw_audio_ring_buffer_set_oldest_frame_pts(GstPwAudioRingBuffer *ring_buffer, GstClockTime oldest_frame_pts);
+
 static inline GstClockTime gst_pw_audio_ring_buffer_get_oldest_frame_pts(GstPwAudioRingBuffer *ring_buffer)
 {
 	g_assert(ring_buffer != NULL);
 	return ring_buffer->oldest_frame_pts;
 }
 
+static inline GstClockTime gst_pw_audio_ring_buffer_get_cursor_oldest_frame_pts(GstPwAudioRingBuffer *ring_buffer, guint cursor_index)
+{
+	g_assert(ring_buffer != NULL);
+	g_assert(cursor_index < ring_buffer->num_cursors);
+	return ring_buffer->cursors[cursor_index].oldest_frame_pts;
+}
+
 static inline GstClockTime gst_pw_audio_ring_buffer_get_current_fill_level(GstPwAudioRingBuffer *ring_buffer)
 {
 	g_assert(ring_buffer != NULL);
 	return ring_buffer->current_fill_level;
 }
 
+static inline GstClockTime gst_pw_audio_ring_buffer_get_cursor_fill_level(GstPwAudioRingBuffer *ring_buffer, guint cursor_index)
+{
+	g_assert(ring_buffer != NULL);
+	g_assert(cursor_index < ring_buffer->num_cursors);
+	return ring_buffer->cursors[cursor_index].current_fill_level;
+}
+
+static inline guint64 gst_pw_audio_ring_buffer_get_cursor_num_buffered_frames(GstPwAudioRingBuffer *ring_buffer, guint cursor_index)
+{
+	g_assert(ring_buffer != NULL);
+	g_assert(cursor_index < ring_buffer->num_cursors);
+	return ring_buffer->cursors[cursor_index].metrics.current_num_buffered_frames;
+}
+
+/* The returned capacity does not include the extra
+ * frames that are kept for delayed channels. */
+static inline guint64 gst_pw_audio_ring_buffer_get_capacity(GstPwAudioRingBuffer *ring_buffer)
+{
+	g_assert(ring_buffer != NULL);
+	return ring_buffer->metrics.capacity - ring_buffer->max_channel_delay;
+}
+
+/* Returns the number of frames that the most recent retrieval through the
+ * given cursor discarded because they expired. If that number is nonzero,
+ * *pts is set to the PTS of the oldest discarded frame, and *lateness to
+ * how far that frame lay in the past relative to the retrieval PTS. Either
+ * pointer can be NULL. The PTS does not include the ring buffer data PTS
+ * shift that was passed to the retrieval function. */
+static inline guint64 gst_pw_audio_ring_buffer_get_cursor_last_expired_frames(GstPwAudioRingBuffer *ring_buffer, guint cursor_index, GstClockTime *pts, GstClockTime *lateness)
+{
+	GstPwAudioRingBufferCursor const *cursor;
+
+	g_assert(ring_buffer != NULL);
+	g_assert(cursor_index < ring_buffer->num_cursors);
+
+	cursor = &(ring_buffer->cursors[cursor_index]);
+	if (pts != NULL)
+		*pts = cursor->last_expired_frames_pts;
+	if (lateness != NULL)
+		*lateness = cursor->last_expired_frames_lateness;
+
+	return cursor->num_last_expired_frames;
+}
+
 
 G_END_DECLS
 
@@ -39,6 +39,7 @@
 #include <gst/audio/audio.h>
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* Turn off -pedantic to mask the "ISO C forbids braced-groups within expressions"
@@ -46,7 +47,9 @@
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpedantic"
 #include <pipewire/pipewire.h>
+#include <pipewire/extensions/metadata.h>
 #include <spa/node/io.h>
+#include <spa/param/latency-utils.h>
 #include <spa/utils/result.h>
 #pragma GCC diagnostic pop
 
@@ -55,13 +58,31 @@
 #include "gstpwaudioformat.h"
 #include "gstpwaudiosink.h"
 #include "gstpwaudioringbuffer.h"
+#include "gstpwaudiotap.h"
 #include "pi_controller.h"
+#include "discontinuity_accumulator.h"
+#include "level_meter.h"
+#include "rt_safety_checker.h"
+
+
+/* PW_KEY_NODE_ASYNC was introduced in PipeWire 1.2. With older
+ * versions, the property is ignored by the graph. */
+#ifndef PW_KEY_NODE_ASYNC
+#define PW_KEY_NODE_ASYNC "node.async"
+#endif
 
 
 GST_DEBUG_CATEGORY(pw_audio_sink_debug);
 #define GST_CAT_DEFAULT pw_audio_sink_debug
 
 
+/* Keys in the session manager's "default" metadata that specify which
+ * object a stream shall be linked to. Changing these while the stream
+ * is linked causes the session manager to move the stream. */
+#define METADATA_KEY_TARGET_NODE "target.node"
+#define METADATA_KEY_TARGET_OBJECT "target.object"
+
+
 #define COLOR_GREEN "\033[32m"
 #define COLOR_DEFAULT "\033[0m"
 
@@ -74,6 +95,7 @@ enum
 	PROP_ALIGNMENT_THRESHOLD,
 	PROP_SKEW_THRESHOLD,
 	PROP_TARGET_OBJECT_ID,
+	PROP_TARGET_NODE_NAME,
 	PROP_STREAM_PROPERTIES,
 	PROP_SOCKET_FD,
 	PROP_RING_BUFFER_LENGTH,
@@ -86,6 +108,21 @@ enum
 	PROP_USE_GLOBAL_PROBED_CAPS_CACHE,
 	PROP_AUTOCONNECT,
 	PROP_ANNOUNCE_PCM_RATE,
+	PROP_ADDITIONAL_TARGET_OBJECT_IDS,
+	PROP_IDLE_TIMEOUT,
+	PROP_LATENCY_UPDATE_THRESHOLD,
+	PROP_LATENCY_UPDATE_RELATIVE_THRESHOLD,
+	PROP_MIN_LATENCY_UPDATE_INTERVAL,
+	PROP_PLAYED_AUDIO_TAP_LENGTH,
+	PROP_FREEWHEEL,
+	PROP_LEVEL_METERING,
+	PROP_LEVEL_INTERVAL,
+	PROP_FALLBACK_TARGETS,
+	PROP_STATS,
+	PROP_ASYNC_PROCESSING,
+	PROP_SCHEDULED_START_TIME,
+	PROP_SCHEDULED_STOP_TIME,
+	PROP_CHANNEL_DELAYS,
 
 	PROP_LAST
 };
@@ -95,6 +132,7 @@ enum
 #define DEFAULT_ALIGNMENT_THRESHOLD (GST_MSECOND * 40)
 #define DEFAULT_SKEW_THRESHOLD (GST_MSECOND * 1)
 #define DEFAULT_TARGET_OBJECT_ID PW_ID_ANY
+#define DEFAULT_TARGET_NODE_NAME NULL
 #define DEFAULT_STREAM_PROPERTIES NULL
 #define DEFAULT_SOCKET_FD (-1)
 #define DEFAULT_RING_BUFFER_LENGTH 100
@@ -106,13 +144,74 @@ enum
 #define DEFAULT_USE_GLOBAL_PROBED_CAPS_CACHE FALSE
 #define DEFAULT_AUTOCONNECT TRUE
 #define DEFAULT_ANNOUNCE_PCM_RATE TRUE
-
-#define LOCK_AUDIO_DATA_BUFFER_MUTEX(pw_audio_sink) g_mutex_lock(&((pw_audio_sink)->audio_data_buffer_mutex))
+#define DEFAULT_IDLE_TIMEOUT 0
+#define DEFAULT_LATENCY_UPDATE_THRESHOLD (GST_MSECOND * 1)
+#define DEFAULT_LATENCY_UPDATE_RELATIVE_THRESHOLD 0.05
+#define DEFAULT_MIN_LATENCY_UPDATE_INTERVAL (GST_MSECOND * 500)
+#define DEFAULT_PLAYED_AUDIO_TAP_LENGTH 0
+#define DEFAULT_FREEWHEEL FALSE
+#define DEFAULT_LEVEL_METERING GST_PW_AUDIO_SINK_LEVEL_METERING_NONE
+#define DEFAULT_LEVEL_INTERVAL (GST_MSECOND * 100)
+#define DEFAULT_ASYNC_PROCESSING FALSE
+#define DEFAULT_SCHEDULED_START_TIME GST_CLOCK_TIME_NONE
+#define DEFAULT_SCHEDULED_STOP_TIME GST_CLOCK_TIME_NONE
+
+#define AUDIO_SINK_MEDIA_CLASS "Audio/Sink"
+
+/* Cursor #0 of the ring buffer is used by the main pw_stream,
+ * the rest are available for additional pw_streams. */
+#define MAX_NUM_ADDITIONAL_STREAMS (GST_PW_AUDIO_RING_BUFFER_MAX_NUM_CURSORS - 1)
+
+#define LOCK_AUDIO_DATA_BUFFER_MUTEX(pw_audio_sink) RT_SAFETY_CHECKER_MUTEX_LOCK(&((pw_audio_sink)->audio_data_buffer_mutex))
 #define UNLOCK_AUDIO_DATA_BUFFER_MUTEX(pw_audio_sink) g_mutex_unlock(&((pw_audio_sink)->audio_data_buffer_mutex))
 
-#define LOCK_LATENCY_MUTEX(pw_audio_sink) g_mutex_lock(&((pw_audio_sink)->latency_mutex))
+#define LOCK_LATENCY_MUTEX(pw_audio_sink) RT_SAFETY_CHECKER_MUTEX_LOCK(&((pw_audio_sink)->latency_mutex))
 #define UNLOCK_LATENCY_MUTEX(pw_audio_sink) g_mutex_unlock(&((pw_audio_sink)->latency_mutex))
 
+/* How long the played audio tap thread waits for a wakeup signal from the
+ * process callback before it checks the tap for new data anyway. The process
+ * callback does not lock the tap mutex before signaling (it must not block),
+ * so a signal may occasionally be missed. This interval bounds the delay
+ * that such a missed signal can cause. */
+#define PLAYED_AUDIO_TAP_POLL_INTERVAL (20 * G_TIME_SPAN_MILLISECOND)
+
+/* How many times a POSITION query tries to read a consistent position
+ * snapshot before it gives up and falls back to the GstBaseSink logic.
+ * Retries only happen if the snapshot is updated while it is being read,
+ * so this is rarely reached. */
+#define MAX_POSITION_SNAPSHOT_READ_ATTEMPTS 16
+
+/* In freewheel mode, the process callback waits for render() to supply
+ * the frames for the current graph cycle. This bounds that wait, so that
+ * the graph does not stall indefinitely if upstream stops delivering data
+ * without sending EOS. If the wait times out, the quantum is padded with
+ * silence like in an underrun. */
+#define MAX_FREEWHEEL_DATA_WAIT_TIME (500 * G_TIME_SPAN_MILLISECOND)
+
+/* Length of the played audio tap that is used for deferred level metering
+ * if the played-audio-tap-length property does not specify one. */
+#define DEFERRED_LEVEL_METERING_TAP_LENGTH (GST_MSECOND * 200)
+
+/* The QoS proportion is a running average of the ratio between the
+ * duration of the frames that should have been played and the duration
+ * of those that actually were played. Like in GstBaseSink, the average
+ * is taken over roughly this many QoS observations. */
+#define QOS_PROPORTION_AVERAGING_LENGTH 8
+/* Upper limit for the per-observation ratio, to prevent a single long
+ * stall from dominating the running average. */
+#define MAX_QOS_PROPORTION 4.0
+/* Once frames were dropped, QoS events are also sent after this much
+ * audio was played without drops, to let upstream know that it can
+ * gradually stop skipping work. */
+#define QOS_RECOVERY_INTERVAL GST_SECOND
+
+/* Forces a function to be inlined even if it is large and called from
+ * several places. This is used for generating specialized variants of
+ * the raw process callback (see gst_pw_audio_sink_raw_process_stream()),
+ * where the inlining allows the compiler to remove all branches that
+ * depend on the (constant) specialization arguments. */
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
 /* Factors for the PI controller. Empirically picked. */
 #define PI_CONTROLLER_KI_FACTOR 0.01
 #define PI_CONTROLLER_KP_FACTOR 0.15
@@ -122,6 +221,24 @@ enum
 #define MAX_DRIFT_PPM 10000
 
 
+/* Describes what was last handed over to the graph by the raw process
+ * callback. See the position snapshot fields in GstPwAudioSink. */
+typedef struct
+{
+	/* Value of position_epoch at the time this snapshot was published. */
+	gint epoch;
+	/* Running time of the first frame of the quantum. */
+	GstClockTime running_time;
+	/* Duration of the quantum. */
+	GstClockTime duration;
+	/* Monotonic system clock timestamp at which stream_delay was measured
+	 * (this is the value of the "now" field in struct pw_time). */
+	gint64 measurement_time;
+	GstClockTime stream_delay;
+}
+GstPwAudioSinkPositionSnapshot;
+
+
 struct _GstPwAudioSink
 {
 	GstBaseSink parent;
@@ -133,6 +250,7 @@ struct _GstPwAudioSink
 	GstClockTimeDiff alignment_threshold;
 	GstClockTimeDiff skew_threshold;
 	uint32_t target_object_id;
+	gchar *target_node_name;
 	GstStructure *stream_properties;
 	int socket_fd;
 	guint ring_buffer_length_in_ms;
@@ -145,6 +263,18 @@ struct _GstPwAudioSink
 	gboolean use_global_probed_caps_cache;
 	gboolean autoconnect;
 	gboolean announce_pcm_rate;
+	GArray *additional_target_object_ids;
+	guint idle_timeout_in_ms;
+	GstClockTimeDiff latency_update_threshold;
+	gdouble latency_update_relative_threshold;
+	GstClockTimeDiff min_latency_update_interval;
+	guint played_audio_tap_length_in_ms;
+	gboolean freewheel;
+	GstPwAudioSinkLevelMetering level_metering;
+	GstClockTime level_interval;
+	GPtrArray *fallback_targets;
+	gboolean async_processing;
+	GArray *channel_delays;
 
 	/** Playback format **/
 
@@ -152,11 +282,15 @@ struct _GstPwAudioSink
 	GstPwAudioFormat pw_audio_format;
 	GstPwAudioFormatProbe *format_probe;
 	GstDsdInfo actual_dsd_info;
+	/* Set in gst_pw_audio_sink_param_changed() if actual_dsd_info differs
+	 * from the DSD format of the incoming data. This is read by the DSD
+	 * process callback to pick the variant that converts the DSD data.
+	 * It is a gint, not a gboolean, since it is used by the GLib atomic
+	 * functions (the process callback runs in a different thread). */
+	gint dsd_conversion_required;
 	gsize stride;
 	gint dsd_data_rate_multiplier_num;
 	gint dsd_data_rate_multiplier_denom;
-	/* This keeps track of remainders during DSD frame count computation. */
-	gint64 dsd_min_num_required_ticks_remainder;
 	GMutex probe_process_mutex;
 	GstCaps *cached_probed_caps;
 
@@ -170,6 +304,12 @@ struct _GstPwAudioSink
 	GMutex audio_data_buffer_mutex;
 	GCond audio_data_buffer_cond;
 	GstQueueArray *encoded_data_queue;
+	/* Number of frames at the head of the encoded_data_queue that the
+	 * process callback already consumed. The process callback does not
+	 * pop and unref them itself, since unref'ing a buffer may free memory,
+	 * which is not permitted in the realtime thread. Instead, the streaming
+	 * thread releases them. See gst_pw_audio_sink_release_consumed_encoded_frames_unlocked(). */
+	guint num_consumed_encoded_frames;
 	GstClockTime total_queued_encoded_data_duration;
 	gsize dsd_conversion_buffer_size;
 	guint8 *dsd_conversion_buffer;
@@ -178,14 +318,6 @@ struct _GstPwAudioSink
 	 * gst_pw_audio_sink_drain_stream_and_audio_data_buffer() for details. */
 	gboolean draining_ring_buffer;
 
-	/** PCM clock drift compensation states **/
-
-	/* PI controller for filtering the PTS delta that comes from the ring buffer. */
-	PIController pi_controller;
-	/* Timestamp of previous tick to calculate the time_scale that gets
-	 * passed to the pi_controller_compute() function. */
-	GstClockTime previous_time;
-
 	/** Misc playback states **/
 
 	/* Set to 1 during the flush-start event, and back to 0 during the flush-stop one.
@@ -196,9 +328,12 @@ struct _GstPwAudioSink
 	 * the pipeline is paused and gets shut down.
 	 * This is a gint, not a gboolean, since it is used by the GLib atomic functions. */
 	gint paused;
-	/* Set to 1 in the process callback if the stream delay has changed.
-	 * Read in render(). If it is set to 1, the code in render() will
-	 * post a latency message to inform the pipeline about the stream
+	/* Set to 1 in the process callback if the stream delay has changed by
+	 * more than the latency update thresholds, and the minimum interval
+	 * between latency updates has passed (see
+	 * gst_pw_audio_sink_stream_delay_change_is_significant()). Read in
+	 * render(). If it is set to 1, the code in render() will post a
+	 * latency message to inform the pipeline about the stream
 	 * delay (as latency). This is not done directly in the process callback
 	 * because that function must finish as quickly as possible, and
 	 * posting a gstmessage could potentially block that function for
@@ -211,26 +346,11 @@ struct _GstPwAudioSink
 	 * not supported, so doing this saves a little time, because the mutex locks that
 	 * gst_base_sink_get_sync() internally does are avoided. */
 	gboolean do_synced_playback;
-	/* The process callback will pass the current pipeline clock time to
-	 * gst_pw_audio_ring_buffer_retrieve_frames(). If synced_playback_started is FALSE,
-	 * that function will be given a skew threshold of 0, forcing the ring buffer to
-	 * resynchronize itself against that current time. This ensures that this function
-	 * call syncs its output exactly at the beginning of the synchronization, which is
-	 * very important to avoid heavily unsynced output in the beginning. Once this call
-	 * finishes, synced_playback_started is set to TRUE, and the normal skew threshold
-	 * is used, since the skew threshold applies to playback that is already in sync.
-	 * synced_playback_started is set back to FALSE in case of underruns, pw_stream
-	 * output discontinuities (see the pw_time checks in the process callback),
-	 * flush events, and when the ring buffer's data is fully expired.
-	 * Access to this field requires the audio_data_buffer_mutex to be locked
-	 * if the pw_stream is connected. */
-	gboolean synced_playback_started;
-	/* Used for checking the buffer PTS for discontinuities. */
-	GstClockTime expected_next_running_time_pts;
 	/* Pipeline latency in nanoseconds. Set when the latency event
 	 * is processed in send_event(). */
 	GstClockTime latency;
-	/* The latency_mutex synchronizes access to latency and stream_delay_in_ns. */
+	/* The latency_mutex synchronizes access to latency, stream_delay_in_ns,
+	 * and reported_stream_delay_in_ns. */
 	GMutex latency_mutex;
 	/* Set to true in the on_stream_drained() callback. Used for waiting until the
 	 * pw_stream itself is drained. */
@@ -244,18 +364,6 @@ struct _GstPwAudioSink
 	 * in the paused state, but this is not done in this sink - queuing is performed
 	 * in the process callback, which is only called in the streaming state.) */
 	gboolean can_drain;
-	/* Relevant for encoded audio. If the encoded audio frames are larger than the
-	 * requested audio length during a cycle, then this counter keeps track of the
-	 * excess playtime that is sent into the graph. It is not possible to subdivide
-	 * an encoded frame, so if it is longer than the quantum, it still has to be sent
-	 * as-is. By keeping track of the excess, the gst_pw_audio_sink_render_encoded()
-	 * function can produce "null frames" at appropriate times to compensate for the
-	 * excess playtime, avoiding an overflow in the PipeWire sink. */
-	GstClockTime accum_excess_encaudio_playtime;
-	/* This is used for determining when the pw_stream's latency property needs an
-	 * update. The unit is _not_ nanoseconds; rather, it uses rate ticks (rate as in
-	 * the rate field in pw_audio_format.info.encoded_audio_info.rate). */
-	guint64 last_encoded_frame_length;
 
 	/** Element clock **/
 
@@ -292,35 +400,400 @@ struct _GstPwAudioSink
 	/* The pointer to the SPA IO RateMatch is received in the
 	 * io_changed stream event and accessed in the process event. */
 	struct spa_io_rate_match *spa_rate_match;
-	/* The stream delay is originally given in ticks by PipeWire.
-	 * We retain that original quantity to be able to later detect
-	 * changes in the stream delay. */
-	gint64 stream_delay_in_ticks;
 	/* Stream delay in nanoseconds. Access to this quantity
 	 * requires the latency_mutex lock to be taken
 	 * if the pw_stream is connected. */
 	gint64 stream_delay_in_ns;
+	/* The stream delay that is reported to the pipeline as this sink's
+	 * latency in the latency query. Unlike stream_delay_in_ns, this is only
+	 * updated if the delay changed significantly, to avoid flooding the
+	 * pipeline with latency messages when the delay jitters by a few frames.
+	 * The small difference to stream_delay_in_ns is instead compensated for
+	 * when retrieving frames from the audio data buffer, since that uses the
+	 * actual stream_delay_in_ns. Access to this quantity requires the
+	 * latency_mutex lock to be taken if the pw_stream is connected. */
+	gint64 reported_stream_delay_in_ns;
 	/* Quantum size in driver ticks. Set in the io_changed callback
 	 * when it is passed SPA_IO_Position information. */
 	guint64 quantum_size_in_ticks;
 	/* Quantum size in nanoseconds. */
 	guint64 quantum_size_in_ns;
-	/* The value of the pw_time.ticks result of the last pw_stream_get_time_n()
-	 * call in the process callback. The difference between this and the current
-	 * pw_time.ticks result must be <= quantum_size_in_ticks. Otherwise, a
-	 * discontinuity happened (ALSA buffer underrun for example). This allows us
-	 * to detect these discontinuities and resynchronize playback when they happen. */
-	guint64 last_pw_time_ticks;
-	gboolean last_pw_time_ticks_set;
+	/* The latency that was last published as the stream's ProcessLatency
+	 * param, or GST_CLOCK_TIME_NONE if none was published since the stream
+	 * was connected. See gst_pw_audio_sink_update_process_latency_unlocked().
+	 * Access to this field requires the pw_thread_loop_lock to be taken. */
+	GstClockTime published_process_latency;
 	/* Snapshot of GObject property values, done in gst_pw_audio_sink_start().
 	 * This is done to prevent potential race conditions if the user changes
 	 * these properties while they are being read. Making these copies
 	 * eliminates the need for a mutex lock. */
 	GstClockTimeDiff skew_threshold_snapshot;
 	GstClockTime ring_buffer_length_snapshot;
+	GstClockTime idle_timeout_snapshot;
+	GstClockTimeDiff latency_update_threshold_snapshot;
+	gdouble latency_update_relative_threshold_snapshot;
+	GstClockTimeDiff min_latency_update_interval_snapshot;
+	GstClockTime played_audio_tap_length_snapshot;
+	gboolean freewheel_snapshot;
+	GstPwAudioSinkLevelMetering level_metering_snapshot;
+	GstClockTime level_interval_snapshot;
+	gboolean async_processing_snapshot;
+	GArray *channel_delays_snapshot;
+
+	/** Idle suspension **/
+
+	/* Set to 1 by gst_pw_audio_sink_idle_suspend_stream_cb() with the
+	 * audio_data_buffer_mutex taken once it decided to suspend the stream,
+	 * and set back to 0 after the stream was deactivated. The stream is
+	 * deactivated with that mutex released, since pw_stream_set_active()
+	 * waits for the data loop, and the process callback may be waiting
+	 * for the mutex at that point. render() checks this flag to find out
+	 * that a suspension is in progress, and that it therefore has to call
+	 * gst_pw_audio_sink_resume_from_idle_suspension() (which blocks until
+	 * the suspension is done, since it takes the pw_thread_loop_lock).
+	 * This is a gint, not a gboolean, since it is used by the GLib atomic functions. */
+	gint idle_suspending;
+	/* Set to 1 by gst_pw_audio_sink_idle_suspend_stream_cb() after it
+	 * deactivated the stream because the idle timeout was exceeded. That
+	 * is done with the pw_thread_loop_lock and the audio_data_buffer_mutex
+	 * taken. Set back to 0 by gst_pw_audio_sink_activate_stream_unlocked().
+	 * render() reads it without these locks as a fast check.
+	 * This is a gint, not a gboolean, since it is used by the GLib atomic functions. */
+	gint idle_suspended;
+	/* Number of idle suspensions so far, for the stats property.
+	 * Protected by the object lock. */
+	guint num_idle_suspensions;
+
+	/** Additional pw_streams **/
+
+	/* Array of GstPwAudioSinkAdditionalStream pointers, one for each entry in
+	 * the additional-target-object-ids property. Created in start(), destroyed
+	 * in stop(). Only used with PCM audio. */
+	GPtrArray *additional_streams;
+
+	/** Live relinking **/
+
+	/* Registry that is used for finding the session manager's "default"
+	 * metadata object. Created in start(), destroyed in stop(). Access to
+	 * these fields requires the pw_thread_loop_lock to be taken. */
+	struct pw_registry *registry;
+	struct spa_hook registry_listener;
+	/* The "default" metadata object, or NULL if it has not been announced
+	 * by the registry (yet). Setting the target keys in this metadata for
+	 * the stream's node makes the session manager move the stream to a
+	 * new target without having to reconnect it. */
+	struct pw_metadata *default_metadata;
+	uint32_t default_metadata_id;
+	/* Set to 1 by gst_pw_audio_sink_relink_stream() after it requested the
+	 * session manager to move the stream. The process callback then resyncs
+	 * once it sees that the stream's driver or delay changed, which happens
+	 * once the session manager completed the move. Set back to 0 by that
+	 * process callback and by gst_pw_audio_sink_activate_stream_unlocked().
+	 * This is a gint, not a gboolean, since it is used by the GLib atomic functions. */
+	gint relink_pending;
+
+	/** Failover **/
+
+	/* Maps the object IDs of the Audio/Sink nodes that the registry announced
+	 * to their node names (owned strings). linked_target_node_id is the ID of
+	 * the node that the stream is currently linked to, or SPA_ID_INVALID if
+	 * that is not known. It is taken from the registry's link objects. These
+	 * are used for detecting that the target disappeared, and for finding
+	 * the fallback targets. Only accessed in the PipeWire loop thread. */
+	GHashTable *audio_sink_node_names;
+	uint32_t linked_target_node_id;
+	/* Set when a failover is initiated, for measuring how long it takes until
+	 * the stream is linked to the fallback target. failover_start_time is
+	 * GST_CLOCK_TIME_NONE if no failover is ongoing. Only accessed in the
+	 * PipeWire loop thread. */
+	GstClockTime failover_start_time;
+	gchar *failover_target_name;
+	/* Failover statistics for the stats property. Protected by the object lock. */
+	guint num_failovers;
+	GstClockTime last_failover_duration;
+
+	/** Played audio tap **/
+
+	/* If the played-audio-tap-length property is nonzero, the raw process
+	 * callback writes each quantum it produced (including silence and any
+	 * corrections made for synchronization) into this tap. The tap thread
+	 * reads the quanta from the tap and emits them with the played-audio
+	 * signal. The tap and the thread are created in
+	 * gst_pw_audio_sink_setup_audio_data_buffer() and destroyed in
+	 * gst_pw_audio_sink_teardown_audio_data_buffer(). The tap itself is
+	 * lock-free; the mutex and cond are only used by the tap thread for
+	 * waiting. The process callback signals the cond without locking. */
+	GstPwAudioTap *played_audio_tap;
+	GThread *played_audio_tap_thread;
+	GMutex played_audio_tap_mutex;
+	GCond played_audio_tap_cond;
+	gboolean played_audio_tap_thread_running;
+
+	/** Freewheel mode **/
+
+	/* If freewheel_snapshot is TRUE, the process callback waits until the
+	 * ring buffer contains enough frames for the current graph cycle (see
+	 * gst_pw_audio_sink_wait_for_freewheel_data_unlocked()). This is only
+	 * acceptable because a freewheeling graph has no realtime deadline.
+	 * The wait is done with the audio_data_buffer_cond, which render()
+	 * broadcasts after each push in this mode. freewheel_wait_enabled is
+	 * set to 0 by gst_pw_audio_sink_activate_stream_unlocked() before
+	 * the stream gets deactivated. Otherwise, that deactivation could
+	 * deadlock, since pw_stream_set_active() waits for the process
+	 * callback to finish. This is a gint, not a gboolean, since it is
+	 * used by the GLib atomic functions. */
+	gint freewheel_wait_enabled;
+
+	/** QoS **/
+
+	/* Observations that are collected for the QoS events that are sent
+	 * upstream. These are protected by the audio data buffer mutex.
+	 * The process callback accumulates the frames that the ring buffer
+	 * discarded because they expired, along with the PTS of the oldest
+	 * of them and the highest observed lateness, as well as the number
+	 * of frames that were played. The render function takes these
+	 * observations and turns them into QoS events. qos_proportion is
+	 * the running average of the proportion that was last sent. */
+	guint64 qos_num_expired_frames;
+	GstClockTime qos_expired_frames_pts;
+	GstClockTime qos_max_lateness;
+	guint64 qos_num_played_frames;
+	gdouble qos_proportion;
+
+	/** Scheduled start and stop **/
+
+	/* Pipeline clock times at which the first frame is output and after
+	 * which only silence is output (see the scheduled-start-time and
+	 * scheduled-stop-time properties), or GST_CLOCK_TIME_NONE if not armed.
+	 * These are set by set_property(). The process callback only reads them,
+	 * except for disarming scheduled_start_time once the scheduled start
+	 * happened. The stop time stays in effect until it is changed. Access
+	 * to these fields requires the audio_data_buffer_mutex to be locked. */
+	GstClockTime scheduled_start_time;
+	GstClockTime scheduled_stop_time;
+
+	/* The remaining fields are grouped into sections by the thread that
+	 * writes them continuously while playing. The fields above are written
+	 * by the PipeWire loop thread, by property and state changes, and by
+	 * other infrequent events. (The QoS observations are the exception; they
+	 * are written by both the process callback and render(), so they cannot
+	 * be assigned to either section.) Each of the sections below is preceded by
+	 * CACHE_LINE_PADDING, so that fields with different writers never share
+	 * a cache line. The padding does not rely on the instance being aligned
+	 * to a cache line boundary, which GObject does not guarantee. */
+
+	/** Process callback states **/
+
+	/* Owner: the process callbacks, which run in the PipeWire realtime thread
+	 * and write these fields in every graph cycle. Other threads only write
+	 * them to reset them (on flushes and state changes, and during setup),
+	 * with the audio_data_buffer_mutex locked. */
+	CACHE_LINE_PADDING(process_states_padding);
+
+	/* This keeps track of remainders during DSD frame count computation. */
+	gint64 dsd_min_num_required_ticks_remainder;
+	/* The process callback will pass the current pipeline clock time to
+	 * gst_pw_audio_ring_buffer_retrieve_frames(). If synced_playback_started is FALSE,
+	 * that function will be given a skew threshold of 0, forcing the ring buffer to
+	 * resynchronize itself against that current time. This ensures that this function
+	 * call syncs its output exactly at the beginning of the synchronization, which is
+	 * very important to avoid heavily unsynced output in the beginning. Once this call
+	 * finishes, synced_playback_started is set to TRUE, and the normal skew threshold
+	 * is used, since the skew threshold applies to playback that is already in sync.
+	 * synced_playback_started is set back to FALSE in case of underruns, pw_stream
+	 * output discontinuities (see gst_pw_audio_sink_detect_xrun()),
+	 * flush events, and when the ring buffer's data is fully expired.
+	 * Access to this field requires the audio_data_buffer_mutex to be locked
+	 * if the pw_stream is connected. */
+	gboolean synced_playback_started;
+	/* The stream delay is originally given in ticks by PipeWire.
+	 * We retain that original quantity to be able to later detect
+	 * changes in the stream delay. */
+	gint64 stream_delay_in_ticks;
+	/* The clock rate that stream_delay_in_ticks was converted with. */
+	struct spa_fraction stream_delay_rate;
+	/* Monotonic timestamp (taken from pw_time.now) of the last time the
+	 * process callback requested a latency message, or GST_CLOCK_TIME_NONE
+	 * if no such request was made yet. Only accessed by the process callback. */
+	GstClockTime last_latency_update_time;
+	/* The value of the pw_time.ticks result of the last pw_stream_get_time_n()
+	 * call in the process callback. The difference between this and the current
+	 * pw_time.ticks result must be <= quantum_size_in_ticks. Otherwise, a
+	 * discontinuity happened (ALSA buffer underrun for example). This allows us
+	 * to detect these discontinuities and resynchronize playback when they happen.
+	 * Only used if spa_position is not available (see below). */
+	guint64 last_pw_time_ticks;
+	gboolean last_pw_time_ticks_set;
+	/* Clock ID, rate, position, duration, cycle counter, and accumulated
+	 * xrun duration of the graph cycle that was seen in the last process
+	 * callback, taken from spa_position. The next cycle's position must equal
+	 * (last_clock_position + last_clock_duration). This allows for telling
+	 * apart real xruns (which cause gaps in the clock position, cycle counter
+	 * jumps, and/or an increase of the clock's xrun duration) from legitimate
+	 * quantum size changes (which only cause the duration to change). If
+	 * spa_position is not available, the pw_time ticks check is used instead. */
+	guint32 last_clock_id;
+	struct spa_fraction last_clock_rate;
+	guint64 last_clock_position;
+	guint64 last_clock_duration;
+	guint32 last_clock_cycle;
+	guint64 last_clock_xrun;
+	gboolean last_clock_values_set;
+	/* Monotonic timestamp (taken from pw_time.now) of the beginning of the
+	 * current period during which the ring buffer was empty, or
+	 * GST_CLOCK_TIME_NONE if the ring buffer is not empty. Only accessed
+	 * by the process callback, and reset in
+	 * gst_pw_audio_sink_activate_stream_unlocked() before activating. */
+	GstClockTime idle_start_time;
+	/* Set to TRUE by the process callback once it asked for the stream to
+	 * be suspended, to not ask again in each subsequent process callback. */
+	gboolean idle_suspension_requested;
+	/* Relevant for encoded audio. If the encoded audio frames are larger than the
+	 * requested audio length during a cycle, then this counter keeps track of the
+	 * excess playtime that is sent into the graph. It is not possible to subdivide
+	 * an encoded frame, so if it is longer than the quantum, it still has to be sent
+	 * as-is. By keeping track of the excess, the gst_pw_audio_sink_render_encoded()
+	 * function can produce "null frames" at appropriate times to compensate for the
+	 * excess playtime, avoiding an overflow in the PipeWire sink. */
+	GstClockTime accum_excess_encaudio_playtime;
+	/* Once the scheduled start happened, scheduled_start_offset stays in
+	 * effect until the next flush. That offset is subtracted from the pipeline
+	 * clock time when retrieving frames, so that the oldest frame in the ring
+	 * buffer at the time the start was armed is output at scheduled_start_time.
+	 * scheduled_stop_announced prevents the stop message from being posted in
+	 * every cycle. Access to these fields requires the audio_data_buffer_mutex
+	 * to be locked. (See the scheduled start and stop section above.) */
+	GstClockTimeDiff scheduled_start_offset;
+	gboolean scheduled_start_offset_set;
+	gboolean scheduled_stop_announced;
+
+	/** PCM clock drift compensation states **/
+
+	/* PI controller for filtering the PTS delta that comes from the ring buffer. */
+	PIController pi_controller;
+	/* Timestamp of previous tick to calculate the time_scale that gets
+	 * passed to the pi_controller_compute() function. */
+	GstClockTime previous_time;
+
+	/** Position snapshot **/
+
+	/* POSITION queries are answered from position_snapshot and from
+	 * position_segment (see the render states below) without taking any
+	 * locks. position_snapshot is published by the raw process callback
+	 * after each quantum that was produced from the ring buffer. It is
+	 * guarded by a seqlock (see seqlock_write_begin() in utils.h) instead
+	 * of a mutex. position_snapshot_seqnum is used by the GLib atomic
+	 * functions. */
+	GstPwAudioSinkPositionSnapshot position_snapshot;
+	gint position_snapshot_seqnum;
+
+	/** Level metering **/
+
+	/* Owner: the raw process callback in realtime mode, or the played audio
+	 * tap thread in deferred mode. Since the latter is not the process
+	 * callback, these fields get their own section.
+	 *
+	 * active_level_metering is the level metering mode that is actually used
+	 * with the current caps. This is set by gst_pw_audio_sink_setup_audio_data_buffer().
+	 * It differs from level_metering_snapshot if the current caps are not
+	 * supported by the level meter (DSD audio or an unsupported sample format
+	 * for example), in which case it is GST_PW_AUDIO_SINK_LEVEL_METERING_NONE.
+	 * The other fields are only accessed by their owner, so they need no
+	 * synchronization. level_interval_start_time is the pipeline clock time
+	 * at which the first frame of the current metering interval is output. */
+	CACHE_LINE_PADDING(level_metering_padding);
+
+	GstPwAudioSinkLevelMetering active_level_metering;
+	LevelMeter level_meter;
+	GstAudioFormat level_meter_format;
+	guint64 level_interval_num_frames;
+	GstClockTime level_interval_start_time;
+
+	/** Render states **/
+
+	/* Owner: the streaming thread, which writes these fields in render()
+	 * for each incoming buffer, and in the event handler. */
+	CACHE_LINE_PADDING(render_states_padding);
+
+	/* Keeps track of the output timeline for checking the buffer PTS for
+	 * discontinuities. Filters out discontinuities that cancel each other out
+	 * over time, so that only persistent ones cause silence insertion or clipping. */
+	DiscontinuityAccumulator discontinuity_accumulator;
+	/* This is used for determining when the pw_stream's latency property needs an
+	 * update. The unit is _not_ nanoseconds; rather, it uses rate ticks (rate as in
+	 * the rate field in pw_audio_format.info.encoded_audio_info.rate). */
+	guint64 last_encoded_frame_length;
+	/* position_segment is a copy of the segment that is published by
+	 * gst_pw_audio_sink_event() when a SEGMENT event arrives; it is needed
+	 * for converting the running time of position_snapshot to a stream time.
+	 * Like position_snapshot, it is guarded by a seqlock. position_epoch is
+	 * incremented to invalidate the current position snapshot (for example
+	 * when flushing). These gints are used by the GLib atomic functions. */
+	GstSegment position_segment;
+	gint position_segment_seqnum;
+	gint position_epoch;
+
+	/* Keeps the render states from sharing a cache line with
+	 * whatever is allocated after the instance. */
+	CACHE_LINE_PADDING(end_padding);
 };
 
 
+/* Results of one level metering interval. In realtime mode, these are
+ * passed from the process callback to the pw_thread_loop, which then
+ * posts them as an element message. */
+typedef struct
+{
+	LevelMeter level_meter;
+	GstClockTime start_time;
+	GstClockTime duration;
+}
+GstPwAudioSinkLevelResults;
+
+
+/* Passed from the process callback to the pw_thread_loop, which
+ * then posts the corresponding scheduled start/stop message. */
+typedef struct
+{
+	gboolean is_stop;
+	GstClockTime time;
+}
+GstPwAudioSinkScheduledEvent;
+
+
+/* An additional pw_stream plays the same PCM audio data as the main pw_stream,
+ * but is connected to a different target object. It reads from the shared
+ * ring buffer through its own ring buffer cursor, and compensates for drift
+ * between its driver and the pipeline clock with its own PI controller and
+ * rate match. Unlike the main pw_stream, it does not drive the stream clock,
+ * and its delay does not factor into the latency that is reported upstream.
+ * Instead, its process callback shifts the retrieval PTS by its own delay,
+ * so that its output is aligned with that of the main pw_stream. */
+typedef struct
+{
+	GstPwAudioSink *sink;
+	uint32_t target_object_id;
+
+	struct pw_stream *stream;
+	gboolean stream_is_connected;
+	struct spa_hook stream_listener;
+	gboolean stream_listener_added;
+	struct spa_io_position *spa_position;
+	struct spa_io_rate_match *spa_rate_match;
+
+	/* Index of the ring buffer cursor this stream reads from, or -1 if no
+	 * cursor is assigned. Access to this field and to synced_playback_started
+	 * requires the audio_data_buffer_mutex to be locked if the pw_stream
+	 * is connected. */
+	gint cursor_index;
+	gboolean synced_playback_started;
+
+	PIController pi_controller;
+	GstClockTime previous_time;
+}
+GstPwAudioSinkAdditionalStream;
+
+
 struct _GstPwAudioSinkClass
 {
 	GstBaseSinkClass parent_class;
@@ -333,12 +806,23 @@ struct _GstPwAudioSinkClass
 	 * passed along to let callers know what format the pw_stream is using.
 	 * This can be important when playing extremely short tracks. */
 	void (*stream_activated)(GstElement *element, GstCaps *sink_caps);
+
+	/* Signal that gets emitted for each quantum that the pw_stream played
+	 * if the played-audio-tap-length property is nonzero. The buffer contains
+	 * the exact audio data that was sent to the graph, in the format that is
+	 * given by the sink caps. Its PTS is the pipeline clock time at which its
+	 * first frame is expected to be output. The GAP flag is set if the quantum
+	 * consisted of silence only, the DISCONT flag if preceding quanta were
+	 * dropped because the tap was full. This signal is emitted from a
+	 * separate thread, never from the PipeWire realtime thread. */
+	void (*played_audio)(GstElement *element, GstBuffer *buffer);
 };
 
 
 enum
 {
 	SIGNAL_STREAM_ACTIVATED,
+	SIGNAL_PLAYED_AUDIO,
 	LAST_SIGNAL
 };
 
@@ -352,6 +836,28 @@ GstCaps *global_cached_probed_caps = NULL;
 G_DEFINE_TYPE(GstPwAudioSink, gst_pw_audio_sink, GST_TYPE_BASE_SINK)
 
 
+GType gst_pw_audio_sink_level_metering_get_type(void)
+{
+	static gsize level_metering_type = 0;
+
+	if (g_once_init_enter(&level_metering_type))
+	{
+		static GEnumValue const level_metering_values[] =
+		{
+			{ GST_PW_AUDIO_SINK_LEVEL_METERING_NONE, "No level metering", "none" },
+			{ GST_PW_AUDIO_SINK_LEVEL_METERING_REALTIME, "Meter levels in the PipeWire process callback", "realtime" },
+			{ GST_PW_AUDIO_SINK_LEVEL_METERING_DEFERRED, "Meter levels in a separate thread", "deferred" },
+			{ 0, NULL, NULL }
+		};
+
+		GType type = g_enum_register_static("GstPwAudioSinkLevelMetering", level_metering_values);
+		g_once_init_leave(&level_metering_type, type);
+	}
+
+	return level_metering_type;
+}
+
+
 static void gst_pw_audio_sink_dispose(GObject *object);
 static void gst_pw_audio_sink_finalize(GObject *object);
 static void gst_pw_audio_sink_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec);
@@ -382,6 +888,7 @@ static GstFlowReturn gst_pw_audio_sink_render(GstBaseSink *basesink, GstBuffer *
 
 static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffer *original_incoming_buffer);
 static GstFlowReturn gst_pw_audio_sink_render_encoded(GstPwAudioSink *self, GstBuffer *original_incoming_buffer);
+static void gst_pw_audio_sink_release_consumed_encoded_frames_unlocked(GstPwAudioSink *self);
 
 static gboolean gst_pw_audio_sink_handle_convert_query(GstPwAudioSink *self, GstQuery *query);
 
@@ -389,6 +896,7 @@ static void gst_pw_audio_sink_set_provide_clock_flag(GstPwAudioSink *self, gbool
 static gboolean gst_pw_audio_sink_get_provide_clock_flag(GstPwAudioSink *self);
 
 static void gst_pw_audio_sink_activate_stream_unlocked(GstPwAudioSink *self, gboolean activate);
+static void gst_pw_audio_sink_wait_for_freewheel_data_unlocked(GstPwAudioSink *self, guint64 num_required_frames);
 static void gst_pw_audio_sink_setup_audio_data_buffer(GstPwAudioSink *self);
 static void gst_pw_audio_sink_teardown_audio_data_buffer(GstPwAudioSink *self);
 static void gst_pw_audio_sink_reset_audio_data_buffer_unlocked(GstPwAudioSink *self);
@@ -398,9 +906,59 @@ static void gst_pw_audio_sink_drain_stream_and_audio_data_buffer(GstPwAudioSink
 static void gst_pw_audio_sink_disconnect_stream(GstPwAudioSink *self);
 static void gst_pw_audio_sink_notify_about_activated_stream(GstPwAudioSink *self);
 static void gst_pw_audio_sink_calculate_data_rate_multiplier(GstPwAudioSink *self);
+static void gst_pw_audio_sink_update_quantum_size(GstPwAudioSink *self);
+static gboolean gst_pw_audio_sink_detect_xrun(GstPwAudioSink *self, struct pw_time const *stream_time, gboolean *graph_clock_changed);
+static gint64 gst_pw_audio_sink_get_delay_in_ticks(GstPwAudioSink *self, struct pw_time const *stream_time, struct spa_io_position const *spa_position);
+static gboolean gst_pw_audio_sink_stream_delay_change_is_significant(GstPwAudioSink *self, gint64 now);
+static void gst_pw_audio_sink_update_process_latency_unlocked(GstPwAudioSink *self);
+static void gst_pw_audio_sink_compensate_drift(GstPwAudioSink *self, PIController *pi_controller, GstClockTime *previous_time, struct spa_io_rate_match *spa_rate_match, GstClockTime current_time, GstClockTimeDiff retrieval_pts_delta);
+static void gst_pw_audio_sink_set_chunk_content(GstPwAudioSink *self, struct pw_buffer *pw_buf, struct spa_data *inner_spa_data, gboolean is_silence, gsize num_bytes);
+static void gst_pw_audio_sink_produce_silence_chunk(GstPwAudioSink *self, struct pw_buffer *pw_buf, struct spa_data *inner_spa_data, guint64 num_frames);
+
+static gboolean gst_pw_audio_sink_create_additional_streams(GstPwAudioSink *self);
+static void gst_pw_audio_sink_destroy_additional_streams(GstPwAudioSink *self);
+static void gst_pw_audio_sink_connect_additional_streams(GstPwAudioSink *self, struct spa_pod const **params, guint num_params, enum pw_stream_flags flags);
+static void gst_pw_audio_sink_disconnect_additional_streams(GstPwAudioSink *self);
+static void gst_pw_audio_sink_activate_additional_streams_unlocked(GstPwAudioSink *self, gboolean activate);
 
 /* This callback is for use with pw_loop_invoke(). */
 static int gst_pw_audio_sink_activated_stream_cb(struct spa_loop *loop, bool async, uint32_t seq, const void *_data, size_t size, void *user_data);
+static int gst_pw_audio_sink_idle_suspend_stream_cb(struct spa_loop *loop, bool async, uint32_t seq, const void *_data, size_t size, void *user_data);
+static gboolean gst_pw_audio_sink_is_idle_suspended(GstPwAudioSink *self);
+static void gst_pw_audio_sink_resume_from_idle_suspension(GstPwAudioSink *self);
+
+static void gst_pw_audio_sink_relink_stream(GstPwAudioSink *self);
+static void gst_pw_audio_sink_set_target_in_metadata_unlocked(GstPwAudioSink *self, uint32_t node_id, uint32_t target_object_id, gchar const *target_node_name);
+static void gst_pw_audio_sink_fail_over_unlocked(GstPwAudioSink *self, uint32_t lost_target_node_id);
+static void gst_pw_audio_sink_finish_failover_unlocked(GstPwAudioSink *self);
+
+static void gst_pw_audio_sink_setup_played_audio_tap(GstPwAudioSink *self);
+static void gst_pw_audio_sink_teardown_played_audio_tap(GstPwAudioSink *self);
+static gpointer gst_pw_audio_sink_played_audio_tap_thread(gpointer user_data);
+static void gst_pw_audio_sink_write_to_played_audio_tap(GstPwAudioSink *self, struct spa_data *inner_spa_data, guint64 num_frames, GstClockTimeDiff output_time_offset);
+static GstClockTime gst_pw_audio_sink_get_output_time(GstPwAudioSink *self, GstClockTimeDiff output_time_offset);
+
+static void gst_pw_audio_sink_setup_level_metering(GstPwAudioSink *self);
+static gboolean gst_pw_audio_sink_accumulate_levels(GstPwAudioSink *self, gconstpointer data, guint64 num_frames, GstClockTime start_time, GstPwAudioSinkLevelResults *results);
+static void gst_pw_audio_sink_meter_levels_in_process_callback(GstPwAudioSink *self, struct spa_data *inner_spa_data, guint64 num_frames, GstClockTimeDiff output_time_offset);
+static int gst_pw_audio_sink_post_level_message_cb(struct spa_loop *loop, bool async, uint32_t seq, const void *data, size_t size, void *user_data);
+static void gst_pw_audio_sink_post_level_message(GstPwAudioSink *self, GstPwAudioSinkLevelResults const *results);
+
+static gboolean gst_pw_audio_sink_scheduled_start_is_pending_unlocked(GstPwAudioSink *self);
+static GstClockTime gst_pw_audio_sink_get_scheduled_retrieval_time_unlocked(GstPwAudioSink *self, GstClockTime current_time);
+static void gst_pw_audio_sink_apply_scheduled_start_unlocked(GstPwAudioSink *self, GstClockTime upstream_pipeline_latency, gint64 stream_delay_in_ns, GstClockTime first_frame_output_time);
+static gsize gst_pw_audio_sink_apply_scheduled_stop_unlocked(GstPwAudioSink *self, GstPwAudioFormat const *output_format, guint8 *data, gsize num_bytes, gsize output_stride, GstClockTime first_frame_output_time);
+static void gst_pw_audio_sink_announce_scheduled_event(GstPwAudioSink *self, gboolean is_stop, GstClockTime time);
+static int gst_pw_audio_sink_post_scheduled_event_message_cb(struct spa_loop *loop, bool async, uint32_t seq, const void *data, size_t size, void *user_data);
+
+static void gst_pw_audio_sink_reset_qos_observations_unlocked(GstPwAudioSink *self);
+static void gst_pw_audio_sink_observe_expired_frames_for_qos_unlocked(GstPwAudioSink *self, guint64 num_played_frames);
+static void gst_pw_audio_sink_perform_qos(GstPwAudioSink *self, GstClockTime overlap_running_time, GstClockTime overlap_duration);
+
+static void gst_pw_audio_sink_publish_position_snapshot(GstPwAudioSink *self, GstClockTime next_frame_pts, guint64 num_frames, struct pw_time const *stream_time, gint64 stream_delay_in_ns);
+static void gst_pw_audio_sink_publish_position_segment(GstPwAudioSink *self, GstSegment const *segment);
+static void gst_pw_audio_sink_invalidate_position_snapshot(GstPwAudioSink *self);
+static gboolean gst_pw_audio_sink_get_position_from_snapshot(GstPwAudioSink *self, GstFormat format, gint64 *position);
 
 
 /* pw_stream callbacks for both raw and encoded data. */
@@ -411,18 +969,32 @@ static void gst_pw_audio_sink_io_changed(void *data, uint32_t id, void *area, ui
 static void gst_pw_audio_sink_on_stream_drained(void *data);
 
 
-/* pw_stream callbacks for raw data. */
+/* pw_stream callbacks for raw data. There is one set of callbacks for
+ * each raw audio type. Their process callbacks are specialized variants
+ * of gst_pw_audio_sink_raw_process_stream(). The right set is picked
+ * in gst_pw_audio_sink_set_caps(). */
+
+static void gst_pw_audio_sink_pcm_on_process_stream(void *data);
+static void gst_pw_audio_sink_dsd_on_process_stream(void *data);
 
-static void gst_pw_audio_sink_raw_on_process_stream(void *data);
+static const struct pw_stream_events pcm_stream_events =
+{
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = gst_pw_audio_sink_pw_state_changed,
+	.param_changed = gst_pw_audio_sink_param_changed,
+	.io_changed = gst_pw_audio_sink_io_changed,
+	.drained = gst_pw_audio_sink_on_stream_drained,
+	.process = gst_pw_audio_sink_pcm_on_process_stream,
+};
 
-static const struct pw_stream_events raw_stream_events =
+static const struct pw_stream_events dsd_stream_events =
 {
 	PW_VERSION_STREAM_EVENTS,
 	.state_changed = gst_pw_audio_sink_pw_state_changed,
 	.param_changed = gst_pw_audio_sink_param_changed,
 	.io_changed = gst_pw_audio_sink_io_changed,
 	.drained = gst_pw_audio_sink_on_stream_drained,
-	.process = gst_pw_audio_sink_raw_on_process_stream,
+	.process = gst_pw_audio_sink_dsd_on_process_stream,
 };
 
 
@@ -441,6 +1013,35 @@ static const struct pw_stream_events encoded_stream_events =
 };
 
 
+/* pw_registry callbacks for finding the "default" metadata object
+ * and for tracking the target nodes for failovers. */
+
+static void gst_pw_audio_sink_registry_global(void *data, uint32_t id, uint32_t permissions, const char *type, uint32_t version, const struct spa_dict *props);
+static void gst_pw_audio_sink_registry_global_remove(void *data, uint32_t id);
+
+static const struct pw_registry_events registry_events =
+{
+	PW_VERSION_REGISTRY_EVENTS,
+	.global = gst_pw_audio_sink_registry_global,
+	.global_remove = gst_pw_audio_sink_registry_global_remove,
+};
+
+
+/* pw_stream callbacks for additional streams (raw data only). */
+
+static void gst_pw_audio_sink_additional_stream_state_changed(void *data, enum pw_stream_state old_state, enum pw_stream_state new_state, const char *error);
+static void gst_pw_audio_sink_additional_stream_io_changed(void *data, uint32_t id, void *area, uint32_t size);
+static void gst_pw_audio_sink_additional_stream_on_process(void *data);
+
+static const struct pw_stream_events additional_stream_events =
+{
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = gst_pw_audio_sink_additional_stream_state_changed,
+	.io_changed = gst_pw_audio_sink_additional_stream_io_changed,
+	.process = gst_pw_audio_sink_additional_stream_on_process,
+};
+
+
 
 
 static void gst_pw_audio_sink_class_init(GstPwAudioSinkClass *klass)
@@ -504,6 +1105,19 @@ static void gst_pw_audio_sink_class_init(GstPwAudioSinkClass *klass)
 		GST_TYPE_CAPS
 	);
 
+	gst_pw_audio_sink_signals[SIGNAL_PLAYED_AUDIO] = g_signal_new(
+		"played-audio",
+		G_TYPE_FROM_CLASS(klass),
+		G_SIGNAL_RUN_LAST,
+		G_STRUCT_OFFSET(GstPwAudioSinkClass, played_audio),
+		NULL,
+		NULL,
+		g_cclosure_marshal_generic,
+		G_TYPE_NONE,
+		1,
+		GST_TYPE_BUFFER
+	);
+
 	g_object_class_install_property(
 		object_class,
 		PROP_PROVIDE_CLOCK,
@@ -549,13 +1163,27 @@ static void gst_pw_audio_sink_class_init(GstPwAudioSinkClass *klass)
 		g_param_spec_uint(
 			"target-object-id",
 			"Target object ID",
-			"PipeWire target object id to connect to (default = let the PipeWire manager select a target)",
+			"PipeWire target object id to connect to (default = let the PipeWire manager select a target); "
+			"can be changed while playing to move the stream to another target",
 			0, G_MAXUINT,
 			DEFAULT_TARGET_OBJECT_ID,
 			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
 		)
 	);
 
+	g_object_class_install_property(
+		object_class,
+		PROP_TARGET_NODE_NAME,
+		g_param_spec_string(
+			"target-node-name",
+			"Target node name",
+			"Name of the PipeWire node to connect to; takes precedence over target-object-id if set "
+			"(default = use target-object-id); can be changed while playing to move the stream to another target",
+			DEFAULT_TARGET_NODE_NAME,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
 	g_object_class_install_property(
 		object_class,
 		PROP_STREAM_PROPERTIES,
@@ -706,62 +1334,315 @@ static void gst_pw_audio_sink_class_init(GstPwAudioSinkClass *klass)
 		)
 	);
 
-	gst_element_class_set_static_metadata(
-		element_class,
-		"pwaudiosink",
-		"Sink/Audio",
-		"Sink for sending audio data to a PipeWire graph",
-		"Carlos Rafael Giani <crg7475@mailbox.org>"
+	g_object_class_install_property(
+		object_class,
+		PROP_ADDITIONAL_TARGET_OBJECT_IDS,
+		gst_param_spec_array(
+			"additional-target-object-ids",
+			"Additional target object IDs",
+			"PipeWire target object IDs of additional targets that shall play the same PCM audio in sync with the main target "
+			"(one extra PipeWire stream is created per ID; at most 7 additional targets are supported)",
+			g_param_spec_uint(
+				"additional-target-object-id",
+				"Additional target object ID",
+				"Additional PipeWire target object ID",
+				0, G_MAXUINT,
+				PW_ID_ANY,
+				(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+			),
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
 	);
-}
-
 
-static void gst_pw_audio_sink_init(GstPwAudioSink *self)
-{
-	self->alignment_threshold = DEFAULT_ALIGNMENT_THRESHOLD;
-	self->skew_threshold = DEFAULT_SKEW_THRESHOLD;
-	self->target_object_id = DEFAULT_TARGET_OBJECT_ID;
-	self->stream_properties = DEFAULT_STREAM_PROPERTIES;
-	self->socket_fd = DEFAULT_SOCKET_FD;
-	self->ring_buffer_length_in_ms = DEFAULT_RING_BUFFER_LENGTH;
-	self->app_name = g_strdup(DEFAULT_APP_NAME);
-	self->node_name = g_strdup(DEFAULT_NODE_NAME);
-	self->node_description = g_strdup(DEFAULT_NODE_DESCRIPTION);
-	self->probe_for_caps = DEFAULT_PROBE_FOR_CAPS;
-	self->cache_probed_caps = DEFAULT_CACHE_PROBED_CAPS;
-	self->custom_probed_caps = NULL;
-	self->use_global_probed_caps_cache = DEFAULT_USE_GLOBAL_PROBED_CAPS_CACHE;
-	self->autoconnect = DEFAULT_AUTOCONNECT;
-	self->announce_pcm_rate = DEFAULT_ANNOUNCE_PCM_RATE;
+	g_object_class_install_property(
+		object_class,
+		PROP_IDLE_TIMEOUT,
+		g_param_spec_uint(
+			"idle-timeout",
+			"Idle timeout",
+			"If the sink is playing PCM or DSD audio and has had no data to play for this many milliseconds, "
+			"the PipeWire stream is deactivated until new data arrives (0 = never deactivate the stream when idle)",
+			0, G_MAXUINT,
+			DEFAULT_IDLE_TIMEOUT,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
 
-	self->sink_caps = NULL;
-	memset(&(self->pw_audio_format), 0, sizeof(self->pw_audio_format));
-	self->format_probe = NULL;
-	self->dsd_min_num_required_ticks_remainder = 0;
-	g_mutex_init(&(self->probe_process_mutex));
-	self->cached_probed_caps = NULL;
+	g_object_class_install_property(
+		object_class,
+		PROP_LATENCY_UPDATE_THRESHOLD,
+		g_param_spec_int64(
+			"latency-update-threshold",
+			"Latency update threshold",
+			"How much the PipeWire stream delay must change, in nanoseconds, before the pipeline "
+			"is informed about the new latency (see also latency-update-relative-threshold)",
+			0, G_MAXINT64,
+			DEFAULT_LATENCY_UPDATE_THRESHOLD,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
 
-	self->ring_buffer = NULL;
-	g_mutex_init(&(self->audio_data_buffer_mutex));
-	g_cond_init(&(self->audio_data_buffer_cond));
-	self->encoded_data_queue = NULL;
-	self->total_queued_encoded_data_duration = 0;
-	self->dsd_conversion_buffer_size = 0;
-	self->dsd_conversion_buffer = NULL;
-	self->draining_ring_buffer = FALSE;
+	g_object_class_install_property(
+		object_class,
+		PROP_LATENCY_UPDATE_RELATIVE_THRESHOLD,
+		g_param_spec_double(
+			"latency-update-relative-threshold",
+			"Latency update relative threshold",
+			"How much the PipeWire stream delay must change, relative to the currently reported delay, "
+			"before the pipeline is informed about the new latency; both this and latency-update-threshold "
+			"must be exceeded (0.05 = 5%)",
+			0.0, G_MAXDOUBLE,
+			DEFAULT_LATENCY_UPDATE_RELATIVE_THRESHOLD,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
 
-	pi_controller_init(&(self->pi_controller), PI_CONTROLLER_KI_FACTOR, PI_CONTROLLER_KP_FACTOR);
-	gst_pw_audio_sink_reset_drift_compensation_states(self);
+	g_object_class_install_property(
+		object_class,
+		PROP_MIN_LATENCY_UPDATE_INTERVAL,
+		g_param_spec_int64(
+			"min-latency-update-interval",
+			"Minimum latency update interval",
+			"Minimum amount of time that must pass between two latency updates caused "
+			"by PipeWire stream delay changes, in nanoseconds",
+			0, G_MAXINT64,
+			DEFAULT_MIN_LATENCY_UPDATE_INTERVAL,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
 
-	self->flushing = 0;
-	self->paused = 0;
-	self->notify_upstream_about_stream_delay = 0;
-	self->expected_next_running_time_pts = GST_CLOCK_TIME_NONE;
-	self->latency = 0;
-	g_mutex_init(&(self->latency_mutex));
+	g_object_class_install_property(
+		object_class,
+		PROP_PLAYED_AUDIO_TAP_LENGTH,
+		g_param_spec_uint(
+			"played-audio-tap-length",
+			"Played audio tap length",
+			"Length of the played audio tap, in milliseconds; if nonzero, each quantum of PCM or DSD audio that was "
+			"sent to the PipeWire graph is emitted with the played-audio signal (0 = tap disabled)",
+			0, G_MAXUINT,
+			DEFAULT_PLAYED_AUDIO_TAP_LENGTH,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_FREEWHEEL,
+		g_param_spec_boolean(
+			"freewheel",
+			"Freewheel",
+			"Render PCM and DSD audio as fast as possible by connecting to the freewheeling driver of the "
+			"PipeWire graph; clock synchronization and drift compensation are disabled in this mode",
+			DEFAULT_FREEWHEEL,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_LEVEL_METERING,
+		g_param_spec_enum(
+			"level-metering",
+			"Level metering",
+			"Where to measure the per-channel peak and RMS levels of the PCM audio that is sent to the PipeWire "
+			"graph; the levels are posted as pwaudiosink-level element messages (only S16, S32, F32, F64 in "
+			"native endianness are supported)",
+			GST_TYPE_PW_AUDIO_SINK_LEVEL_METERING,
+			DEFAULT_LEVEL_METERING,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_LEVEL_INTERVAL,
+		g_param_spec_uint64(
+			"level-interval",
+			"Level interval",
+			"Interval between level messages, in nanoseconds",
+			1, G_MAXUINT64,
+			DEFAULT_LEVEL_INTERVAL,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_FALLBACK_TARGETS,
+		gst_param_spec_array(
+			"fallback-targets",
+			"Fallback targets",
+			"Names of PipeWire nodes to move the stream to if the node it is linked to disappears, in order of preference; "
+			"the first one that currently exists is used; the ring buffer, the clock, and the sync state are kept across "
+			"the move (default = empty list; the session manager decides where the stream goes)",
+			g_param_spec_string(
+				"fallback-target",
+				"Fallback target",
+				"Node name of a fallback target",
+				NULL,
+				(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+			),
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_STATS,
+		g_param_spec_boxed(
+			"stats",
+			"Statistics",
+			"Sink statistics: num-failovers (number of failovers to a fallback target so far), "
+			"last-failover-duration (time in nanoseconds between the loss of the target and the stream "
+			"getting linked to the fallback target in the last failover; GST_CLOCK_TIME_NONE if there was none), "
+			"num-idle-suspensions (number of times the stream was suspended because of the idle timeout so far)",
+			GST_TYPE_STRUCTURE,
+			(GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_ASYNC_PROCESSING,
+		g_param_spec_boolean(
+			"async-processing",
+			"Async processing",
+			"Let the PipeWire graph process this node asynchronously, so that the data for a graph cycle is "
+			"produced during the preceding cycle; this adds one quantum of latency, but gives the PCM and DSD "
+			"process callbacks a full quantum of time instead of having to finish within the current cycle's "
+			"deadline (requires PipeWire 1.2 or newer)",
+			DEFAULT_ASYNC_PROCESSING,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_SCHEDULED_START_TIME,
+		g_param_spec_uint64(
+			"scheduled-start-time",
+			"Scheduled start time",
+			"Pipeline clock time at which the oldest buffered frame shall be output; until then, silence is "
+			"output, and the ring buffer is filled; a pwaudiosink-scheduled-start element message is posted once "
+			"the start happened, and the property is then reset to GST_CLOCK_TIME_NONE (only used with raw audio "
+			"if sync is enabled; GST_CLOCK_TIME_NONE = no scheduled start)",
+			0, G_MAXUINT64,
+			DEFAULT_SCHEDULED_START_TIME,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_SCHEDULED_STOP_TIME,
+		g_param_spec_uint64(
+			"scheduled-stop-time",
+			"Scheduled stop time",
+			"Pipeline clock time from which on only silence is output; buffered data is still consumed in real time; "
+			"a pwaudiosink-scheduled-stop element message is posted once the stop happened (only used with raw audio "
+			"if sync is enabled; GST_CLOCK_TIME_NONE = no scheduled stop)",
+			0, G_MAXUINT64,
+			DEFAULT_SCHEDULED_STOP_TIME,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_CHANNEL_DELAYS,
+		gst_param_spec_array(
+			"channel-delays",
+			"Channel delays",
+			"Per-channel delays in frames, for aligning speakers at different distances; entry #i delays channel #i; "
+			"channels without an entry are not delayed; the ring buffer is enlarged by the largest delay "
+			"(only used with raw audio; default = empty list; no channel is delayed)",
+			g_param_spec_uint(
+				"channel-delay",
+				"Channel delay",
+				"Delay of a channel, in frames",
+				0, G_MAXUINT,
+				0,
+				(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+			),
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	gst_element_class_set_static_metadata(
+		element_class,
+		"pwaudiosink",
+		"Sink/Audio",
+		"Sink for sending audio data to a PipeWire graph",
+		"Carlos Rafael Giani <crg7475@mailbox.org>"
+	);
+}
+
+
+static void gst_pw_audio_sink_init(GstPwAudioSink *self)
+{
+	self->alignment_threshold = DEFAULT_ALIGNMENT_THRESHOLD;
+	self->skew_threshold = DEFAULT_SKEW_THRESHOLD;
+	self->target_object_id = DEFAULT_TARGET_OBJECT_ID;
+	self->target_node_name = g_strdup(DEFAULT_TARGET_NODE_NAME);
+	self->stream_properties = DEFAULT_STREAM_PROPERTIES;
+	self->socket_fd = DEFAULT_SOCKET_FD;
+	self->ring_buffer_length_in_ms = DEFAULT_RING_BUFFER_LENGTH;
+	self->app_name = g_strdup(DEFAULT_APP_NAME);
+	self->node_name = g_strdup(DEFAULT_NODE_NAME);
+	self->node_description = g_strdup(DEFAULT_NODE_DESCRIPTION);
+	self->probe_for_caps = DEFAULT_PROBE_FOR_CAPS;
+	self->cache_probed_caps = DEFAULT_CACHE_PROBED_CAPS;
+	self->custom_probed_caps = NULL;
+	self->use_global_probed_caps_cache = DEFAULT_USE_GLOBAL_PROBED_CAPS_CACHE;
+	self->autoconnect = DEFAULT_AUTOCONNECT;
+	self->announce_pcm_rate = DEFAULT_ANNOUNCE_PCM_RATE;
+	self->additional_target_object_ids = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+	self->idle_timeout_in_ms = DEFAULT_IDLE_TIMEOUT;
+	self->latency_update_threshold = DEFAULT_LATENCY_UPDATE_THRESHOLD;
+	self->latency_update_relative_threshold = DEFAULT_LATENCY_UPDATE_RELATIVE_THRESHOLD;
+	self->min_latency_update_interval = DEFAULT_MIN_LATENCY_UPDATE_INTERVAL;
+	self->played_audio_tap_length_in_ms = DEFAULT_PLAYED_AUDIO_TAP_LENGTH;
+	self->freewheel = DEFAULT_FREEWHEEL;
+	self->level_metering = DEFAULT_LEVEL_METERING;
+	self->level_interval = DEFAULT_LEVEL_INTERVAL;
+	self->fallback_targets = g_ptr_array_new_with_free_func(g_free);
+	self->async_processing = DEFAULT_ASYNC_PROCESSING;
+	self->channel_delays = g_array_new(FALSE, FALSE, sizeof(guint));
+
+	self->sink_caps = NULL;
+	memset(&(self->pw_audio_format), 0, sizeof(self->pw_audio_format));
+	self->format_probe = NULL;
+	self->dsd_min_num_required_ticks_remainder = 0;
+	g_mutex_init(&(self->probe_process_mutex));
+	self->cached_probed_caps = NULL;
+
+	self->ring_buffer = NULL;
+	g_mutex_init(&(self->audio_data_buffer_mutex));
+	g_cond_init(&(self->audio_data_buffer_cond));
+	self->encoded_data_queue = NULL;
+	self->num_consumed_encoded_frames = 0;
+	self->total_queued_encoded_data_duration = 0;
+	self->dsd_conversion_buffer_size = 0;
+	self->dsd_conversion_buffer = NULL;
+	self->draining_ring_buffer = FALSE;
+
+	pi_controller_init(&(self->pi_controller), PI_CONTROLLER_KI_FACTOR, PI_CONTROLLER_KP_FACTOR);
+	gst_pw_audio_sink_reset_drift_compensation_states(self);
+
+	self->flushing = 0;
+	self->paused = 0;
+	self->notify_upstream_about_stream_delay = 0;
+	discontinuity_accumulator_init(&(self->discontinuity_accumulator));
+	self->latency = 0;
+	g_mutex_init(&(self->latency_mutex));
 	self->stream_drained = FALSE;
 	self->can_drain = FALSE;
 	self->accum_excess_encaudio_playtime = 0;
+	self->scheduled_start_time = DEFAULT_SCHEDULED_START_TIME;
+	self->scheduled_stop_time = DEFAULT_SCHEDULED_STOP_TIME;
+	self->scheduled_start_offset = 0;
+	self->scheduled_start_offset_set = FALSE;
+	self->scheduled_stop_announced = FALSE;
 
 	self->stream_clock = gst_pw_stream_clock_new(NULL);
 	g_assert(self->stream_clock != NULL);
@@ -777,11 +1658,66 @@ static void gst_pw_audio_sink_init(GstPwAudioSink *self)
 	self->spa_position = NULL;
 	self->spa_rate_match = NULL;
 	self->stream_delay_in_ticks = 0;
+	self->stream_delay_rate.num = 0;
+	self->stream_delay_rate.denom = 0;
 	self->stream_delay_in_ns = 0;
+	self->reported_stream_delay_in_ns = 0;
+	self->last_latency_update_time = GST_CLOCK_TIME_NONE;
 	self->quantum_size_in_ticks = 0;
 	self->quantum_size_in_ns = 0;
+	self->published_process_latency = GST_CLOCK_TIME_NONE;
 	self->last_pw_time_ticks = 0;
 	self->last_pw_time_ticks_set = FALSE;
+	self->last_clock_values_set = FALSE;
+
+	self->additional_streams = NULL;
+
+	self->registry = NULL;
+	self->default_metadata = NULL;
+	self->default_metadata_id = SPA_ID_INVALID;
+	self->relink_pending = 0;
+	self->audio_sink_node_names = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	self->linked_target_node_id = SPA_ID_INVALID;
+	self->failover_start_time = GST_CLOCK_TIME_NONE;
+	self->failover_target_name = NULL;
+	self->num_failovers = 0;
+	self->num_idle_suspensions = 0;
+	self->last_failover_duration = GST_CLOCK_TIME_NONE;
+	self->freewheel_wait_enabled = 0;
+	self->active_level_metering = GST_PW_AUDIO_SINK_LEVEL_METERING_NONE;
+	self->qos_num_expired_frames = 0;
+	self->qos_expired_frames_pts = GST_CLOCK_TIME_NONE;
+	self->qos_max_lateness = 0;
+	self->qos_num_played_frames = 0;
+	self->qos_proportion = 1.0;
+
+	self->played_audio_tap = NULL;
+	self->played_audio_tap_thread = NULL;
+	g_mutex_init(&(self->played_audio_tap_mutex));
+	g_cond_init(&(self->played_audio_tap_cond));
+	self->played_audio_tap_thread_running = FALSE;
+
+	memset(&(self->position_snapshot), 0, sizeof(self->position_snapshot));
+	self->position_snapshot.running_time = GST_CLOCK_TIME_NONE;
+	self->position_snapshot_seqnum = 0;
+	gst_segment_init(&(self->position_segment), GST_FORMAT_TIME);
+	self->position_segment_seqnum = 0;
+	self->position_epoch = 0;
+
+	self->idle_timeout_snapshot = 0;
+	self->latency_update_threshold_snapshot = 0;
+	self->latency_update_relative_threshold_snapshot = 0.0;
+	self->min_latency_update_interval_snapshot = 0;
+	self->played_audio_tap_length_snapshot = 0;
+	self->freewheel_snapshot = FALSE;
+	self->level_metering_snapshot = GST_PW_AUDIO_SINK_LEVEL_METERING_NONE;
+	self->level_interval_snapshot = 0;
+	self->async_processing_snapshot = FALSE;
+	self->channel_delays_snapshot = g_array_new(FALSE, FALSE, sizeof(guint));
+	self->idle_start_time = GST_CLOCK_TIME_NONE;
+	self->idle_suspension_requested = FALSE;
+	self->idle_suspending = 0;
+	self->idle_suspended = 0;
 
 	gst_pw_audio_sink_set_provide_clock_flag(self, DEFAULT_PROVIDE_CLOCK);
 }
@@ -808,15 +1744,26 @@ static void gst_pw_audio_sink_finalize(GObject *object)
 
 	g_cond_clear(&(self->audio_data_buffer_cond));
 	g_mutex_clear(&(self->audio_data_buffer_mutex));
+	g_cond_clear(&(self->played_audio_tap_cond));
+	g_mutex_clear(&(self->played_audio_tap_mutex));
 
 	g_free(self->node_description);
 	g_free(self->node_name);
 	g_free(self->app_name);
+	g_free(self->target_node_name);
 	if (self->stream_properties != NULL)
 		gst_structure_free(self->stream_properties);
 
 	gst_caps_replace(&(self->custom_probed_caps), NULL);
 
+	g_array_unref(self->additional_target_object_ids);
+	g_ptr_array_unref(self->fallback_targets);
+	g_array_unref(self->channel_delays);
+	g_array_unref(self->channel_delays_snapshot);
+
+	g_hash_table_unref(self->audio_sink_node_names);
+	g_free(self->failover_target_name);
+
 	G_OBJECT_CLASS(gst_pw_audio_sink_parent_class)->finalize(object);
 }
 
@@ -847,6 +1794,15 @@ static void gst_pw_audio_sink_set_property(GObject *object, guint prop_id, GValu
 			GST_OBJECT_LOCK(self);
 			self->target_object_id = g_value_get_uint(value);
 			GST_OBJECT_UNLOCK(self);
+			gst_pw_audio_sink_relink_stream(self);
+			break;
+
+		case PROP_TARGET_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_free(self->target_node_name);
+			self->target_node_name = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(self);
+			gst_pw_audio_sink_relink_stream(self);
 			break;
 
 		case PROP_STREAM_PROPERTIES:
@@ -939,6 +1895,150 @@ static void gst_pw_audio_sink_set_property(GObject *object, guint prop_id, GValu
 			GST_OBJECT_UNLOCK(self);
 			break;
 
+		case PROP_ADDITIONAL_TARGET_OBJECT_IDS:
+		{
+			guint i, num_ids;
+
+			GST_OBJECT_LOCK(self);
+
+			g_array_set_size(self->additional_target_object_ids, 0);
+
+			num_ids = gst_value_array_get_size(value);
+			for (i = 0; i < num_ids; ++i)
+			{
+				uint32_t id = g_value_get_uint(gst_value_array_get_value(value, i));
+				g_array_append_val(self->additional_target_object_ids, id);
+			}
+
+			GST_OBJECT_UNLOCK(self);
+
+			break;
+		}
+
+		case PROP_IDLE_TIMEOUT:
+			GST_OBJECT_LOCK(self);
+			self->idle_timeout_in_ms = g_value_get_uint(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_LATENCY_UPDATE_THRESHOLD:
+			GST_OBJECT_LOCK(self);
+			self->latency_update_threshold = g_value_get_int64(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_LATENCY_UPDATE_RELATIVE_THRESHOLD:
+			GST_OBJECT_LOCK(self);
+			self->latency_update_relative_threshold = g_value_get_double(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_MIN_LATENCY_UPDATE_INTERVAL:
+			GST_OBJECT_LOCK(self);
+			self->min_latency_update_interval = g_value_get_int64(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_PLAYED_AUDIO_TAP_LENGTH:
+			GST_OBJECT_LOCK(self);
+			self->played_audio_tap_length_in_ms = g_value_get_uint(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_FREEWHEEL:
+			GST_OBJECT_LOCK(self);
+			self->freewheel = g_value_get_boolean(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_LEVEL_METERING:
+			GST_OBJECT_LOCK(self);
+			self->level_metering = g_value_get_enum(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_LEVEL_INTERVAL:
+			GST_OBJECT_LOCK(self);
+			self->level_interval = g_value_get_uint64(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_FALLBACK_TARGETS:
+		{
+			guint i, num_targets;
+
+			GST_OBJECT_LOCK(self);
+
+			g_ptr_array_set_size(self->fallback_targets, 0);
+
+			num_targets = gst_value_array_get_size(value);
+			for (i = 0; i < num_targets; ++i)
+			{
+				gchar const *target = g_value_get_string(gst_value_array_get_value(value, i));
+				if ((target != NULL) && (target[0] != '\0'))
+					g_ptr_array_add(self->fallback_targets, g_strdup(target));
+			}
+
+			GST_OBJECT_UNLOCK(self);
+
+			break;
+		}
+
+		case PROP_ASYNC_PROCESSING:
+			GST_OBJECT_LOCK(self);
+			self->async_processing = g_value_get_boolean(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		/* The scheduled times are accessed by the process callback,
+		 * which already holds the audio data buffer mutex, so they
+		 * are guarded by that mutex instead of the object lock. */
+
+		case PROP_SCHEDULED_START_TIME:
+			LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+			self->scheduled_start_time = g_value_get_uint64(value);
+			/* The offset is recomputed by the process callback
+			 * based on the data that is buffered at that point. */
+			self->scheduled_start_offset_set = FALSE;
+			/* A stop that already happened must not silence the newly
+			 * scheduled start. A stop that is still pending is kept. */
+			if (GST_CLOCK_TIME_IS_VALID(self->scheduled_start_time) && self->scheduled_stop_announced)
+			{
+				self->scheduled_stop_time = GST_CLOCK_TIME_NONE;
+				self->scheduled_stop_announced = FALSE;
+			}
+			GST_DEBUG_OBJECT(self, "scheduled start time set to %" GST_TIME_FORMAT, GST_TIME_ARGS(self->scheduled_start_time));
+			UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+			break;
+
+		case PROP_SCHEDULED_STOP_TIME:
+			LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+			self->scheduled_stop_time = g_value_get_uint64(value);
+			self->scheduled_stop_announced = FALSE;
+			GST_DEBUG_OBJECT(self, "scheduled stop time set to %" GST_TIME_FORMAT, GST_TIME_ARGS(self->scheduled_stop_time));
+			UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+			break;
+
+		case PROP_CHANNEL_DELAYS:
+		{
+			guint i, num_delays;
+
+			GST_OBJECT_LOCK(self);
+
+			g_array_set_size(self->channel_delays, 0);
+
+			num_delays = gst_value_array_get_size(value);
+			for (i = 0; i < num_delays; ++i)
+			{
+				guint delay = g_value_get_uint(gst_value_array_get_value(value, i));
+				g_array_append_val(self->channel_delays, delay);
+			}
+
+			GST_OBJECT_UNLOCK(self);
+
+			break;
+		}
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -974,6 +2074,12 @@ static void gst_pw_audio_sink_get_property(GObject *object, guint prop_id, GValu
 			GST_OBJECT_UNLOCK(self);
 			break;
 
+		case PROP_TARGET_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->target_node_name);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
 		case PROP_STREAM_PROPERTIES:
 			GST_OBJECT_LOCK(self);
 			gst_value_set_structure(value, self->stream_properties);
@@ -1046,40 +2152,175 @@ static void gst_pw_audio_sink_get_property(GObject *object, guint prop_id, GValu
 			GST_OBJECT_UNLOCK(self);
 			break;
 
-		default:
-			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
-			break;
-	}
-}
+		case PROP_ADDITIONAL_TARGET_OBJECT_IDS:
+		{
+			guint i;
 
+			GST_OBJECT_LOCK(self);
 
-static GstStateChangeReturn gst_pw_audio_sink_change_state(GstElement *element, GstStateChange transition)
-{
-	GstStateChangeReturn result;
-	GstPwAudioSink *self = GST_PW_AUDIO_SINK(element);
+			for (i = 0; i < self->additional_target_object_ids->len; ++i)
+			{
+				GValue id_value = G_VALUE_INIT;
+				g_value_init(&id_value, G_TYPE_UINT);
+				g_value_set_uint(&id_value, g_array_index(self->additional_target_object_ids, uint32_t, i));
+				gst_value_array_append_and_take_value(value, &id_value);
+			}
 
-	switch (transition)
-	{
-		/* Pausing/resuming requires (de)activating the stream. Stream
-		 * activation is also known as "corking" (PulseAudio terminology).
-		 * It avoids unnecessary on_process_stream() calls while paused.
-		 * Also, the "paused" flag is used in render() to enter/exit
-		 * a wait loop. */
+			GST_OBJECT_UNLOCK(self);
 
-		case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
-			GST_DEBUG_OBJECT(self, "setting paused flag and deactivating stream (if not already inactive) before PLAYING->PAUSED state change");
+			break;
+		}
 
-			pw_thread_loop_lock(self->pipewire_core->loop);
-			gst_pw_audio_sink_activate_stream_unlocked(self, FALSE);
-			pw_thread_loop_unlock(self->pipewire_core->loop);
+		case PROP_IDLE_TIMEOUT:
+			GST_OBJECT_LOCK(self);
+			g_value_set_uint(value, self->idle_timeout_in_ms);
+			GST_OBJECT_UNLOCK(self);
+			break;
 
-			g_atomic_int_set(&(self->paused), 1);
-			g_cond_signal(&(self->audio_data_buffer_cond));
+		case PROP_LATENCY_UPDATE_THRESHOLD:
+			GST_OBJECT_LOCK(self);
+			g_value_set_int64(value, self->latency_update_threshold);
+			GST_OBJECT_UNLOCK(self);
+			break;
 
+		case PROP_LATENCY_UPDATE_RELATIVE_THRESHOLD:
+			GST_OBJECT_LOCK(self);
+			g_value_set_double(value, self->latency_update_relative_threshold);
+			GST_OBJECT_UNLOCK(self);
 			break;
 
-		case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
-			GST_DEBUG_OBJECT(self, "clearing paused flag and activating stream (if not already active) before PAUSED->PLAYING state change");
+		case PROP_MIN_LATENCY_UPDATE_INTERVAL:
+			GST_OBJECT_LOCK(self);
+			g_value_set_int64(value, self->min_latency_update_interval);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_PLAYED_AUDIO_TAP_LENGTH:
+			GST_OBJECT_LOCK(self);
+			g_value_set_uint(value, self->played_audio_tap_length_in_ms);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_FREEWHEEL:
+			GST_OBJECT_LOCK(self);
+			g_value_set_boolean(value, self->freewheel);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_LEVEL_METERING:
+			GST_OBJECT_LOCK(self);
+			g_value_set_enum(value, self->level_metering);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_LEVEL_INTERVAL:
+			GST_OBJECT_LOCK(self);
+			g_value_set_uint64(value, self->level_interval);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_FALLBACK_TARGETS:
+		{
+			guint i;
+
+			GST_OBJECT_LOCK(self);
+
+			for (i = 0; i < self->fallback_targets->len; ++i)
+			{
+				GValue target_value = G_VALUE_INIT;
+				g_value_init(&target_value, G_TYPE_STRING);
+				g_value_set_string(&target_value, g_ptr_array_index(self->fallback_targets, i));
+				gst_value_array_append_and_take_value(value, &target_value);
+			}
+
+			GST_OBJECT_UNLOCK(self);
+
+			break;
+		}
+
+		case PROP_STATS:
+			GST_OBJECT_LOCK(self);
+			g_value_take_boxed(value, gst_structure_new(
+				"pwaudiosink-stats",
+				"num-failovers", G_TYPE_UINT, self->num_failovers,
+				"last-failover-duration", G_TYPE_UINT64, (guint64)(self->last_failover_duration),
+				"num-idle-suspensions", G_TYPE_UINT, self->num_idle_suspensions,
+				NULL
+			));
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_ASYNC_PROCESSING:
+			GST_OBJECT_LOCK(self);
+			g_value_set_boolean(value, self->async_processing);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_SCHEDULED_START_TIME:
+			LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+			g_value_set_uint64(value, self->scheduled_start_time);
+			UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+			break;
+
+		case PROP_SCHEDULED_STOP_TIME:
+			LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+			g_value_set_uint64(value, self->scheduled_stop_time);
+			UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+			break;
+
+		case PROP_CHANNEL_DELAYS:
+		{
+			guint i;
+
+			GST_OBJECT_LOCK(self);
+
+			for (i = 0; i < self->channel_delays->len; ++i)
+			{
+				GValue delay_value = G_VALUE_INIT;
+				g_value_init(&delay_value, G_TYPE_UINT);
+				g_value_set_uint(&delay_value, g_array_index(self->channel_delays, guint, i));
+				gst_value_array_append_and_take_value(value, &delay_value);
+			}
+
+			GST_OBJECT_UNLOCK(self);
+
+			break;
+		}
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+static GstStateChangeReturn gst_pw_audio_sink_change_state(GstElement *element, GstStateChange transition)
+{
+	GstStateChangeReturn result;
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK(element);
+
+	switch (transition)
+	{
+		/* Pausing/resuming requires (de)activating the stream. Stream
+		 * activation is also known as "corking" (PulseAudio terminology).
+		 * It avoids unnecessary on_process_stream() calls while paused.
+		 * Also, the "paused" flag is used in render() to enter/exit
+		 * a wait loop. */
+
+		case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+			GST_DEBUG_OBJECT(self, "setting paused flag and deactivating stream (if not already inactive) before PLAYING->PAUSED state change");
+
+			pw_thread_loop_lock(self->pipewire_core->loop);
+			gst_pw_audio_sink_activate_stream_unlocked(self, FALSE);
+			pw_thread_loop_unlock(self->pipewire_core->loop);
+
+			g_atomic_int_set(&(self->paused), 1);
+			g_cond_signal(&(self->audio_data_buffer_cond));
+
+			break;
+
+		case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+			GST_DEBUG_OBJECT(self, "clearing paused flag and activating stream (if not already active) before PAUSED->PLAYING state change");
 
 			pw_thread_loop_lock(self->pipewire_core->loop);
 			gst_pw_audio_sink_activate_stream_unlocked(self, TRUE);
@@ -1162,7 +2403,7 @@ static GstStateChangeReturn gst_pw_audio_sink_change_state(GstElement *element,
 				clock = GST_ELEMENT_CLOCK(self);
 				if ((clock != NULL) && (self->ring_buffer != NULL))
 				{
-					self->ring_buffer->oldest_frame_pts = gst_clock_get_time(clock);
+					gst_pw_audio_ring_buffer_set_oldest_frame_pts(self->ring_buffer, gst_clock_get_time(clock));
 					GST_DEBUG_OBJECT(
 						self,
 						"set oldest_frame_pts to %" GST_TIME_FORMAT " after stream clock freeze",
@@ -1171,7 +2412,7 @@ static GstStateChangeReturn gst_pw_audio_sink_change_state(GstElement *element,
 				}
 				else if (self->ring_buffer != NULL)
 				{
-					self->ring_buffer->oldest_frame_pts = GST_CLOCK_TIME_NONE;
+					gst_pw_audio_ring_buffer_set_oldest_frame_pts(self->ring_buffer, GST_CLOCK_TIME_NONE);
 					GST_DEBUG_OBJECT(
 						self,
 						"reset oldest_frame_pts since the sink no longer has a clock set by the pipeline"
@@ -1277,6 +2518,15 @@ static gboolean gst_pw_audio_sink_send_event(GstElement *element, GstEvent *even
 
 			GST_DEBUG_OBJECT(self, "got base sink latency: %" GST_TIME_FORMAT, GST_TIME_ARGS(self->latency));
 
+			/* The pipeline latency determines how far behind the PTS the
+			 * data is retrieved from the ring buffer, so let the graph know. */
+			if (self->pipewire_core != NULL)
+			{
+				pw_thread_loop_lock(self->pipewire_core->loop);
+				gst_pw_audio_sink_update_process_latency_unlocked(self);
+				pw_thread_loop_unlock(self->pipewire_core->loop);
+			}
+
 			break;
 
 		default:
@@ -1347,7 +2597,7 @@ static gboolean gst_pw_audio_sink_query(GstElement *element, GstQuery *query)
 				/* Synchronize access since the stream delay is set by
 				 * the on_process_stream() function. */
 				LOCK_LATENCY_MUTEX(self);
-				stream_delay_in_ns = self->stream_delay_in_ns;
+				stream_delay_in_ns = self->reported_stream_delay_in_ns;
 				UNLOCK_LATENCY_MUTEX(self);
 
 				min_latency += stream_delay_in_ns;
@@ -1371,6 +2621,26 @@ static gboolean gst_pw_audio_sink_query(GstElement *element, GstQuery *query)
 			break;
 		}
 
+		case GST_QUERY_POSITION:
+		{
+			GstFormat format;
+			gint64 position;
+
+			/* Answer from the position snapshot if possible. This avoids the
+			 * GstBaseSink position logic, which locks the object and accesses
+			 * the clock, and is accurate to what is actually audible, since
+			 * the snapshot takes the pw_stream delay into account. */
+			gst_query_parse_position(query, &format, NULL);
+			if (gst_pw_audio_sink_get_position_from_snapshot(self, format, &position))
+			{
+				gst_query_set_position(query, format, position);
+				break;
+			}
+
+			ret = GST_ELEMENT_CLASS(gst_pw_audio_sink_parent_class)->query(element, query);
+			break;
+		}
+
 		case GST_QUERY_CONVERT:
 			ret = gst_pw_audio_sink_handle_convert_query(self, query);
 			break;
@@ -1393,6 +2663,7 @@ static gboolean gst_pw_audio_sink_set_caps(GstBaseSink *basesink, GstCaps *caps)
 	char const *error_str = NULL;
 	enum pw_stream_flags flags = 0;
 	uint32_t target_object_id;
+	gchar *target_node_name = NULL;
 	gboolean autoconnect;
 	gboolean announce_pcm_rate;
 	gboolean pw_thread_loop_locked = FALSE;
@@ -1458,10 +2729,17 @@ static gboolean gst_pw_audio_sink_set_caps(GstBaseSink *basesink, GstCaps *caps)
 	/* Get GObject property values. */
 	GST_OBJECT_LOCK(self);
 	target_object_id = self->target_object_id;
+	target_node_name = g_strdup(self->target_node_name);
 	autoconnect = self->autoconnect;
 	announce_pcm_rate = self->announce_pcm_rate;
 	GST_OBJECT_UNLOCK(self);
 
+	/* A target node name takes precedence over the target object ID.
+	 * It is passed to the session manager as the target.object property,
+	 * so the stream itself must not be connected to a specific ID. */
+	if (target_node_name != NULL)
+		target_object_id = PW_ID_ANY;
+
 	/* Pick the stream connection flags.
 	 *
 	 * - PW_STREAM_FLAG_AUTOCONNECT to tell the session manager to link this client to a consumer.
@@ -1489,27 +2767,61 @@ static gboolean gst_pw_audio_sink_set_caps(GstBaseSink *basesink, GstCaps *caps)
 		goto error;
 	}
 
-	pw_stream_add_listener(
-		self->stream,
-		&(self->stream_listener),
-		gst_pw_audio_format_data_is_raw(self->pw_audio_format.audio_type) ? &raw_stream_events : &encoded_stream_events,
-		self
-	);
-	self->stream_listener_added = TRUE;
+	{
+		struct pw_stream_events const *stream_events;
+
+		switch (self->pw_audio_format.audio_type)
+		{
+			case GST_PIPEWIRE_AUDIO_TYPE_PCM:
+				stream_events = &pcm_stream_events;
+				break;
+
+			case GST_PIPEWIRE_AUDIO_TYPE_DSD:
+				stream_events = &dsd_stream_events;
+				break;
+
+			default:
+				stream_events = &encoded_stream_events;
+				break;
+		}
+
+		/* Whether the DSD data needs to be converted is only known once the
+		 * graph picked its DSD format (see gst_pw_audio_sink_param_changed()). */
+		g_atomic_int_set(&(self->dsd_conversion_required), 0);
+
+		pw_stream_add_listener(
+			self->stream,
+			&(self->stream_listener),
+			stream_events,
+			self
+		);
+		self->stream_listener_added = TRUE;
+	}
 
 	/* Announce the audio rate to the graph. This can help with tuning the
 	 * quantum to better fit encoded frame lengths, and is necessary for
 	 * configuring the graph with a clock rate that most closely matches
 	 * the audio signal's sample rate.
 	 * Also, remove the latency property in case there's one left over from
-	 * a previous stream.
-	 * Do this before connecing to not cause unnecessary reconfigurations. */
+	 * a previous stream, and set the target node name if one is configured.
+	 * If none is configured, the target.object property is removed, since
+	 * it might be left over from a previous connection.
+	 * Do this before connecing to not cause unnecessary reconfigurations.
+	 * The additional streams only get the latency and rate properties;
+	 * their targets are configured with additional-target-object-ids. */
 	{
 		gchar *rate_str = NULL;
-		struct spa_dict_item items[2];
+		struct spa_dict_item items[3];
+		struct spa_dict_item additional_stream_items[2];
 		int num_populated_items = 0;
+		int num_populated_additional_stream_items = 0;
 
 		items[num_populated_items++] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_LATENCY, NULL);
+		additional_stream_items[num_populated_additional_stream_items++] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_LATENCY, NULL);
+
+		if (target_node_name != NULL)
+			GST_DEBUG_OBJECT(self, "setting the target.object property to \"%s\"", target_node_name);
+		items[num_populated_items++] = SPA_DICT_ITEM_INIT(PW_KEY_TARGET_OBJECT, target_node_name);
 
 		gint rate = -1;
 
@@ -1538,9 +2850,21 @@ static gboolean gst_pw_audio_sink_set_caps(GstBaseSink *basesink, GstCaps *caps)
 			rate_str = g_strdup_printf("1/%d", rate);
 			GST_DEBUG_OBJECT(self, "setting the node.rate property to \"%s\"", rate_str);
 			items[num_populated_items++] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_RATE, rate_str);
+			additional_stream_items[num_populated_additional_stream_items++] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_RATE, rate_str);
 		}
 
 		pw_stream_update_properties(self->stream, &SPA_DICT_INIT(items, num_populated_items));
+
+		if (self->additional_streams != NULL)
+		{
+			guint i;
+			for (i = 0; i < self->additional_streams->len; ++i)
+			{
+				GstPwAudioSinkAdditionalStream *additional_stream = g_ptr_array_index(self->additional_streams, i);
+				pw_stream_update_properties(additional_stream->stream, &SPA_DICT_INIT(additional_stream_items, num_populated_additional_stream_items));
+			}
+		}
+
 		g_free(rate_str);
 	}
 
@@ -1562,6 +2886,8 @@ static gboolean gst_pw_audio_sink_set_caps(GstBaseSink *basesink, GstCaps *caps)
 	self->stream_is_connected = TRUE;
 	self->sink_caps = gst_caps_ref(caps);
 
+	gst_pw_audio_sink_connect_additional_streams(self, params, 1, flags);
+
 	self->last_encoded_frame_length = 0;
 
 	gst_pw_audio_sink_setup_audio_data_buffer(self);
@@ -1571,6 +2897,7 @@ static gboolean gst_pw_audio_sink_set_caps(GstBaseSink *basesink, GstCaps *caps)
 finish:
 	if (pw_thread_loop_locked)
 		pw_thread_loop_unlock(self->pipewire_core->loop);
+	g_free(target_node_name);
 	return ret;
 
 error:
@@ -1677,105 +3004,9 @@ static GstCaps* gst_pw_audio_sink_get_caps(GstBaseSink *basesink, GstCaps *filte
 	}
 
 	{
-		gint audio_type;
-
 		GST_DEBUG_OBJECT(self, "probing PipeWire graph for available caps");
 
-		available_sinkcaps = gst_caps_new_empty();
-
-		gst_pw_audio_format_probe_setup(self->format_probe);
-
-		for (audio_type = 0; (audio_type < GST_NUM_PIPEWIRE_AUDIO_TYPES) && !cancelled; ++audio_type)
-		{
-			GstPwAudioFormatProbeResult probing_result;
-			GstPwAudioFormat *probed_details = NULL;
-
-			probing_result = gst_pw_audio_format_probe_probe_audio_type(
-				self->format_probe,
-				audio_type,
-				target_object_id,
-				&probed_details
-			);
-
-			switch (probing_result)
-			{
-				case GST_PW_AUDIO_FORMAT_PROBE_RESULT_SUPPORTED:
-				{
-					switch (audio_type)
-					{
-						case GST_PIPEWIRE_AUDIO_TYPE_DSD:
-						{
-							/* In here, place the probed DSD format as the first one
-							 * in the format list. This ensures that upstream prefers
-							 * this format and only uses others if necessary, which
-							 * helps, since those others require conversion, while
-							 * the probed format doesn't. */
-
-							GstCaps *caps = gst_pw_audio_format_get_template_caps_for_type(audio_type);
-							GstStructure *s = gst_caps_get_structure(caps, 0);
-							GValue list_value = G_VALUE_INIT;
-							GValue string_value = G_VALUE_INIT;
-							gint format_idx;
-
-							g_value_init(&list_value, GST_TYPE_LIST);
-							g_value_init(&string_value, G_TYPE_STRING);
-
-							/* First add the probed format. */
-							g_value_set_static_string(&string_value, gst_dsd_format_to_string(GST_DSD_INFO_FORMAT(&(probed_details->info.dsd_audio_info))));
-							gst_value_list_append_value(&list_value, &string_value);
-
-							/* Now add the rest. */
-							for (format_idx = GST_DSD_FORMAT_U8; format_idx < GST_NUM_DSD_FORMATS; ++format_idx)
-							{
-								GstDsdFormat dsd_format = (GstDsdFormat)format_idx;
-
-								if (dsd_format == GST_DSD_INFO_FORMAT(&(probed_details->info.dsd_audio_info)))
-									continue;
-
-								g_value_set_static_string(&string_value, gst_dsd_format_to_string(dsd_format));
-								gst_value_list_append_value(&list_value, &string_value);
-							}
-
-							gst_structure_set_value(s, "format", &list_value);
-
-							g_value_unset(&list_value);
-							g_value_unset(&string_value);
-
-							gst_caps_append(available_sinkcaps, caps);
-							break;
-						}
-
-						default:
-							gst_caps_append(available_sinkcaps, gst_pw_audio_format_get_template_caps_for_type(audio_type));
-					}
-
-					break;
-				}
-
-				case GST_PW_AUDIO_FORMAT_PROBE_RESULT_CANCELLED:
-					cancelled = TRUE;
-					break;
-
-				default:
-					break;
-			}
-		}
-
-#if !PW_CHECK_VERSION(0, 3, 57)
-		// This is a workaround. Without this, any DSD playback other than DSD64 fails.
-		// It seems that the ALSA SPA sink node is not correctly reinitialized, and "lingers"
-		// in its DSD64 setup (which is used during probing). This leads to this error in the log:
-		//
-		//   pw.context   | [       context.c:  737 pw_context_debug_port_params()] params Spa:Enum:ParamId:EnumFormat: 0:0 Invalid argument (input format (no more input formats))
-		//
-		// By dummy-probing PCM again, the node is forced to reinitialize.
-		//
-		// Reported as: https://gitlab.freedesktop.org/pipewire/pipewire/-/issues/2625
-		// Fixed in version 0.3.57.
-		gst_pw_audio_format_probe_probe_audio_type(self->format_probe, GST_PIPEWIRE_AUDIO_TYPE_PCM, target_object_id, NULL);
-#endif
-
-		gst_pw_audio_format_probe_teardown(self->format_probe);
+		available_sinkcaps = gst_pw_audio_format_probe_caps(self->format_probe, target_object_id, &cancelled);
 
 		if (cache_probed_caps)
 		{
@@ -1904,12 +3135,32 @@ static gboolean gst_pw_audio_sink_start(GstBaseSink *basesink)
 	socket_fd = self->socket_fd;
 	self->skew_threshold_snapshot = self->skew_threshold;
 	self->ring_buffer_length_snapshot = self->ring_buffer_length_in_ms * GST_MSECOND;
+	self->idle_timeout_snapshot = self->idle_timeout_in_ms * GST_MSECOND;
+	self->latency_update_threshold_snapshot = self->latency_update_threshold;
+	self->latency_update_relative_threshold_snapshot = self->latency_update_relative_threshold;
+	self->min_latency_update_interval_snapshot = self->min_latency_update_interval;
+	self->played_audio_tap_length_snapshot = self->played_audio_tap_length_in_ms * GST_MSECOND;
+	self->freewheel_snapshot = self->freewheel;
+	self->level_metering_snapshot = self->level_metering;
+	self->level_interval_snapshot = self->level_interval;
+	self->async_processing_snapshot = self->async_processing;
+	g_array_set_size(self->channel_delays_snapshot, 0);
+	g_array_append_vals(self->channel_delays_snapshot, self->channel_delays->data, self->channel_delays->len);
 
 	self->pipewire_core = gst_pipewire_core_get(socket_fd);
 
 	GST_OBJECT_UNLOCK(self);
 
-	self->do_synced_playback = gst_base_sink_get_sync(basesink);
+	/* In freewheel mode, the graph runs as fast as it can, so its pace has
+	 * nothing to do with the pipeline clock. Synchronizing against that
+	 * clock would throttle playback back to real time. Instead, the process
+	 * callback waits for render() to supply the data for each graph cycle.
+	 * The stream clock then reports the graph time, since extrapolating it
+	 * with the system clock makes no sense in this mode. */
+	self->do_synced_playback = gst_base_sink_get_sync(basesink) && !(self->freewheel_snapshot);
+	gst_pw_stream_clock_set_follow_graph_time(self->stream_clock, self->freewheel_snapshot);
+	if (self->freewheel_snapshot)
+		GST_DEBUG_OBJECT(self, "freewheel mode enabled; disabling synced playback");
 
 	if (G_UNLIKELY(self->pipewire_core == NULL))
 	{
@@ -1957,6 +3208,20 @@ static gboolean gst_pw_audio_sink_start(GstBaseSink *basesink)
 		GST_DEBUG_OBJECT(self, "extra properties for the new PipeWire stream: %" GST_PTR_FORMAT, (gpointer)(self->stream_properties));
 	}
 
+	/* This makes PipeWire switch the graph that this node is
+	 * in to the freewheel driver while the node is active. */
+	if (self->freewheel_snapshot)
+		pw_properties_set(pw_props, PW_KEY_NODE_FREEWHEEL, "true");
+
+	/* This makes the graph consume the data that the process callback
+	 * produced in the previous cycle instead of waiting for the process
+	 * callback to finish within the current cycle. The extra cycle is
+	 * added to the stream delay (see gst_pw_audio_sink_get_delay_in_ticks()).
+	 * The additional streams copy these properties, so they are
+	 * processed asynchronously as well. */
+	if (self->async_processing_snapshot)
+		pw_properties_set(pw_props, PW_KEY_NODE_ASYNC, "true");
+
 	/* Reuse the node name as the stream name. We copy the string here
 	 * to prevent potential race conditions if the user assigns a new
 	 * name string to the node-name property while this code runs. */
@@ -1966,6 +3231,11 @@ static gboolean gst_pw_audio_sink_start(GstBaseSink *basesink)
 
 	pw_thread_loop_lock(self->pipewire_core->loop);
 	self->stream = pw_stream_new(self->pipewire_core->core, stream_media_name, pw_props);
+	/* Listen for the "default" metadata object, which is
+	 * needed for moving the stream to a different target. */
+	self->registry = pw_core_get_registry(self->pipewire_core->core, PW_VERSION_REGISTRY, 0);
+	if (self->registry != NULL)
+		pw_registry_add_listener(self->registry, &(self->registry_listener), &registry_events, self);
 	pw_thread_loop_unlock(self->pipewire_core->loop);
 	if (G_UNLIKELY(self->stream == NULL))
 	{
@@ -1975,6 +3245,9 @@ static gboolean gst_pw_audio_sink_start(GstBaseSink *basesink)
 
 	GST_DEBUG_OBJECT(self, "PipeWire stream successfully created");
 
+	if (!gst_pw_audio_sink_create_additional_streams(self))
+		goto error;
+
 finish:
 	g_free(stream_media_name);
 	return retval;
@@ -1994,6 +3267,7 @@ static gboolean gst_pw_audio_sink_stop(GstBaseSink *basesink)
 	{
 		GST_DEBUG_OBJECT(self, "disconnecting and destroying PipeWire stream");
 		gst_pw_audio_sink_disconnect_stream(self);
+		gst_pw_audio_sink_destroy_additional_streams(self);
 
 		pw_thread_loop_lock(self->pipewire_core->loop);
 		pw_stream_destroy(self->stream);
@@ -2002,6 +3276,30 @@ static gboolean gst_pw_audio_sink_stop(GstBaseSink *basesink)
 		self->stream = NULL;
 	}
 
+	if (self->registry != NULL)
+	{
+		pw_thread_loop_lock(self->pipewire_core->loop);
+
+		if (self->default_metadata != NULL)
+		{
+			pw_proxy_destroy((struct pw_proxy *)(self->default_metadata));
+			self->default_metadata = NULL;
+			self->default_metadata_id = SPA_ID_INVALID;
+		}
+
+		spa_hook_remove(&(self->registry_listener));
+		pw_proxy_destroy((struct pw_proxy *)(self->registry));
+		self->registry = NULL;
+
+		g_hash_table_remove_all(self->audio_sink_node_names);
+		self->linked_target_node_id = SPA_ID_INVALID;
+		self->failover_start_time = GST_CLOCK_TIME_NONE;
+		g_free(self->failover_target_name);
+		self->failover_target_name = NULL;
+
+		pw_thread_loop_unlock(self->pipewire_core->loop);
+	}
+
 	/* Perform these teardown steps with the probe_process_mutex
 	 * locked, since caps queries can happen simultaneously,
 	 * and those trigger a get_caps() call. get_caps() accesses
@@ -2060,10 +3358,24 @@ static gboolean gst_pw_audio_sink_stop(GstBaseSink *basesink)
 	gst_pw_audio_sink_reset_audio_data_buffer_unlocked(self);
 	gst_pw_audio_sink_teardown_audio_data_buffer(self);
 
+	/* The stream is destroyed at this point, so the process callback
+	 * cannot publish a new snapshot anymore. The segment is reset through
+	 * the seqlock, since POSITION queries may still run concurrently. */
+	{
+		GstSegment segment;
+
+		gst_pw_audio_sink_invalidate_position_snapshot(self);
+
+		gst_segment_init(&segment, GST_FORMAT_TIME);
+		gst_pw_audio_sink_publish_position_segment(self, &segment);
+	}
+
 	self->flushing = 0;
 	self->paused = 0;
 	self->latency = 0;
 	self->accum_excess_encaudio_playtime = 0;
+	self->scheduled_start_offset_set = FALSE;
+	self->scheduled_stop_announced = FALSE;
 	self->stream_clock_is_pipeline_clock = FALSE;
 	self->stream_listener_added = FALSE;
 	self->notify_about_activated_stream = FALSE;
@@ -2074,12 +3386,40 @@ static gboolean gst_pw_audio_sink_stop(GstBaseSink *basesink)
 	self->spa_position = NULL;
 	self->spa_rate_match = NULL;
 	self->stream_delay_in_ticks = 0;
+	self->stream_delay_rate.num = 0;
+	self->stream_delay_rate.denom = 0;
 	self->stream_delay_in_ns = 0;
+	self->reported_stream_delay_in_ns = 0;
+	self->last_latency_update_time = GST_CLOCK_TIME_NONE;
 	self->quantum_size_in_ticks = 0;
 	self->quantum_size_in_ns = 0;
+	self->published_process_latency = GST_CLOCK_TIME_NONE;
 	self->last_pw_time_ticks = 0;
 	self->last_pw_time_ticks_set = FALSE;
+	self->last_clock_values_set = FALSE;
 	self->skew_threshold_snapshot = 0;
+	self->idle_timeout_snapshot = 0;
+	self->latency_update_threshold_snapshot = 0;
+	self->latency_update_relative_threshold_snapshot = 0.0;
+	self->min_latency_update_interval_snapshot = 0;
+	self->played_audio_tap_length_snapshot = 0;
+	self->freewheel_snapshot = FALSE;
+	self->level_metering_snapshot = GST_PW_AUDIO_SINK_LEVEL_METERING_NONE;
+	self->level_interval_snapshot = 0;
+	self->async_processing_snapshot = FALSE;
+	g_array_set_size(self->channel_delays_snapshot, 0);
+	self->idle_start_time = GST_CLOCK_TIME_NONE;
+	self->idle_suspension_requested = FALSE;
+	self->idle_suspending = 0;
+	self->idle_suspended = 0;
+	self->relink_pending = 0;
+	self->freewheel_wait_enabled = 0;
+	self->active_level_metering = GST_PW_AUDIO_SINK_LEVEL_METERING_NONE;
+	self->qos_num_expired_frames = 0;
+	self->qos_expired_frames_pts = GST_CLOCK_TIME_NONE;
+	self->qos_max_lateness = 0;
+	self->qos_num_played_frames = 0;
+	self->qos_proportion = 1.0;
 
 	return TRUE;
 }
@@ -2122,11 +3462,25 @@ static gboolean gst_pw_audio_sink_event(GstBaseSink *basesink, GstEvent *event)
 			gst_pw_stream_clock_freeze(self->stream_clock);
 
 			g_atomic_int_set(&(self->flushing), 1);
-			g_cond_signal(&(self->audio_data_buffer_cond));
+			/* Broadcast, since in freewheel mode, the process callback
+			 * may be waiting on the cond in addition to render(). */
+			g_cond_broadcast(&(self->audio_data_buffer_cond));
+
+			gst_pw_audio_sink_invalidate_position_snapshot(self);
 
 			/* Deactivate the stream since we won't be producing data during flush. */
 			pw_thread_loop_lock(self->pipewire_core->loop);
 			pw_stream_flush(self->stream, FALSE);
+			if (self->additional_streams != NULL)
+			{
+				guint i;
+				for (i = 0; i < self->additional_streams->len; ++i)
+				{
+					GstPwAudioSinkAdditionalStream *additional_stream = g_ptr_array_index(self->additional_streams, i);
+					if (additional_stream->stream_is_connected)
+						pw_stream_flush(additional_stream->stream, FALSE);
+				}
+			}
 			self->can_drain = FALSE;
 			gst_pw_audio_sink_activate_stream_unlocked(self, FALSE);
 			pw_thread_loop_unlock(self->pipewire_core->loop);
@@ -2153,6 +3507,17 @@ static gboolean gst_pw_audio_sink_event(GstBaseSink *basesink, GstEvent *event)
 			break;
 		}
 
+		case GST_EVENT_SEGMENT:
+		{
+			GstSegment segment;
+
+			gst_event_copy_segment(event, &segment);
+			if (segment.format == GST_FORMAT_TIME)
+				gst_pw_audio_sink_publish_position_segment(self, &segment);
+
+			break;
+		}
+
 		default:
 			break;
 	}
@@ -2171,15 +3536,7 @@ static GstFlowReturn gst_pw_audio_sink_wait_event(GstBaseSink *basesink, GstEven
 		case GST_EVENT_GAP:
 		{
 			GstClockTime timestamp, duration;
-
-			/* These events are not explicitly handled, since gaps are already
-			 * compensated for in render() by inserting nullsamples (via the
-			 * alignment threshold check). We just log gaps here and do nothing
-			 * further. */
-			// TODO: Change this: Record the gap event, and next time the
-			// render() function is called, insert the exact amount of nullsamples.
-			// That's because the alignment threshold check won't work properly
-			// for small gaps that are below that threshold.
+			GstBuffer *gap_buffer;
 
 			gst_event_parse_gap(event, &timestamp, &duration);
 
@@ -2190,6 +3547,34 @@ static GstFlowReturn gst_pw_audio_sink_wait_event(GstBaseSink *basesink, GstEven
 				GST_TIME_ARGS(duration)
 			);
 
+			/* Without a valid timestamp and duration, the gap cannot be
+			 * placed in the timeline. Such gaps are then compensated for
+			 * in render() by inserting nullsamples (via the alignment
+			 * threshold check) once the next buffer arrives. Encoded data
+			 * has no notion of gap frames, so it is not handled here. */
+			if (!GST_CLOCK_TIME_IS_VALID(timestamp) || !GST_CLOCK_TIME_IS_VALID(duration)
+			 || !gst_pw_audio_format_data_is_raw(self->pw_audio_format.audio_type)
+			 || (self->ring_buffer == NULL))
+				break;
+
+			if (gst_pw_audio_format_calculate_num_frames_from_duration(&(self->pw_audio_format), duration) == 0)
+				break;
+
+			/* Turn the gap into a GAP buffer and render it. This records the
+			 * exact gap in the ring buffer's timeline. The alignment threshold
+			 * check in render() alone would not handle gaps that are smaller
+			 * than that threshold. The buffer has no memory, since gap frames
+			 * are not written into the ring buffer, and gaps can be very long;
+			 * render_raw() gets the number of gap frames from the duration. */
+			gap_buffer = gst_buffer_new();
+			GST_BUFFER_PTS(gap_buffer) = timestamp;
+			GST_BUFFER_DURATION(gap_buffer) = duration;
+			GST_BUFFER_FLAG_SET(gap_buffer, GST_BUFFER_FLAG_GAP);
+
+			flow_ret = gst_pw_audio_sink_render_raw(self, gap_buffer);
+
+			gst_buffer_unref(gap_buffer);
+
 			break;
 		}
 
@@ -2263,8 +3648,29 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 	gsize num_frames;
 	gsize num_remaining_frames_to_push;
 	gsize incoming_buffer_frame_offset;
-
-	num_frames = gst_buffer_get_size(original_incoming_buffer) / self->stride;
+	gboolean is_gap_buffer;
+	/* Data that was clipped because it overlaps with already played data.
+	 * This is reported upstream as a QoS observation. */
+	GstClockTime overlap_running_time = GST_CLOCK_TIME_NONE;
+	GstClockTime overlap_duration = 0;
+
+	/* GAP buffers contain silence. Their data does not have to be copied; instead,
+	 * gap frames are pushed into the ring buffer, which allows on_process_stream
+	 * to mark the SPA chunks as empty. The flag is checked here, since the
+	 * buffer copies that are made below do not retain the buffer flags. */
+	is_gap_buffer = GST_BUFFER_FLAG_IS_SET(original_incoming_buffer, GST_BUFFER_FLAG_GAP);
+
+	/* GAP buffers may have no memory at all (this is how GAP events are
+	 * rendered; see gst_pw_audio_sink_wait_event()). Their length is then
+	 * given by their duration. */
+	if (is_gap_buffer && (gst_buffer_n_memory(original_incoming_buffer) == 0))
+	{
+		num_frames = GST_BUFFER_DURATION_IS_VALID(original_incoming_buffer)
+		           ? gst_pw_audio_format_calculate_num_frames_from_duration(&(self->pw_audio_format), GST_BUFFER_DURATION(original_incoming_buffer))
+		           : 0;
+	}
+	else
+		num_frames = gst_buffer_get_size(original_incoming_buffer) / self->stride;
 
 	/* For PCM/DSD audio data, it is better to not rely on values from GST_BUFFER_DURATION.
 	 * These can be invalid, completely absent, or differ in length from the playtime of
@@ -2286,12 +3692,12 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 	if (G_UNLIKELY(GST_BUFFER_FLAG_IS_SET(original_incoming_buffer, GST_BUFFER_FLAG_DISCONT)))
 	{
 		GST_DEBUG_OBJECT(self, "discont flag set - resetting alignment check");
-		/* Forget about the last expected_next_running_time_pts, since between it and
-		 * the current running_time_pts value is an expected discontinuity. That's what
+		/* Forget about the output timeline, since between its end and the current
+		 * running_time_pts value is an expected discontinuity. That's what
 		 * the DISCONT buffer flag is for - to announce *expected* discontinuities.
 		 * It doesn't mean "handle a discontinuity now", quite the opposite, it essentially
 		 * means "ignore this discontinuity". */
-		self->expected_next_running_time_pts = GST_CLOCK_TIME_NONE;
+		discontinuity_accumulator_reset(&(self->discontinuity_accumulator));
 	}
 
 	if (G_UNLIKELY(GST_BUFFER_FLAG_IS_SET(original_incoming_buffer, GST_BUFFER_FLAG_RESYNC)))
@@ -2305,6 +3711,9 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 		force_discontinuity_handling = TRUE;
 	}
 
+	if (is_gap_buffer)
+		GST_LOG_OBJECT(self, "gap flag set; pushing gap frames instead of the buffer's data");
+
 	sync_enabled = self->do_synced_playback;
 
 	/* If the sync property is set to TRUE, and the incoming data is in a TIME
@@ -2403,6 +3812,7 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 		if (GST_CLOCK_TIME_IS_VALID(clipped_pts_begin) && GST_CLOCK_TIME_IS_VALID(clipped_pts_end))
 		{
 			GstClockTime running_time_pts;
+			GstClockTimeDiff discontinuity;
 			gsize clipped_begin_frames = 0, clipped_end_frames = 0;
 			gsize original_num_frames;
 			GstClockTime begin_clip_duration, end_clip_duration;
@@ -2412,55 +3822,72 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 
 			pw_base_time = GST_ELEMENT_CAST(self)->base_time;
 
-			if (GST_CLOCK_TIME_IS_VALID(self->expected_next_running_time_pts))
+			/* Do not compensate for each discontinuity individually. Instead,
+			 * accumulate them, and only compensate if the accumulated value
+			 * persistently exceeds the alignment threshold. This filters out
+			 * alternating discontinuities like +1ms -1ms +1ms -1ms etc. that
+			 * cancel each other out. The only exception is a forced handling,
+			 * which must happen right away. */
+			if (discontinuity_accumulator_check(
+				&(self->discontinuity_accumulator),
+				running_time_pts,
+				self->alignment_threshold,
+				force_discontinuity_handling,
+				&discontinuity
+			))
 			{
-				GstClockTimeDiff discontinuity = GST_CLOCK_DIFF(self->expected_next_running_time_pts, running_time_pts);
-
-				// TODO: Accumulate discontinuity, and only perform compensation
-				// if the accumulated discontinuity is nonzero after a while.
-				// This filters out cases of alternating discontinuities, like
-				// +1ms now -1ms next +1ms next -1ms next etc.
-
-				if (G_UNLIKELY((ABS(discontinuity) > self->alignment_threshold) || ((discontinuity != 0) && force_discontinuity_handling)))
+				/* A positive discontinuity value means that there is a gap between
+				 * this buffer and the data that was pushed so far. If we are playing
+				 * contiguous audio data, we can fill the gap with silence frames.
+				 * A negative discontinuity value means that the first N nanoseconds
+				 * of this buffer overlap with already pushed data. We have to throw
+				 * away the first N nanoseconds of the new buffer in that case.
+				 * (N = ABS(discontinuity)) */
+
+				if (discontinuity > 0)
 				{
-					/* A positive discontinuity value means that there is a gap between
-					 * this buffer and the last one. If we are playing contiguous
-					 * audio data, we can fill the gap with silence frames.
-					 * A negative discontinuity value means that the last N nanoseconds
-					 * of the last buffer overlap with the first N nanoseconds of this
-					 * buffer. We have to throw away the first N nanoseconds of the
-					 * new buffer in that case. (N = ABS(discontinuity)) */
-
-					if (discontinuity > 0)
-					{
-						/* Shift the running-time PTS to make room for the extra silence frames. */
-						running_time_pts += discontinuity;
-						num_silence_frames_to_insert = gst_pw_audio_format_calculate_num_frames_from_duration(&(self->pw_audio_format), discontinuity);
-						GST_DEBUG_OBJECT(
-							self,
-							"discontinuity detected (%" GST_TIME_FORMAT "); need to insert %" G_GSIZE_FORMAT " silence frame(s) to compensate",
-							GST_TIME_ARGS(discontinuity),
-							num_silence_frames_to_insert
-						);
-					}
-					else
-					{
-						/* We need to clip the first N nanoseconds (N = -discontinuity), since these
-						 * overlap with already played data. The start of the remaining data needs to
-						 * be shifted into the future by (-discontinuity) nanoseconds to align it with
-						 * the previous data and to account for the clipped amount. clipped_pts_end
-						 * is not modified, however, since the overall duration of the data to play
-						 * is reduced by (-discontinuity) nanoseconds by the clipping. */
-						running_time_pts += (-discontinuity);
-						clipped_pts_begin += (-discontinuity);
-						GST_DEBUG_OBJECT(
-							self,
-							"discontinuity detected (-%" GST_TIME_FORMAT "); need to clip this (positive) amount of nanoseconds from the beginning of the gstbuffer",
-							GST_TIME_ARGS(-discontinuity)
-						);
-					}
+					num_silence_frames_to_insert = gst_pw_audio_format_calculate_num_frames_from_duration(&(self->pw_audio_format), discontinuity);
+					GST_DEBUG_OBJECT(
+						self,
+						"discontinuity detected (%" GST_TIME_FORMAT "); need to insert %" G_GSIZE_FORMAT " silence frame(s) to compensate",
+						GST_TIME_ARGS(discontinuity),
+						num_silence_frames_to_insert
+					);
+				}
+				else
+				{
+					/* We need to clip the first N nanoseconds (N = -discontinuity), since these
+					 * overlap with already played data. clipped_pts_end is not modified, since
+					 * the overall duration of the data to play is reduced by (-discontinuity)
+					 * nanoseconds by the clipping. */
+					overlap_running_time = running_time_pts;
+					overlap_duration = -discontinuity;
+					clipped_pts_begin += (-discontinuity);
+					GST_DEBUG_OBJECT(
+						self,
+						"discontinuity detected (-%" GST_TIME_FORMAT "); need to clip this (positive) amount of nanoseconds from the beginning of the gstbuffer",
+						GST_TIME_ARGS(-discontinuity)
+					);
 				}
 			}
+			else
+			{
+				GST_LOG_OBJECT(
+					self,
+					"deviation from output timeline: %" G_GINT64_FORMAT " ns; not compensating",
+					self->discontinuity_accumulator.deviation
+				);
+			}
+
+			/* Place the data in the output timeline, that is, right after the data
+			 * that was pushed earlier (and after the silence frames, if a gap is
+			 * compensated for). Using the buffer PTS here instead would make the
+			 * accumulator compensate for the same discontinuity once more later. */
+			running_time_pts = discontinuity_accumulator_get_output_pts(
+				&(self->discontinuity_accumulator),
+				running_time_pts,
+				discontinuity
+			);
 
 			g_assert(GST_CLOCK_TIME_IS_VALID(running_time_pts));
 
@@ -2470,7 +3897,7 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 			clipped_begin_frames = gst_pw_audio_format_calculate_num_frames_from_duration(&(self->pw_audio_format), begin_clip_duration);
 			clipped_end_frames = gst_pw_audio_format_calculate_num_frames_from_duration(&(self->pw_audio_format), end_clip_duration);
 
-			original_num_frames = gst_buffer_get_size(original_incoming_buffer) / self->stride;
+			original_num_frames = num_frames;
 
 			GST_LOG_OBJECT(
 				self,
@@ -2481,33 +3908,44 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 			);
 
 			/* Fringe case: The buffer is completely clipped, so we just drop it. */
-			if (G_UNLIKELY((clipped_begin_frames >= original_num_frames) || (clipped_end_frames >= original_num_frames)))
+			if (G_UNLIKELY((clipped_begin_frames + clipped_end_frames) >= original_num_frames))
 			{
 				GST_DEBUG_OBJECT(self, "clipped begin/end frames fully clip the buffer; dropping buffer");
 				goto finish;
 			}
 
-			incoming_buffer_copy = gst_buffer_copy_region(
-				original_incoming_buffer,
-				GST_BUFFER_COPY_MEMORY,
-				clipped_begin_frames * self->stride,
-				gst_buffer_get_size(original_incoming_buffer) - (clipped_begin_frames + clipped_end_frames) * self->stride
-			);
+			/* The data of GAP buffers is never accessed, so there is no
+			 * need to create a sub-buffer of their memory (if they have any). */
+			if (is_gap_buffer)
+			{
+				incoming_buffer_copy = gst_buffer_new();
+			}
+			else
+			{
+				incoming_buffer_copy = gst_buffer_copy_region(
+					original_incoming_buffer,
+					GST_BUFFER_COPY_MEMORY,
+					clipped_begin_frames * self->stride,
+					(original_num_frames - (clipped_begin_frames + clipped_end_frames)) * self->stride
+				);
+			}
+
+			num_frames = original_num_frames - (clipped_begin_frames + clipped_end_frames);
 
 			/* Set the incoming_buffer_copy's timestamp, translated to
 			 * clock-time by adding pw_base_time to running_time_pts. */
 			GST_BUFFER_PTS(incoming_buffer_copy) = pw_base_time + running_time_pts;
 			GST_BUFFER_DURATION(incoming_buffer_copy) = clipped_pts_end - clipped_pts_begin;
 
-			/* Estimate the next PTS. If the stream PTS are properly aligned, then the next
-			 * running-time PTS will match this estimate. Otherwise, there is a misalignment,
-			 * and we have to compensate. */
-			self->expected_next_running_time_pts = running_time_pts + GST_BUFFER_DURATION(incoming_buffer_copy);
+			/* Advance the output timeline. If the stream PTS are properly aligned, then
+			 * the next running-time PTS will match its end. Otherwise, there is a
+			 * misalignment, and we may have to compensate. */
+			discontinuity_accumulator_advance(&(self->discontinuity_accumulator), running_time_pts, GST_BUFFER_DURATION(incoming_buffer_copy));
 
 			GST_LOG_OBJECT(
 				self,
 				"current and next expected running time: %" GST_TIME_FORMAT " / %" GST_TIME_FORMAT,
-				GST_TIME_ARGS(running_time_pts), GST_TIME_ARGS(self->expected_next_running_time_pts)
+				GST_TIME_ARGS(running_time_pts), GST_TIME_ARGS(self->discontinuity_accumulator.expected_next_pts)
 			);
 
 			GST_LOG_OBJECT(
@@ -2545,9 +3983,9 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 		 */
 		incoming_buffer_copy = gst_buffer_copy(original_incoming_buffer);
 		GST_BUFFER_PTS(incoming_buffer_copy) = GST_CLOCK_TIME_NONE;
-		/* Also discard the expected_next_running_time_pts to avoid
+		/* Also discard the output timeline to avoid
 		 * incorrect discontinuity calculations. */
-		self->expected_next_running_time_pts = GST_CLOCK_TIME_NONE;
+		discontinuity_accumulator_reset(&(self->discontinuity_accumulator));
 	}
 
 	num_remaining_frames_to_push = num_frames;
@@ -2585,12 +4023,19 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 			g_atomic_int_set(&(self->notify_upstream_about_stream_delay), 0);
 		}
 
-		map_ret = gst_buffer_map(incoming_buffer_copy, &map_info, GST_MAP_READ);
-		if (G_UNLIKELY(!map_ret))
+		/* Reactivate the stream if it was suspended due to the idle timeout. */
+		if (G_UNLIKELY(gst_pw_audio_sink_is_idle_suspended(self)))
+			gst_pw_audio_sink_resume_from_idle_suspension(self);
+
+		if (!is_gap_buffer)
 		{
-			GST_ERROR_OBJECT(self, "could not map incoming buffer; buffer details: %" GST_PTR_FORMAT, (gpointer)incoming_buffer_copy);
-			flow_ret = GST_FLOW_ERROR;
-			goto finish;
+			map_ret = gst_buffer_map(incoming_buffer_copy, &map_info, GST_MAP_READ);
+			if (G_UNLIKELY(!map_ret))
+			{
+				GST_ERROR_OBJECT(self, "could not map incoming buffer; buffer details: %" GST_PTR_FORMAT, (gpointer)incoming_buffer_copy);
+				flow_ret = GST_FLOW_ERROR;
+				goto finish;
+			}
 		}
 
 		LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
@@ -2602,18 +4047,35 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 
 		push_pts = GST_BUFFER_PTS_IS_VALID(incoming_buffer_copy) ? (GST_BUFFER_PTS(incoming_buffer_copy) + pts_offset) : GST_CLOCK_TIME_NONE;
 
-		num_pushed_frames = gst_pw_audio_ring_buffer_push_frames(
-			self->ring_buffer,
-			map_info.data + incoming_buffer_frame_offset * self->stride,
-			num_remaining_frames_to_push,
-			&num_silence_frames_to_insert,
-			push_pts
-		);
+		if (is_gap_buffer)
+		{
+			num_pushed_frames = gst_pw_audio_ring_buffer_push_gap_frames(
+				self->ring_buffer,
+				num_remaining_frames_to_push,
+				&num_silence_frames_to_insert,
+				push_pts
+			);
+		}
+		else
+		{
+			num_pushed_frames = gst_pw_audio_ring_buffer_push_frames(
+				self->ring_buffer,
+				map_info.data + incoming_buffer_frame_offset * self->stride,
+				num_remaining_frames_to_push,
+				&num_silence_frames_to_insert,
+				push_pts
+			);
 
-		gst_buffer_unmap(incoming_buffer_copy, &map_info);
+			gst_buffer_unmap(incoming_buffer_copy, &map_info);
+		}
 
 		g_assert(num_pushed_frames <= num_remaining_frames_to_push);
 
+		/* In freewheel mode, the process callback may be
+		 * waiting for the frames that were just pushed. */
+		if (self->freewheel_snapshot)
+			g_cond_broadcast(&(self->audio_data_buffer_cond));
+
 		if (num_pushed_frames == num_remaining_frames_to_push)
 		{
 			UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
@@ -2629,7 +4091,11 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 				num_pushed_frames
 			);
 
-			g_cond_wait(&(self->audio_data_buffer_cond), &(self->audio_data_buffer_mutex));
+			/* Do not wait if the stream got suspended in the meantime, since
+			 * then, no room would be made. Instead, go straight to the
+			 * reactivation at the beginning of the next iteration. */
+			if (!gst_pw_audio_sink_is_idle_suspended(self))
+				g_cond_wait(&(self->audio_data_buffer_cond), &(self->audio_data_buffer_mutex));
 
 			UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
 		}
@@ -2638,7 +4104,16 @@ static GstFlowReturn gst_pw_audio_sink_render_raw(GstPwAudioSink *self, GstBuffe
 		incoming_buffer_frame_offset += num_pushed_frames;
 	}
 
+	/* The stream may have been suspended while the frames were pushed.
+	 * Make sure it gets reactivated, since otherwise, the pushed frames
+	 * would not be played until the next buffer arrives. */
+	if (G_UNLIKELY(gst_pw_audio_sink_is_idle_suspended(self)))
+		gst_pw_audio_sink_resume_from_idle_suspension(self);
+
 finish:
+	if (flow_ret == GST_FLOW_OK)
+		gst_pw_audio_sink_perform_qos(self, overlap_running_time, overlap_duration);
+
 	if (incoming_buffer_copy != NULL)
 		gst_buffer_unref(incoming_buffer_copy);
 	return flow_ret;
@@ -2693,6 +4168,8 @@ static GstFlowReturn gst_pw_audio_sink_render_encoded(GstPwAudioSink *self, GstB
 
 	while (TRUE)
 	{
+		gst_pw_audio_sink_release_consumed_encoded_frames_unlocked(self);
+
 		if (g_atomic_int_get(&(self->flushing)))
 		{
 			GST_DEBUG_OBJECT(self, "exiting loop in render function since we are flushing");
@@ -2744,10 +4221,23 @@ finish:
 }
 
 
-static gboolean gst_pw_audio_sink_handle_convert_query(GstPwAudioSink *self, GstQuery *query)
+static void gst_pw_audio_sink_release_consumed_encoded_frames_unlocked(GstPwAudioSink *self)
 {
-	GstFormat source_gstformat, dest_gstformat;
-	gint64 source_quantity, dest_quantity;
+	/* This must be called with the audio data buffer mutex locked,
+	 * and never from the process callback. */
+
+	while (self->num_consumed_encoded_frames > 0)
+	{
+		gst_buffer_unref(GST_BUFFER_CAST(gst_queue_array_pop_head(self->encoded_data_queue)));
+		self->num_consumed_encoded_frames--;
+	}
+}
+
+
+static gboolean gst_pw_audio_sink_handle_convert_query(GstPwAudioSink *self, GstQuery *query)
+{
+	GstFormat source_gstformat, dest_gstformat;
+	gint64 source_quantity, dest_quantity;
 
 	gst_query_parse_convert(query, &source_gstformat, &source_quantity, &dest_gstformat, NULL);
 
@@ -2872,6 +4362,12 @@ static void gst_pw_audio_sink_activate_stream_unlocked(GstPwAudioSink *self, gbo
 	 * for example, because gst_pw_audio_sink_pw_state_changed()
 	 * is called in the unconnected state after deactivation. */
 
+	/* Any explicit (de)activation ends an idle suspension. If the stream
+	 * is being deactivated, this also prevents render() from reactivating
+	 * it, since gst_pw_audio_sink_resume_from_idle_suspension() checks
+	 * this flag with the pw_thread_loop_lock taken. */
+	g_atomic_int_set(&(self->idle_suspended), 0);
+
 	if (self->stream_is_active == activate)
 		return;
 
@@ -2890,13 +4386,32 @@ static void gst_pw_audio_sink_activate_stream_unlocked(GstPwAudioSink *self, gbo
 		gst_pw_audio_sink_reset_drift_compensation_states(self);
 		self->last_pw_time_ticks = 0;
 		self->last_pw_time_ticks_set = FALSE;
+		self->last_clock_values_set = FALSE;
 		self->stream_drained = FALSE;
 		self->notify_about_activated_stream = TRUE;
+		self->idle_start_time = GST_CLOCK_TIME_NONE;
+		self->idle_suspension_requested = FALSE;
+		/* The sync is reset anyway in the activation case,
+		 * so there is no need to resync after a relink. */
+		g_atomic_int_set(&(self->relink_pending), 0);
+		g_atomic_int_set(&(self->freewheel_wait_enabled), self->freewheel_snapshot ? 1 : 0);
+	}
+	else if (self->freewheel_snapshot)
+	{
+		/* Wake up the process callback if it is waiting for data, and
+		 * prevent it from waiting again. pw_stream_set_active() would
+		 * otherwise block until that wait times out. */
+		LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+		g_atomic_int_set(&(self->freewheel_wait_enabled), 0);
+		g_cond_broadcast(&(self->audio_data_buffer_cond));
+		UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
 	}
 
 	pw_stream_set_active(self->stream, activate);
 	GST_DEBUG_OBJECT(self, "%s PipeWire stream", activate ? "activating" : "deactivating");
 
+	gst_pw_audio_sink_activate_additional_streams_unlocked(self, activate);
+
 	self->stream_is_active = activate;
 
 	if (!activate)
@@ -2912,7 +4427,25 @@ static void gst_pw_audio_sink_setup_audio_data_buffer(GstPwAudioSink *self)
 {
 	if (gst_pw_audio_format_data_is_raw(self->pw_audio_format.audio_type))
 	{
-		self->ring_buffer = gst_pw_audio_ring_buffer_new(&(self->pw_audio_format), self->ring_buffer_length_snapshot);
+		self->ring_buffer = gst_pw_audio_ring_buffer_new_with_channel_delays(
+			&(self->pw_audio_format),
+			self->ring_buffer_length_snapshot,
+			(guint const *)(self->channel_delays_snapshot->data),
+			self->channel_delays_snapshot->len
+		);
+
+		/* Each connected additional stream reads through its own cursor.
+		 * These cursors stay inactive until their streams are streaming. */
+		if (self->additional_streams != NULL)
+		{
+			guint i;
+			for (i = 0; i < self->additional_streams->len; ++i)
+			{
+				GstPwAudioSinkAdditionalStream *additional_stream = g_ptr_array_index(self->additional_streams, i);
+				if (additional_stream->stream_is_connected)
+					additional_stream->cursor_index = gst_pw_audio_ring_buffer_add_cursor(self->ring_buffer);
+			}
+		}
 
 		if (self->pw_audio_format.audio_type == GST_PIPEWIRE_AUDIO_TYPE_DSD)
 		{
@@ -2935,11 +4468,18 @@ static void gst_pw_audio_sink_setup_audio_data_buffer(GstPwAudioSink *self)
 
 			self->dsd_conversion_buffer = g_malloc(self->dsd_conversion_buffer_size);
 		}
+
+		gst_pw_audio_sink_setup_level_metering(self);
+
+		/* Deferred level metering reads the played audio from the tap. */
+		if ((self->played_audio_tap_length_snapshot > 0) || (self->active_level_metering == GST_PW_AUDIO_SINK_LEVEL_METERING_DEFERRED))
+			gst_pw_audio_sink_setup_played_audio_tap(self);
 	}
 	else
 	{
 		self->encoded_data_queue = gst_queue_array_new(0);
 		gst_queue_array_set_clear_func(self->encoded_data_queue, (GDestroyNotify)gst_buffer_unref);
+		self->num_consumed_encoded_frames = 0;
 		self->total_queued_encoded_data_duration = 0;
 	}
 }
@@ -2947,16 +4487,29 @@ static void gst_pw_audio_sink_setup_audio_data_buffer(GstPwAudioSink *self)
 
 static void gst_pw_audio_sink_teardown_audio_data_buffer(GstPwAudioSink *self)
 {
+	gst_pw_audio_sink_teardown_played_audio_tap(self);
+
 	if (self->ring_buffer != NULL)
 	{
 		gst_object_unref(GST_OBJECT(self->ring_buffer));
 		self->ring_buffer = NULL;
 	}
 
+	if (self->additional_streams != NULL)
+	{
+		guint i;
+		for (i = 0; i < self->additional_streams->len; ++i)
+		{
+			GstPwAudioSinkAdditionalStream *additional_stream = g_ptr_array_index(self->additional_streams, i);
+			additional_stream->cursor_index = -1;
+		}
+	}
+
 	if (self->encoded_data_queue != NULL)
 	{
 		gst_queue_array_free(self->encoded_data_queue);
 		self->encoded_data_queue = NULL;
+		self->num_consumed_encoded_frames = 0;
 	}
 
 	g_free(self->dsd_conversion_buffer);
@@ -2973,11 +4526,25 @@ static void gst_pw_audio_sink_reset_audio_data_buffer_unlocked(GstPwAudioSink *s
 
 	self->accum_excess_encaudio_playtime = 0;
 
+	/* The buffered data that the offset was computed for is gone. If the
+	 * start is still armed, the offset is computed again for the new data. */
+	self->scheduled_start_offset_set = FALSE;
+
 	/* Also reset these states, since a queue reset effectively ends
 	 * any synchronized playback of the stream that was going on earlier,
 	 * and there's no more old data to check for alignment with new data. */
 	self->synced_playback_started = FALSE;
-	self->expected_next_running_time_pts = GST_CLOCK_TIME_NONE;
+	discontinuity_accumulator_reset(&(self->discontinuity_accumulator));
+	gst_pw_audio_sink_reset_qos_observations_unlocked(self);
+	if (self->additional_streams != NULL)
+	{
+		guint i;
+		for (i = 0; i < self->additional_streams->len; ++i)
+		{
+			GstPwAudioSinkAdditionalStream *additional_stream = g_ptr_array_index(self->additional_streams, i);
+			additional_stream->synced_playback_started = FALSE;
+		}
+	}
 
 	/* Reset this, since any remainders are gone now. */
 	self->dsd_min_num_required_ticks_remainder = 0;
@@ -2991,6 +4558,102 @@ static void gst_pw_audio_sink_reset_drift_compensation_states(GstPwAudioSink *se
 }
 
 
+static void gst_pw_audio_sink_compensate_drift(GstPwAudioSink *self, PIController *pi_controller, GstClockTime *previous_time, struct spa_io_rate_match *spa_rate_match, GstClockTime current_time, GstClockTimeDiff retrieval_pts_delta)
+{
+	/* NOTE: This must be called from within a process callback. */
+
+	double input_ppm, filtered_ppm;
+	double rate, time_scale;
+	GstClockTimeDiff drift_pts_delta, clamped_drift_pts_delta;
+
+	/* Get the PTS delta from the queue. This delta already comes median-filtered,
+	 * so we don't bother pre-filtering it further here. However, we do clamp it
+	 * to limit the impact it can have on the PI controller. */
+	drift_pts_delta = retrieval_pts_delta;
+	clamped_drift_pts_delta = CLAMP(drift_pts_delta, -MAX_DRIFT_PTS_DELTA, +MAX_DRIFT_PTS_DELTA);
+
+	/* Do a simple linear transform to convert the PTS delta to a PPM value. PPM
+	 * is a relative quantity, and we use MAX_DRIFT_PTS_DELTA as the reference. */
+	input_ppm = MAX_DRIFT_PPM * ((double)clamped_drift_pts_delta) / MAX_DRIFT_PTS_DELTA;
+
+	/* Calculate the time_scale to correctly factor in the elapsed time between
+	 * ticks when the PI controller calculates the filtered PPM quantity. As for
+	 * the situation in the beginning, we don't do any clock drift compensation
+	 * from the get-go anyway, so it is fine to use a time_scale of 0, which
+	 * effectively amounts to a no-op in pi_controller_compute(). */
+	time_scale = GST_CLOCK_TIME_IS_VALID(*previous_time)
+		? (((double)GST_CLOCK_DIFF(*previous_time, current_time)) / GST_SECOND)
+		: 0.0;
+
+	/* Perform the filtering using the PI controller. */
+	filtered_ppm = pi_controller_compute(pi_controller, input_ppm, time_scale);
+
+	/* Using the PPM, adjust the ASRC. */
+	rate = 1.0 - filtered_ppm / 1000000.0;
+	spa_rate_match->rate = rate;
+
+	GST_LOG_OBJECT(
+		self,
+		"drift adjustment: original / clamped PTS delta: %"
+		G_GINT64_FORMAT " / %" G_GINT64_FORMAT
+		" time scale: %f input / filtered PPM: %f / %f rate: %f",
+		drift_pts_delta, clamped_drift_pts_delta,
+		time_scale, input_ppm, filtered_ppm, rate
+	);
+
+	/* Store the current time for the next iteration so we can compute the next time_scale. */
+	*previous_time = current_time;
+}
+
+
+static void gst_pw_audio_sink_set_chunk_content(GstPwAudioSink *self, struct pw_buffer *pw_buf, struct spa_data *inner_spa_data, gboolean is_silence, gsize num_bytes)
+{
+	/* NOTE: This must be called from within a process callback. */
+
+	/* Silent PCM chunks are marked as empty, which allows downstream nodes
+	 * (mixers for example) to skip their data. This is not done with DSD,
+	 * since DSD silence is not made of zero bytes.
+	 *
+	 * With PCM, pw_buf->user_data stores how many bytes at the beginning of
+	 * the buffer's memory are known to contain silence. pw_buffers are recycled, so this
+	 * allows for skipping redundant silence writes if the same buffer is used
+	 * for producing silence several times in a row. The data is still filled
+	 * with silence once, since not all consumers honor SPA_CHUNK_FLAG_EMPTY. */
+
+	if (is_silence && (self->pw_audio_format.audio_type == GST_PIPEWIRE_AUDIO_TYPE_PCM))
+	{
+		inner_spa_data->chunk->flags = SPA_CHUNK_FLAG_EMPTY;
+		pw_buf->user_data = GSIZE_TO_POINTER(MAX(GPOINTER_TO_SIZE(pw_buf->user_data), num_bytes));
+	}
+	else
+	{
+		inner_spa_data->chunk->flags = SPA_CHUNK_FLAG_NONE;
+		pw_buf->user_data = NULL;
+	}
+}
+
+
+static void gst_pw_audio_sink_produce_silence_chunk(GstPwAudioSink *self, struct pw_buffer *pw_buf, struct spa_data *inner_spa_data, guint64 num_frames)
+{
+	/* NOTE: This must be called from within a process callback. */
+
+	gsize num_bytes = num_frames * self->stride;
+
+	g_assert(num_frames <= (inner_spa_data->maxsize / self->stride));
+
+	inner_spa_data->chunk->offset = 0;
+	inner_spa_data->chunk->size = num_bytes;
+	inner_spa_data->chunk->stride = self->stride;
+
+	if (GPOINTER_TO_SIZE(pw_buf->user_data) < num_bytes)
+		gst_pw_audio_format_write_silence_frames(&(self->pw_audio_format), inner_spa_data->data, num_frames);
+	else
+		GST_LOG_OBJECT(self, "buffer already contains silence; not writing silence frames again");
+
+	gst_pw_audio_sink_set_chunk_content(self, pw_buf, inner_spa_data, TRUE, num_bytes);
+}
+
+
 static void gst_pw_audio_sink_drain_stream_unlocked(GstPwAudioSink *self)
 {
 	/* This must be called with the pw_thread_loop_lock taken. */
@@ -3101,16 +4764,21 @@ static void gst_pw_audio_sink_drain_stream_and_audio_data_buffer(GstPwAudioSink
 					);
 
 					/* Set the draining_ring_buffer flag while waiting for the ring buffer to be emptied.
-					 * This flag informs the code in gst_pw_audio_sink_raw_on_process_stream() that the
+					 * This flag informs the code in gst_pw_audio_sink_raw_process_stream() that the
 					 * data in the ring buffer is to be accessed without any synchronization. The reason
 					 * for this is that during the draining process, the buffered frames window keeps
 					 * shrinking (since the ring buffer is being drained). Eventually, it might shrink
 					 * to such an extent that the retrieval window and the buffered frames window no
 					 * longer overlap. This in turn can then lead to audible data loss depending on how
 					 * these windows overlapped in the first place. Solve this by using this flag, which
-					 * essentially instructs gst_pw_audio_sink_raw_on_process_stream() do not use any
+					 * essentially instructs gst_pw_audio_sink_raw_process_stream() do not use any
 					 * such windows, and use the ring buffer in a simple FIFO like manner instead. */
 					self->draining_ring_buffer = TRUE;
+					/* In freewheel mode, the process callback may be waiting for more data.
+					 * Wake it up so it sees the draining_ring_buffer flag and retrieves
+					 * the remaining frames instead. */
+					if (self->freewheel_snapshot)
+						g_cond_broadcast(&(self->audio_data_buffer_cond));
 					g_cond_wait(&(self->audio_data_buffer_cond), &(self->audio_data_buffer_mutex));
 					self->draining_ring_buffer = FALSE;
 				}
@@ -3129,6 +4797,7 @@ static void gst_pw_audio_sink_drain_stream_and_audio_data_buffer(GstPwAudioSink
 				break;
 			}
 
+			gst_pw_audio_sink_release_consumed_encoded_frames_unlocked(self);
 			num_queued_frames = gst_queue_array_get_length(self->encoded_data_queue);
 
 			if (num_queued_frames == 0)
@@ -3183,8 +4852,11 @@ static void gst_pw_audio_sink_disconnect_stream(GstPwAudioSink *self)
 	pw_thread_loop_lock(self->pipewire_core->loop);
 	gst_pw_audio_sink_activate_stream_unlocked(self, FALSE);
 	pw_stream_disconnect(self->stream);
+	self->published_process_latency = GST_CLOCK_TIME_NONE;
 	pw_thread_loop_unlock(self->pipewire_core->loop);
 
+	gst_pw_audio_sink_disconnect_additional_streams(self);
+
 	self->stream_is_connected = FALSE;
 }
 
@@ -3254,154 +4926,1792 @@ static void gst_pw_audio_sink_calculate_data_rate_multiplier(GstPwAudioSink *sel
 }
 
 
-static int gst_pw_audio_sink_activated_stream_cb(
-	G_GNUC_UNUSED struct spa_loop *loop,
-	G_GNUC_UNUSED bool async,
-	G_GNUC_UNUSED uint32_t seq,
-	G_GNUC_UNUSED const void *_data,
-	G_GNUC_UNUSED size_t size,
-	void *user_data)
+static void gst_pw_audio_sink_update_quantum_size(GstPwAudioSink *self)
 {
-	/* NOTE: This is called in the threaded PipeWire loop (self->pipewire_core->loop),
-	 * not in any particular GStreamer thread nor in a pw_stream dataloop thread.
-	 * It is important to not block here. Just emit the GLib signal and then exit. */
+	struct spa_io_clock const *clock = &(self->spa_position->clock);
 
-	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(user_data);
+	if (clock->rate.denom == 0)
+		return;
 
-	/* See the comment in gst_pw_audio_sink_disconnect_stream()
-	 * for why the seq ID is checked this way. */
-	if (g_atomic_int_get(&(self->activated_stream_seq_id)) == (gint)seq)
+	self->quantum_size_in_ticks = clock->duration;
+	self->quantum_size_in_ns = gst_util_uint64_scale_int(
+		self->quantum_size_in_ticks * clock->rate.num,
+		GST_SECOND,
+		clock->rate.denom
+	);
+}
+
+
+static gboolean gst_pw_audio_sink_detect_xrun(GstPwAudioSink *self, struct pw_time const *stream_time, gboolean *graph_clock_changed)
+{
+	gboolean xrun_detected = FALSE;
+
+	/* Returns TRUE if a real xrun (a discontinuity in the graph's timeline)
+	 * happened since the last call. Quantum size changes are not xruns; if
+	 * another client requests a different node.latency, the graph's cycle
+	 * duration changes, but the clock position still advances contiguously.
+	 * Driver changes and clock rate changes are not xruns either. These are
+	 * reported through graph_clock_changed instead, since they require other
+	 * states (like the stream clock) to be adjusted to the new clock. */
+
+	*graph_clock_changed = FALSE;
+
+	if (G_LIKELY(self->spa_position != NULL))
 	{
-		GST_DEBUG_OBJECT(self, "got activated stream notification with seq ID %" PRIu32 "; emitting stream-activated signal", seq);
-		g_signal_emit(self, gst_pw_audio_sink_signals[SIGNAL_STREAM_ACTIVATED], 0, self->sink_caps);
+		struct spa_io_clock const *clock = &(self->spa_position->clock);
+
+		if (self->last_clock_values_set)
+		{
+			if (G_UNLIKELY((clock->id != self->last_clock_id) || (clock->rate.num != self->last_clock_rate.num) || (clock->rate.denom != self->last_clock_rate.denom)))
+			{
+				/* The positions of different clocks or different clock rates
+				 * are not comparable. Just start over with the new clock. No
+				 * data was lost, so there is no need to resynchronize. The rate
+				 * dependent quantities are recomputed, since io_changed() is not
+				 * called if the rate changes within the same SPA IO position area. */
+				GST_INFO_OBJECT(
+					self,
+					"graph clock changed (ID %" G_GUINT32_FORMAT " -> %" G_GUINT32_FORMAT ", rate %" G_GUINT32_FORMAT "/%" G_GUINT32_FORMAT " -> %" G_GUINT32_FORMAT "/%" G_GUINT32_FORMAT "); not checking for xrun in this cycle",
+					self->last_clock_id, (guint32)(clock->id),
+					self->last_clock_rate.num, self->last_clock_rate.denom,
+					(guint32)(clock->rate.num), (guint32)(clock->rate.denom)
+				);
+
+				gst_pw_audio_sink_update_quantum_size(self);
+				gst_pw_audio_sink_calculate_data_rate_multiplier(self);
+
+				*graph_clock_changed = TRUE;
+			}
+			else
+			{
+				guint64 expected_position = self->last_clock_position + self->last_clock_duration;
+				guint32 cycle_delta = clock->cycle - self->last_clock_cycle;
+
+				if (G_UNLIKELY(clock->xrun != self->last_clock_xrun))
+				{
+					GST_INFO_OBJECT(
+						self,
+						"driver reported xrun (accumulated xrun duration %" G_GUINT64_FORMAT " -> %" G_GUINT64_FORMAT ")",
+						self->last_clock_xrun, (guint64)(clock->xrun)
+					);
+					xrun_detected = TRUE;
+				}
+				else if (G_UNLIKELY(clock->position > expected_position))
+				{
+					GST_INFO_OBJECT(
+						self,
+						"clock position is %" G_GUINT64_FORMAT ", which is %" G_GUINT64_FORMAT " tick(s) ahead of expected position %" G_GUINT64_FORMAT "; xrun detected",
+						(guint64)(clock->position),
+						(guint64)(clock->position - expected_position),
+						expected_position
+					);
+					xrun_detected = TRUE;
+				}
+				else if (G_UNLIKELY(cycle_delta > 1))
+				{
+					GST_INFO_OBJECT(
+						self,
+						"%" G_GUINT32_FORMAT " graph cycle(s) were skipped; xrun detected",
+						cycle_delta - 1
+					);
+					xrun_detected = TRUE;
+				}
+				else if (G_UNLIKELY(clock->position < expected_position))
+				{
+					/* This happens when the driver repositions its clock, for
+					 * example after it was restarted. No audio data was lost
+					 * in this case, so no resynchronization is needed. */
+					GST_DEBUG_OBJECT(
+						self,
+						"clock position is %" G_GUINT64_FORMAT ", which is behind expected position %" G_GUINT64_FORMAT "; clock was repositioned",
+						(guint64)(clock->position),
+						expected_position
+					);
+				}
+
+				if (G_UNLIKELY(clock->duration != self->last_clock_duration))
+				{
+					GST_DEBUG_OBJECT(
+						self,
+						"quantum size changed from %" G_GUINT64_FORMAT " to %" G_GUINT64_FORMAT " tick(s)",
+						self->last_clock_duration, (guint64)(clock->duration)
+					);
+				}
+			}
+		}
+		else
+			self->last_clock_values_set = TRUE;
+
+		/* io_changed() is only called when the SPA IO position area itself
+		 * changes, not when its contents change, so keep the quantum size
+		 * up to date here. */
+		if (G_UNLIKELY(clock->duration != self->quantum_size_in_ticks))
+			gst_pw_audio_sink_update_quantum_size(self);
+
+		self->last_clock_id = clock->id;
+		self->last_clock_rate = clock->rate;
+		self->last_clock_position = clock->position;
+		self->last_clock_duration = clock->duration;
+		self->last_clock_cycle = clock->cycle;
+		self->last_clock_xrun = clock->xrun;
 	}
 	else
-		GST_DEBUG_OBJECT(self, "ignoring expired activated stream notification with seq ID %" PRIu32, seq);
+	{
+		/* Without spa_position, the best we can do is compare the pw_time
+		 * ticks against the quantum size. A tick delta that is smaller than
+		 * the quantum size can be caused by a quantum size change, and does
+		 * not imply lost data, so only a greater tick delta counts as xrun. */
 
-	return 0;
+		if (self->last_pw_time_ticks_set)
+		{
+			uint64_t tick_delta = stream_time->ticks - self->last_pw_time_ticks;
+
+			if (G_UNLIKELY(tick_delta > self->quantum_size_in_ticks))
+			{
+				GST_INFO_OBJECT(self, "tick delta is %" G_GUINT64_FORMAT ", which is greater than expected %" G_GUINT64_FORMAT "; discontinuity in pw stream detected", (guint64)tick_delta, (guint64)(self->quantum_size_in_ticks));
+				xrun_detected = TRUE;
+			}
+		}
+		else
+			self->last_pw_time_ticks_set = TRUE;
+
+		self->last_pw_time_ticks = stream_time->ticks;
+	}
+
+	return xrun_detected;
 }
 
 
-static gchar const * spa_io_position_state_to_string(enum spa_io_position_state const state)
+static gint64 gst_pw_audio_sink_get_delay_in_ticks(GstPwAudioSink *self, struct pw_time const *stream_time, struct spa_io_position const *spa_position)
 {
-	switch (state)
+	/* With asynchronous processing, the data that a process callback
+	 * produces is consumed by the graph in the next cycle, that is, at
+	 * spa_position->clock.next_nsec instead of spa_position->clock.nsec.
+	 * pw_time.delay does not include that extra cycle, so add it here.
+	 * That way, the data is retrieved from the ring buffer one cycle
+	 * earlier, and the sink's latency is increased by that cycle.
+	 * The cycle is added in ticks (the clock duration) instead of
+	 * (next_nsec - nsec), since the latter jitters with the driver's
+	 * rate, and would make the delay appear to change in every cycle. */
+
+	gint64 delay_in_ticks = stream_time->delay;
+
+	if (self->async_processing_snapshot && (spa_position != NULL))
+		delay_in_ticks += spa_position->clock.duration;
+
+	return delay_in_ticks;
+}
+
+
+static gboolean gst_pw_audio_sink_stream_delay_change_is_significant(GstPwAudioSink *self, gint64 now)
+{
+	/* Must be called with the latency mutex locked.
+	 *
+	 * Some drivers report a delay that jitters by a few frames. Reporting
+	 * each such change to the pipeline would cause a storm of LATENCY
+	 * messages, and each one of them triggers a pipeline-wide latency
+	 * query and redistribution. Such small changes are therefore not
+	 * reported; they are compensated for by the frame retrieval in the
+	 * process callback instead, which uses the actual stream delay. */
+
+	gint64 delay_change;
+	gint64 relative_threshold;
+
+	delay_change = ABS(self->stream_delay_in_ns - self->reported_stream_delay_in_ns);
+	if (delay_change == 0)
+		return FALSE;
+
+	/* The very first delay must always be reported, otherwise
+	 * the pipeline latency would never include the stream delay. */
+	if (!GST_CLOCK_TIME_IS_VALID(self->last_latency_update_time))
+		return TRUE;
+
+	relative_threshold = (gint64)(self->reported_stream_delay_in_ns * self->latency_update_relative_threshold_snapshot);
+	if ((delay_change <= self->latency_update_threshold_snapshot) || (delay_change <= relative_threshold))
+		return FALSE;
+
+	if ((now - (gint64)(self->last_latency_update_time)) < self->min_latency_update_interval_snapshot)
 	{
-		case SPA_IO_POSITION_STATE_STOPPED: return "stopped";
-		case SPA_IO_POSITION_STATE_STARTING: return "starting";
-		case SPA_IO_POSITION_STATE_RUNNING: return "running";
-		default: return "<unknown>";
+		GST_LOG_OBJECT(
+			self,
+			"stream delay changed significantly (by %" G_GINT64_FORMAT " ns), but the minimum latency update interval has not passed yet",
+			delay_change
+		);
+		return FALSE;
 	}
+
+	return TRUE;
 }
 
 
-static void gst_pw_audio_sink_pw_state_changed(void *data, enum pw_stream_state old_state, enum pw_stream_state new_state, const char *error)
+static void gst_pw_audio_sink_update_process_latency_unlocked(GstPwAudioSink *self)
 {
-	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
+	/* Must be called with the pw_thread_loop lock held. */
 
-	GST_DEBUG_OBJECT(
-		self,
-		"PipeWire state changed:  old: %s  new: %s  error: \"%s\"",
-		pw_stream_state_as_string(old_state),
-		pw_stream_state_as_string(new_state),
-		(error == NULL) ? "<none>" : error
-	);
+	guint8 builder_buffer[256];
+	struct spa_pod_builder builder = SPA_POD_BUILDER_INIT(builder_buffer, sizeof(builder_buffer));
+	struct spa_process_latency_info process_latency_info;
+	struct spa_pod const *params[1];
+	GstClockTime process_latency;
 
-	switch (new_state) {
-		case PW_STREAM_STATE_STREAMING:
-			self->can_drain = TRUE;
-			break;
-		case PW_STREAM_STATE_ERROR:
-		case PW_STREAM_STATE_UNCONNECTED:
-			/* Make sure the stream is now considered drained. This is important if
-			 * the pipewire server went away, because then, the sink will attempt
-			 * to drain the stream, and that request will never be answered, because
-			 * the response would come from the (now gone) server. */
-			GST_DEBUG_OBJECT(
-				self,
-				"marking stream as drained after reaching the %s state; if stream wasn't drained before, its data for sure is gone by now",
-				pw_stream_state_as_string(new_state)
-			);
-			self->stream_drained = TRUE;
-			self->can_drain = FALSE;
-			pw_thread_loop_signal(self->pipewire_core->loop, FALSE);
-			break;
-		default:
-			break;
+	/* Encoded audio is not buffered in the ring buffer. Its
+	 * latency is instead published with the node.latency
+	 * property (see gst_pw_audio_sink_render_encoded()). */
+	if ((self->stream == NULL) || !(self->stream_is_connected) || !gst_pw_audio_format_data_is_raw(self->pw_audio_format.audio_type))
+		return;
+
+	/* The stream delay covers what happens to the data after it left this
+	 * node. But the data also spends time in the ring buffer before the
+	 * process callback retrieves it. With synced playback, frames are
+	 * retrieved once the clock reaches their PTS plus the upstream latency
+	 * (that is, the pipeline latency without the stream delay, see
+	 * gst_pw_audio_sink_raw_process_stream()). Without synced playback,
+	 * frames are retrieved as soon as the graph asks for them, so they wait
+	 * for as long as it takes to play the frames that are ahead of them. Since
+	 * render() keeps the ring buffer filled, that is the ring buffer length.
+	 * Publishing this as the ProcessLatency param lets the graph add it to
+	 * the latency that it reports to other nodes, so these can compensate
+	 * for it. The quantum size is not part of this, since the graph already
+	 * accounts for the quantum of each node on its own. */
+	if (self->do_synced_playback)
+	{
+		LOCK_LATENCY_MUTEX(self);
+		process_latency = ((gint64)(self->latency) >= self->reported_stream_delay_in_ns) ? (self->latency - self->reported_stream_delay_in_ns) : 0;
+		UNLOCK_LATENCY_MUTEX(self);
 	}
+	else
+		process_latency = self->ring_buffer_length_snapshot;
+
+	if (process_latency == self->published_process_latency)
+		return;
+
+	GST_DEBUG_OBJECT(self, "publishing process latency %" GST_TIME_FORMAT, GST_TIME_ARGS(process_latency));
+
+	spa_zero(process_latency_info);
+	process_latency_info.ns = process_latency;
+	params[0] = spa_process_latency_build(&builder, SPA_PARAM_ProcessLatency, &process_latency_info);
+
+	pw_stream_update_params(self->stream, params, 1);
+
+	self->published_process_latency = process_latency;
 }
 
 
-static void gst_pw_audio_sink_param_changed(void *data, uint32_t id, const struct spa_pod *param)
+static void gst_pw_audio_sink_relink_stream(GstPwAudioSink *self)
 {
-	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
-	GstPwAudioFormat changed_pw_audio_format;
+	GstPipewireCore *pipewire_core;
+	uint32_t target_object_id;
+	gchar *target_node_name;
+	uint32_t node_id;
+
+	/* Moves the stream to the target that is currently specified by the
+	 * target-object-id and target-node-name properties. This is done by
+	 * setting the target keys in the session manager's "default" metadata
+	 * for the stream's node - the same mechanism that "pw-metadata" uses.
+	 * The stream stays connected, and the audio data buffer and the stream
+	 * clock are not touched, so this is much faster than reconnecting.
+	 * If the stream is not connected yet, nothing is done here, since then,
+	 * set_caps() picks up the new target when it connects the stream. */
 
-	if ((id != SPA_PARAM_Format) || (param == NULL))
-		return;
+	GST_OBJECT_LOCK(self);
+	pipewire_core = self->pipewire_core;
+	target_object_id = self->target_object_id;
+	target_node_name = g_strdup(self->target_node_name);
+	GST_OBJECT_UNLOCK(self);
 
-	/* In theory, the format param may change at any moment. In practice, this is
-	 * not expected to happen, since we set up the pw_stream with an EnumFormat
-	 * param that contains exactly one set of fixed parameters. The only exception
-	 * is the DSD audio format, which can change depending on what the graph needs.
-	 * This means that we can expect all parameters except the DSD audio format
-	 * to stay the same. For this reason, we look at only that one here. */
+	if (pipewire_core == NULL)
+		goto finish;
 
-	if (!gst_pw_audio_format_from_spa_pod_with_format_param(
-		&changed_pw_audio_format,
-		GST_OBJECT_CAST(self),
-		param
-	))
-		return;
+	pw_thread_loop_lock(pipewire_core->loop);
 
+	if ((self->stream == NULL) || !(self->stream_is_connected))
 	{
-		gchar *format_str = gst_pw_audio_format_to_string(&changed_pw_audio_format);
-		GST_DEBUG_OBJECT(self, "format param changed;  audio format details: %s", format_str);
-		g_free(format_str);
+		GST_DEBUG_OBJECT(self, "stream is not connected; new target will be used when connecting");
+		goto unlock;
 	}
 
-	if (changed_pw_audio_format.audio_type == GST_PIPEWIRE_AUDIO_TYPE_DSD)
+	node_id = pw_stream_get_node_id(self->stream);
+	if (node_id == SPA_ID_INVALID)
 	{
-		GstDsdFormat input_dsd_format = GST_DSD_INFO_FORMAT(&(self->pw_audio_format.info.dsd_audio_info));
-		GstDsdFormat graph_dsd_format = GST_DSD_INFO_FORMAT(&(changed_pw_audio_format.info.dsd_audio_info));
+		GST_DEBUG_OBJECT(self, "stream has no node ID yet; new target will be used when connecting");
+		goto unlock;
+	}
 
-		guint input_dsd_format_width = gst_dsd_format_get_width(input_dsd_format);
-		guint graph_dsd_format_width = gst_dsd_format_get_width(graph_dsd_format);
+	if (self->default_metadata == NULL)
+	{
+		GST_WARNING_OBJECT(self, "no default metadata object available; cannot move stream to new target");
+		goto unlock;
+	}
 
-		memcpy(&(self->actual_dsd_info), &(changed_pw_audio_format.info.dsd_audio_info), sizeof(self->actual_dsd_info));
+	gst_pw_audio_sink_set_target_in_metadata_unlocked(self, node_id, target_object_id, target_node_name);
 
-		gst_pw_audio_sink_calculate_data_rate_multiplier(self);
+	g_atomic_int_set(&(self->relink_pending), 1);
 
-		GST_DEBUG_OBJECT(
-			self,
-			"additional DSD information:  input/graph DSD format: %s/%s  input/graph DSD format width: %u/%u  data rate multiplier: %d/%d",
-			gst_dsd_format_to_string(input_dsd_format), gst_dsd_format_to_string(graph_dsd_format),
-			input_dsd_format_width, graph_dsd_format_width,
-			self->dsd_data_rate_multiplier_num, self->dsd_data_rate_multiplier_denom
-		);
-	}
+unlock:
+	pw_thread_loop_unlock(pipewire_core->loop);
+
+finish:
+	g_free(target_node_name);
 }
 
 
-static void gst_pw_audio_sink_io_changed(void *data, uint32_t id, void *area, G_GNUC_UNUSED uint32_t size)
+static void gst_pw_audio_sink_set_target_in_metadata_unlocked(GstPwAudioSink *self, uint32_t node_id, uint32_t target_object_id, gchar const *target_node_name)
 {
-	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
-
-	switch (id)
+	/* Must be called with the pw_thread_loop lock held,
+	 * and with default_metadata being non-NULL. */
+
+	/* Clear the key that is not used, otherwise the session manager may
+	 * prefer an older target over the new one. If neither a node name nor
+	 * an object ID are set, both keys are cleared, and the session manager
+	 * moves the stream to the default target. */
+	if (target_node_name != NULL)
+	{
+		GST_INFO_OBJECT(self, "moving stream (node ID %" G_GUINT32_FORMAT ") to target node \"%s\"", node_id, target_node_name);
+		pw_metadata_set_property(self->default_metadata, node_id, METADATA_KEY_TARGET_NODE, NULL, NULL);
+		pw_metadata_set_property(self->default_metadata, node_id, METADATA_KEY_TARGET_OBJECT, NULL, target_node_name);
+	}
+	else if (target_object_id != PW_ID_ANY)
+	{
+		gchar *target_object_id_str = g_strdup_printf("%" G_GUINT32_FORMAT, target_object_id);
+		GST_INFO_OBJECT(self, "moving stream (node ID %" G_GUINT32_FORMAT ") to target object %" G_GUINT32_FORMAT, node_id, target_object_id);
+		pw_metadata_set_property(self->default_metadata, node_id, METADATA_KEY_TARGET_OBJECT, NULL, NULL);
+		pw_metadata_set_property(self->default_metadata, node_id, METADATA_KEY_TARGET_NODE, "Spa:Id", target_object_id_str);
+		g_free(target_object_id_str);
+	}
+	else
+	{
+		GST_INFO_OBJECT(self, "moving stream (node ID %" G_GUINT32_FORMAT ") to default target", node_id);
+		pw_metadata_set_property(self->default_metadata, node_id, METADATA_KEY_TARGET_NODE, NULL, NULL);
+		pw_metadata_set_property(self->default_metadata, node_id, METADATA_KEY_TARGET_OBJECT, NULL, NULL);
+	}
+}
+
+
+static void gst_pw_audio_sink_fail_over_unlocked(GstPwAudioSink *self, uint32_t lost_target_node_id)
+{
+	/* NOTE: This is called in the threaded PipeWire loop (self->pipewire_core->loop). */
+
+	GPtrArray *fallback_targets;
+	gchar const *fallback_target_name = NULL;
+	uint32_t node_id;
+	guint i;
+
+	GST_OBJECT_LOCK(self);
+	fallback_targets = g_ptr_array_copy(self->fallback_targets, (GCopyFunc)g_strdup, NULL);
+	g_ptr_array_set_free_func(fallback_targets, g_free);
+	GST_OBJECT_UNLOCK(self);
+
+	if (fallback_targets->len == 0)
+	{
+		GST_DEBUG_OBJECT(self, "no fallback targets configured; leaving it to the session manager to handle the target loss");
+		goto finish;
+	}
+
+	if ((self->stream == NULL) || !(self->stream_is_connected))
+		goto finish;
+
+	node_id = pw_stream_get_node_id(self->stream);
+	if (node_id == SPA_ID_INVALID)
+		goto finish;
+
+	if (self->default_metadata == NULL)
+	{
+		GST_WARNING_OBJECT(self, "no default metadata object available; cannot move stream to a fallback target");
+		goto finish;
+	}
+
+	/* Pick the first fallback target that currently exists. */
+	for (i = 0; (i < fallback_targets->len) && (fallback_target_name == NULL); ++i)
+	{
+		gchar const *candidate_name = g_ptr_array_index(fallback_targets, i);
+		GHashTableIter iter;
+		gpointer key, value;
+
+		g_hash_table_iter_init(&iter, self->audio_sink_node_names);
+		while (g_hash_table_iter_next(&iter, &key, &value))
+		{
+			if ((GPOINTER_TO_UINT(key) != lost_target_node_id) && (g_strcmp0(value, candidate_name) == 0))
+			{
+				fallback_target_name = candidate_name;
+				break;
+			}
+		}
+	}
+
+	if (fallback_target_name == NULL)
+	{
+		GST_WARNING_OBJECT(self, "none of the configured fallback targets exist; leaving it to the session manager to handle the target loss");
+		goto finish;
+	}
+
+	GST_INFO_OBJECT(self, "target node with object ID %" G_GUINT32_FORMAT " disappeared; failing over to \"%s\"", lost_target_node_id, fallback_target_name);
+
+	/* This moves the stream just like the relinking does when the
+	 * target properties are changed. The ring buffer, the stream clock,
+	 * and the sync state are kept. Until the stream is linked to the
+	 * fallback target, no process callbacks are invoked, and the stream
+	 * clock just continues to extrapolate the last observed time. Once
+	 * process callbacks resume, the output is resynchronized if the
+	 * fallback target is driven differently (see relink_pending). */
+	gst_pw_audio_sink_set_target_in_metadata_unlocked(self, node_id, PW_ID_ANY, fallback_target_name);
+	g_atomic_int_set(&(self->relink_pending), 1);
+
+	self->failover_start_time = gst_util_get_timestamp();
+	g_free(self->failover_target_name);
+	self->failover_target_name = g_strdup(fallback_target_name);
+
+finish:
+	g_ptr_array_unref(fallback_targets);
+}
+
+
+static void gst_pw_audio_sink_finish_failover_unlocked(GstPwAudioSink *self)
+{
+	/* NOTE: This is called in the threaded PipeWire loop (self->pipewire_core->loop). */
+
+	GstClockTime failover_duration;
+	GstStructure *structure;
+
+	failover_duration = gst_util_get_timestamp() - self->failover_start_time;
+	self->failover_start_time = GST_CLOCK_TIME_NONE;
+
+	GST_INFO_OBJECT(self, "failover to \"%s\" completed after %" GST_TIME_FORMAT, self->failover_target_name, GST_TIME_ARGS(failover_duration));
+
+	GST_OBJECT_LOCK(self);
+	self->num_failovers++;
+	self->last_failover_duration = failover_duration;
+	GST_OBJECT_UNLOCK(self);
+
+	structure = gst_structure_new(
+		"pwaudiosink-failover",
+		"target", G_TYPE_STRING, self->failover_target_name,
+		"duration", G_TYPE_UINT64, (guint64)failover_duration,
+		NULL
+	);
+	gst_element_post_message(GST_ELEMENT_CAST(self), gst_message_new_element(GST_OBJECT_CAST(self), structure));
+}
+
+
+static void gst_pw_audio_sink_registry_global(void *data, uint32_t id, G_GNUC_UNUSED uint32_t permissions, const char *type, G_GNUC_UNUSED uint32_t version, const struct spa_dict *props)
+{
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
+
+	if (props == NULL)
+		return;
+
+	if (strcmp(type, PW_TYPE_INTERFACE_Metadata) == 0)
+	{
+		char const *metadata_name;
+
+		if (self->default_metadata != NULL)
+			return;
+
+		metadata_name = spa_dict_lookup(props, PW_KEY_METADATA_NAME);
+		if ((metadata_name == NULL) || (strcmp(metadata_name, "default") != 0))
+			return;
+
+		self->default_metadata = pw_registry_bind(self->registry, id, type, PW_VERSION_METADATA, 0);
+		if (self->default_metadata == NULL)
+		{
+			GST_WARNING_OBJECT(self, "could not bind default metadata object with ID %" G_GUINT32_FORMAT, id);
+			return;
+		}
+
+		self->default_metadata_id = id;
+		GST_DEBUG_OBJECT(self, "bound default metadata object with ID %" G_GUINT32_FORMAT, id);
+	}
+	else if (strcmp(type, PW_TYPE_INTERFACE_Node) == 0)
+	{
+		char const *media_class = spa_dict_lookup(props, PW_KEY_MEDIA_CLASS);
+		char const *node_name = spa_dict_lookup(props, PW_KEY_NODE_NAME);
+
+		if ((media_class == NULL) || (node_name == NULL) || (strcmp(media_class, AUDIO_SINK_MEDIA_CLASS) != 0))
+			return;
+
+		g_hash_table_insert(self->audio_sink_node_names, GUINT_TO_POINTER(id), g_strdup(node_name));
+	}
+	else if (strcmp(type, PW_TYPE_INTERFACE_Link) == 0)
+	{
+		char const *output_node_str = spa_dict_lookup(props, PW_KEY_LINK_OUTPUT_NODE);
+		char const *input_node_str = spa_dict_lookup(props, PW_KEY_LINK_INPUT_NODE);
+		uint32_t node_id;
+
+		if ((output_node_str == NULL) || (input_node_str == NULL) || (self->stream == NULL))
+			return;
+
+		node_id = pw_stream_get_node_id(self->stream);
+		if ((node_id == SPA_ID_INVALID) || (strtoul(output_node_str, NULL, 10) != node_id))
+			return;
+
+		self->linked_target_node_id = strtoul(input_node_str, NULL, 10);
+		GST_DEBUG_OBJECT(self, "stream is linked to target node with object ID %" G_GUINT32_FORMAT, self->linked_target_node_id);
+
+		if (GST_CLOCK_TIME_IS_VALID(self->failover_start_time))
+			gst_pw_audio_sink_finish_failover_unlocked(self);
+	}
+}
+
+
+static void gst_pw_audio_sink_registry_global_remove(void *data, uint32_t id)
+{
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
+
+	if ((self->default_metadata != NULL) && (id == self->default_metadata_id))
+	{
+		GST_DEBUG_OBJECT(self, "default metadata object with ID %" G_GUINT32_FORMAT " was removed", id);
+
+		pw_proxy_destroy((struct pw_proxy *)(self->default_metadata));
+		self->default_metadata = NULL;
+		self->default_metadata_id = SPA_ID_INVALID;
+	}
+	else if (id == self->linked_target_node_id)
+	{
+		self->linked_target_node_id = SPA_ID_INVALID;
+		gst_pw_audio_sink_fail_over_unlocked(self, id);
+	}
+
+	g_hash_table_remove(self->audio_sink_node_names, GUINT_TO_POINTER(id));
+}
+
+
+static void gst_pw_audio_sink_setup_played_audio_tap(GstPwAudioSink *self)
+{
+	gsize capacity;
+	guint64 num_frames;
+	GstClockTime tap_length;
+
+	tap_length = (self->played_audio_tap_length_snapshot > 0) ? self->played_audio_tap_length_snapshot : DEFERRED_LEVEL_METERING_TAP_LENGTH;
+
+	/* Reserve some extra room for the per-quantum headers in the tap. */
+	num_frames = gst_pw_audio_format_calculate_num_frames_from_duration(&(self->pw_audio_format), tap_length);
+	capacity = num_frames * self->stride;
+	capacity += capacity / 4;
+
+	self->played_audio_tap = gst_pw_audio_tap_new(capacity);
+	if (G_UNLIKELY(self->played_audio_tap == NULL))
+	{
+		GST_WARNING_OBJECT(self, "could not create played audio tap; the played-audio signal will not be emitted, and levels will not be metered");
+		self->active_level_metering = GST_PW_AUDIO_SINK_LEVEL_METERING_NONE;
+		return;
+	}
+
+	self->played_audio_tap_thread_running = TRUE;
+	self->played_audio_tap_thread = g_thread_new("pwaudiosink-tap", gst_pw_audio_sink_played_audio_tap_thread, self);
+
+	GST_DEBUG_OBJECT(self, "set up played audio tap with a length of %" GST_TIME_FORMAT, GST_TIME_ARGS(tap_length));
+}
+
+
+static void gst_pw_audio_sink_teardown_played_audio_tap(GstPwAudioSink *self)
+{
+	/* This must not be called while the process callback may
+	 * still be running, since it accesses played_audio_tap. */
+
+	if (self->played_audio_tap_thread != NULL)
+	{
+		g_mutex_lock(&(self->played_audio_tap_mutex));
+		self->played_audio_tap_thread_running = FALSE;
+		g_cond_signal(&(self->played_audio_tap_cond));
+		g_mutex_unlock(&(self->played_audio_tap_mutex));
+
+		g_thread_join(self->played_audio_tap_thread);
+		self->played_audio_tap_thread = NULL;
+	}
+
+	if (self->played_audio_tap != NULL)
+	{
+		gst_object_unref(GST_OBJECT(self->played_audio_tap));
+		self->played_audio_tap = NULL;
+	}
+}
+
+
+static gpointer gst_pw_audio_sink_played_audio_tap_thread(gpointer user_data)
+{
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(user_data);
+	gboolean running = TRUE;
+
+	GST_DEBUG_OBJECT(self, "played audio tap thread started");
+
+	while (running)
+	{
+		GstBuffer *buffer;
+
+		/* Emit all quanta that are currently in the tap. This is done
+		 * once more after the thread was told to stop, to not lose
+		 * the quanta that were played right before the stop. */
+		while ((buffer = gst_pw_audio_tap_read(self->played_audio_tap)) != NULL)
+		{
+			if (self->active_level_metering == GST_PW_AUDIO_SINK_LEVEL_METERING_DEFERRED)
+			{
+				GstPwAudioSinkLevelResults results;
+				GstMapInfo map_info;
+				guint64 num_frames = gst_buffer_get_size(buffer) / self->stride;
+
+				gst_buffer_map(buffer, &map_info, GST_MAP_READ);
+				if (gst_pw_audio_sink_accumulate_levels(self, GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_GAP) ? NULL : map_info.data, num_frames, GST_BUFFER_PTS(buffer), &results))
+					gst_pw_audio_sink_post_level_message(self, &results);
+				gst_buffer_unmap(buffer, &map_info);
+			}
+
+			/* The tap may only exist for the deferred level metering. */
+			if (self->played_audio_tap_length_snapshot > 0)
+				g_signal_emit(self, gst_pw_audio_sink_signals[SIGNAL_PLAYED_AUDIO], 0, buffer);
+
+			gst_buffer_unref(buffer);
+		}
+
+		g_mutex_lock(&(self->played_audio_tap_mutex));
+		if (self->played_audio_tap_thread_running)
+			g_cond_wait_until(&(self->played_audio_tap_cond), &(self->played_audio_tap_mutex), g_get_monotonic_time() + PLAYED_AUDIO_TAP_POLL_INTERVAL);
+		else
+			running = FALSE;
+		g_mutex_unlock(&(self->played_audio_tap_mutex));
+	}
+
+	GST_DEBUG_OBJECT(self, "played audio tap thread stopped; %u quantum/quanta were dropped", gst_pw_audio_tap_get_num_dropped_blocks(self->played_audio_tap));
+
+	return NULL;
+}
+
+
+static void gst_pw_audio_sink_write_to_played_audio_tap(GstPwAudioSink *self, struct spa_data *inner_spa_data, guint64 num_frames, GstClockTimeDiff output_time_offset)
+{
+	/* NOTE: This must be called from within the raw process callback,
+	 * after the chunk in inner_spa_data was filled. */
+
+	GstClockTime pts;
+	GstClockTime duration;
+	gboolean is_gap;
+
+	if (G_UNLIKELY(inner_spa_data->chunk->size == 0))
+		return;
+
+	pts = gst_pw_audio_sink_get_output_time(self, output_time_offset);
+	duration = gst_pw_audio_format_calculate_duration_from_num_frames(&(self->pw_audio_format), num_frames);
+	is_gap = (inner_spa_data->chunk->flags & SPA_CHUNK_FLAG_EMPTY) != 0;
+
+	/* If the tap is full, the quantum is dropped. The tap counts the drops
+	 * and marks the next quantum as discontinuous; it is not logged here,
+	 * since this runs in the realtime thread. */
+	gst_pw_audio_tap_write(
+		self->played_audio_tap,
+		((guint8 const *)(inner_spa_data->data)) + inner_spa_data->chunk->offset,
+		inner_spa_data->chunk->size,
+		pts,
+		duration,
+		is_gap
+	);
+
+	/* This is not done with the mutex locked, since the realtime thread must not
+	 * block. (See PLAYED_AUDIO_TAP_POLL_INTERVAL for why this is acceptable.) */
+	RT_SAFETY_CHECKER_COND_SIGNAL(&(self->played_audio_tap_cond));
+}
+
+
+static GstClockTime gst_pw_audio_sink_get_output_time(GstPwAudioSink *self, GstClockTimeDiff output_time_offset)
+{
+	/* Returns the pipeline clock time that lies output_time_offset
+	 * nanoseconds in the future (or past, if the offset is negative),
+	 * or GST_CLOCK_TIME_NONE if there is no clock. */
+
+	GstClock *clock;
+	GstClockTime now;
+
+	clock = GST_ELEMENT_CLOCK(self);
+	if (G_UNLIKELY(clock == NULL))
+		return GST_CLOCK_TIME_NONE;
+
+	now = gst_clock_get_time(clock);
+	if ((output_time_offset < 0) && (now < (GstClockTime)(-output_time_offset)))
+		return GST_CLOCK_TIME_NONE;
+
+	return now + output_time_offset;
+}
+
+
+static void gst_pw_audio_sink_setup_level_metering(GstPwAudioSink *self)
+{
+	/* This must be called while the process callback and the
+	 * played audio tap thread are not running. */
+
+	GstAudioInfo const *audio_info = &(self->pw_audio_format.info.pcm_audio_info);
+
+	self->active_level_metering = GST_PW_AUDIO_SINK_LEVEL_METERING_NONE;
+
+	if (self->level_metering_snapshot == GST_PW_AUDIO_SINK_LEVEL_METERING_NONE)
+		return;
+
+	if (self->pw_audio_format.audio_type != GST_PIPEWIRE_AUDIO_TYPE_PCM)
+	{
+		GST_WARNING_OBJECT(self, "level metering is only supported with PCM audio; not metering levels");
+		return;
+	}
+
+	if (!level_meter_format_is_supported(GST_AUDIO_INFO_FORMAT(audio_info)) || (GST_AUDIO_INFO_CHANNELS(audio_info) > LEVEL_METER_MAX_NUM_CHANNELS))
+	{
+		GST_WARNING_OBJECT(
+			self,
+			"level metering does not support format %s with %d channel(s); not metering levels",
+			gst_audio_format_to_string(GST_AUDIO_INFO_FORMAT(audio_info)),
+			GST_AUDIO_INFO_CHANNELS(audio_info)
+		);
+		return;
+	}
+
+	level_meter_init(&(self->level_meter), GST_AUDIO_INFO_CHANNELS(audio_info));
+	self->level_meter_format = GST_AUDIO_INFO_FORMAT(audio_info);
+	self->level_interval_num_frames = MAX(gst_pw_audio_format_calculate_num_frames_from_duration(&(self->pw_audio_format), self->level_interval_snapshot), 1);
+	self->level_interval_start_time = GST_CLOCK_TIME_NONE;
+	self->active_level_metering = self->level_metering_snapshot;
+
+	GST_DEBUG_OBJECT(
+		self,
+		"set up %s level metering with an interval of %" G_GUINT64_FORMAT " frame(s)",
+		(self->active_level_metering == GST_PW_AUDIO_SINK_LEVEL_METERING_REALTIME) ? "realtime" : "deferred",
+		self->level_interval_num_frames
+	);
+}
+
+
+static gboolean gst_pw_audio_sink_accumulate_levels(GstPwAudioSink *self, gconstpointer data, guint64 num_frames, GstClockTime start_time, GstPwAudioSinkLevelResults *results)
+{
+	/* Accumulates the levels of the given frames. data is NULL if the frames
+	 * are silent. start_time is the pipeline clock time of the first frame.
+	 * If the current interval is complete, the results are copied into
+	 * *results, the meter is reset, and TRUE is returned. This does not
+	 * allocate and does not block, so it can be called in the process
+	 * callback. */
+
+	if (self->level_meter.num_frames == 0)
+		self->level_interval_start_time = start_time;
+
+	level_meter_process(&(self->level_meter), self->level_meter_format, data, num_frames);
+
+	if (self->level_meter.num_frames < self->level_interval_num_frames)
+		return FALSE;
+
+	results->level_meter = self->level_meter;
+	results->start_time = self->level_interval_start_time;
+	results->duration = gst_pw_audio_format_calculate_duration_from_num_frames(&(self->pw_audio_format), self->level_meter.num_frames);
+
+	level_meter_reset(&(self->level_meter));
+
+	return TRUE;
+}
+
+
+static void gst_pw_audio_sink_meter_levels_in_process_callback(GstPwAudioSink *self, struct spa_data *inner_spa_data, guint64 num_frames, GstClockTimeDiff output_time_offset)
+{
+	/* NOTE: This must be called from within the raw process callback,
+	 * after the chunk in inner_spa_data was filled. Like the played audio
+	 * tap, this meters the quantum exactly as it is sent to the graph,
+	 * that is, after any corrections that were made for synchronization. */
+
+	GstPwAudioSinkLevelResults results;
+	gconstpointer data = NULL;
+
+	if (G_UNLIKELY(inner_spa_data->chunk->size == 0))
+		return;
+
+	if (!(inner_spa_data->chunk->flags & SPA_CHUNK_FLAG_EMPTY))
+		data = ((guint8 const *)(inner_spa_data->data)) + inner_spa_data->chunk->offset;
+
+	/* The clock is only queried at the start of an interval. */
+	if (!gst_pw_audio_sink_accumulate_levels(
+		self,
+		data,
+		num_frames,
+		(self->level_meter.num_frames == 0) ? gst_pw_audio_sink_get_output_time(self, output_time_offset) : GST_CLOCK_TIME_NONE,
+		&results
+	))
+		return;
+
+	/* Messages cannot be posted from here, since that allocates memory.
+	 * pw_loop_invoke() copies the results into its queue without blocking,
+	 * and the message is then posted in the pw_thread_loop. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+	pw_loop_invoke(
+		pw_thread_loop_get_loop(self->pipewire_core->loop),
+		gst_pw_audio_sink_post_level_message_cb,
+		0,
+		&results,
+		sizeof(results),
+		false,
+		self
+	);
+#pragma GCC diagnostic pop
+}
+
+
+static int gst_pw_audio_sink_post_level_message_cb(
+	G_GNUC_UNUSED struct spa_loop *loop,
+	G_GNUC_UNUSED bool async,
+	G_GNUC_UNUSED uint32_t seq,
+	const void *data,
+	G_GNUC_UNUSED size_t size,
+	void *user_data)
+{
+	/* NOTE: This is called in the threaded PipeWire loop (self->pipewire_core->loop). */
+
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(user_data);
+	gst_pw_audio_sink_post_level_message(self, (GstPwAudioSinkLevelResults const *)data);
+	return 0;
+}
+
+
+static void gst_pw_audio_sink_post_level_message(GstPwAudioSink *self, GstPwAudioSinkLevelResults const *results)
+{
+	GValue peak_array = G_VALUE_INIT;
+	GValue rms_array = G_VALUE_INIT;
+	GstStructure *structure;
+	guint channel;
+
+	g_value_init(&peak_array, GST_TYPE_ARRAY);
+	g_value_init(&rms_array, GST_TYPE_ARRAY);
+
+	for (channel = 0; channel < results->level_meter.num_channels; ++channel)
+	{
+		GValue value = G_VALUE_INIT;
+
+		g_value_init(&value, G_TYPE_DOUBLE);
+		g_value_set_double(&value, level_meter_get_peak_db(&(results->level_meter), channel));
+		gst_value_array_append_and_take_value(&peak_array, &value);
+
+		g_value_init(&value, G_TYPE_DOUBLE);
+		g_value_set_double(&value, level_meter_get_rms_db(&(results->level_meter), channel));
+		gst_value_array_append_and_take_value(&rms_array, &value);
+	}
+
+	structure = gst_structure_new(
+		"pwaudiosink-level",
+		"timestamp", G_TYPE_UINT64, (guint64)(results->start_time),
+		"duration", G_TYPE_UINT64, (guint64)(results->duration),
+		NULL
+	);
+	gst_structure_take_value(structure, "peak", &peak_array);
+	gst_structure_take_value(structure, "rms", &rms_array);
+
+	GST_LOG_OBJECT(self, "posting level message: %" GST_PTR_FORMAT, (gpointer)structure);
+
+	gst_element_post_message(GST_ELEMENT_CAST(self), gst_message_new_element(GST_OBJECT_CAST(self), structure));
+}
+
+
+static gboolean gst_pw_audio_sink_scheduled_start_is_pending_unlocked(GstPwAudioSink *self)
+{
+	/* NOTE: This must be called with the audio data buffer mutex locked. */
+
+	/* Scheduled starts require the pipeline clock, so they
+	 * are ignored if synced playback is not being done. */
+	return self->do_synced_playback
+	    && !(self->draining_ring_buffer)
+	    && GST_CLOCK_TIME_IS_VALID(self->scheduled_start_time)
+	    && !(self->scheduled_start_offset_set);
+}
+
+
+static GstClockTime gst_pw_audio_sink_get_scheduled_retrieval_time_unlocked(GstPwAudioSink *self, GstClockTime current_time)
+{
+	/* NOTE: This must be called with the audio data buffer mutex locked. */
+
+	GstClockTimeDiff retrieval_time;
+
+	if (!GST_CLOCK_TIME_IS_VALID(current_time) || !(self->scheduled_start_offset_set))
+		return current_time;
+
+	retrieval_time = (GstClockTimeDiff)current_time - self->scheduled_start_offset;
+	return (retrieval_time > 0) ? (GstClockTime)retrieval_time : 0;
+}
+
+
+static void gst_pw_audio_sink_apply_scheduled_start_unlocked(GstPwAudioSink *self, GstClockTime upstream_pipeline_latency, gint64 stream_delay_in_ns, GstClockTime first_frame_output_time)
+{
+	/* NOTE: This must be called from within the raw process callback,
+	 * with the audio data buffer mutex locked. */
+
+	GstClockTime oldest_frame_pts;
+	GstClockTime start_time;
+
+	oldest_frame_pts = gst_pw_audio_ring_buffer_get_cursor_oldest_frame_pts(self->ring_buffer, 0);
+	if (!GST_CLOCK_TIME_IS_VALID(oldest_frame_pts))
+		return;
+
+	/* If the scheduled start time already passed, start right away. */
+	start_time = MAX(self->scheduled_start_time, first_frame_output_time);
+
+	/* Without an offset, the oldest frame would be output once the pipeline
+	 * latency passed, that is, at oldest_frame_pts + upstream_pipeline_latency
+	 * + stream_delay_in_ns. Shift the retrieval so that it is output at
+	 * start_time instead. Until then, the frames lie fully in the future as
+	 * far as the ring buffer is concerned, so it produces silence and keeps
+	 * the frames. In the cycle that contains the start time, it prepends the
+	 * matching number of silence frames, so the start is sample accurate. */
+	self->scheduled_start_offset = GST_CLOCK_DIFF(oldest_frame_pts + upstream_pipeline_latency + stream_delay_in_ns, start_time);
+	self->scheduled_start_offset_set = TRUE;
+	self->scheduled_start_time = start_time;
+	/* The retrieval has to be aligned anew, without skew tolerance. */
+	self->synced_playback_started = FALSE;
+
+	GST_DEBUG_OBJECT(
+		self,
+		"scheduled start at %" GST_TIME_FORMAT "; oldest frame PTS: %" GST_TIME_FORMAT "  retrieval offset: %" G_GINT64_FORMAT " ns",
+		GST_TIME_ARGS(start_time),
+		GST_TIME_ARGS(oldest_frame_pts),
+		self->scheduled_start_offset
+	);
+}
+
+
+static gsize gst_pw_audio_sink_apply_scheduled_stop_unlocked(GstPwAudioSink *self, GstPwAudioFormat const *output_format, guint8 *data, gsize num_bytes, gsize output_stride, GstClockTime first_frame_output_time)
+{
+	/* NOTE: This must be called from within a raw process callback,
+	 * with the audio data buffer mutex locked. */
+
+	gsize num_frames = num_bytes / output_stride;
+	gsize num_frames_to_keep;
+	GstClockTime stop_time = self->scheduled_stop_time;
+
+	if (!GST_CLOCK_TIME_IS_VALID(stop_time) || !GST_CLOCK_TIME_IS_VALID(first_frame_output_time))
+		return num_bytes;
+
+	/* Frames that are output at or after the stop time are replaced
+	 * with silence. They are still consumed, so the data keeps flowing
+	 * at the usual pace instead of piling up in the ring buffer. */
+	if (stop_time <= first_frame_output_time)
+		num_frames_to_keep = 0;
+	else
+	{
+		num_frames_to_keep = gst_pw_audio_format_calculate_num_frames_from_duration(output_format, stop_time - first_frame_output_time);
+		if (num_frames_to_keep >= num_frames)
+			return num_bytes;
+	}
+
+	gst_pw_audio_format_write_silence_frames(output_format, data + num_frames_to_keep * output_stride, num_frames - num_frames_to_keep);
+
+	return num_frames_to_keep * output_stride;
+}
+
+
+static void gst_pw_audio_sink_announce_scheduled_event(GstPwAudioSink *self, gboolean is_stop, GstClockTime time)
+{
+	/* NOTE: This must be called from within a process callback. */
+
+	GstPwAudioSinkScheduledEvent event = { is_stop, time };
+
+	/* Messages cannot be posted from here, since that allocates memory.
+	 * See gst_pw_audio_sink_meter_levels_in_process_callback(). */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+	pw_loop_invoke(
+		pw_thread_loop_get_loop(self->pipewire_core->loop),
+		gst_pw_audio_sink_post_scheduled_event_message_cb,
+		0,
+		&event,
+		sizeof(event),
+		false,
+		self
+	);
+#pragma GCC diagnostic pop
+}
+
+
+static int gst_pw_audio_sink_post_scheduled_event_message_cb(
+	G_GNUC_UNUSED struct spa_loop *loop,
+	G_GNUC_UNUSED bool async,
+	G_GNUC_UNUSED uint32_t seq,
+	const void *data,
+	G_GNUC_UNUSED size_t size,
+	void *user_data)
+{
+	/* NOTE: This is called in the threaded PipeWire loop (self->pipewire_core->loop). */
+
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(user_data);
+	GstPwAudioSinkScheduledEvent const *event = (GstPwAudioSinkScheduledEvent const *)data;
+	GstStructure *structure;
+
+	if (event->is_stop)
+		structure = gst_structure_new("pwaudiosink-scheduled-stop", "stop-time", G_TYPE_UINT64, (guint64)(event->time), NULL);
+	else
+		structure = gst_structure_new("pwaudiosink-scheduled-start", "start-time", G_TYPE_UINT64, (guint64)(event->time), NULL);
+
+	GST_DEBUG_OBJECT(self, "posting scheduled event message: %" GST_PTR_FORMAT, (gpointer)structure);
+
+	gst_element_post_message(GST_ELEMENT_CAST(self), gst_message_new_element(GST_OBJECT_CAST(self), structure));
+
+	return 0;
+}
+
+
+static void gst_pw_audio_sink_publish_position_snapshot(GstPwAudioSink *self, GstClockTime next_frame_pts, guint64 num_frames, struct pw_time const *stream_time, gint64 stream_delay_in_ns)
+{
+	/* NOTE: This must be called from within the raw process callback. */
+
+	GstClockTime base_time;
+	GstClockTime duration;
+	GstPwAudioSinkPositionSnapshot *snapshot = &(self->position_snapshot);
+
+	/* The PTS in the ring buffer are clock times (see render()),
+	 * so the base time is subtracted to get running times. */
+	base_time = GST_ELEMENT_CAST(self)->base_time;
+	duration = gst_pw_audio_format_calculate_duration_from_num_frames(&(self->pw_audio_format), num_frames);
+
+	if (G_UNLIKELY(!GST_CLOCK_TIME_IS_VALID(next_frame_pts) || (next_frame_pts < (base_time + duration))))
+		return;
+
+	seqlock_write_begin(&(self->position_snapshot_seqnum));
+	snapshot->epoch = g_atomic_int_get(&(self->position_epoch));
+	snapshot->running_time = next_frame_pts - duration - base_time;
+	snapshot->duration = duration;
+	snapshot->measurement_time = stream_time->now;
+	snapshot->stream_delay = MAX(stream_delay_in_ns, 0);
+	seqlock_write_end(&(self->position_snapshot_seqnum));
+}
+
+
+static void gst_pw_audio_sink_publish_position_segment(GstPwAudioSink *self, GstSegment const *segment)
+{
+	/* This is only called by the streaming thread, so
+	 * there is always only one writer at a time. */
+	seqlock_write_begin(&(self->position_segment_seqnum));
+	gst_segment_copy_into(segment, &(self->position_segment));
+	seqlock_write_end(&(self->position_segment_seqnum));
+}
+
+
+static void gst_pw_audio_sink_invalidate_position_snapshot(GstPwAudioSink *self)
+{
+	/* The snapshot itself is not modified here, since the process
+	 * callback may be writing to it at the same time. Changing the
+	 * epoch is enough to make get_position_from_snapshot() ignore it. */
+	g_atomic_int_inc(&(self->position_epoch));
+}
+
+
+static gboolean gst_pw_audio_sink_get_position_from_snapshot(GstPwAudioSink *self, GstFormat format, gint64 *position)
+{
+	GstPwAudioSinkPositionSnapshot snapshot;
+	GstSegment segment;
+	GstClockTime running_time;
+	GstClockTime stream_time;
+	GstClockTimeDiff elapsed_time;
+	struct timespec ts;
+	gint begin_seqnum;
+	guint num_attempts;
+
+	if (format != GST_FORMAT_TIME)
+		return FALSE;
+
+	for (num_attempts = 0; ; ++num_attempts)
+	{
+		if (num_attempts == MAX_POSITION_SNAPSHOT_READ_ATTEMPTS)
+			return FALSE;
+
+		begin_seqnum = seqlock_read_begin(&(self->position_snapshot_seqnum));
+		snapshot = self->position_snapshot;
+		if (!seqlock_read_retry(&(self->position_snapshot_seqnum), begin_seqnum))
+			break;
+	}
+
+	if ((snapshot.epoch != g_atomic_int_get(&(self->position_epoch))) || !GST_CLOCK_TIME_IS_VALID(snapshot.running_time))
+		return FALSE;
+
+	for (num_attempts = 0; ; ++num_attempts)
+	{
+		if (num_attempts == MAX_POSITION_SNAPSHOT_READ_ATTEMPTS)
+			return FALSE;
+
+		begin_seqnum = seqlock_read_begin(&(self->position_segment_seqnum));
+		segment = self->position_segment;
+		if (!seqlock_read_retry(&(self->position_segment_seqnum), begin_seqnum))
+			break;
+	}
+
+	/* The first frame of the snapshot's quantum becomes audible once the
+	 * stream delay has passed, counted from the moment that delay was
+	 * measured. Extrapolate from there using the same monotonic clock
+	 * that PipeWire uses for its timestamps. The position must not go
+	 * past the end of that quantum, since the frames that come after it
+	 * were not handed to the graph yet. This also makes the position stop
+	 * advancing if the process callback is no longer called. */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	elapsed_time = (GstClockTimeDiff)(SPA_TIMESPEC_TO_NSEC(&ts) - snapshot.measurement_time) - (GstClockTimeDiff)(snapshot.stream_delay);
+	elapsed_time = CLAMP(elapsed_time, -(GstClockTimeDiff)(snapshot.running_time), (GstClockTimeDiff)(snapshot.duration));
+	running_time = snapshot.running_time + elapsed_time;
+
+	stream_time = gst_segment_to_stream_time(&segment, GST_FORMAT_TIME, gst_segment_position_from_running_time(&segment, GST_FORMAT_TIME, running_time));
+	if (!GST_CLOCK_TIME_IS_VALID(stream_time))
+		return FALSE;
+
+	GST_LOG_OBJECT(
+		self,
+		"position from snapshot: running time %" GST_TIME_FORMAT " stream time %" GST_TIME_FORMAT,
+		GST_TIME_ARGS(running_time),
+		GST_TIME_ARGS(stream_time)
+	);
+
+	*position = stream_time;
+	return TRUE;
+}
+
+
+static void gst_pw_audio_sink_wait_for_freewheel_data_unlocked(GstPwAudioSink *self, guint64 num_required_frames)
+{
+	/* This must be called from the process callback with the audio
+	 * data buffer mutex locked, and only in freewheel mode. Blocking
+	 * is normally not permitted in the process callback, but the
+	 * freewheel driver starts the next graph cycle as soon as the
+	 * current one finished, so the graph simply runs at the pace at
+	 * which render() supplies data. The wait also ends if the ring
+	 * buffer is full, since render() cannot push more frames then
+	 * (this happens if the quantum is longer than the ring buffer). */
+
+	gint64 end_time = g_get_monotonic_time() + MAX_FREEWHEEL_DATA_WAIT_TIME;
+
+	RT_SAFETY_CHECKER_PERMIT_WAITS();
+
+	num_required_frames = MIN(num_required_frames, gst_pw_audio_ring_buffer_get_capacity(self->ring_buffer));
+
+	while (gst_pw_audio_ring_buffer_get_cursor_num_buffered_frames(self->ring_buffer, 0) < num_required_frames)
+	{
+		if (!g_atomic_int_get(&(self->freewheel_wait_enabled))
+		 || g_atomic_int_get(&(self->flushing))
+		 || g_atomic_int_get(&(self->paused))
+		 || self->draining_ring_buffer)
+			break;
+
+		if (!RT_SAFETY_CHECKER_COND_WAIT_UNTIL(&(self->audio_data_buffer_cond), &(self->audio_data_buffer_mutex), end_time))
+		{
+			GST_DEBUG_OBJECT(self, "timeout while waiting for data in freewheel mode");
+			break;
+		}
+	}
+}
+
+
+static void gst_pw_audio_sink_reset_qos_observations_unlocked(GstPwAudioSink *self)
+{
+	/* This must be called with the audio data buffer mutex locked. */
+
+	self->qos_num_expired_frames = 0;
+	self->qos_expired_frames_pts = GST_CLOCK_TIME_NONE;
+	self->qos_max_lateness = 0;
+	self->qos_num_played_frames = 0;
+	self->qos_proportion = 1.0;
+}
+
+
+static void gst_pw_audio_sink_observe_expired_frames_for_qos_unlocked(GstPwAudioSink *self, guint64 num_played_frames)
+{
+	/* NOTE: This must be called from within the raw process callback,
+	 * right after frames were retrieved from the ring buffer, with
+	 * the audio data buffer mutex locked. */
+
+	guint64 num_expired_frames;
+	GstClockTime expired_frames_pts;
+	GstClockTime lateness;
+
+	self->qos_num_played_frames += num_played_frames;
+
+	num_expired_frames = gst_pw_audio_ring_buffer_get_cursor_last_expired_frames(self->ring_buffer, 0, &expired_frames_pts, &lateness);
+	if (G_LIKELY(num_expired_frames == 0))
+		return;
+
+	/* Keep the PTS of the oldest expired frame since the last QoS event. */
+	if (self->qos_num_expired_frames == 0)
+		self->qos_expired_frames_pts = expired_frames_pts;
+
+	self->qos_num_expired_frames += num_expired_frames;
+	self->qos_max_lateness = MAX(self->qos_max_lateness, lateness);
+}
+
+
+static void gst_pw_audio_sink_perform_qos(GstPwAudioSink *self, GstClockTime overlap_running_time, GstClockTime overlap_duration)
+{
+	/* Turns the QoS observations that were made since the last call into
+	 * a QoS event and sends it upstream. overlap_running_time and
+	 * overlap_duration describe data that render_raw() just clipped,
+	 * since it overlapped with already played data. This must be called
+	 * from the streaming thread.
+	 *
+	 * Only raw audio is handled here. With encoded audio, GstBaseSink
+	 * synchronizes the buffers, and performs QoS on its own. */
+
+	GstBaseSink *basesink = GST_BASE_SINK_CAST(self);
+	GstClockTime expired_frames_pts;
+	GstClockTime expired_duration;
+	GstClockTime dropped_duration;
+	GstClockTime played_duration;
+	GstClockTime jitter;
+	GstClockTime running_time = GST_CLOCK_TIME_NONE;
+	GstClockTime base_time;
+	gdouble rate;
+	gdouble proportion;
+	GstEvent *qos_event;
+	gboolean qos_enabled;
+
+	/* Query this before locking the mutex, since it takes the object lock. */
+	qos_enabled = gst_base_sink_is_qos_enabled(basesink);
+
+	LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+
+	if (!qos_enabled)
+	{
+		/* Discard the observations, so that stale ones
+		 * are not used if QoS is enabled later. */
+		gst_pw_audio_sink_reset_qos_observations_unlocked(self);
+		UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+		return;
+	}
+
+	expired_duration = gst_pw_audio_format_calculate_duration_from_num_frames(&(self->pw_audio_format), self->qos_num_expired_frames);
+	played_duration = gst_pw_audio_format_calculate_duration_from_num_frames(&(self->pw_audio_format), self->qos_num_played_frames);
+	dropped_duration = expired_duration + overlap_duration;
+
+	/* If nothing was dropped, only send an event if upstream was previously
+	 * told to skip work, and enough audio was played since then to be
+	 * sure that the sink has recovered. Otherwise, keep accumulating. */
+	if ((dropped_duration == 0) && ((self->qos_proportion <= 1.0) || (played_duration < QOS_RECOVERY_INTERVAL)))
+	{
+		UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+		return;
+	}
+
+	/* The rate is the ratio between the duration of the data that should
+	 * have been played (the played and the dropped data) and the duration
+	 * of the data that actually was played. It is 1.0 if nothing was
+	 * dropped, and is higher the more data was dropped. */
+	rate = (gdouble)(played_duration + dropped_duration) / (gdouble)MAX(played_duration, 1);
+	rate = MIN(rate, MAX_QOS_PROPORTION);
+
+	proportion = (self->qos_proportion * (QOS_PROPORTION_AVERAGING_LENGTH - 1) + rate) / QOS_PROPORTION_AVERAGING_LENGTH;
+	/* Do not approach 1.0 asymptotically during recovery. Otherwise,
+	 * the sink would never stop sending recovery events. */
+	if ((dropped_duration == 0) && (proportion < 1.01))
+		proportion = 1.0;
+	self->qos_proportion = proportion;
+
+	expired_frames_pts = self->qos_expired_frames_pts;
+	jitter = MAX(self->qos_max_lateness, overlap_duration);
+
+	self->qos_num_expired_frames = 0;
+	self->qos_expired_frames_pts = GST_CLOCK_TIME_NONE;
+	self->qos_max_lateness = 0;
+	self->qos_num_played_frames = 0;
+
+	UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+
+	/* Use the running time of the oldest dropped data as the timestamp.
+	 * The ring buffer PTS are clock-time values (see render_raw()). */
+	base_time = GST_ELEMENT_CAST(self)->base_time;
+	if ((expired_duration > 0) && GST_CLOCK_TIME_IS_VALID(expired_frames_pts) && (expired_frames_pts >= base_time))
+		running_time = expired_frames_pts - base_time;
+	else if (overlap_duration > 0)
+		running_time = overlap_running_time;
+	else if (GST_ELEMENT_CLOCK(self) != NULL)
+	{
+		GstClockTime now = gst_clock_get_time(GST_ELEMENT_CLOCK(self));
+		if (now >= base_time)
+			running_time = now - base_time;
+	}
+
+	if (G_UNLIKELY(!GST_CLOCK_TIME_IS_VALID(running_time)))
+	{
+		GST_DEBUG_OBJECT(self, "no valid running time available for QoS event; not sending one");
+		return;
+	}
+
+	GST_DEBUG_OBJECT(
+		self,
+		"sending QoS event upstream; dropped: %" GST_TIME_FORMAT "  played: %" GST_TIME_FORMAT "  "
+		"proportion: %f  jitter: %" GST_TIME_FORMAT "  running time: %" GST_TIME_FORMAT,
+		GST_TIME_ARGS(dropped_duration),
+		GST_TIME_ARGS(played_duration),
+		proportion,
+		GST_TIME_ARGS(jitter),
+		GST_TIME_ARGS(running_time)
+	);
+
+	/* Late data means that upstream is producing data too slowly
+	 * for the sink. GstQOSType defines this as an underflow. */
+	qos_event = gst_event_new_qos(GST_QOS_TYPE_UNDERFLOW, proportion, (GstClockTimeDiff)jitter, running_time);
+	gst_pad_push_event(GST_BASE_SINK_PAD(basesink), qos_event);
+}
+
+
+static gboolean gst_pw_audio_sink_create_additional_streams(GstPwAudioSink *self)
+{
+	/* This must be called after the main pw_stream was created,
+	 * since its properties are used as a template. */
+
+	GArray *target_object_ids;
+	guint i, num_streams;
+	gboolean retval = TRUE;
+	struct pw_properties const *main_pw_props;
+	char const *node_name;
+
+	GST_OBJECT_LOCK(self);
+	target_object_ids = g_array_sized_new(FALSE, FALSE, sizeof(uint32_t), self->additional_target_object_ids->len);
+	g_array_append_vals(target_object_ids, self->additional_target_object_ids->data, self->additional_target_object_ids->len);
+	GST_OBJECT_UNLOCK(self);
+
+	if (target_object_ids->len == 0)
+		goto finish;
+
+	num_streams = target_object_ids->len;
+	if (num_streams > MAX_NUM_ADDITIONAL_STREAMS)
+	{
+		GST_WARNING_OBJECT(
+			self,
+			"%u additional target object IDs were given, but only up to %d are supported; ignoring the rest",
+			num_streams,
+			MAX_NUM_ADDITIONAL_STREAMS
+		);
+		num_streams = MAX_NUM_ADDITIONAL_STREAMS;
+	}
+
+	self->additional_streams = g_ptr_array_new_with_free_func(g_free);
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+
+	main_pw_props = pw_stream_get_properties(self->stream);
+	node_name = pw_properties_get(main_pw_props, PW_KEY_NODE_NAME);
+
+	for (i = 0; i < num_streams; ++i)
+	{
+		GstPwAudioSinkAdditionalStream *additional_stream;
+		struct pw_properties *pw_props;
+
+		additional_stream = g_new0(GstPwAudioSinkAdditionalStream, 1);
+		additional_stream->sink = self;
+		additional_stream->target_object_id = g_array_index(target_object_ids, uint32_t, i);
+		additional_stream->cursor_index = -1;
+		pi_controller_init(&(additional_stream->pi_controller), PI_CONTROLLER_KI_FACTOR, PI_CONTROLLER_KP_FACTOR);
+		additional_stream->previous_time = GST_CLOCK_TIME_NONE;
+
+		/* Node names should be unique, so append a suffix
+		 * to the main node name if one was set. */
+		pw_props = pw_properties_copy(main_pw_props);
+		if (node_name != NULL)
+			pw_properties_setf(pw_props, PW_KEY_NODE_NAME, "%s-%u", node_name, i + 1);
+
+		additional_stream->stream = pw_stream_new(self->pipewire_core->core, pw_stream_get_name(self->stream), pw_props);
+		if (G_UNLIKELY(additional_stream->stream == NULL))
+		{
+			GST_ERROR_OBJECT(self, "could not create additional PipeWire stream for target object %" G_GUINT32_FORMAT, additional_stream->target_object_id);
+			g_free(additional_stream);
+			retval = FALSE;
+			break;
+		}
+
+		GST_DEBUG_OBJECT(self, "created additional PipeWire stream for target object %" G_GUINT32_FORMAT, additional_stream->target_object_id);
+
+		g_ptr_array_add(self->additional_streams, additional_stream);
+	}
+
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+
+finish:
+	g_array_unref(target_object_ids);
+	return retval;
+}
+
+
+static void gst_pw_audio_sink_destroy_additional_streams(GstPwAudioSink *self)
+{
+	guint i;
+
+	if (self->additional_streams == NULL)
+		return;
+
+	gst_pw_audio_sink_disconnect_additional_streams(self);
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+	for (i = 0; i < self->additional_streams->len; ++i)
+	{
+		GstPwAudioSinkAdditionalStream *additional_stream = g_ptr_array_index(self->additional_streams, i);
+		pw_stream_destroy(additional_stream->stream);
+	}
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+
+	g_ptr_array_unref(self->additional_streams);
+	self->additional_streams = NULL;
+}
+
+
+static void gst_pw_audio_sink_connect_additional_streams(GstPwAudioSink *self, struct spa_pod const **params, guint num_params, enum pw_stream_flags flags)
+{
+	/* This must be called with the pw_thread_loop_lock taken. */
+
+	guint i;
+
+	if (self->additional_streams == NULL)
+		return;
+
+	/* Additional streams rely on the ring buffer cursors and on ASRC based
+	 * drift compensation, neither of which exist for DSD and encoded audio. */
+	if (self->pw_audio_format.audio_type != GST_PIPEWIRE_AUDIO_TYPE_PCM)
+	{
+		GST_WARNING_OBJECT(
+			self,
+			"additional target objects are only supported with PCM audio; not connecting %u additional stream(s)",
+			self->additional_streams->len
+		);
+		return;
+	}
+
+	for (i = 0; i < self->additional_streams->len; ++i)
+	{
+		GstPwAudioSinkAdditionalStream *additional_stream = g_ptr_array_index(self->additional_streams, i);
+		enum pw_stream_state state;
+		char const *error_str = NULL;
+
+		pw_stream_add_listener(
+			additional_stream->stream,
+			&(additional_stream->stream_listener),
+			&additional_stream_events,
+			additional_stream
+		);
+		additional_stream->stream_listener_added = TRUE;
+
+		pw_stream_connect(
+			additional_stream->stream,
+			PW_DIRECTION_OUTPUT,
+			additional_stream->target_object_id,
+			flags,
+			params, num_params
+		);
+
+		/* A failing additional stream does not prevent playback
+		 * through the main stream and the other additional ones. */
+		state = pw_stream_get_state(additional_stream->stream, &error_str);
+		if (state == PW_STREAM_STATE_ERROR)
+		{
+			GST_WARNING_OBJECT(
+				self,
+				"cannot connect additional stream for target object %" G_GUINT32_FORMAT " - PW stream is in an error state: %s",
+				additional_stream->target_object_id,
+				error_str
+			);
+			continue;
+		}
+
+		additional_stream->stream_is_connected = TRUE;
+	}
+}
+
+
+static void gst_pw_audio_sink_disconnect_additional_streams(GstPwAudioSink *self)
+{
+	guint i;
+
+	if (self->additional_streams == NULL)
+		return;
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+
+	for (i = 0; i < self->additional_streams->len; ++i)
+	{
+		GstPwAudioSinkAdditionalStream *additional_stream = g_ptr_array_index(self->additional_streams, i);
+
+		if (additional_stream->stream_is_connected)
+		{
+			pw_stream_disconnect(additional_stream->stream);
+			additional_stream->stream_is_connected = FALSE;
+		}
+
+		/* Remove the listener after disconnecting, for the same
+		 * reasons as with the main stream in set_caps(). */
+		if (additional_stream->stream_listener_added)
+		{
+			spa_hook_remove(&(additional_stream->stream_listener));
+			additional_stream->stream_listener_added = FALSE;
+		}
+	}
+
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+}
+
+
+static void gst_pw_audio_sink_activate_additional_streams_unlocked(GstPwAudioSink *self, gboolean activate)
+{
+	/* This must be called with the pw_thread_loop_lock taken. */
+
+	guint i;
+
+	if (self->additional_streams == NULL)
+		return;
+
+	for (i = 0; i < self->additional_streams->len; ++i)
+	{
+		GstPwAudioSinkAdditionalStream *additional_stream = g_ptr_array_index(self->additional_streams, i);
+
+		if (!additional_stream->stream_is_connected)
+			continue;
+
+		/* Same as with the main stream, reset the drift compensation
+		 * states only before activating to avoid race conditions. */
+		if (activate)
+		{
+			pi_controller_reset(&(additional_stream->pi_controller));
+			additional_stream->previous_time = GST_CLOCK_TIME_NONE;
+		}
+
+		pw_stream_set_active(additional_stream->stream, activate);
+	}
+
+	GST_DEBUG_OBJECT(self, "%s %u additional PipeWire stream(s)", activate ? "activating" : "deactivating", self->additional_streams->len);
+}
+
+
+static int gst_pw_audio_sink_activated_stream_cb(
+	G_GNUC_UNUSED struct spa_loop *loop,
+	G_GNUC_UNUSED bool async,
+	G_GNUC_UNUSED uint32_t seq,
+	G_GNUC_UNUSED const void *_data,
+	G_GNUC_UNUSED size_t size,
+	void *user_data)
+{
+	/* NOTE: This is called in the threaded PipeWire loop (self->pipewire_core->loop),
+	 * not in any particular GStreamer thread nor in a pw_stream dataloop thread.
+	 * It is important to not block here. Just emit the GLib signal and then exit. */
+
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(user_data);
+
+	/* See the comment in gst_pw_audio_sink_disconnect_stream()
+	 * for why the seq ID is checked this way. */
+	if (g_atomic_int_get(&(self->activated_stream_seq_id)) == (gint)seq)
+	{
+		GST_DEBUG_OBJECT(self, "got activated stream notification with seq ID %" PRIu32 "; emitting stream-activated signal", seq);
+		g_signal_emit(self, gst_pw_audio_sink_signals[SIGNAL_STREAM_ACTIVATED], 0, self->sink_caps);
+	}
+	else
+		GST_DEBUG_OBJECT(self, "ignoring expired activated stream notification with seq ID %" PRIu32, seq);
+
+	return 0;
+}
+
+
+static int gst_pw_audio_sink_idle_suspend_stream_cb(
+	G_GNUC_UNUSED struct spa_loop *loop,
+	G_GNUC_UNUSED bool async,
+	uint32_t seq,
+	G_GNUC_UNUSED const void *_data,
+	G_GNUC_UNUSED size_t size,
+	void *user_data)
+{
+	/* NOTE: This is called in the threaded PipeWire loop (self->pipewire_core->loop),
+	 * so the pw_thread_loop_lock is already taken. */
+
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(user_data);
+
+	/* The seq ID is checked for the same reason as in
+	 * gst_pw_audio_sink_activated_stream_cb(). */
+	if (g_atomic_int_get(&(self->activated_stream_seq_id)) != (gint)seq)
+	{
+		GST_DEBUG_OBJECT(self, "ignoring expired idle suspension request with seq ID %" PRIu32, seq);
+		return 0;
+	}
+
+	if (!(self->stream_is_active) || g_atomic_int_get(&(self->paused)))
+		return 0;
+
+	/* render() may have pushed data into the ring buffer after the process
+	 * callback requested the suspension. Check the fill level again, and
+	 * raise the idle_suspending flag while the audio_data_buffer_mutex is
+	 * still taken. render() checks that flag after pushing data, so any
+	 * data that is pushed from here on causes a reactivation. */
+	LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+
+	if ((self->ring_buffer == NULL) || (gst_pw_audio_ring_buffer_get_cursor_fill_level(self->ring_buffer, 0) != 0))
+	{
+		GST_DEBUG_OBJECT(self, "ring buffer is no longer empty; not suspending stream");
+		UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+		return 0;
+	}
+
+	g_atomic_int_set(&(self->idle_suspending), 1);
+
+	UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+
+	/* The stream must be deactivated with the audio_data_buffer_mutex
+	 * released. pw_stream_set_active() waits for the data loop, so it
+	 * would deadlock if the process callback were waiting for the mutex.
+	 * Also, in freewheel mode, gst_pw_audio_sink_activate_stream_unlocked()
+	 * takes that mutex itself to wake up the process callback. */
+	GST_DEBUG_OBJECT(self, "suspending idle stream");
+	gst_pw_audio_sink_activate_stream_unlocked(self, FALSE);
+
+	/* Raise idle_suspended and signal the cond while the mutex is taken,
+	 * so that render() either sees the flag before it waits for room
+	 * in the ring buffer, or gets woken up by the signal. */
+	LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+	g_atomic_int_set(&(self->idle_suspended), 1);
+	g_atomic_int_set(&(self->idle_suspending), 0);
+	g_cond_signal(&(self->audio_data_buffer_cond));
+	UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+
+	GST_OBJECT_LOCK(self);
+	self->num_idle_suspensions++;
+	GST_OBJECT_UNLOCK(self);
+
+	return 0;
+}
+
+
+static gboolean gst_pw_audio_sink_is_idle_suspended(GstPwAudioSink *self)
+{
+	/* Also returns TRUE while a suspension is still in progress. Then,
+	 * gst_pw_audio_sink_resume_from_idle_suspension() blocks until the
+	 * suspension is done, and reactivates the stream afterwards. */
+	return g_atomic_int_get(&(self->idle_suspending)) || g_atomic_int_get(&(self->idle_suspended));
+}
+
+
+static void gst_pw_audio_sink_resume_from_idle_suspension(GstPwAudioSink *self)
+{
+	pw_thread_loop_lock(self->pipewire_core->loop);
+
+	/* Check again with the lock taken, since a state change
+	 * may have (de)activated the stream in the meantime. */
+	if (g_atomic_int_get(&(self->idle_suspended)))
+	{
+		GST_DEBUG_OBJECT(self, "new data arrived; resuming idle stream");
+		gst_pw_audio_sink_activate_stream_unlocked(self, TRUE);
+	}
+
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+}
+
+
+static gchar const * spa_io_position_state_to_string(enum spa_io_position_state const state)
+{
+	switch (state)
+	{
+		case SPA_IO_POSITION_STATE_STOPPED: return "stopped";
+		case SPA_IO_POSITION_STATE_STARTING: return "starting";
+		case SPA_IO_POSITION_STATE_RUNNING: return "running";
+		default: return "<unknown>";
+	}
+}
+
+
+static void gst_pw_audio_sink_pw_state_changed(void *data, enum pw_stream_state old_state, enum pw_stream_state new_state, const char *error)
+{
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
+
+	GST_DEBUG_OBJECT(
+		self,
+		"PipeWire state changed:  old: %s  new: %s  error: \"%s\"",
+		pw_stream_state_as_string(old_state),
+		pw_stream_state_as_string(new_state),
+		(error == NULL) ? "<none>" : error
+	);
+
+	switch (new_state) {
+		case PW_STREAM_STATE_STREAMING:
+			self->can_drain = TRUE;
+			break;
+		case PW_STREAM_STATE_ERROR:
+		case PW_STREAM_STATE_UNCONNECTED:
+			/* Make sure the stream is now considered drained. This is important if
+			 * the pipewire server went away, because then, the sink will attempt
+			 * to drain the stream, and that request will never be answered, because
+			 * the response would come from the (now gone) server. */
+			GST_DEBUG_OBJECT(
+				self,
+				"marking stream as drained after reaching the %s state; if stream wasn't drained before, its data for sure is gone by now",
+				pw_stream_state_as_string(new_state)
+			);
+			self->stream_drained = TRUE;
+			self->can_drain = FALSE;
+			pw_thread_loop_signal(self->pipewire_core->loop, FALSE);
+			break;
+		default:
+			break;
+	}
+}
+
+
+static void gst_pw_audio_sink_param_changed(void *data, uint32_t id, const struct spa_pod *param)
+{
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
+	GstPwAudioFormat changed_pw_audio_format;
+
+	if ((id != SPA_PARAM_Format) || (param == NULL))
+		return;
+
+	/* The format is set, so the stream's ports exist now. Publish the
+	 * initial process latency. (In non-live pipelines, there is no latency
+	 * event that would do that later.) */
+	gst_pw_audio_sink_update_process_latency_unlocked(self);
+
+	/* In theory, the format param may change at any moment. In practice, this is
+	 * not expected to happen, since we set up the pw_stream with an EnumFormat
+	 * param that contains exactly one set of fixed parameters. The only exception
+	 * is the DSD audio format, which can change depending on what the graph needs.
+	 * This means that we can expect all parameters except the DSD audio format
+	 * to stay the same. For this reason, we look at only that one here. */
+
+	if (!gst_pw_audio_format_from_spa_pod_with_format_param(
+		&changed_pw_audio_format,
+		GST_OBJECT_CAST(self),
+		param
+	))
+		return;
+
+	{
+		gchar *format_str = gst_pw_audio_format_to_string(&changed_pw_audio_format);
+		GST_DEBUG_OBJECT(self, "format param changed;  audio format details: %s", format_str);
+		g_free(format_str);
+	}
+
+	if (changed_pw_audio_format.audio_type == GST_PIPEWIRE_AUDIO_TYPE_DSD)
+	{
+		GstDsdFormat input_dsd_format = GST_DSD_INFO_FORMAT(&(self->pw_audio_format.info.dsd_audio_info));
+		GstDsdFormat graph_dsd_format = GST_DSD_INFO_FORMAT(&(changed_pw_audio_format.info.dsd_audio_info));
+
+		guint input_dsd_format_width = gst_dsd_format_get_width(input_dsd_format);
+		guint graph_dsd_format_width = gst_dsd_format_get_width(graph_dsd_format);
+
+		memcpy(&(self->actual_dsd_info), &(changed_pw_audio_format.info.dsd_audio_info), sizeof(self->actual_dsd_info));
+
+		g_atomic_int_set(
+			&(self->dsd_conversion_required),
+			(GST_DSD_INFO_FORMAT(&(self->pw_audio_format.info.dsd_audio_info)) != GST_DSD_INFO_FORMAT(&(self->actual_dsd_info)))
+			|| (GST_DSD_INFO_REVERSED_BYTES(&(self->pw_audio_format.info.dsd_audio_info)) != GST_DSD_INFO_REVERSED_BYTES(&(self->actual_dsd_info)))
+		);
+
+		gst_pw_audio_sink_calculate_data_rate_multiplier(self);
+
+		GST_DEBUG_OBJECT(
+			self,
+			"additional DSD information:  input/graph DSD format: %s/%s  input/graph DSD format width: %u/%u  data rate multiplier: %d/%d  conversion required: %d",
+			gst_dsd_format_to_string(input_dsd_format), gst_dsd_format_to_string(graph_dsd_format),
+			input_dsd_format_width, graph_dsd_format_width,
+			self->dsd_data_rate_multiplier_num, self->dsd_data_rate_multiplier_denom,
+			g_atomic_int_get(&(self->dsd_conversion_required))
+		);
+	}
+}
+
+
+static void gst_pw_audio_sink_io_changed(void *data, uint32_t id, void *area, G_GNUC_UNUSED uint32_t size)
+{
+	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
+
+	switch (id)
 	{
 		case SPA_IO_Position:
 		{
 			/* Retrieve SPA IO position pointer for keeping track of spa_rate_match.
-			 * spa_rate_match is then accessed in gst_pw_audio_sink_raw_on_process_stream(). */
+			 * spa_rate_match is then accessed in gst_pw_audio_sink_raw_process_stream(). */
 
 			self->spa_position = (struct spa_io_position *)area;
 			if (self->spa_position != NULL)
 			{
-				self->quantum_size_in_ticks = self->spa_position->clock.duration;
-				self->quantum_size_in_ns = gst_util_uint64_scale_int(
-					self->quantum_size_in_ticks * self->spa_position->clock.rate.num,
-					GST_SECOND,
-					self->spa_position->clock.rate.denom
-				);
+				gst_pw_audio_sink_update_quantum_size(self);
 
 				/* Since the clock rate might have changed, recalculate the data rate multiplier. */
 				gst_pw_audio_sink_calculate_data_rate_multiplier(self);
@@ -3431,7 +6741,7 @@ static void gst_pw_audio_sink_io_changed(void *data, uint32_t id, void *area, G_
 		case SPA_IO_RateMatch:
 		{
 			/* Retrieve SPA IO RateMatch pointer. The referred rate_match structure does not yet
-			 * contain valid values at this point. But when gst_pw_audio_sink_raw_on_process_stream()
+			 * contain valid values at this point. But when gst_pw_audio_sink_raw_process_stream()
 			 * is called, it does, so it is usable there.
 			 * The rate matching ASRC is disabled by default, and is enabled explicitly by setting
 			 * the SPA_IO_RATE_MATCH_FLAG_ACTIVE flag. Once enabled, the "rate" field tweaks the ASRC
@@ -3439,7 +6749,7 @@ static void gst_pw_audio_sink_io_changed(void *data, uint32_t id, void *area, G_
 			 * that if for example rate is 1.1, then 110% of the normal amount of data is generated.
 			 * So, if the audio output is falling behind the reference signal, rate needs to be >1.0,
 			 * and if it is ahead of the reference signal, it needs to be <1.0. The rate field can be
-			 * set in the process callback (see gst_pw_audio_sink_raw_on_process_stream).
+			 * set in the process callback (see gst_pw_audio_sink_raw_process_stream).
 			 * The rate match pointer can be NULL if no rate matching is available, for example,
 			 * because this is a passthrough stream. */
 
@@ -3452,6 +6762,13 @@ static void gst_pw_audio_sink_io_changed(void *data, uint32_t id, void *area, G_
 					GST_INFO_OBJECT(self, "stream clock is the pipeline clock; not enabling rate match");
 					self->spa_rate_match->flags &= ~SPA_IO_RATE_MATCH_FLAG_ACTIVE;
 				}
+				else if (self->freewheel_snapshot)
+				{
+					/* There is no clock drift to compensate for, since
+					 * nothing is synchronized to a clock in this mode. */
+					GST_INFO_OBJECT(self, "freewheel mode enabled; not enabling rate match");
+					self->spa_rate_match->flags &= ~SPA_IO_RATE_MATCH_FLAG_ACTIVE;
+				}
 				else
 				{
 					/* Make sure that the starting state is one without any actual sample rate conversion. */
@@ -3485,18 +6802,161 @@ static void gst_pw_audio_sink_on_stream_drained(void *data)
 }
 
 
-static void gst_pw_audio_sink_raw_on_process_stream(void *data)
+static ALWAYS_INLINE guint64 gst_pw_audio_sink_calculate_num_dsd_frames_to_produce(GstPwAudioSink *self, guint64 min_num_required_ticks)
+{
+	/* Calculating num_frames_to_produce is non-trivial with DSD, for the following reasons:
+	 *
+	 * 1. For each tick, a certain number of DSD bytes is expected. This number is a fractional,
+	 *    and stored as self->dsd_data_rate_multiplier_num and self->dsd_data_rate_multiplier_denom.
+	 * 2. DSD bytes are not necessary stored directly as bytes here. For example, the graph might
+	 *    expect the bytes to be organized in groups of 4 if the underlying audio hardware outputs
+	 *    data through alsa with the DSDU32BE format.
+	 *
+	 * These two cause num_frames_to_produce amounts to be non-integer. The computation overall is:
+	 *
+	 * num_frames_to_produce = min_num_required_ticks * dsd_data_rate_multiplier_num / (dsd_data_rate_multiplier_denom * dsd_format_width)
+	 *
+	 * The dsd_format_width value in the denominator factors in the aforementioned grouping.
+	 *
+	 * Simply rounding that result down or up to get an integer value results in synchronized
+	 * playback issues. Instead, keep track of the non-integer portion. Once it accumulates
+	 * enough to amount to at least 1 frame, factor this into the calculation to let the
+	 * num_frames_to_produce be higher be increased. That way, the overall consumption rate
+	 * is correct. */
+
+	gint dsd_format_width = gst_dsd_format_get_width(GST_DSD_INFO_FORMAT(&(self->pw_audio_format.info.dsd_audio_info)));
+	gint64 min_num_required_ticks_num = min_num_required_ticks * self->dsd_data_rate_multiplier_num;
+	gint64 min_num_required_ticks_denom = self->dsd_data_rate_multiplier_denom * dsd_format_width;
+
+	self->dsd_min_num_required_ticks_remainder += min_num_required_ticks_num % min_num_required_ticks_denom;
+
+	if (self->dsd_min_num_required_ticks_remainder >= min_num_required_ticks_denom)
+	{
+		min_num_required_ticks_num += min_num_required_ticks_denom;
+		self->dsd_min_num_required_ticks_remainder -= min_num_required_ticks_denom;
+	}
+
+	return min_num_required_ticks_num / min_num_required_ticks_denom;
+}
+
+
+static ALWAYS_INLINE GstPwAudioRingBufferRetrievalResult gst_pw_audio_sink_retrieve_and_convert_dsd_frames(
+	GstPwAudioSink *self,
+	struct spa_data *inner_spa_data,
+	guint64 num_frames_to_produce,
+	GstClockTime current_time,
+	GstClockTime ring_buffer_data_pts_shift,
+	GstClockTimeDiff skew_threshold,
+	GstClockTimeDiff *buffered_frames_to_retrieval_pts_delta,
+	gsize *output_stride
+)
+{
+	/* This is used if we have incoming DSD data that can't directly be passed
+	 * to the graph, because the latter uses a different grouping format. We
+	 * have to convert the data first. Retrieve incoming DSD frames from the
+	 * ring buffer and store them in the intermediate "DSD conversion buffer".
+	 * Then, use that buffer as the source and the SPA data chunk as the
+	 * destination for the conversion.
+	 *
+	 * The frame counts can be confusing, because they depend on the
+	 * DSD format. The same playtime that is covered by 20 DSDU8
+	 * frames is also coverd by 10 DSDU16LE frames for example.
+	 * Here, we deal with _input_ format widths and strides, because
+	 * that's what is passed around until the very end, when the
+	 * actual conversion takes place. */
+
+	GstPwAudioRingBufferRetrievalResult retrieval_result = GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_RING_BUFFER_IS_EMPTY;
+
+	GstDsdFormat input_dsd_format = GST_DSD_INFO_FORMAT(&(self->pw_audio_format.info.dsd_audio_info));
+	GstDsdFormat graph_dsd_format = GST_DSD_INFO_FORMAT(&(self->actual_dsd_info));
+	guint input_dsd_format_stride = GST_DSD_INFO_STRIDE(&(self->pw_audio_format.info.dsd_audio_info));
+
+	/* To avoid buffer overflows, check how many input DSD frames can
+	 * fit in the DSD conversion buffer. */
+	guint64 max_num_input_frames_in_conv_buffer = self->dsd_conversion_buffer_size / input_dsd_format_stride;
+	/* Counter for many DSD frames were retrieved and converted in the loop. */
+	guint64 num_produced_frames;
+
+	guint8 *dest_start_ptr = (guint8 *)(inner_spa_data->data);
+	guint8 *dest_ptr = (guint8 *)(inner_spa_data->data);
+
+	for (num_produced_frames = 0;  num_produced_frames < num_frames_to_produce;)
+	{
+		guint64 num_frames_left_to_produce = num_frames_to_produce - num_produced_frames;
+
+		/* Apply limit in case there are more frames to retrieve
+		 * than what the DSD conversion buffer can handle. */
+		guint64 num_frames_to_convert = MIN(max_num_input_frames_in_conv_buffer, num_frames_left_to_produce);
+
+		gsize num_conv_output_bytes = num_frames_to_convert * input_dsd_format_stride;
+
+		GST_LOG_OBJECT(
+			self,
+			"converting DSD frames: num produced / num to produce: %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT "; "
+			"now converting %" G_GUINT64_FORMAT,
+			num_produced_frames, num_frames_to_produce,
+			num_frames_to_convert
+		);
+
+		g_assert((dest_ptr - dest_start_ptr) <= inner_spa_data->maxsize);
+		g_assert(num_conv_output_bytes <= self->dsd_conversion_buffer_size);
+
+		retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(
+			self->ring_buffer,
+			self->dsd_conversion_buffer,
+			num_frames_to_convert,
+			current_time,
+			ring_buffer_data_pts_shift,
+			skew_threshold,
+			buffered_frames_to_retrieval_pts_delta
+		);
+
+		gst_dsd_convert(
+			self->dsd_conversion_buffer,
+			dest_ptr,
+			input_dsd_format,
+			graph_dsd_format,
+			GST_AUDIO_LAYOUT_INTERLEAVED,
+			GST_AUDIO_LAYOUT_INTERLEAVED,
+			NULL,
+			NULL,
+			num_conv_output_bytes,
+			GST_DSD_INFO_CHANNELS(&(self->pw_audio_format.info.dsd_audio_info)),
+			GST_DSD_INFO_REVERSED_BYTES(&(self->pw_audio_format.info.dsd_audio_info)) != GST_DSD_INFO_REVERSED_BYTES(&(self->actual_dsd_info))
+		);
+
+		dest_ptr += num_conv_output_bytes;
+		num_produced_frames += num_frames_to_convert;
+	}
+
+	/* Since the converted data is to be sent out instead of the
+	 * original one, overwrite the original data's stride with
+	 * that of the converted data. */
+	*output_stride = GST_DSD_INFO_CHANNELS(&(self->actual_dsd_info)) * gst_dsd_format_get_width(GST_DSD_INFO_FORMAT(&(self->actual_dsd_info)));
+
+	return retrieval_result;
+}
+
+
+/* This is the body of the raw process callbacks. It is always inlined, and
+ * audio_type and convert_dsd are always passed as constants. That way, the
+ * compiler generates one specialized variant for each combination, and all
+ * branches that only depend on these arguments are resolved at compile time
+ * instead of in every graph cycle. */
+static ALWAYS_INLINE void gst_pw_audio_sink_raw_process_stream(GstPwAudioSink *self, GstPipewireAudioType const audio_type, gboolean const convert_dsd)
 {
-	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
 	struct pw_time stream_time;
 	struct pw_buffer *pw_buf;
 	struct spa_data *inner_spa_data;
 	GstClockTime upstream_pipeline_latency;
 	gint64 stream_delay_in_ns;
+	gint64 delay_in_ticks;
 	guint64 num_frames_to_produce;
 	gint64 time_since_delay_measurement;
 	guint64 min_num_required_ticks;
 	gboolean produce_silence_quantum = TRUE;
+	gboolean graph_clock_changed;
+	gboolean stream_delay_changed = FALSE;
 
 	GST_LOG_OBJECT(self, COLOR_GREEN "new PipeWire graph tick" COLOR_DEFAULT);
 
@@ -3507,41 +6967,35 @@ static void gst_pw_audio_sink_raw_on_process_stream(void *data)
 	pw_stream_get_time(self->stream, &stream_time);
 #endif
 
-	gst_pw_stream_clock_add_observation(self->stream_clock, &stream_time);
-
-	if (self->last_pw_time_ticks_set)
+	if (G_UNLIKELY(gst_pw_audio_sink_detect_xrun(self, &stream_time, &graph_clock_changed)))
 	{
-		uint64_t tick_delta = stream_time.ticks - self->last_pw_time_ticks;
-
-		if (G_UNLIKELY(tick_delta > self->quantum_size_in_ticks))
-		{
-			GST_INFO_OBJECT(self, "tick delta is %" G_GUINT64_FORMAT ", which is greater than expected %" G_GUINT64_FORMAT "; discontinuity in pw stream detected; resynchronizing", (guint64)tick_delta, (guint64)(self->quantum_size_in_ticks));
-			self->synced_playback_started = FALSE;
-		}
-		else if (G_UNLIKELY(tick_delta < self->quantum_size_in_ticks))
-		{
-			/* TODO: It is currently unclear what this case means, but it does not seem that we have to resynchronize then. */
-			GST_INFO_OBJECT(self, "tick delta is %" G_GUINT64_FORMAT ", which is lesser than expected %" G_GUINT64_FORMAT, (guint64)tick_delta, (guint64)(self->quantum_size_in_ticks));
-		}
-
-		/* If tick_delta == self->quantum_size_in_ticks, then no discontinuity happens, everything is OK. */
+		GST_INFO_OBJECT(self, "xrun detected; resynchronizing");
+		self->synced_playback_started = FALSE;
 	}
-	else
-		self->last_pw_time_ticks_set = TRUE;
 
-	self->last_pw_time_ticks = stream_time.ticks;
+	/* After a driver or rate change, the stream clock must continue seamlessly
+	 * instead of jumping to the new driver's timeline. The sync state is
+	 * retained; the drift compensation absorbs the remaining difference. */
+	if (G_UNLIKELY(graph_clock_changed))
+		gst_pw_stream_clock_add_discontinuous_observation(self->stream_clock, &stream_time);
+	else
+		gst_pw_stream_clock_add_observation(self->stream_clock, &stream_time);
 
 	/* We set the stream_delay_in_ns value here and access the latency value,
 	 * so the latency mutex must be locked. (stream_delay_in_ticks is only
 	 * ever used in here.) */
 	LOCK_LATENCY_MUTEX(self);
 
-	if ((stream_time.rate.denom != 0) && (self->stream_delay_in_ticks != stream_time.delay))
+	/* The delay is given in ticks of the driver's clock rate. If that rate
+	 * changes, the delay has to be converted again even if its tick count
+	 * stays the same. */
+	delay_in_ticks = gst_pw_audio_sink_get_delay_in_ticks(self, &stream_time, self->spa_position);
+	if ((stream_time.rate.denom != 0) && ((self->stream_delay_in_ticks != delay_in_ticks) || (self->stream_delay_rate.num != stream_time.rate.num) || (self->stream_delay_rate.denom != stream_time.rate.denom)))
 	{
 		gint64 new_delay_in_ns;
 
 		new_delay_in_ns = gst_util_uint64_scale_int(
-			stream_time.delay * stream_time.rate.num,
+			delay_in_ticks * stream_time.rate.num,
 			GST_SECOND,
 			stream_time.rate.denom
 		);
@@ -3551,17 +7005,50 @@ static void gst_pw_audio_sink_raw_on_process_stream(void *data)
 			"stream delay updated from %" GST_TIME_FORMAT " to %" GST_TIME_FORMAT " (old -> new delay in ticks: %" G_GINT64_FORMAT " -> %" G_GINT64_FORMAT "; PW rate: %" G_GUINT32_FORMAT "/%" G_GUINT32_FORMAT ")",
 			GST_TIME_ARGS(self->stream_delay_in_ns),
 			GST_TIME_ARGS(new_delay_in_ns),
-			self->stream_delay_in_ticks, (gint64)(stream_time.delay),
+			self->stream_delay_in_ticks, delay_in_ticks,
 			(guint32)(stream_time.rate.num), (guint32)(stream_time.rate.denom)
 		);
 
-		self->stream_delay_in_ticks = stream_time.delay;
+		self->stream_delay_in_ticks = delay_in_ticks;
+		self->stream_delay_rate = stream_time.rate;
 		self->stream_delay_in_ns = stream_delay_in_ns = new_delay_in_ns;
-		g_atomic_int_set(&(self->notify_upstream_about_stream_delay), 1);
+		stream_delay_changed = TRUE;
 	}
 	else
 		stream_delay_in_ns = self->stream_delay_in_ns;
 
+	/* After gst_pw_audio_sink_relink_stream() asked the session manager to
+	 * move the stream, the stream is relinked asynchronously. Once that is
+	 * done, the driver and/or the delay are different. Then the output has
+	 * to be resynchronized, and the new delay must be reported right away
+	 * instead of waiting for the minimum latency update interval to pass.
+	 * If neither changed, the new target shares the old one's timing, and
+	 * the sync can be kept as it is. */
+	if (G_UNLIKELY(g_atomic_int_get(&(self->relink_pending)) && (graph_clock_changed || stream_delay_changed)))
+	{
+		GST_INFO_OBJECT(self, "stream was moved to a new target; resynchronizing");
+		self->synced_playback_started = FALSE;
+		self->last_latency_update_time = GST_CLOCK_TIME_NONE;
+		g_atomic_int_set(&(self->relink_pending), 0);
+	}
+
+	/* This is checked in every cycle, not just when the delay changes, since
+	 * a significant change may have been held back by the minimum update
+	 * interval earlier, and must then be reported once that interval passed. */
+	if (G_UNLIKELY(gst_pw_audio_sink_stream_delay_change_is_significant(self, stream_time.now)))
+	{
+		GST_DEBUG_OBJECT(
+			self,
+			"reported stream delay updated from %" GST_TIME_FORMAT " to %" GST_TIME_FORMAT "; requesting latency message",
+			GST_TIME_ARGS(self->reported_stream_delay_in_ns),
+			GST_TIME_ARGS(stream_delay_in_ns)
+		);
+
+		self->reported_stream_delay_in_ns = stream_delay_in_ns;
+		self->last_latency_update_time = stream_time.now;
+		g_atomic_int_set(&(self->notify_upstream_about_stream_delay), 1);
+	}
+
 	/* In live pipelines, the pipeline has a defined latency. This sink element
 	 * gets the latency in a latency event (see gst_pw_audio_sink_send_event())
 	 * and is stored there in self->latency. That latency quantity includes our
@@ -3634,61 +7121,53 @@ static void gst_pw_audio_sink_raw_on_process_stream(void *data)
 	 * thread starvation (in the render() function) and similar. */
 	LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
 
-	switch (self->pw_audio_format.audio_type)
-	{
-		case GST_PIPEWIRE_AUDIO_TYPE_PCM:
-			num_frames_to_produce = min_num_required_ticks;
-			break;
-
-		case GST_PIPEWIRE_AUDIO_TYPE_DSD:
-		{
-			/* Calculating num_frames_to_produce is non-trivial with DSD, for the following reasons:
-			 *
-			 * 1. For each tick, a certain number of DSD bytes is expected. This number is a fractional,
-			 *    and stored as self->dsd_data_rate_multiplier_num and self->dsd_data_rate_multiplier_denom.
-			 * 2. DSD bytes are not necessary stored directly as bytes here. For example, the graph might
-			 *    expect the bytes to be organized in groups of 4 if the underlying audio hardware outputs
-			 *    data through alsa with the DSDU32BE format.
-			 *
-			 * These two cause num_frames_to_produce amounts to be non-integer. The computation overall is:
-			 *
-			 * num_frames_to_produce = min_num_required_ticks * dsd_data_rate_multiplier_num / (dsd_data_rate_multiplier_denom * dsd_format_width)
-			 *
-			 * The dsd_format_width value in the denominator factors in the aforementioned grouping.
-			 *
-			 * Simply rounding that result down or up to get an integer value results in synchronized
-			 * playback issues. Instead, keep track of the non-integer portion. Once it accumulates
-			 * enough to amount to at least 1 frame, factor this into the calculation to let the
-			 * num_frames_to_produce be higher be increased. That way, the overall consumption rate
-			 * is correct. */
-
-			gint dsd_format_width = gst_dsd_format_get_width(GST_DSD_INFO_FORMAT(&(self->pw_audio_format.info.dsd_audio_info)));
-			gint64 min_num_required_ticks_num = min_num_required_ticks * self->dsd_data_rate_multiplier_num;
-			gint64 min_num_required_ticks_denom = self->dsd_data_rate_multiplier_denom * dsd_format_width;
-
-			self->dsd_min_num_required_ticks_remainder += min_num_required_ticks_num % min_num_required_ticks_denom;
-
-			if (self->dsd_min_num_required_ticks_remainder >= min_num_required_ticks_denom)
-			{
-				min_num_required_ticks_num += min_num_required_ticks_denom;
-				self->dsd_min_num_required_ticks_remainder -= min_num_required_ticks_denom;
-			}
-
-			num_frames_to_produce = min_num_required_ticks_num / min_num_required_ticks_denom;
-
-			break;
-		}
+	if (audio_type == GST_PIPEWIRE_AUDIO_TYPE_PCM)
+		num_frames_to_produce = min_num_required_ticks;
+	else
+		num_frames_to_produce = gst_pw_audio_sink_calculate_num_dsd_frames_to_produce(self, min_num_required_ticks);
 
-		default:
-			g_assert_not_reached();
-	}
+	if (G_UNLIKELY(self->freewheel_snapshot))
+		gst_pw_audio_sink_wait_for_freewheel_data_unlocked(self, num_frames_to_produce);
 
-	if (G_UNLIKELY(gst_pw_audio_ring_buffer_get_current_fill_level(self->ring_buffer) == 0))
+	/* Check the fill level of cursor #0 (the cursor that is used by the main
+	 * pw_stream), not the shared fill level. If additional streams are present,
+	 * the shared fill level may be nonzero even though this stream's cursor
+	 * has already consumed all of the data. */
+	if (G_UNLIKELY(gst_pw_audio_ring_buffer_get_cursor_fill_level(self->ring_buffer, 0) == 0))
 	{
 		GST_DEBUG_OBJECT(self, "ring buffer empty/underrun; producing silence quantum");
 		/* In case of an underrun we have to re-sync the output. */
 		self->synced_playback_started = FALSE;
 		UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+
+		/* If the ring buffer stays empty for longer than the idle timeout,
+		 * ask the pw_thread_loop to deactivate the stream. This is not done
+		 * here, since this is an RT callback. The stream clock is not frozen
+		 * during the suspension; it keeps extrapolating timestamps. */
+		if ((self->idle_timeout_snapshot > 0) && !(self->idle_suspension_requested))
+		{
+			if (!GST_CLOCK_TIME_IS_VALID(self->idle_start_time))
+			{
+				self->idle_start_time = stream_time.now;
+			}
+			else if ((GstClockTime)(stream_time.now) >= (self->idle_start_time + self->idle_timeout_snapshot))
+			{
+				GST_DEBUG_OBJECT(self, "ring buffer was empty for longer than the idle timeout; requesting stream suspension");
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+				pw_loop_invoke(
+					pw_thread_loop_get_loop(self->pipewire_core->loop),
+					gst_pw_audio_sink_idle_suspend_stream_cb,
+					g_atomic_int_get(&(self->activated_stream_seq_id)),
+					NULL,
+					0,
+					false,
+					self
+				);
+#pragma GCC diagnostic pop
+				self->idle_suspension_requested = TRUE;
+			}
+		}
 	}
 	else if (G_UNLIKELY(num_frames_to_produce == 0))
 	{
@@ -3700,297 +7179,263 @@ static void gst_pw_audio_sink_raw_on_process_stream(void *data)
 	else
 	{
 		produce_silence_quantum = FALSE;
+		self->idle_start_time = GST_CLOCK_TIME_NONE;
+		self->idle_suspension_requested = FALSE;
 
-		switch (self->pw_audio_format.audio_type)
-		{
-			case GST_PIPEWIRE_AUDIO_TYPE_PCM:
-			case GST_PIPEWIRE_AUDIO_TYPE_DSD:
-			{
-				GstPwAudioRingBufferRetrievalResult retrieval_result;
-				GstClockTime current_time = GST_CLOCK_TIME_NONE;
-				GstClockTimeDiff buffered_frames_to_retrieval_pts_delta;
-				gboolean early_exit = FALSE;
-
-				/* This variable exists because in case of a conversion, the stride
-				 * of the actual output may differ from that of the original data
-				 * (since that data was converted). */
-				gsize output_stride = self->stride;
-
-				/* How many bytes the output that goes to the SPA chunk must contain.
-				 * Note that even in the DSD conversion case (= the gst_dsd_convert()
-				 * call below), this stays the same, since gst_dsd_convert() changes
-				 * the layout of the DSD data - it does not add or remove bytes. */
-				guint num_output_bytes = num_frames_to_produce * self->stride;
-
-				GstClockTimeDiff effective_skew_threshold = self->synced_playback_started ? self->skew_threshold_snapshot : 0;
-
-				if (self->do_synced_playback)
-				{
-					if (G_UNLIKELY(self->draining_ring_buffer))
-					{
-						GST_LOG_OBJECT(
-							self,
-							"num frames to produce (without sync because ring buffer is being drained): %" G_GUINT64_FORMAT,
-							num_frames_to_produce
-						);
-					}
-					else
-					{
-						current_time = gst_clock_get_time(GST_ELEMENT_CLOCK(self));
-
-						GST_LOG_OBJECT(
-							self,
-							"current time: %" GST_TIME_FORMAT "  "
-							"num frames to produce: %" G_GUINT64_FORMAT "  "
-							"upstream pipeline latency: %" GST_TIME_FORMAT,
-							GST_TIME_ARGS(current_time),
-							num_frames_to_produce,
-							GST_TIME_ARGS(upstream_pipeline_latency)
-						);
-					}
-				}
-				else
+		{
+			GstPwAudioRingBufferRetrievalResult retrieval_result;
+			GstClockTime current_time = GST_CLOCK_TIME_NONE;
+			GstClockTime retrieval_time;
+			GstClockTime first_frame_output_time = GST_CLOCK_TIME_NONE;
+			GstClockTime scheduled_start_time = GST_CLOCK_TIME_NONE;
+			GstClockTime scheduled_stop_time = GST_CLOCK_TIME_NONE;
+			GstClockTimeDiff buffered_frames_to_retrieval_pts_delta;
+			GstClockTime next_frame_pts;
+			gboolean early_exit = FALSE;
+			gboolean is_silence;
+
+			/* This variable exists because in case of a conversion, the stride
+			 * of the actual output may differ from that of the original data
+			 * (since that data was converted). */
+			gsize output_stride = self->stride;
+
+			/* How many bytes the output that goes to the SPA chunk must contain.
+			 * Note that even in the DSD conversion case (= the gst_dsd_convert()
+			 * call below), this stays the same, since gst_dsd_convert() changes
+			 * the layout of the DSD data - it does not add or remove bytes. */
+			guint num_output_bytes = num_frames_to_produce * self->stride;
+
+			GstClockTimeDiff effective_skew_threshold;
+
+			if (self->do_synced_playback)
+			{
+				if (G_UNLIKELY(self->draining_ring_buffer))
 				{
 					GST_LOG_OBJECT(
 						self,
-						"num frames to produce (without sync): %" G_GUINT64_FORMAT,
+						"num frames to produce (without sync because ring buffer is being drained): %" G_GUINT64_FORMAT,
 						num_frames_to_produce
 					);
 				}
-
-				if ((self->pw_audio_format.audio_type == GST_PIPEWIRE_AUDIO_TYPE_DSD)
-					&& (
-						(GST_DSD_INFO_FORMAT(&(self->pw_audio_format.info.dsd_audio_info)) != GST_DSD_INFO_FORMAT(&(self->actual_dsd_info)))
-						|| (GST_DSD_INFO_REVERSED_BYTES(&(self->pw_audio_format.info.dsd_audio_info)) != GST_DSD_INFO_REVERSED_BYTES(&(self->actual_dsd_info)))
-					)
-				)
-				{
-					/* If we reach this point, it means we have incoming DSD data
-					 * that can't directly be passed to the graph, because the latter
-					 * uses a different grouping format. We have to convert the data
-					 * first. Retrieve incoming DSD frames from the ring buffer and
-					 * store them in the intermediate "DSD conversion buffer". Then,
-					 * use that buffer as the source and the SPA data chunk as the
-					 * destination for the conversion.
-					 *
-					 * The frame counts can be confusing, because they depend on the
-					 * DSD format. The same playtime that is covered by 20 DSDU8
-					 * frames is also coverd by 10 DSDU16LE frames for example.
-					 * Here, we deal with _input_ format widths and strides, because
-					 * that's what is passed around until the very end, when the
-					 * actual conversion takes place. */
-
-					GstDsdFormat input_dsd_format = GST_DSD_INFO_FORMAT(&(self->pw_audio_format.info.dsd_audio_info));
-					GstDsdFormat graph_dsd_format = GST_DSD_INFO_FORMAT(&(self->actual_dsd_info));
-					guint input_dsd_format_stride = GST_DSD_INFO_STRIDE(&(self->pw_audio_format.info.dsd_audio_info));
-
-					/* To avoid buffer overflows, check how many input DSD frames can
-					 * fit in the DSD conversion buffer. */
-					guint64 max_num_input_frames_in_conv_buffer = self->dsd_conversion_buffer_size / input_dsd_format_stride;
-					/* Counter for many DSD frames were retrieved and converted in the loop. */
-					guint64 num_produced_frames;
-
-					guint8 *dest_start_ptr = (guint8 *)(inner_spa_data->data);
-					guint8 *dest_ptr = (guint8 *)(inner_spa_data->data);
-
-					for (num_produced_frames = 0;  num_produced_frames < num_frames_to_produce;)
-					{
-						guint64 num_frames_left_to_produce = num_frames_to_produce - num_produced_frames;
-
-						/* Apply limit in case there are more frames to retrieve
-						 * than what the DSD conversion buffer can handle. */
-						guint64 num_frames_to_convert = MIN(max_num_input_frames_in_conv_buffer, num_frames_left_to_produce);
-
-						gsize num_conv_output_bytes = num_frames_to_convert * input_dsd_format_stride;
-
-						GST_LOG_OBJECT(
-							self,
-							"converting DSD frames: num produced / num to produce: %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT "; "
-							"now converting %" G_GUINT64_FORMAT,
-							num_produced_frames, num_frames_to_produce,
-							num_frames_to_convert
-						);
-
-						g_assert((dest_ptr - dest_start_ptr) <= inner_spa_data->maxsize);
-						g_assert(num_conv_output_bytes <= self->dsd_conversion_buffer_size);
-
-						retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(
-							self->ring_buffer,
-							self->dsd_conversion_buffer,
-							num_frames_to_convert,
-							current_time,
-							upstream_pipeline_latency + time_since_delay_measurement,
-							effective_skew_threshold,
-							&buffered_frames_to_retrieval_pts_delta
-						);
-
-						gst_dsd_convert(
-							self->dsd_conversion_buffer,
-							dest_ptr,
-							input_dsd_format,
-							graph_dsd_format,
-							GST_AUDIO_LAYOUT_INTERLEAVED,
-							GST_AUDIO_LAYOUT_INTERLEAVED,
-							NULL,
-							NULL,
-							num_conv_output_bytes,
-							GST_DSD_INFO_CHANNELS(&(self->pw_audio_format.info.dsd_audio_info)),
-							GST_DSD_INFO_REVERSED_BYTES(&(self->pw_audio_format.info.dsd_audio_info)) != GST_DSD_INFO_REVERSED_BYTES(&(self->actual_dsd_info))
-						);
-
-						dest_ptr += num_conv_output_bytes;
-						num_produced_frames += num_frames_to_convert;
-
-						/* Since the converted data is to be sent out instead of the
-						 * original one, overwrite the original data's stride with
-						 * that of the converted data. */
-						output_stride = GST_DSD_INFO_CHANNELS(&(self->actual_dsd_info)) * gst_dsd_format_get_width(GST_DSD_INFO_FORMAT(&(self->actual_dsd_info)));
-					}
-				}
 				else
 				{
-					/* We use both upstream_pipeline_latency and time_since_delay_measurement
-					 * for the PTS shift quantity. The former is necessary to compensate for
-					 * the upstream pipeline latency. The latter is necessary to retrieve data
-					 * from a moment that corresponds to the scheduled beginning of this
-					 * pipewire graph tick. */
-					retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(
-						self->ring_buffer,
-						inner_spa_data->data,
+					current_time = gst_clock_get_time(GST_ELEMENT_CLOCK(self));
+
+					GST_LOG_OBJECT(
+						self,
+						"current time: %" GST_TIME_FORMAT "  "
+						"num frames to produce: %" G_GUINT64_FORMAT "  "
+						"upstream pipeline latency: %" GST_TIME_FORMAT,
+						GST_TIME_ARGS(current_time),
 						num_frames_to_produce,
-						current_time,
-						upstream_pipeline_latency + time_since_delay_measurement,
-						effective_skew_threshold,
-						&buffered_frames_to_retrieval_pts_delta
+						GST_TIME_ARGS(upstream_pipeline_latency)
 					);
+
+					/* This is when the first frame of this quantum is output.
+					 * See the played audio tap code below for details. */
+					first_frame_output_time = current_time + stream_delay_in_ns - time_since_delay_measurement;
+
+					if (G_UNLIKELY(gst_pw_audio_sink_scheduled_start_is_pending_unlocked(self)))
+						gst_pw_audio_sink_apply_scheduled_start_unlocked(self, upstream_pipeline_latency, stream_delay_in_ns, first_frame_output_time);
 				}
+			}
+			else
+			{
+				GST_LOG_OBJECT(
+					self,
+					"num frames to produce (without sync): %" G_GUINT64_FORMAT,
+					num_frames_to_produce
+				);
+			}
+
+			/* This is read here, since a scheduled start resets synced_playback_started. */
+			effective_skew_threshold = self->synced_playback_started ? self->skew_threshold_snapshot : 0;
+
+			/* After a scheduled start, the pipeline clock time is shifted
+			 * by an offset before retrieving frames. The unshifted current_time
+			 * is still used below, since the drift compensation needs the
+			 * actual clock time. */
+			retrieval_time = gst_pw_audio_sink_get_scheduled_retrieval_time_unlocked(self, current_time);
+
+			/* We use both upstream_pipeline_latency and time_since_delay_measurement
+			 * for the PTS shift quantity. The former is necessary to compensate for
+			 * the upstream pipeline latency. The latter is necessary to retrieve data
+			 * from a moment that corresponds to the scheduled beginning of this
+			 * pipewire graph tick. */
+			if (convert_dsd)
+			{
+				retrieval_result = gst_pw_audio_sink_retrieve_and_convert_dsd_frames(
+					self,
+					inner_spa_data,
+					num_frames_to_produce,
+					retrieval_time,
+					upstream_pipeline_latency + time_since_delay_measurement,
+					effective_skew_threshold,
+					&buffered_frames_to_retrieval_pts_delta,
+					&output_stride
+				);
+			}
+			else
+			{
+				retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(
+					self->ring_buffer,
+					inner_spa_data->data,
+					num_frames_to_produce,
+					retrieval_time,
+					upstream_pipeline_latency + time_since_delay_measurement,
+					effective_skew_threshold,
+					&buffered_frames_to_retrieval_pts_delta
+				);
+			}
+
+			inner_spa_data->chunk->offset = 0;
+			inner_spa_data->chunk->size = num_output_bytes;
+			inner_spa_data->chunk->stride = output_stride;
+
+			/* This is the PTS of the frame that follows the ones that were just
+			 * retrieved. It is read here, since the audio data buffer mutex
+			 * is unlocked by the switch-case block below. */
+			next_frame_pts = gst_pw_audio_ring_buffer_get_cursor_oldest_frame_pts(self->ring_buffer, 0);
 
-				inner_spa_data->chunk->offset = 0;
-				inner_spa_data->chunk->size = num_output_bytes;
-				inner_spa_data->chunk->stride = output_stride;
+			gst_pw_audio_sink_observe_expired_frames_for_qos_unlocked(
+				self,
+				((retrieval_result == GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK) || (retrieval_result == GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES)) ? num_frames_to_produce : 0
+			);
+
+			/* All results except OK and RING_BUFFER_IS_EMPTY mean that the
+			 * ring buffer filled the output with silence frames. */
+			is_silence = (retrieval_result != GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK) && (retrieval_result != GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_RING_BUFFER_IS_EMPTY);
+
+			if (G_UNLIKELY(GST_CLOCK_TIME_IS_VALID(self->scheduled_stop_time)) && ((retrieval_result == GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK) || (retrieval_result == GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES)))
+			{
+				GstPwAudioFormat const *output_format = &(self->pw_audio_format);
+				GstPwAudioFormat converted_dsd_format;
+				gsize num_kept_bytes;
 
-				switch (retrieval_result)
+				/* The silence has to be written in the layout of the converted data. */
+				if (convert_dsd)
 				{
-					case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK:
-						self->synced_playback_started = TRUE;
-						UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
-						break;
+					converted_dsd_format.audio_type = GST_PIPEWIRE_AUDIO_TYPE_DSD;
+					converted_dsd_format.info.dsd_audio_info = self->actual_dsd_info;
+					output_format = &converted_dsd_format;
+				}
 
-					case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_RING_BUFFER_IS_EMPTY:
-					{
-						self->synced_playback_started = FALSE;
-						UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
-						early_exit = TRUE;
-						GST_DEBUG_OBJECT(self, "ring buffer is empty; could not retrieve frames and need to resynchronize playback");
-						break;
-					}
+				num_kept_bytes = gst_pw_audio_sink_apply_scheduled_stop_unlocked(self, output_format, inner_spa_data->data, num_output_bytes, output_stride, first_frame_output_time);
 
-					case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_DATA_FULLY_IN_THE_FUTURE:
+				if (num_kept_bytes < num_output_bytes)
+				{
+					if (!(self->scheduled_stop_announced))
 					{
-						UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
-						early_exit = TRUE;
-						break;
+						scheduled_stop_time = self->scheduled_stop_time;
+						self->scheduled_stop_announced = TRUE;
 					}
 
-					case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_DATA_FULLY_IN_THE_PAST:
-					{
-						self->synced_playback_started = FALSE;
-						UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
-						early_exit = TRUE;
-						GST_DEBUG_OBJECT(self, "the ring buffer's frames lie entirely in the past; need to flush those and then resynchronize playback");
-						break;
-					}
+					is_silence = is_silence || (num_kept_bytes == 0);
+				}
+			}
+
+			gst_pw_audio_sink_set_chunk_content(
+				self,
+				pw_buf,
+				inner_spa_data,
+				is_silence,
+				num_output_bytes
+			);
 
-					case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_ALL_DATA_FOR_BUFFER_CLIPPED:
+			switch (retrieval_result)
+			{
+				case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK:
+				case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES:
+					self->synced_playback_started = TRUE;
+					/* The first frames were just retrieved, so the scheduled
+					 * start happened. The offset stays in effect. */
+					if (G_UNLIKELY(self->scheduled_start_offset_set && GST_CLOCK_TIME_IS_VALID(self->scheduled_start_time)))
 					{
-						UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
-						early_exit = TRUE;
-						break;
+						scheduled_start_time = self->scheduled_start_time;
+						self->scheduled_start_time = GST_CLOCK_TIME_NONE;
 					}
+					UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+					break;
+
+				case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_RING_BUFFER_IS_EMPTY:
+				{
+					self->synced_playback_started = FALSE;
+					UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+					early_exit = TRUE;
+					GST_DEBUG_OBJECT(self, "ring buffer is empty; could not retrieve frames and need to resynchronize playback");
+					break;
+				}
+
+				case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_DATA_FULLY_IN_THE_FUTURE:
+				{
+					UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+					early_exit = TRUE;
+					break;
+				}
+
+				case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_DATA_FULLY_IN_THE_PAST:
+				{
+					self->synced_playback_started = FALSE;
+					UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+					early_exit = TRUE;
+					GST_DEBUG_OBJECT(self, "the ring buffer's frames lie entirely in the past; need to flush those and then resynchronize playback");
+					break;
 				}
 
-				if (early_exit)
+				case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_ALL_DATA_FOR_BUFFER_CLIPPED:
+				{
+					UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+					early_exit = TRUE;
 					break;
+				}
+			}
+
+			if (G_UNLIKELY(GST_CLOCK_TIME_IS_VALID(scheduled_start_time)))
+				gst_pw_audio_sink_announce_scheduled_event(self, FALSE, scheduled_start_time);
+			if (G_UNLIKELY(GST_CLOCK_TIME_IS_VALID(scheduled_stop_time)))
+				gst_pw_audio_sink_announce_scheduled_event(self, TRUE, scheduled_stop_time);
+
+			if (!early_exit)
+			{
+				if (self->do_synced_playback)
+					gst_pw_audio_sink_publish_position_snapshot(self, next_frame_pts, num_frames_to_produce, &stream_time, stream_delay_in_ns);
 
 				/* If the pipeline clock and our PW stream clock are not the same, we must compensate
 				 * for a clock drift. Calculate it and a factor for compensating this drift with the
 				 * ASRC of the pw_stream. We use the PI controller for this. */
-				if ((self->pw_audio_format.audio_type == GST_PIPEWIRE_AUDIO_TYPE_PCM) && !(self->stream_clock_is_pipeline_clock) && (self->spa_rate_match != NULL))
+				if ((audio_type == GST_PIPEWIRE_AUDIO_TYPE_PCM) && !(self->stream_clock_is_pipeline_clock) && !(self->freewheel_snapshot) && (self->spa_rate_match != NULL))
 				{
-					double input_ppm, filtered_ppm;
-					double rate, time_scale;
-					GstClockTimeDiff drift_pts_delta, clamped_drift_pts_delta;
-
-					/* Get the PTS delta from the queue. This delta already comes median-filtered,
-					 * so we don't bother pre-filtering it further here. However, we do clamp it
-					 * to limit the impact it can have on the PI controller. */
-					drift_pts_delta = buffered_frames_to_retrieval_pts_delta;
-					clamped_drift_pts_delta = CLAMP(drift_pts_delta, -MAX_DRIFT_PTS_DELTA, +MAX_DRIFT_PTS_DELTA);
-
-					/* Do a simple linear transform to convert the PTS delta to a PPM value. PPM
-					 * is a relative quantity, and we use MAX_DRIFT_PTS_DELTA as the reference. */
-					input_ppm = MAX_DRIFT_PPM * ((double)clamped_drift_pts_delta) / MAX_DRIFT_PTS_DELTA;
-
-					/* Calculate the time_scale to correctly factor in the elapsed time between
-					 * ticks when the PI controller calculates the filtered PPM quantity. As for
-					 * the situation in the beginning, we don't do any clock drift compensation
-					 * from the get-go anyway, so it is fine to use a time_scale of 0, which
-					 * effectively amounts to a no-op in pi_controller_compute(). */
-					time_scale = GST_CLOCK_TIME_IS_VALID(self->previous_time)
-						? (((double)GST_CLOCK_DIFF(self->previous_time, current_time)) / GST_SECOND)
-						: 0.0;
-
-					/* Perform the filtering using the PI controller. */
-					filtered_ppm = pi_controller_compute(&(self->pi_controller), input_ppm, time_scale);
-
-					/* Using the PPM, adjust the ASRC. */
-					rate = 1.0 - filtered_ppm / 1000000.0;
-					self->spa_rate_match->rate = rate;
-
-					GST_LOG_OBJECT(
+					gst_pw_audio_sink_compensate_drift(
 						self,
-						"drift adjustment: original / clamped PTS delta: %"
-						G_GINT64_FORMAT " / %" G_GINT64_FORMAT
-						" time scale: %f input / filtered PPM: %f / %f rate: %f",
-						drift_pts_delta, clamped_drift_pts_delta,
-						time_scale, input_ppm, filtered_ppm, rate
+						&(self->pi_controller),
+						&(self->previous_time),
+						self->spa_rate_match,
+						current_time,
+						buffered_frames_to_retrieval_pts_delta
 					);
-
-					/* Store the current time for the next iteration so we can compute the next time_scale. */
-					self->previous_time = current_time;
 				}
-
-				break;
 			}
-
-			default:
-				/* Raise an assertion here. If we reach this point, then it means that
-				 * either, this raw process callback is being used for non-raw
-				 * data, or some extra raw audio type got introduced, but code for
-				 * processing it wasn't added here yet. */
-				g_assert_not_reached();
 		}
 
-		g_cond_signal(&(self->audio_data_buffer_cond));
+		RT_SAFETY_CHECKER_COND_SIGNAL(&(self->audio_data_buffer_cond));
 	}
 
 	if (produce_silence_quantum)
 	{
-		guint64 num_silence_frames = num_frames_to_produce;
-		guint64 num_silence_bytes = num_silence_frames * self->stride;
-
-		g_assert(num_silence_frames <= (inner_spa_data->maxsize / self->stride));
+		GST_LOG_OBJECT(self, "producing %" G_GUINT64_FORMAT " frame(s) of silence for silent quantum", num_frames_to_produce);
 
-		GST_LOG_OBJECT(self, "producing %" G_GUINT64_FORMAT " frame(s) of silence for silent quantum", num_silence_frames);
+		gst_pw_audio_sink_produce_silence_chunk(self, pw_buf, inner_spa_data, num_frames_to_produce);
 
-		inner_spa_data->chunk->offset = 0;
-		inner_spa_data->chunk->size = num_silence_bytes;
-		inner_spa_data->chunk->stride = self->stride;
+		RT_SAFETY_CHECKER_COND_SIGNAL(&(self->audio_data_buffer_cond));
+	}
 
-		gst_pw_audio_format_write_silence_frames(&(self->pw_audio_format), inner_spa_data->data, num_silence_frames);
+	/* The first frame of this quantum is output once the stream delay
+	 * has passed, counted from the moment that delay was measured. */
+	if (self->played_audio_tap != NULL)
+		gst_pw_audio_sink_write_to_played_audio_tap(self, inner_spa_data, num_frames_to_produce, stream_delay_in_ns - time_since_delay_measurement);
 
-		g_cond_signal(&(self->audio_data_buffer_cond));
-	}
+	if (self->active_level_metering == GST_PW_AUDIO_SINK_LEVEL_METERING_REALTIME)
+		gst_pw_audio_sink_meter_levels_in_process_callback(self, inner_spa_data, num_frames_to_produce, stream_delay_in_ns - time_since_delay_measurement);
 
 finish:
 	pw_stream_queue_buffer(self->stream, pw_buf);
@@ -4002,19 +7447,54 @@ finish:
 }
 
 
-static void gst_pw_audio_sink_encoded_on_process_stream(void *data)
+static void gst_pw_audio_sink_pcm_on_process_stream(void *data)
+{
+	RT_SAFETY_CHECKER_ENTER("pwaudiosink PCM process callback");
+	gst_pw_audio_sink_raw_process_stream(GST_PW_AUDIO_SINK_CAST(data), GST_PIPEWIRE_AUDIO_TYPE_PCM, FALSE);
+	RT_SAFETY_CHECKER_LEAVE();
+}
+
+
+static void gst_pw_audio_sink_dsd_on_process_stream(void *data)
 {
 	GstPwAudioSink *self = GST_PW_AUDIO_SINK_CAST(data);
+
+	/* Unlike the audio type, the need for conversion may change while the
+	 * stream is running, since the graph may pick a different DSD format.
+	 * Swapping the stream listener is not possible then, since the process
+	 * callback runs in the realtime thread, and the listener list must not
+	 * be modified while that thread may be iterating over it. So, instead,
+	 * select between the two specialized variants here. */
+	RT_SAFETY_CHECKER_ENTER("pwaudiosink DSD process callback");
+	if (g_atomic_int_get(&(self->dsd_conversion_required)))
+		gst_pw_audio_sink_raw_process_stream(self, GST_PIPEWIRE_AUDIO_TYPE_DSD, TRUE);
+	else
+		gst_pw_audio_sink_raw_process_stream(self, GST_PIPEWIRE_AUDIO_TYPE_DSD, FALSE);
+	RT_SAFETY_CHECKER_LEAVE();
+}
+
+
+static void gst_pw_audio_sink_encoded_process_stream(GstPwAudioSink *self)
+{
 	struct pw_time stream_time;
 	struct pw_buffer *pw_buf;
 	struct spa_data *inner_spa_data;
 	gboolean produce_null_frame = FALSE;
+	gboolean graph_clock_changed;
 
 	GST_LOG_OBJECT(self, COLOR_GREEN "new PipeWire graph tick" COLOR_DEFAULT);
 
 	pw_stream_get_time_n(self->stream, &stream_time, sizeof(stream_time));
 
-	gst_pw_stream_clock_add_observation(self->stream_clock, &stream_time);
+	/* Encoded data is not played in sync with the graph's timeline, so xruns
+	 * are not relevant here. But driver and rate changes still are, since
+	 * the stream clock has to continue seamlessly across them. */
+	gst_pw_audio_sink_detect_xrun(self, &stream_time, &graph_clock_changed);
+
+	if (G_UNLIKELY(graph_clock_changed))
+		gst_pw_stream_clock_add_discontinuous_observation(self->stream_clock, &stream_time);
+	else
+		gst_pw_stream_clock_add_observation(self->stream_clock, &stream_time);
 
 	pw_buf = pw_stream_dequeue_buffer(self->stream);
 	if (G_UNLIKELY(pw_buf == NULL))
@@ -4075,15 +7555,18 @@ static void gst_pw_audio_sink_encoded_on_process_stream(void *data)
 		 * single frames instead of accumulating them to match a quantum's size,
 		 * underflows could constantly happen in the graph's sink (because we'd
 		 * send insufficient data for covering the quantum's duration).
-		 * To be safe, this loop also checks that the queue isn't empty.
-		 * It should not be empty, but better safe than sorry. */
-		while ((gst_queue_array_get_length(self->encoded_data_queue) > 0) && (accumulated_duration < self->quantum_size_in_ns))
+		 * To be safe, this loop also checks that the queue still contains
+		 * frames that were not consumed yet. This should always be the case,
+		 * but better safe than sorry. Consumed frames stay in the queue until
+		 * the streaming thread releases them (see num_consumed_encoded_frames). */
+		while ((gst_queue_array_get_length(self->encoded_data_queue) > self->num_consumed_encoded_frames) && (accumulated_duration < self->quantum_size_in_ns))
 		{
 			GstBuffer *frame;
 			uint32_t new_chunk_size;
 			gboolean out_of_bounds = FALSE;
 
-			frame = gst_queue_array_pop_head(self->encoded_data_queue);
+			frame = gst_queue_array_peek_nth(self->encoded_data_queue, self->num_consumed_encoded_frames);
+			self->num_consumed_encoded_frames++;
 
 			gst_buffer_map(frame, &map_info, GST_MAP_READ);
 			new_chunk_size = inner_spa_data->chunk->size + map_info.size;
@@ -4097,7 +7580,6 @@ static void gst_pw_audio_sink_encoded_on_process_stream(void *data)
 			gst_buffer_unmap(frame, &map_info);
 
 			accumulated_duration += GST_BUFFER_DURATION(frame);
-			gst_buffer_unref(frame);
 
 			if (G_UNLIKELY(out_of_bounds))
 			{
@@ -4132,7 +7614,7 @@ static void gst_pw_audio_sink_encoded_on_process_stream(void *data)
 		/* Signal that there is now room in the queue for new data.
 		 * Potentially needed if the g_cond_wait() call in
 		 * gst_pw_audio_sink_render_encoded() is blocking. */
-		g_cond_signal(&(self->audio_data_buffer_cond));
+		RT_SAFETY_CHECKER_COND_SIGNAL(&(self->audio_data_buffer_cond));
 	}
 
 	if (produce_null_frame)
@@ -4153,3 +7635,285 @@ finish:
 	 * something (even it is just silence) before notifying. */
 	gst_pw_audio_sink_notify_about_activated_stream(self);
 }
+
+
+static void gst_pw_audio_sink_encoded_on_process_stream(void *data)
+{
+	RT_SAFETY_CHECKER_ENTER("pwaudiosink encoded process callback");
+	gst_pw_audio_sink_encoded_process_stream(GST_PW_AUDIO_SINK_CAST(data));
+	RT_SAFETY_CHECKER_LEAVE();
+}
+
+
+static void gst_pw_audio_sink_additional_stream_state_changed(void *data, enum pw_stream_state old_state, enum pw_stream_state new_state, const char *error)
+{
+	GstPwAudioSinkAdditionalStream *additional_stream = (GstPwAudioSinkAdditionalStream *)data;
+	GstPwAudioSink *self = additional_stream->sink;
+
+	GST_DEBUG_OBJECT(
+		self,
+		"PipeWire state of additional stream for target object %" G_GUINT32_FORMAT " changed:  old: %s  new: %s  error: \"%s\"",
+		additional_stream->target_object_id,
+		pw_stream_state_as_string(old_state),
+		pw_stream_state_as_string(new_state),
+		(error == NULL) ? "<none>" : error
+	);
+
+	/* The cursor of an additional stream only takes part in the ring buffer
+	 * bookkeeping while that stream is actually streaming. Otherwise, an
+	 * additional stream whose target never got linked or went away would
+	 * keep the ring buffer full, and render() would block forever. */
+	LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+
+	if ((self->ring_buffer != NULL) && (additional_stream->cursor_index > 0))
+	{
+		gst_pw_audio_ring_buffer_set_cursor_active(
+			self->ring_buffer,
+			additional_stream->cursor_index,
+			new_state == PW_STREAM_STATE_STREAMING
+		);
+		additional_stream->synced_playback_started = FALSE;
+
+		/* Deactivating a cursor may have made room in the ring buffer,
+		 * so wake up render() in case it is waiting for that. */
+		g_cond_signal(&(self->audio_data_buffer_cond));
+	}
+
+	UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+}
+
+
+static void gst_pw_audio_sink_additional_stream_io_changed(void *data, uint32_t id, void *area, G_GNUC_UNUSED uint32_t size)
+{
+	GstPwAudioSinkAdditionalStream *additional_stream = (GstPwAudioSinkAdditionalStream *)data;
+	GstPwAudioSink *self = additional_stream->sink;
+
+	/* The position is only needed for the clock duration
+	 * (see gst_pw_audio_sink_get_delay_in_ticks()). */
+	if (id == SPA_IO_Position)
+	{
+		additional_stream->spa_position = (struct spa_io_position *)area;
+		return;
+	}
+
+	if (id != SPA_IO_RateMatch)
+		return;
+
+	/* Unlike with the main stream, rate matching is always enabled here.
+	 * The driver of an additional stream may be a different one than the
+	 * driver of the main stream, so even if the stream clock is the
+	 * pipeline clock, the additional stream may drift against it. */
+
+	additional_stream->spa_rate_match = (struct spa_io_rate_match *)area;
+
+	if (additional_stream->spa_rate_match != NULL)
+	{
+		additional_stream->spa_rate_match->rate = 1.0;
+		additional_stream->spa_rate_match->flags |= SPA_IO_RATE_MATCH_FLAG_ACTIVE;
+		GST_INFO_OBJECT(self, "enabling rate match in additional stream for target object %" G_GUINT32_FORMAT, additional_stream->target_object_id);
+	}
+	else
+	{
+		GST_DEBUG_OBJECT(self, "got NULL SPA IO rate match in additional stream for target object %" G_GUINT32_FORMAT, additional_stream->target_object_id);
+	}
+}
+
+
+static void gst_pw_audio_sink_additional_stream_process(GstPwAudioSinkAdditionalStream *additional_stream)
+{
+	GstPwAudioSink *self = additional_stream->sink;
+	struct pw_time stream_time;
+	struct pw_buffer *pw_buf;
+	struct spa_data *inner_spa_data;
+	GstClockTime upstream_pipeline_latency;
+	gint64 stream_delay_in_ns = 0;
+	gint64 time_since_delay_measurement;
+	guint64 num_frames_to_produce;
+	guint64 max_num_frames;
+	gboolean produce_silence_quantum = TRUE;
+
+#if PW_CHECK_VERSION(0, 3, 50)
+	pw_stream_get_time_n(additional_stream->stream, &stream_time, sizeof(stream_time));
+#else
+	pw_stream_get_time(additional_stream->stream, &stream_time);
+#endif
+
+	if (stream_time.rate.denom != 0)
+	{
+		stream_delay_in_ns = gst_util_uint64_scale_int(
+			gst_pw_audio_sink_get_delay_in_ticks(self, &stream_time, additional_stream->spa_position) * stream_time.rate.num,
+			GST_SECOND,
+			stream_time.rate.denom
+		);
+	}
+
+	/* The delay of this stream is not part of the latency that the sink
+	 * reports, since only the main stream's delay is. To play in sync with
+	 * the main stream, subtract _this_ stream's delay from the pipeline latency
+	 * instead. See gst_pw_audio_sink_raw_process_stream() for details. */
+	LOCK_LATENCY_MUTEX(self);
+	upstream_pipeline_latency = ((gint64)(self->latency) >= stream_delay_in_ns) ? (self->latency - stream_delay_in_ns) : 0;
+	UNLOCK_LATENCY_MUTEX(self);
+
+	{
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		time_since_delay_measurement = SPA_TIMESPEC_TO_NSEC(&ts) - stream_time.now;
+	}
+
+	pw_buf = pw_stream_dequeue_buffer(additional_stream->stream);
+	if (G_UNLIKELY(pw_buf == NULL))
+	{
+		GST_WARNING_OBJECT(self, "there are no PipeWire buffers to dequeue in additional stream; cannot process anything");
+		return;
+	}
+
+	g_assert(pw_buf->buffer != NULL);
+
+	if (G_UNLIKELY(pw_buf->buffer->n_datas == 0))
+	{
+		GST_WARNING_OBJECT(self, "dequeued PipeWire buffer of additional stream has no data");
+		goto finish;
+	}
+
+	inner_spa_data = &(pw_buf->buffer->datas[0]);
+	if (G_UNLIKELY(inner_spa_data->data == NULL))
+	{
+		GST_WARNING_OBJECT(self, "dequeued PipeWire buffer of additional stream has no mapped data pointer");
+		goto finish;
+	}
+
+	/* Like in the main stream, prefer the rate match size, and otherwise use
+	 * the quantum size from this stream's SPA IO position. If neither is
+	 * present, fall back to the size that PipeWire requests for this buffer. */
+	max_num_frames = inner_spa_data->maxsize / self->stride;
+	if (additional_stream->spa_rate_match != NULL)
+		num_frames_to_produce = additional_stream->spa_rate_match->size;
+	else if (additional_stream->spa_position != NULL)
+		num_frames_to_produce = additional_stream->spa_position->clock.duration;
+	else
+		num_frames_to_produce = pw_buf->requested;
+	if ((num_frames_to_produce == 0) || (num_frames_to_produce > max_num_frames))
+		num_frames_to_produce = max_num_frames;
+
+	LOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+
+	if (G_UNLIKELY(
+		(self->ring_buffer == NULL)
+		|| (additional_stream->cursor_index <= 0)
+		|| !(self->ring_buffer->cursors[additional_stream->cursor_index].active)
+		|| (gst_pw_audio_ring_buffer_get_cursor_fill_level(self->ring_buffer, additional_stream->cursor_index) == 0)
+		/* The main stream has not yet computed the retrieval
+		 * offset for the scheduled start; keep the data until then. */
+		|| gst_pw_audio_sink_scheduled_start_is_pending_unlocked(self)
+	))
+	{
+		GST_LOG_OBJECT(self, "no data for additional stream for target object %" G_GUINT32_FORMAT "; producing silence quantum", additional_stream->target_object_id);
+		additional_stream->synced_playback_started = FALSE;
+		UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+	}
+	else
+	{
+		GstPwAudioRingBufferRetrievalResult retrieval_result;
+		GstClockTime current_time = GST_CLOCK_TIME_NONE;
+		GstClockTimeDiff buffered_frames_to_retrieval_pts_delta;
+		GstClockTimeDiff effective_skew_threshold = additional_stream->synced_playback_started ? self->skew_threshold_snapshot : 0;
+		gsize num_output_bytes = num_frames_to_produce * self->stride;
+		gboolean is_silence;
+
+		produce_silence_quantum = FALSE;
+
+		if (self->do_synced_playback && !(self->draining_ring_buffer))
+			current_time = gst_clock_get_time(GST_ELEMENT_CLOCK(self));
+
+		retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames_with_cursor(
+			self->ring_buffer,
+			additional_stream->cursor_index,
+			inner_spa_data->data,
+			num_frames_to_produce,
+			gst_pw_audio_sink_get_scheduled_retrieval_time_unlocked(self, current_time),
+			upstream_pipeline_latency + time_since_delay_measurement,
+			effective_skew_threshold,
+			&buffered_frames_to_retrieval_pts_delta
+		);
+
+		inner_spa_data->chunk->offset = 0;
+		inner_spa_data->chunk->size = num_output_bytes;
+		inner_spa_data->chunk->stride = self->stride;
+
+		is_silence = (retrieval_result != GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK) && (retrieval_result != GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_RING_BUFFER_IS_EMPTY);
+
+		/* Like in the main stream, this also covers retrievals that only
+		 * produced gap frames, since those still carry the output timeline.
+		 * Only the main stream announces the scheduled stop. */
+		if (G_UNLIKELY(GST_CLOCK_TIME_IS_VALID(self->scheduled_stop_time))
+		 && ((retrieval_result == GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK) || (retrieval_result == GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES))
+		 && GST_CLOCK_TIME_IS_VALID(current_time))
+		{
+			if (gst_pw_audio_sink_apply_scheduled_stop_unlocked(
+				self,
+				&(self->pw_audio_format),
+				inner_spa_data->data,
+				num_output_bytes,
+				self->stride,
+				current_time + stream_delay_in_ns - time_since_delay_measurement
+			) == 0)
+			{
+				is_silence = TRUE;
+			}
+		}
+
+		gst_pw_audio_sink_set_chunk_content(
+			self,
+			pw_buf,
+			inner_spa_data,
+			is_silence,
+			num_output_bytes
+		);
+
+		switch (retrieval_result)
+		{
+			case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK:
+			case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES:
+				additional_stream->synced_playback_started = TRUE;
+				if (GST_CLOCK_TIME_IS_VALID(current_time) && (additional_stream->spa_rate_match != NULL))
+				{
+					gst_pw_audio_sink_compensate_drift(
+						self,
+						&(additional_stream->pi_controller),
+						&(additional_stream->previous_time),
+						additional_stream->spa_rate_match,
+						current_time,
+						buffered_frames_to_retrieval_pts_delta
+					);
+				}
+				break;
+
+			case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_RING_BUFFER_IS_EMPTY:
+			case GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_DATA_FULLY_IN_THE_PAST:
+				additional_stream->synced_playback_started = FALSE;
+				break;
+
+			default:
+				break;
+		}
+
+		RT_SAFETY_CHECKER_COND_SIGNAL(&(self->audio_data_buffer_cond));
+		UNLOCK_AUDIO_DATA_BUFFER_MUTEX(self);
+	}
+
+	if (produce_silence_quantum)
+		gst_pw_audio_sink_produce_silence_chunk(self, pw_buf, inner_spa_data, num_frames_to_produce);
+
+finish:
+	pw_stream_queue_buffer(additional_stream->stream, pw_buf);
+}
+
+
+static void gst_pw_audio_sink_additional_stream_on_process(void *data)
+{
+	RT_SAFETY_CHECKER_ENTER("pwaudiosink additional stream process callback");
+	gst_pw_audio_sink_additional_stream_process((GstPwAudioSinkAdditionalStream *)data);
+	RT_SAFETY_CHECKER_LEAVE();
+}
@@ -46,6 +46,31 @@ typedef struct _GstPwAudioSinkClass GstPwAudioSinkClass;
 GType gst_pw_audio_sink_get_type(void);
 
 
+/**
+ * GstPwAudioSinkLevelMetering:
+ * @GST_PW_AUDIO_SINK_LEVEL_METERING_NONE: No level metering.
+ * @GST_PW_AUDIO_SINK_LEVEL_METERING_REALTIME: Meter the levels in the PipeWire
+ *     process callback. This has the lowest latency, but adds to the work that
+ *     has to be done in each graph cycle.
+ * @GST_PW_AUDIO_SINK_LEVEL_METERING_DEFERRED: Copy the played audio out of the
+ *     process callback, and meter the levels in a separate thread. Use this if
+ *     the graph cycle budget is tight (for example with very short quanta).
+ *
+ * Where pwaudiosink measures the peak and RMS levels of the played PCM audio.
+ */
+typedef enum
+{
+	GST_PW_AUDIO_SINK_LEVEL_METERING_NONE,
+	GST_PW_AUDIO_SINK_LEVEL_METERING_REALTIME,
+	GST_PW_AUDIO_SINK_LEVEL_METERING_DEFERRED
+}
+GstPwAudioSinkLevelMetering;
+
+#define GST_TYPE_PW_AUDIO_SINK_LEVEL_METERING (gst_pw_audio_sink_level_metering_get_type())
+
+GType gst_pw_audio_sink_level_metering_get_type(void);
+
+
 G_END_DECLS
 
 
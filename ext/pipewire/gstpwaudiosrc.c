@@ -0,0 +1,1717 @@
+/* gst-pipewire-extra
+ *
+ * Copyright © 2022 Carlos Rafael Giani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* This source works like the sink in reverse. The process callback runs
+ * in the PipeWire realtime thread, and does as little as possible: it
+ * timestamps the captured quantum and copies it into a lock-free queue
+ * (a GstPwAudioTap). create() then runs in the streaming thread, and takes
+ * care of everything else, like translating timestamps to running time,
+ * smoothing out timestamp jitter, and allocating the outgoing buffers. */
+
+#include <gst/gst.h>
+/* Turn off -Wdeprecated-declarations to mask the "g_memdup is deprecated"
+ * warning (originating in gst/base/gstbytereader.h) that is present in
+ * many GStreamer installations. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <gst/base/base.h>
+#pragma GCC diagnostic pop
+#include <gst/audio/audio.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Turn off -pedantic to mask the "ISO C forbids braced-groups within expressions"
+ * warnings that occur because PipeWire uses such braced-groups extensively. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#include <pipewire/pipewire.h>
+#include <spa/node/io.h>
+#pragma GCC diagnostic pop
+
+#include "gstpipewirecore.h"
+#include "gstpwstreamclock.h"
+#include "gstpwaudioformat.h"
+#include "gstpwaudiosrc.h"
+#include "gstpwaudiotap.h"
+#include "rt_safety_checker.h"
+
+
+GST_DEBUG_CATEGORY(pw_audio_src_debug);
+#define GST_CAT_DEFAULT pw_audio_src_debug
+
+
+enum
+{
+	PROP_0,
+
+	PROP_ALIGNMENT_THRESHOLD,
+	PROP_TARGET_OBJECT_ID,
+	PROP_TARGET_NODE_NAME,
+	PROP_STREAM_PROPERTIES,
+	PROP_SOCKET_FD,
+	PROP_RING_BUFFER_LENGTH,
+	PROP_APP_NAME,
+	PROP_NODE_NAME,
+	PROP_NODE_DESCRIPTION,
+	PROP_PROBE_FOR_CAPS,
+	PROP_TARGET_LATENCY,
+
+	PROP_LAST
+};
+
+
+#define DEFAULT_ALIGNMENT_THRESHOLD (GST_MSECOND * 40)
+#define DEFAULT_TARGET_OBJECT_ID PW_ID_ANY
+#define DEFAULT_TARGET_NODE_NAME NULL
+#define DEFAULT_STREAM_PROPERTIES NULL
+#define DEFAULT_SOCKET_FD (-1)
+#define DEFAULT_RING_BUFFER_LENGTH 100
+#define DEFAULT_APP_NAME NULL
+#define DEFAULT_NODE_NAME NULL
+#define DEFAULT_NODE_DESCRIPTION NULL
+#define DEFAULT_PROBE_FOR_CAPS TRUE
+#define DEFAULT_TARGET_LATENCY 0
+
+#define LOCK_LATENCY_MUTEX(pw_audio_src) RT_SAFETY_CHECKER_MUTEX_LOCK(&((pw_audio_src)->latency_mutex))
+#define UNLOCK_LATENCY_MUTEX(pw_audio_src) g_mutex_unlock(&((pw_audio_src)->latency_mutex))
+
+/* How long create() waits for a wakeup signal from the process callback
+ * before it checks the capture tap for new data anyway. The process callback
+ * does not lock the capture tap mutex before signaling (it must not block),
+ * so a signal may occasionally be missed. This interval bounds the delay
+ * that such a missed signal can cause. It is kept short, since any such
+ * delay directly adds to the capture latency. */
+#define CAPTURE_TAP_POLL_INTERVAL (5 * G_TIME_SPAN_MILLISECOND)
+
+/* If the stream delay changes by at least this much, a latency
+ * message is posted to let the pipeline recalculate its latency. */
+#define LATENCY_UPDATE_THRESHOLD (GST_MSECOND * 1)
+
+
+struct _GstPwAudioSrc
+{
+	GstPushSrc parent;
+
+	/*< private >*/
+
+	/** Object properties **/
+
+	GstClockTimeDiff alignment_threshold;
+	uint32_t target_object_id;
+	gchar *target_node_name;
+	GstStructure *stream_properties;
+	int socket_fd;
+	guint ring_buffer_length_in_ms;
+	gchar *app_name;
+	gchar *node_name;
+	gchar *node_description;
+	gboolean probe_for_caps;
+	GstClockTime target_latency;
+
+	/** Capture format **/
+
+	GstPwAudioFormat pw_audio_format;
+	gsize stride;
+	GstPwAudioFormatProbe *format_probe;
+	GMutex probe_process_mutex;
+	/* The graph's native PCM rate and channel count, as reported by the
+	 * format probe. These are preferred during caps fixation, since any
+	 * other rate or channel count requires conversion in the graph.
+	 * 0 if not probed (yet). */
+	gint probed_rate;
+	gint probed_channels;
+
+	/** Captured data **/
+
+	/* Transports captured quanta from the process callback to create().
+	 * The process callback is the producer, create() the consumer. */
+	GstPwAudioTap *capture_tap;
+	/* The mutex is only used by the consumer, for waiting on the cond.
+	 * The process callback signals the cond without locking the mutex
+	 * (see CAPTURE_TAP_POLL_INTERVAL). */
+	GMutex capture_tap_mutex;
+	GCond capture_tap_cond;
+	/* Set to 1 in unlock(), and back to 0 in unlock_stop().
+	 * This is a gint, not a gboolean, since it is used by the GLib atomic functions. */
+	gint flushing;
+
+	/** Timestamping **/
+
+	/* Used for checking the captured data for discontinuities, and
+	 * for smoothing out jitter in the captured data timestamps.
+	 * Only accessed by create(), and by change_state() while the
+	 * streaming thread is not producing data. */
+	GstClockTime expected_next_running_time;
+	/* Running count of produced frames. Used for the buffer offsets. */
+	guint64 next_offset;
+
+	/** Latency **/
+
+	/* The latency_mutex synchronizes access to the quantities below. */
+	GMutex latency_mutex;
+	/* How old the first frame of a quantum was when the graph cycle
+	 * started. Measured in every process callback. */
+	GstClockTime stream_delay_in_ns;
+	/* The stream delay that was last reported with a latency message. */
+	GstClockTime reported_stream_delay_in_ns;
+	/* Duration of a graph cycle. Captured data arrives one quantum at a
+	 * time, so this is the minimum latency that capturing can have. */
+	GstClockTime quantum_size_in_ns;
+	/* Set to 1 by the process callback if the stream delay changed
+	 * significantly. create() then posts a latency message. That is
+	 * not done in the process callback itself, since posting a message
+	 * could block that callback for an unpredictable amount of time.
+	 * This is a gint, not a gboolean, since it is used by the GLib atomic functions. */
+	gint notify_about_latency_change;
+
+	/** Snapshots of property values, taken in start() **/
+
+	GstClockTimeDiff alignment_threshold_snapshot;
+	GstClockTime ring_buffer_length_snapshot;
+	GstClockTime target_latency_snapshot;
+
+	/** Element clock **/
+
+	/* Element clock based on the pw_stream. Always available, since it gets timestamps
+	 * from the monotonic system clock and adjusts them according to the pw_stream
+	 * feedback (see the process callback). */
+	GstPwStreamClock *stream_clock;
+	/* True if the stream_clock is set as the pipeline clock.
+	 * Access to this field requires the object lock. */
+	gboolean stream_clock_is_pipeline_clock;
+
+	/** PipeWire specifics **/
+
+	GstPipewireCore *pipewire_core;
+	struct pw_stream *stream;
+	gboolean stream_is_connected;
+	gboolean stream_is_active;
+	/* TRUE while the element is in the PLAYING state. The stream is only
+	 * active while playing, since live sources do not produce data when
+	 * paused. Access to this field requires the pw_thread_loop_lock. */
+	gboolean playing;
+	struct spa_hook stream_listener;
+	gboolean stream_listener_added;
+};
+
+
+struct _GstPwAudioSrcClass
+{
+	GstPushSrcClass parent_class;
+};
+
+
+G_DEFINE_TYPE(GstPwAudioSrc, gst_pw_audio_src, GST_TYPE_PUSH_SRC)
+
+
+static void gst_pw_audio_src_dispose(GObject *object);
+static void gst_pw_audio_src_finalize(GObject *object);
+static void gst_pw_audio_src_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec);
+static void gst_pw_audio_src_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+
+static GstStateChangeReturn gst_pw_audio_src_change_state(GstElement *element, GstStateChange transition);
+static GstClock* gst_pw_audio_src_provide_clock(GstElement *element);
+static gboolean gst_pw_audio_src_set_clock(GstElement *element, GstClock *clock);
+
+static GstCaps* gst_pw_audio_src_get_caps(GstBaseSrc *basesrc, GstCaps *filter);
+static GstCaps* gst_pw_audio_src_fixate(GstBaseSrc *basesrc, GstCaps *caps);
+static gboolean gst_pw_audio_src_set_caps(GstBaseSrc *basesrc, GstCaps *caps);
+static gboolean gst_pw_audio_src_start(GstBaseSrc *basesrc);
+static gboolean gst_pw_audio_src_stop(GstBaseSrc *basesrc);
+static gboolean gst_pw_audio_src_query(GstBaseSrc *basesrc, GstQuery *query);
+static gboolean gst_pw_audio_src_unlock(GstBaseSrc *basesrc);
+static gboolean gst_pw_audio_src_unlock_stop(GstBaseSrc *basesrc);
+
+static GstFlowReturn gst_pw_audio_src_create(GstPushSrc *pushsrc, GstBuffer **buffer);
+
+static void gst_pw_audio_src_probe_graph_format(GstPwAudioSrc *self);
+static void gst_pw_audio_src_activate_stream_unlocked(GstPwAudioSrc *self, gboolean activate);
+static void gst_pw_audio_src_disconnect_stream(GstPwAudioSrc *self);
+static void gst_pw_audio_src_teardown_capture_tap(GstPwAudioSrc *self);
+static void gst_pw_audio_src_timestamp_buffer(GstPwAudioSrc *self, GstBuffer *buffer);
+static GstClockTime gst_pw_audio_src_get_capture_time(GstPwAudioSrc *self, GstClockTimeDiff capture_time_offset);
+
+static void gst_pw_audio_src_pw_state_changed(void *data, enum pw_stream_state old_state, enum pw_stream_state new_state, const char *error);
+static void gst_pw_audio_src_io_changed(void *data, uint32_t id, void *area, uint32_t size);
+static void gst_pw_audio_src_on_process_stream(void *data);
+
+
+static const struct pw_stream_events stream_events =
+{
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = gst_pw_audio_src_pw_state_changed,
+	.io_changed = gst_pw_audio_src_io_changed,
+	.process = gst_pw_audio_src_on_process_stream,
+};
+
+
+
+
+static void gst_pw_audio_src_class_init(GstPwAudioSrcClass *klass)
+{
+	GObjectClass *object_class;
+	GstElementClass *element_class;
+	GstBaseSrcClass *base_src_class;
+	GstPushSrcClass *push_src_class;
+	GstCaps *template_caps;
+
+	GST_DEBUG_CATEGORY_INIT(pw_audio_src_debug, "pwaudiosrc", 0, "PipeWire audio source");
+
+	object_class = G_OBJECT_CLASS(klass);
+	element_class = GST_ELEMENT_CLASS(klass);
+	base_src_class = GST_BASE_SRC_CLASS(klass);
+	push_src_class = GST_PUSH_SRC_CLASS(klass);
+
+	/* Only PCM can be captured. */
+	template_caps = gst_pw_audio_format_get_template_caps_for_type(GST_PIPEWIRE_AUDIO_TYPE_PCM);
+	gst_element_class_add_pad_template(
+		element_class,
+		gst_pad_template_new(
+			"src",
+			GST_PAD_SRC,
+			GST_PAD_ALWAYS,
+			template_caps
+		)
+	);
+	gst_caps_unref(template_caps);
+
+	object_class->dispose      = GST_DEBUG_FUNCPTR(gst_pw_audio_src_dispose);
+	object_class->finalize     = GST_DEBUG_FUNCPTR(gst_pw_audio_src_finalize);
+	object_class->set_property = GST_DEBUG_FUNCPTR(gst_pw_audio_src_set_property);
+	object_class->get_property = GST_DEBUG_FUNCPTR(gst_pw_audio_src_get_property);
+
+	element_class->change_state  = GST_DEBUG_FUNCPTR(gst_pw_audio_src_change_state);
+	element_class->provide_clock = GST_DEBUG_FUNCPTR(gst_pw_audio_src_provide_clock);
+	element_class->set_clock     = GST_DEBUG_FUNCPTR(gst_pw_audio_src_set_clock);
+
+	base_src_class->get_caps    = GST_DEBUG_FUNCPTR(gst_pw_audio_src_get_caps);
+	base_src_class->fixate      = GST_DEBUG_FUNCPTR(gst_pw_audio_src_fixate);
+	base_src_class->set_caps    = GST_DEBUG_FUNCPTR(gst_pw_audio_src_set_caps);
+	base_src_class->start       = GST_DEBUG_FUNCPTR(gst_pw_audio_src_start);
+	base_src_class->stop        = GST_DEBUG_FUNCPTR(gst_pw_audio_src_stop);
+	base_src_class->query       = GST_DEBUG_FUNCPTR(gst_pw_audio_src_query);
+	base_src_class->unlock      = GST_DEBUG_FUNCPTR(gst_pw_audio_src_unlock);
+	base_src_class->unlock_stop = GST_DEBUG_FUNCPTR(gst_pw_audio_src_unlock_stop);
+
+	push_src_class->create = GST_DEBUG_FUNCPTR(gst_pw_audio_src_create);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_ALIGNMENT_THRESHOLD,
+		g_param_spec_int64(
+			"alignment-threshold",
+			"Alignment threshold",
+			"How far apart the timestamps of captured quanta can maximally be from their expected values "
+			"to still be considered continuous, in nanoseconds",
+			0, G_MAXINT64,
+			DEFAULT_ALIGNMENT_THRESHOLD,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_TARGET_OBJECT_ID,
+		g_param_spec_uint(
+			"target-object-id",
+			"Target object ID",
+			"PipeWire target object id to connect to (default = let the PipeWire manager select a target)",
+			0, G_MAXUINT,
+			DEFAULT_TARGET_OBJECT_ID,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_TARGET_NODE_NAME,
+		g_param_spec_string(
+			"target-node-name",
+			"Target node name",
+			"Name of the PipeWire node to connect to; takes precedence over target-object-id if set "
+			"(default = use target-object-id)",
+			DEFAULT_TARGET_NODE_NAME,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_STREAM_PROPERTIES,
+		g_param_spec_boxed(
+			"stream-properties",
+			"Stream properties",
+			"List of PipeWire stream properties to add to this source's client PipeWire node",
+			GST_TYPE_STRUCTURE,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_SOCKET_FD,
+		g_param_spec_int(
+			"socket-fd",
+			"Socket file descriptor",
+			"File descriptor of connected socket to use for communicating with the PipeWire daemon (-1 = open custom internal socket)",
+			-1, G_MAXINT,
+			DEFAULT_SOCKET_FD,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_RING_BUFFER_LENGTH,
+		g_param_spec_uint(
+			"ring-buffer-length",
+			"Ring buffer length",
+			"The length of the ring buffer that holds captured data until it is pushed downstream, in milliseconds "
+			"(if filled to this capacity, newly captured data is dropped)",
+			1, G_MAXUINT,
+			DEFAULT_RING_BUFFER_LENGTH,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_APP_NAME,
+		g_param_spec_string(
+			"app-name",
+			"App name",
+			"Name of the application that uses this source; example: \"Sound Recorder\" (NULL = default)",
+			DEFAULT_APP_NAME,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_NODE_NAME,
+		g_param_spec_string(
+			"node-name",
+			"Node name",
+			"Name to use for this source's client PipeWire node (NULL = default)",
+			DEFAULT_NODE_NAME,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_NODE_DESCRIPTION,
+		g_param_spec_string(
+			"node-description",
+			"Node description",
+			"One-line human readable description of this source's client PipeWire node; example: \"Voice recorder\" (NULL = default)",
+			DEFAULT_NODE_DESCRIPTION,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_PROBE_FOR_CAPS,
+		g_param_spec_boolean(
+			"probe-for-caps",
+			"Probe for caps",
+			"Create a probing stream to figure out the native sample rate and channel count of the capture side "
+			"of the PipeWire graph, and prefer these during caps fixation",
+			DEFAULT_PROBE_FOR_CAPS,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_TARGET_LATENCY,
+		g_param_spec_uint64(
+			"target-latency",
+			"Target latency",
+			"Capture latency to request from the PipeWire graph, in nanoseconds; captured data is pushed downstream "
+			"one quantum at a time, so the lowest possible latency is one quantum (0 = use the graph's quantum)",
+			0, G_MAXUINT64,
+			DEFAULT_TARGET_LATENCY,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	gst_element_class_set_static_metadata(
+		element_class,
+		"pwaudiosrc",
+		"Source/Audio",
+		"Source for capturing audio data from a PipeWire graph",
+		"Carlos Rafael Giani <crg7475@mailbox.org>"
+	);
+}
+
+
+static void gst_pw_audio_src_init(GstPwAudioSrc *self)
+{
+	self->alignment_threshold = DEFAULT_ALIGNMENT_THRESHOLD;
+	self->target_object_id = DEFAULT_TARGET_OBJECT_ID;
+	self->target_node_name = g_strdup(DEFAULT_TARGET_NODE_NAME);
+	self->stream_properties = DEFAULT_STREAM_PROPERTIES;
+	self->socket_fd = DEFAULT_SOCKET_FD;
+	self->ring_buffer_length_in_ms = DEFAULT_RING_BUFFER_LENGTH;
+	self->app_name = g_strdup(DEFAULT_APP_NAME);
+	self->node_name = g_strdup(DEFAULT_NODE_NAME);
+	self->node_description = g_strdup(DEFAULT_NODE_DESCRIPTION);
+	self->probe_for_caps = DEFAULT_PROBE_FOR_CAPS;
+	self->target_latency = DEFAULT_TARGET_LATENCY;
+
+	memset(&(self->pw_audio_format), 0, sizeof(self->pw_audio_format));
+	self->stride = 0;
+	self->format_probe = NULL;
+	g_mutex_init(&(self->probe_process_mutex));
+	self->probed_rate = 0;
+	self->probed_channels = 0;
+
+	self->capture_tap = NULL;
+	g_mutex_init(&(self->capture_tap_mutex));
+	g_cond_init(&(self->capture_tap_cond));
+	self->flushing = 0;
+
+	self->expected_next_running_time = GST_CLOCK_TIME_NONE;
+	self->next_offset = 0;
+
+	g_mutex_init(&(self->latency_mutex));
+	self->stream_delay_in_ns = 0;
+	self->reported_stream_delay_in_ns = 0;
+	self->quantum_size_in_ns = 0;
+	self->notify_about_latency_change = 0;
+
+	self->alignment_threshold_snapshot = 0;
+	self->ring_buffer_length_snapshot = 0;
+	self->target_latency_snapshot = 0;
+
+	self->stream_clock = gst_pw_stream_clock_new(NULL);
+	g_assert(self->stream_clock != NULL);
+	self->stream_clock_is_pipeline_clock = FALSE;
+
+	self->pipewire_core = NULL;
+	self->stream = NULL;
+	self->stream_is_connected = FALSE;
+	self->stream_is_active = FALSE;
+	self->playing = FALSE;
+	self->stream_listener_added = FALSE;
+
+	gst_base_src_set_live(GST_BASE_SRC(self), TRUE);
+	gst_base_src_set_format(GST_BASE_SRC(self), GST_FORMAT_TIME);
+	/* The buffers are timestamped in create(), based on when
+	 * the data was actually captured, not when it was pushed. */
+	gst_base_src_set_do_timestamp(GST_BASE_SRC(self), FALSE);
+
+	GST_OBJECT_FLAG_SET(self, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
+}
+
+
+static void gst_pw_audio_src_dispose(GObject *object)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(object);
+
+	gst_pw_audio_src_teardown_capture_tap(self);
+
+	if (self->stream_clock != NULL)
+	{
+		gst_object_unref(GST_OBJECT(self->stream_clock));
+		self->stream_clock = NULL;
+	}
+
+	G_OBJECT_CLASS(gst_pw_audio_src_parent_class)->dispose(object);
+}
+
+
+static void gst_pw_audio_src_finalize(GObject *object)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(object);
+
+	g_cond_clear(&(self->capture_tap_cond));
+	g_mutex_clear(&(self->capture_tap_mutex));
+	g_mutex_clear(&(self->latency_mutex));
+	g_mutex_clear(&(self->probe_process_mutex));
+
+	g_free(self->node_description);
+	g_free(self->node_name);
+	g_free(self->app_name);
+	g_free(self->target_node_name);
+	if (self->stream_properties != NULL)
+		gst_structure_free(self->stream_properties);
+
+	G_OBJECT_CLASS(gst_pw_audio_src_parent_class)->finalize(object);
+}
+
+
+static void gst_pw_audio_src_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(object);
+
+	switch (prop_id)
+	{
+		case PROP_ALIGNMENT_THRESHOLD:
+			GST_OBJECT_LOCK(self);
+			self->alignment_threshold = g_value_get_int64(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_TARGET_OBJECT_ID:
+			GST_OBJECT_LOCK(self);
+			self->target_object_id = g_value_get_uint(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_TARGET_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_free(self->target_node_name);
+			self->target_node_name = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_STREAM_PROPERTIES:
+		{
+			GstStructure const *new_structure;
+
+			GST_OBJECT_LOCK(self);
+
+			if (self->stream_properties != NULL)
+				gst_structure_free(self->stream_properties);
+
+			new_structure = gst_value_get_structure(value);
+
+			if (new_structure != NULL)
+				self->stream_properties = gst_structure_copy(new_structure);
+			else
+				self->stream_properties = NULL;
+
+			GST_OBJECT_UNLOCK(self);
+
+			break;
+		}
+
+		case PROP_SOCKET_FD:
+			GST_OBJECT_LOCK(self);
+			self->socket_fd = g_value_get_int(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_RING_BUFFER_LENGTH:
+			GST_OBJECT_LOCK(self);
+			self->ring_buffer_length_in_ms = g_value_get_uint(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_APP_NAME:
+			GST_OBJECT_LOCK(self);
+			g_free(self->app_name);
+			self->app_name = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_free(self->node_name);
+			self->node_name = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_NODE_DESCRIPTION:
+			GST_OBJECT_LOCK(self);
+			g_free(self->node_description);
+			self->node_description = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_PROBE_FOR_CAPS:
+			GST_OBJECT_LOCK(self);
+			self->probe_for_caps = g_value_get_boolean(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_TARGET_LATENCY:
+			GST_OBJECT_LOCK(self);
+			self->target_latency = g_value_get_uint64(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+static void gst_pw_audio_src_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(object);
+
+	switch (prop_id)
+	{
+		case PROP_ALIGNMENT_THRESHOLD:
+			GST_OBJECT_LOCK(self);
+			g_value_set_int64(value, self->alignment_threshold);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_TARGET_OBJECT_ID:
+			GST_OBJECT_LOCK(self);
+			g_value_set_uint(value, self->target_object_id);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_TARGET_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->target_node_name);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_STREAM_PROPERTIES:
+			GST_OBJECT_LOCK(self);
+			gst_value_set_structure(value, self->stream_properties);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_SOCKET_FD:
+			GST_OBJECT_LOCK(self);
+			g_value_set_int(value, self->socket_fd);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_RING_BUFFER_LENGTH:
+			GST_OBJECT_LOCK(self);
+			g_value_set_uint(value, self->ring_buffer_length_in_ms);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_APP_NAME:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->app_name);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->node_name);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_NODE_DESCRIPTION:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->node_description);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_PROBE_FOR_CAPS:
+			GST_OBJECT_LOCK(self);
+			g_value_set_boolean(value, self->probe_for_caps);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_TARGET_LATENCY:
+			GST_OBJECT_LOCK(self);
+			g_value_set_uint64(value, self->target_latency);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+static GstStateChangeReturn gst_pw_audio_src_change_state(GstElement *element, GstStateChange transition)
+{
+	GstStateChangeReturn result;
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(element);
+
+	switch (transition)
+	{
+		/* Live sources only produce data in the PLAYING state,
+		 * so the stream is only active in that state. Otherwise,
+		 * data would pile up in the capture tap while paused. */
+
+		case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+			GST_DEBUG_OBJECT(self, "deactivating stream (if not already inactive) before PLAYING->PAUSED state change");
+
+			pw_thread_loop_lock(self->pipewire_core->loop);
+			self->playing = FALSE;
+			gst_pw_audio_src_activate_stream_unlocked(self, FALSE);
+			pw_thread_loop_unlock(self->pipewire_core->loop);
+
+			break;
+
+		case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+			GST_DEBUG_OBJECT(self, "activating stream (if not already active) before PAUSED->PLAYING state change");
+
+			pw_thread_loop_lock(self->pipewire_core->loop);
+			self->playing = TRUE;
+			gst_pw_audio_src_activate_stream_unlocked(self, TRUE);
+			pw_thread_loop_unlock(self->pipewire_core->loop);
+
+			break;
+
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+			/* Cancel any gst_pw_audio_format_probe_probe_audio_type()
+			 * call that is running inside fixate(). */
+			gst_pw_audio_format_probe_cancel(self->format_probe);
+			break;
+
+		default:
+			break;
+	}
+
+	result = GST_ELEMENT_CLASS(gst_pw_audio_src_parent_class)->change_state(element, transition);
+
+	GST_DEBUG_OBJECT(
+		self,
+		"state change %s result: %s",
+		gst_state_change_get_name(transition),
+		gst_element_state_change_return_get_name(result)
+	);
+
+	switch (transition)
+	{
+		case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+			/* Freeze the stream clock to bridge the gap caused by the pause.
+			 * See gst_pw_audio_sink_change_state() for the details. */
+			gst_pw_stream_clock_freeze(self->stream_clock);
+			break;
+
+		default:
+			break;
+	}
+
+	return result;
+}
+
+
+static GstClock* gst_pw_audio_src_provide_clock(GstElement *element)
+{
+	GstClock *clock = NULL;
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(element);
+
+	GST_OBJECT_LOCK(self);
+	clock = GST_CLOCK_CAST(gst_object_ref(self->stream_clock));
+	GST_OBJECT_UNLOCK(self);
+
+	return clock;
+}
+
+
+static gboolean gst_pw_audio_src_set_clock(GstElement *element, GstClock *clock)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(element);
+
+	GST_OBJECT_LOCK(self);
+	self->stream_clock_is_pipeline_clock = (clock == GST_CLOCK_CAST(self->stream_clock));
+	GST_OBJECT_UNLOCK(self);
+
+	GST_DEBUG_OBJECT(
+		self,
+		"pipeline is setting clock %" GST_PTR_FORMAT " as the element's clock; is the PW stream clock %" GST_PTR_FORMAT ": %d",
+		(gpointer)clock,
+		(gpointer)(self->stream_clock),
+		self->stream_clock_is_pipeline_clock
+	);
+
+	return GST_ELEMENT_CLASS(gst_pw_audio_src_parent_class)->set_clock(element, clock);
+}
+
+
+static GstCaps* gst_pw_audio_src_get_caps(GstBaseSrc *basesrc, GstCaps *filter)
+{
+	GstCaps *available_srccaps = gst_pw_audio_format_get_template_caps_for_type(GST_PIPEWIRE_AUDIO_TYPE_PCM);
+
+	if (filter != NULL)
+	{
+		GstCaps *unfiltered_available_srccaps = available_srccaps;
+		available_srccaps = gst_caps_intersect_full(filter, available_srccaps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(unfiltered_available_srccaps);
+	}
+
+	GST_DEBUG_OBJECT(basesrc, "responding to caps query with caps %" GST_PTR_FORMAT, (gpointer)available_srccaps);
+
+	return available_srccaps;
+}
+
+
+static GstCaps* gst_pw_audio_src_fixate(GstBaseSrc *basesrc, GstCaps *caps)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(basesrc);
+	gint probed_rate, probed_channels;
+
+	gst_pw_audio_src_probe_graph_format(self);
+
+	GST_OBJECT_LOCK(self);
+	probed_rate = self->probed_rate;
+	probed_channels = self->probed_channels;
+	GST_OBJECT_UNLOCK(self);
+
+	/* Prefer the graph's native rate and channel count, since these can be
+	 * captured without any conversion. Fields that are already fixed (for
+	 * example by a capsfilter downstream) are not touched by this. Anything
+	 * that remains unfixated afterwards is taken care of by the generic
+	 * PipeWire audio caps fixation. */
+	if ((probed_rate > 0) && (probed_channels > 0) && !gst_caps_is_empty(caps))
+	{
+		GstStructure *s;
+
+		caps = gst_caps_make_writable(caps);
+		s = gst_caps_get_structure(caps, 0);
+
+		gst_structure_fixate_field_nearest_int(s, "rate", probed_rate);
+		gst_structure_fixate_field_nearest_int(s, "channels", probed_channels);
+	}
+
+	caps = gst_pw_audio_format_fixate_caps(caps);
+	return GST_BASE_SRC_CLASS(gst_pw_audio_src_parent_class)->fixate(basesrc, caps);
+}
+
+
+static gboolean gst_pw_audio_src_set_caps(GstBaseSrc *basesrc, GstCaps *caps)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(basesrc);
+	gboolean ret = TRUE;
+	struct spa_pod const *params[1];
+	enum pw_stream_state state;
+	char const *error_str = NULL;
+	uint32_t target_object_id;
+	gchar *target_node_name = NULL;
+	gboolean pw_thread_loop_locked = FALSE;
+	guint8 builder_buffer[1024];
+
+	GST_DEBUG_OBJECT(self, "got new src caps %" GST_PTR_FORMAT, (gpointer)caps);
+
+	gst_pw_audio_src_disconnect_stream(self);
+
+	/* Freeze the clock _after_ disconnecting. Otherwise, the process
+	 * callback could update the clock after it was frozen. */
+	gst_pw_stream_clock_freeze(self->stream_clock);
+
+	/* After disconnecting we remove the listener if it was previously added.
+	 * This is important, otherwise the stream accumulates listeners -
+	 * we only want one to be in use. */
+	if (self->stream_listener_added)
+	{
+		spa_hook_remove(&(self->stream_listener));
+		self->stream_listener_added = FALSE;
+	}
+
+	/* The stream is disconnected, so the process callback
+	 * cannot access the capture tap anymore at this point. */
+	gst_pw_audio_src_teardown_capture_tap(self);
+
+	if (!gst_pw_audio_format_from_caps(&(self->pw_audio_format), GST_OBJECT_CAST(self), caps))
+		goto error;
+
+	if (G_UNLIKELY(self->pw_audio_format.audio_type != GST_PIPEWIRE_AUDIO_TYPE_PCM))
+	{
+		GST_ERROR_OBJECT(self, "only PCM audio can be captured");
+		goto error;
+	}
+
+	if (!gst_pw_audio_format_to_spa_pod(&(self->pw_audio_format), GST_OBJECT_CAST(self), builder_buffer, sizeof(builder_buffer), params))
+		goto error;
+
+	self->stride = gst_pw_audio_format_get_stride(&(self->pw_audio_format));
+
+	/* Reserve some extra room for the per-quantum headers in the tap. */
+	{
+		gsize capacity;
+
+		capacity = gst_pw_audio_format_calculate_num_frames_from_duration(&(self->pw_audio_format), self->ring_buffer_length_snapshot) * self->stride;
+		capacity += capacity / 4;
+
+		self->capture_tap = gst_pw_audio_tap_new(capacity);
+		if (G_UNLIKELY(self->capture_tap == NULL))
+		{
+			GST_ERROR_OBJECT(self, "could not create capture tap");
+			goto error;
+		}
+	}
+
+	/* Get GObject property values. */
+	GST_OBJECT_LOCK(self);
+	target_object_id = self->target_object_id;
+	target_node_name = g_strdup(self->target_node_name);
+	GST_OBJECT_UNLOCK(self);
+
+	/* A target node name takes precedence over the target object ID.
+	 * It is passed to the session manager as the target.object property,
+	 * so the stream itself must not be connected to a specific ID. */
+	if (target_node_name != NULL)
+		target_object_id = PW_ID_ANY;
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+	pw_thread_loop_locked = TRUE;
+
+	state = pw_stream_get_state(self->stream, &error_str);
+	if (state == PW_STREAM_STATE_ERROR)
+	{
+		GST_ERROR_OBJECT(self, "cannot start stream - PW stream is in an error state: %s", error_str);
+		goto error;
+	}
+
+	pw_stream_add_listener(
+		self->stream,
+		&(self->stream_listener),
+		&stream_events,
+		self
+	);
+	self->stream_listener_added = TRUE;
+
+	/* Request the target latency (if any) as the node latency. The graph
+	 * picks its quantum based on the node latencies of its nodes, so this
+	 * is what makes capture latencies of less than the default quantum
+	 * possible. Also set the target node name if one is configured.
+	 * Do this before connecting to not cause unnecessary reconfigurations. */
+	{
+		gchar *latency_str = NULL;
+		struct spa_dict_item items[2];
+		int num_populated_items = 0;
+
+		if (self->target_latency_snapshot > 0)
+		{
+			gint rate = GST_AUDIO_INFO_RATE(&(self->pw_audio_format.info.pcm_audio_info));
+			guint64 latency_in_frames = gst_util_uint64_scale_int(self->target_latency_snapshot, rate, GST_SECOND);
+
+			latency_str = g_strdup_printf("%" G_GUINT64_FORMAT "/%d", MAX(latency_in_frames, 1), rate);
+			GST_DEBUG_OBJECT(self, "setting the node.latency property to \"%s\"", latency_str);
+		}
+
+		items[num_populated_items++] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_LATENCY, latency_str);
+
+		if (target_node_name != NULL)
+		{
+			GST_DEBUG_OBJECT(self, "setting the target.object property to \"%s\"", target_node_name);
+			items[num_populated_items++] = SPA_DICT_ITEM_INIT(PW_KEY_TARGET_OBJECT, target_node_name);
+		}
+
+		pw_stream_update_properties(self->stream, &SPA_DICT_INIT(items, num_populated_items));
+
+		g_free(latency_str);
+	}
+
+	/* Pick the stream connection flags.
+	 *
+	 * - PW_STREAM_FLAG_AUTOCONNECT to tell the session manager to link this client to a producer.
+	 * - PW_STREAM_FLAG_MAP_BUFFERS to not have to memory-map PW buffers manually.
+	 * - PW_STREAM_FLAG_INACTIVE since the stream shall only run while the element is PLAYING.
+	 * - PW_STREAM_FLAG_RT_PROCESS to force the process stream event to be called in the same thread
+	 *   that does the processing in the PipeWire graph. This avoids an extra thread hop, which
+	 *   would otherwise add latency, and makes the pw_time values refer to the current cycle.
+	 */
+	pw_stream_connect(
+		self->stream,
+		PW_DIRECTION_INPUT,
+		target_object_id,
+		PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS | PW_STREAM_FLAG_INACTIVE | PW_STREAM_FLAG_RT_PROCESS,
+		params, 1
+	);
+
+	state = pw_stream_get_state(self->stream, &error_str);
+	if (state == PW_STREAM_STATE_ERROR)
+	{
+		GST_ERROR_OBJECT(self, "cannot start stream - PW stream is in an error state: %s", error_str);
+		goto error;
+	}
+
+	self->stream_is_connected = TRUE;
+
+	/* Caps may also be set while already playing (when renegotiating). */
+	if (self->playing)
+		gst_pw_audio_src_activate_stream_unlocked(self, TRUE);
+
+finish:
+	if (pw_thread_loop_locked)
+		pw_thread_loop_unlock(self->pipewire_core->loop);
+	g_free(target_node_name);
+	return ret;
+
+error:
+	ret = FALSE;
+	goto finish;
+}
+
+
+static gboolean copy_stream_properties_to_pw_props(GQuark field_id, GValue const *value, gpointer data)
+{
+	struct pw_properties *pw_props = (struct pw_properties *)data;
+	GValue stringified_gvalue = G_VALUE_INIT;
+
+	if (g_value_type_transformable(G_VALUE_TYPE(value), G_TYPE_STRING))
+	{
+		g_value_init(&stringified_gvalue, G_TYPE_STRING);
+
+		if (g_value_transform(value, &stringified_gvalue))
+			pw_properties_set(pw_props, g_quark_to_string(field_id), g_value_get_string(&stringified_gvalue));
+
+		g_value_unset(&stringified_gvalue);
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_pw_audio_src_start(GstBaseSrc *basesrc)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(basesrc);
+	gboolean retval = TRUE;
+	int socket_fd;
+	struct pw_properties *pw_props;
+	gchar *stream_media_name = NULL;
+
+	GST_OBJECT_LOCK(self);
+
+	/* Get GObject property values. */
+	socket_fd = self->socket_fd;
+	self->alignment_threshold_snapshot = self->alignment_threshold;
+	self->ring_buffer_length_snapshot = self->ring_buffer_length_in_ms * GST_MSECOND;
+	self->target_latency_snapshot = self->target_latency;
+
+	self->pipewire_core = gst_pipewire_core_get(socket_fd);
+
+	GST_OBJECT_UNLOCK(self);
+
+	if (G_UNLIKELY(self->pipewire_core == NULL))
+	{
+		GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ_WRITE, ("Could not get PipeWire core"), (NULL));
+		goto error;
+	}
+
+	self->format_probe = gst_pw_audio_format_probe_new_for_capture(self->pipewire_core);
+
+	GST_DEBUG_OBJECT(self, "creating new PipeWire stream");
+
+	pw_props = pw_properties_new(
+		PW_KEY_MEDIA_TYPE, "Audio",
+		PW_KEY_MEDIA_CATEGORY, "Capture",
+		NULL
+	);
+
+	GST_OBJECT_LOCK(self);
+
+	if (self->app_name != NULL)
+	{
+		pw_properties_set(pw_props, PW_KEY_APP_NAME, self->app_name);
+		GST_DEBUG_OBJECT(self, "app name for the new PipeWire stream: %s", self->app_name);
+	}
+
+	if (self->node_name != NULL)
+	{
+		pw_properties_set(pw_props, PW_KEY_NODE_NAME, self->node_name);
+		GST_DEBUG_OBJECT(self, "node name for the new PipeWire stream: %s", self->node_name);
+	}
+
+	if (self->node_description != NULL)
+	{
+		pw_properties_set(pw_props, PW_KEY_NODE_DESCRIPTION, self->node_description);
+		GST_DEBUG_OBJECT(self, "node description for the new PipeWire stream: %s", self->node_description);
+	}
+
+	if (self->stream_properties != NULL)
+	{
+		gst_structure_foreach(self->stream_properties, copy_stream_properties_to_pw_props, pw_props);
+		GST_DEBUG_OBJECT(self, "extra properties for the new PipeWire stream: %" GST_PTR_FORMAT, (gpointer)(self->stream_properties));
+	}
+
+	/* Reuse the node name as the stream name. */
+	stream_media_name = g_strdup(self->node_name);
+
+	GST_OBJECT_UNLOCK(self);
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+	self->stream = pw_stream_new(self->pipewire_core->core, stream_media_name, pw_props);
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+	if (G_UNLIKELY(self->stream == NULL))
+	{
+		GST_ERROR_OBJECT(self, "could not create PipeWire stream");
+		goto error;
+	}
+
+	GST_DEBUG_OBJECT(self, "PipeWire stream successfully created");
+
+finish:
+	g_free(stream_media_name);
+	return retval;
+
+error:
+	gst_pw_audio_src_stop(basesrc);
+	retval = FALSE;
+	goto finish;
+}
+
+
+static gboolean gst_pw_audio_src_stop(GstBaseSrc *basesrc)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(basesrc);
+	gboolean stream_clock_is_pipeline_clock;
+
+	if (self->stream != NULL)
+	{
+		GST_DEBUG_OBJECT(self, "disconnecting and destroying PipeWire stream");
+		gst_pw_audio_src_disconnect_stream(self);
+
+		pw_thread_loop_lock(self->pipewire_core->loop);
+		pw_stream_destroy(self->stream);
+		pw_thread_loop_unlock(self->pipewire_core->loop);
+
+		self->stream = NULL;
+	}
+
+	/* Perform these teardown steps with the probe_process_mutex
+	 * locked, since fixate() may access the same resources. */
+	{
+		g_mutex_lock(&(self->probe_process_mutex));
+
+		if (self->format_probe != NULL)
+		{
+			gst_pw_audio_format_probe_teardown(self->format_probe);
+			gst_object_unref(GST_OBJECT(self->format_probe));
+			self->format_probe = NULL;
+		}
+
+		if (self->pipewire_core != NULL)
+		{
+			GST_DEBUG_OBJECT(self, "releasing PipeWire core");
+			gst_pipewire_core_release(self->pipewire_core);
+			self->pipewire_core = NULL;
+		}
+
+		g_mutex_unlock(&(self->probe_process_mutex));
+	}
+
+	gst_pw_audio_src_teardown_capture_tap(self);
+
+	GST_OBJECT_LOCK(self);
+	stream_clock_is_pipeline_clock = self->stream_clock_is_pipeline_clock;
+	self->stream_clock_is_pipeline_clock = FALSE;
+	self->probed_rate = 0;
+	self->probed_channels = 0;
+	GST_OBJECT_UNLOCK(self);
+
+	/* Recreate the stream clock. This is the only way
+	 * to fully reset _all_ internal states, including
+	 * the states of the clock base classes. */
+	if (self->stream_clock != NULL)
+	{
+		/* Announce to the pipeline that the previous clock
+		 * is lost and not valid anymore. See the equivalent
+		 * code in gst_pw_audio_sink_stop() for details. */
+		if (stream_clock_is_pipeline_clock)
+		{
+			gst_element_post_message(
+				GST_ELEMENT_CAST(self),
+				gst_message_new_clock_lost(
+					GST_OBJECT_CAST(self),
+					GST_CLOCK_CAST(self->stream_clock)
+				)
+			);
+		}
+
+		gst_object_unref(GST_OBJECT(self->stream_clock));
+		self->stream_clock = gst_pw_stream_clock_new(NULL);
+		g_assert(self->stream_clock != NULL);
+	}
+
+	self->flushing = 0;
+	self->expected_next_running_time = GST_CLOCK_TIME_NONE;
+	self->next_offset = 0;
+	self->stream_delay_in_ns = 0;
+	self->reported_stream_delay_in_ns = 0;
+	self->quantum_size_in_ns = 0;
+	self->notify_about_latency_change = 0;
+	self->alignment_threshold_snapshot = 0;
+	self->ring_buffer_length_snapshot = 0;
+	self->target_latency_snapshot = 0;
+	self->stream_listener_added = FALSE;
+	self->playing = FALSE;
+
+	return TRUE;
+}
+
+
+static gboolean gst_pw_audio_src_query(GstBaseSrc *basesrc, GstQuery *query)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(basesrc);
+
+	switch (GST_QUERY_TYPE(query))
+	{
+		case GST_QUERY_LATENCY:
+		{
+			GstClockTime min_latency, max_latency;
+
+			/* Captured data is pushed downstream one quantum at a time, and the
+			 * timestamp of each buffer is the capture time of its first frame.
+			 * That first frame is therefore always at least one quantum plus the
+			 * stream delay old by the time the buffer is pushed. If the quantum
+			 * size is not known yet, use the target latency as an estimate.
+			 * Up to one ring buffer's worth of data can be held back before
+			 * data is dropped, so that is the additional maximum latency. */
+
+			LOCK_LATENCY_MUTEX(self);
+			min_latency = ((self->quantum_size_in_ns > 0) ? self->quantum_size_in_ns : self->target_latency_snapshot) + self->stream_delay_in_ns;
+			UNLOCK_LATENCY_MUTEX(self);
+
+			max_latency = min_latency + self->ring_buffer_length_snapshot;
+
+			GST_DEBUG_OBJECT(
+				self,
+				"responding to latency query:  min/max latency: %" GST_TIME_FORMAT "/%" GST_TIME_FORMAT,
+				GST_TIME_ARGS(min_latency), GST_TIME_ARGS(max_latency)
+			);
+
+			gst_query_set_latency(query, TRUE, min_latency, max_latency);
+
+			return TRUE;
+		}
+
+		default:
+			return GST_BASE_SRC_CLASS(gst_pw_audio_src_parent_class)->query(basesrc, query);
+	}
+}
+
+
+static gboolean gst_pw_audio_src_unlock(GstBaseSrc *basesrc)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(basesrc);
+
+	GST_DEBUG_OBJECT(self, "unlocking create()");
+
+	g_mutex_lock(&(self->capture_tap_mutex));
+	g_atomic_int_set(&(self->flushing), 1);
+	g_cond_broadcast(&(self->capture_tap_cond));
+	g_mutex_unlock(&(self->capture_tap_mutex));
+
+	return TRUE;
+}
+
+
+static gboolean gst_pw_audio_src_unlock_stop(GstBaseSrc *basesrc)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(basesrc);
+
+	GST_DEBUG_OBJECT(self, "stopping unlock");
+
+	g_mutex_lock(&(self->capture_tap_mutex));
+	g_atomic_int_set(&(self->flushing), 0);
+	g_mutex_unlock(&(self->capture_tap_mutex));
+
+	return TRUE;
+}
+
+
+static GstFlowReturn gst_pw_audio_src_create(GstPushSrc *pushsrc, GstBuffer **buffer)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC(pushsrc);
+	GstBuffer *captured_buffer = NULL;
+
+	if (G_UNLIKELY(self->capture_tap == NULL))
+	{
+		GST_ERROR_OBJECT(self, "no capture tap present; caps were not set");
+		return GST_FLOW_NOT_NEGOTIATED;
+	}
+
+	if (g_atomic_int_compare_and_exchange(&(self->notify_about_latency_change), 1, 0))
+	{
+		GST_DEBUG_OBJECT(self, "stream delay changed significantly; posting latency message");
+		gst_element_post_message(GST_ELEMENT_CAST(self), gst_message_new_latency(GST_OBJECT_CAST(self)));
+	}
+
+	g_mutex_lock(&(self->capture_tap_mutex));
+
+	while (TRUE)
+	{
+		if (g_atomic_int_get(&(self->flushing)))
+		{
+			g_mutex_unlock(&(self->capture_tap_mutex));
+			GST_DEBUG_OBJECT(self, "flushing");
+			return GST_FLOW_FLUSHING;
+		}
+
+		captured_buffer = gst_pw_audio_tap_read(self->capture_tap);
+		if (captured_buffer != NULL)
+			break;
+
+		g_cond_wait_until(&(self->capture_tap_cond), &(self->capture_tap_mutex), g_get_monotonic_time() + CAPTURE_TAP_POLL_INTERVAL);
+	}
+
+	g_mutex_unlock(&(self->capture_tap_mutex));
+
+	gst_pw_audio_src_timestamp_buffer(self, captured_buffer);
+
+	*buffer = captured_buffer;
+	return GST_FLOW_OK;
+}
+
+
+static void gst_pw_audio_src_probe_graph_format(GstPwAudioSrc *self)
+{
+	gboolean probe_for_caps;
+	uint32_t target_object_id;
+	GstPwAudioFormat *probed_details = NULL;
+	GstPwAudioFormatProbeResult probing_result;
+
+	GST_OBJECT_LOCK(self);
+	probe_for_caps = self->probe_for_caps;
+	target_object_id = self->target_object_id;
+	GST_OBJECT_UNLOCK(self);
+
+	if (!probe_for_caps)
+		return;
+
+	/* Do not let probing attempts run concurrently. See
+	 * gst_pw_audio_sink_get_caps() for details. */
+	g_mutex_lock(&(self->probe_process_mutex));
+
+	/* The graph format is only probed once after the element started. */
+	if ((self->format_probe == NULL) || (self->probed_rate > 0))
+		goto finish;
+
+	GST_DEBUG_OBJECT(self, "probing PipeWire graph for its native capture format");
+
+	gst_pw_audio_format_probe_setup(self->format_probe);
+	probing_result = gst_pw_audio_format_probe_probe_audio_type(
+		self->format_probe,
+		GST_PIPEWIRE_AUDIO_TYPE_PCM,
+		target_object_id,
+		&probed_details
+	);
+	gst_pw_audio_format_probe_teardown(self->format_probe);
+
+	if ((probing_result == GST_PW_AUDIO_FORMAT_PROBE_RESULT_SUPPORTED) && (probed_details != NULL))
+	{
+		GST_OBJECT_LOCK(self);
+		self->probed_rate = GST_AUDIO_INFO_RATE(&(probed_details->info.pcm_audio_info));
+		self->probed_channels = GST_AUDIO_INFO_CHANNELS(&(probed_details->info.pcm_audio_info));
+		GST_OBJECT_UNLOCK(self);
+
+		GST_DEBUG_OBJECT(self, "probed native capture format:  rate: %d  channels: %d", self->probed_rate, self->probed_channels);
+	}
+	else
+		GST_DEBUG_OBJECT(self, "could not probe native capture format; using default caps fixation");
+
+finish:
+	g_mutex_unlock(&(self->probe_process_mutex));
+}
+
+
+static void gst_pw_audio_src_activate_stream_unlocked(GstPwAudioSrc *self, gboolean activate)
+{
+	/* This must be called with the pw_thread_loop_lock taken. */
+
+	if (!self->stream_is_connected || (self->stream_is_active == activate))
+		return;
+
+	/* Discard any data that is left over from before the stream was
+	 * last deactivated, since it is stale by now. This is done _before_
+	 * activating, since the process callback must not be running while
+	 * the tap is flushed. create() is not running either at this point,
+	 * since live sources do not produce data until they are PLAYING.
+	 * Also start timestamping afresh, since the base-time is different. */
+	if (activate)
+	{
+		gst_pw_audio_tap_flush(self->capture_tap);
+		self->expected_next_running_time = GST_CLOCK_TIME_NONE;
+	}
+
+	pw_stream_set_active(self->stream, activate);
+	GST_DEBUG_OBJECT(self, "%s PipeWire stream", activate ? "activating" : "deactivating");
+
+	self->stream_is_active = activate;
+}
+
+
+static void gst_pw_audio_src_disconnect_stream(GstPwAudioSrc *self)
+{
+	if (!self->stream_is_connected)
+		return;
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+	gst_pw_audio_src_activate_stream_unlocked(self, FALSE);
+	pw_stream_disconnect(self->stream);
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+
+	self->stream_is_connected = FALSE;
+}
+
+
+static void gst_pw_audio_src_teardown_capture_tap(GstPwAudioSrc *self)
+{
+	/* This must not be called while the process callback
+	 * may still be running, since it accesses capture_tap. */
+
+	if (self->capture_tap != NULL)
+	{
+		GST_DEBUG_OBJECT(self, "tearing down capture tap; %u quantum/quanta were dropped", gst_pw_audio_tap_get_num_dropped_blocks(self->capture_tap));
+		gst_object_unref(GST_OBJECT(self->capture_tap));
+		self->capture_tap = NULL;
+	}
+}
+
+
+static void gst_pw_audio_src_timestamp_buffer(GstPwAudioSrc *self, GstBuffer *buffer)
+{
+	GstClockTime capture_time, base_time, running_time;
+	guint64 num_frames;
+
+	num_frames = gst_buffer_get_size(buffer) / self->stride;
+
+	/* The tap contains pipeline clock times. Translate them to running times. */
+	capture_time = GST_BUFFER_PTS(buffer);
+	base_time = gst_element_get_base_time(GST_ELEMENT_CAST(self));
+	if (GST_CLOCK_TIME_IS_VALID(capture_time) && (capture_time >= base_time))
+		running_time = capture_time - base_time;
+	else
+		running_time = GST_CLOCK_TIME_NONE;
+
+	/* The capture times contain jitter, since they are derived from the moments
+	 * the graph cycles started, and those moments vary somewhat. If a buffer's
+	 * timestamp is close enough to where the previous buffer ended, the data is
+	 * considered continuous, and the expected timestamp is used instead. If the
+	 * data was not continuous anyway, because the tap dropped quanta (which is
+	 * indicated by the DISCONT flag), resynchronize to the capture time. */
+	if (GST_CLOCK_TIME_IS_VALID(self->expected_next_running_time) && !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT))
+	{
+		if (GST_CLOCK_TIME_IS_VALID(running_time))
+		{
+			GstClockTimeDiff deviation = GST_CLOCK_DIFF(self->expected_next_running_time, running_time);
+
+			if (ABS(deviation) <= self->alignment_threshold_snapshot)
+			{
+				running_time = self->expected_next_running_time;
+			}
+			else
+			{
+				GST_DEBUG_OBJECT(
+					self,
+					"captured data deviates from expected timestamp by %" G_GINT64_FORMAT " ns; resynchronizing",
+					deviation
+				);
+				GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+			}
+		}
+		else
+			running_time = self->expected_next_running_time;
+	}
+
+	GST_BUFFER_PTS(buffer) = running_time;
+	GST_BUFFER_DTS(buffer) = GST_CLOCK_TIME_NONE;
+	GST_BUFFER_OFFSET(buffer) = self->next_offset;
+	GST_BUFFER_OFFSET_END(buffer) = self->next_offset + num_frames;
+
+	self->next_offset += num_frames;
+	self->expected_next_running_time = GST_CLOCK_TIME_IS_VALID(running_time) ? (running_time + GST_BUFFER_DURATION(buffer)) : GST_CLOCK_TIME_NONE;
+
+	GST_LOG_OBJECT(
+		self,
+		"pushing captured buffer:  running time: %" GST_TIME_FORMAT "  duration: %" GST_TIME_FORMAT "  num frames: %" G_GUINT64_FORMAT "  discont: %d",
+		GST_TIME_ARGS(running_time),
+		GST_TIME_ARGS(GST_BUFFER_DURATION(buffer)),
+		num_frames,
+		GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT)
+	);
+}
+
+
+static GstClockTime gst_pw_audio_src_get_capture_time(GstPwAudioSrc *self, GstClockTimeDiff capture_time_offset)
+{
+	/* Returns the pipeline clock time that lies capture_time_offset
+	 * nanoseconds in the future (or past, if the offset is negative),
+	 * or GST_CLOCK_TIME_NONE if there is no clock. */
+
+	GstClock *clock;
+	GstClockTime now;
+
+	clock = GST_ELEMENT_CLOCK(self);
+	if (G_UNLIKELY(clock == NULL))
+		return GST_CLOCK_TIME_NONE;
+
+	now = gst_clock_get_time(clock);
+	if ((capture_time_offset < 0) && (now < (GstClockTime)(-capture_time_offset)))
+		return GST_CLOCK_TIME_NONE;
+
+	return now + capture_time_offset;
+}
+
+
+static void gst_pw_audio_src_pw_state_changed(void *data, enum pw_stream_state old_state, enum pw_stream_state new_state, const char *error)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC_CAST(data);
+
+	GST_DEBUG_OBJECT(
+		self,
+		"PipeWire state changed:  old: %s  new: %s  error: \"%s\"",
+		pw_stream_state_as_string(old_state),
+		pw_stream_state_as_string(new_state),
+		(error == NULL) ? "<none>" : error
+	);
+
+	if (new_state == PW_STREAM_STATE_ERROR)
+		GST_ELEMENT_ERROR(self, RESOURCE, READ, ("PipeWire stream error"), ("%s", (error == NULL) ? "<unknown>" : error));
+}
+
+
+static void gst_pw_audio_src_io_changed(void *data, uint32_t id, void *area, G_GNUC_UNUSED uint32_t size)
+{
+	GstPwAudioSrc *self = GST_PW_AUDIO_SRC_CAST(data);
+
+	switch (id)
+	{
+		case SPA_IO_Position:
+		{
+			struct spa_io_position *spa_position = (struct spa_io_position *)area;
+			GstClockTime quantum_size_in_ns;
+
+			if ((spa_position == NULL) || (spa_position->clock.rate.denom == 0))
+				break;
+
+			quantum_size_in_ns = gst_util_uint64_scale_int(
+				spa_position->clock.duration * spa_position->clock.rate.num,
+				GST_SECOND,
+				spa_position->clock.rate.denom
+			);
+
+			LOCK_LATENCY_MUTEX(self);
+			self->quantum_size_in_ns = quantum_size_in_ns;
+			UNLOCK_LATENCY_MUTEX(self);
+
+			GST_DEBUG_OBJECT(self, "got new SPA IO position;  quantum size: %" GST_TIME_FORMAT, GST_TIME_ARGS(quantum_size_in_ns));
+
+			/* A different quantum size changes the latency. */
+			g_atomic_int_set(&(self->notify_about_latency_change), 1);
+
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+
+static void gst_pw_audio_src_process_stream(GstPwAudioSrc *self)
+{
+	/* NOTE: This runs in the PipeWire realtime thread. Do not allocate
+	 * memory, and do not block in here. Anything that is not strictly
+	 * necessary for getting the captured data out is done in create(). */
+
+	struct pw_time stream_time;
+	struct pw_buffer *pw_buf;
+	struct spa_data *inner_spa_data;
+	gint64 stream_delay_in_ns = 0;
+	gint64 time_since_cycle_start;
+	guint32 offset, num_bytes;
+	guint64 num_frames;
+	GstClockTime capture_time;
+
+	/* pw_stream_get_time() is deprecated since version 0.3.50. */
+#if PW_CHECK_VERSION(0, 3, 50)
+	pw_stream_get_time_n(self->stream, &stream_time, sizeof(stream_time));
+#else
+	pw_stream_get_time(self->stream, &stream_time);
+#endif
+
+	gst_pw_stream_clock_add_observation(self->stream_clock, &stream_time);
+
+	/* For capture streams, the delay is the time that passed between
+	 * the capture of the first frame of this cycle's data and the
+	 * beginning of this cycle (which is at stream_time.now). */
+	if ((stream_time.rate.denom != 0) && (stream_time.delay > 0))
+	{
+		stream_delay_in_ns = gst_util_uint64_scale_int(
+			stream_time.delay * stream_time.rate.num,
+			GST_SECOND,
+			stream_time.rate.denom
+		);
+	}
+
+	LOCK_LATENCY_MUTEX(self);
+	self->stream_delay_in_ns = stream_delay_in_ns;
+	if (ABS((gint64)(self->reported_stream_delay_in_ns) - stream_delay_in_ns) >= (gint64)LATENCY_UPDATE_THRESHOLD)
+	{
+		self->reported_stream_delay_in_ns = stream_delay_in_ns;
+		g_atomic_int_set(&(self->notify_about_latency_change), 1);
+	}
+	UNLOCK_LATENCY_MUTEX(self);
+
+	{
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		time_since_cycle_start = SPA_TIMESPEC_TO_NSEC(&ts) - stream_time.now;
+	}
+
+	pw_buf = pw_stream_dequeue_buffer(self->stream);
+	if (G_UNLIKELY(pw_buf == NULL))
+		return;
+
+	g_assert(pw_buf->buffer != NULL);
+
+	if (G_UNLIKELY(pw_buf->buffer->n_datas == 0))
+		goto finish;
+
+	inner_spa_data = &(pw_buf->buffer->datas[0]);
+	if (G_UNLIKELY((inner_spa_data->data == NULL) || (inner_spa_data->chunk == NULL)))
+		goto finish;
+
+	/* Clamp the chunk to the mapped memory, just in case. */
+	offset = MIN(inner_spa_data->chunk->offset, inner_spa_data->maxsize);
+	num_bytes = MIN(inner_spa_data->chunk->size, inner_spa_data->maxsize - offset);
+	num_frames = num_bytes / self->stride;
+	if (G_UNLIKELY(num_frames == 0))
+		goto finish;
+
+	capture_time = gst_pw_audio_src_get_capture_time(self, -(stream_delay_in_ns + MAX(time_since_cycle_start, 0)));
+
+	/* If the tap is full, the quantum is dropped. The tap counts the drops
+	 * and marks the next quantum as discontinuous; it is not logged here,
+	 * since this runs in the realtime thread. */
+	gst_pw_audio_tap_write(
+		self->capture_tap,
+		((guint8 const *)(inner_spa_data->data)) + offset,
+		num_frames * self->stride,
+		capture_time,
+		gst_pw_audio_format_calculate_duration_from_num_frames(&(self->pw_audio_format), num_frames),
+		(inner_spa_data->chunk->flags & SPA_CHUNK_FLAG_EMPTY) != 0
+	);
+
+	/* This is not done with the mutex locked, since the realtime thread must not
+	 * block. (See CAPTURE_TAP_POLL_INTERVAL for why this is acceptable.) */
+	RT_SAFETY_CHECKER_COND_SIGNAL(&(self->capture_tap_cond));
+
+finish:
+	pw_stream_queue_buffer(self->stream, pw_buf);
+}
+
+
+static void gst_pw_audio_src_on_process_stream(void *data)
+{
+	RT_SAFETY_CHECKER_ENTER("pwaudiosrc process callback");
+	gst_pw_audio_src_process_stream(GST_PW_AUDIO_SRC_CAST(data));
+	RT_SAFETY_CHECKER_LEAVE();
+}
@@ -0,0 +1,280 @@
+/* gst-pipewire-extra
+ *
+ * Copyright © 2022 Carlos Rafael Giani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+#include "gstpwaudiotap.h"
+
+GST_DEBUG_CATEGORY(pw_audio_tap_debug);
+#define GST_CAT_DEFAULT pw_audio_tap_debug
+
+
+G_DEFINE_TYPE(GstPwAudioTap, gst_pw_audio_tap, GST_TYPE_OBJECT)
+
+
+/* Header that precedes each block in the memory region. */
+typedef struct
+{
+	GstClockTime pts;
+	GstClockTime duration;
+	guint32 num_bytes;
+	guint32 flags;
+}
+GstPwAudioTapBlockHeader;
+
+#define BLOCK_FLAG_GAP     (1u << 0)
+#define BLOCK_FLAG_DISCONT (1u << 1)
+/* Marks the rest of the memory region as unused. The next
+ * block begins at the beginning of the memory region. */
+#define BLOCK_FLAG_WRAP    (1u << 2)
+
+#define BLOCK_HEADER_SIZE (sizeof(GstPwAudioTapBlockHeader))
+/* Blocks are aligned to 8 bytes to keep the headers aligned. */
+#define BLOCK_ALIGNMENT 8
+#define ALIGN_BLOCK_SIZE(SIZE) (((SIZE) + (BLOCK_ALIGNMENT - 1)) & ~((guint)(BLOCK_ALIGNMENT - 1)))
+
+#define MIN_CAPACITY 64
+#define MAX_CAPACITY (1u << 30)
+
+
+static void gst_pw_audio_tap_dispose(GObject *object);
+
+
+static void gst_pw_audio_tap_class_init(GstPwAudioTapClass *klass)
+{
+	GObjectClass *object_class;
+
+	object_class = G_OBJECT_CLASS(klass);
+	object_class->dispose = GST_DEBUG_FUNCPTR(gst_pw_audio_tap_dispose);
+
+	GST_DEBUG_CATEGORY_INIT(pw_audio_tap_debug, "pwaudiotap", 0, "GStreamer PipeWire audio tap");
+}
+
+
+static void gst_pw_audio_tap_init(GstPwAudioTap *self)
+{
+	self->memory = NULL;
+	self->capacity = 0;
+	self->write_position = 0;
+	self->read_position = 0;
+	self->num_dropped_blocks = 0;
+	self->discont_pending = FALSE;
+}
+
+
+static void gst_pw_audio_tap_dispose(GObject *object)
+{
+	GstPwAudioTap *self = GST_PW_AUDIO_TAP(object);
+
+	g_free(self->memory);
+	self->memory = NULL;
+
+	G_OBJECT_CLASS(gst_pw_audio_tap_parent_class)->dispose(object);
+}
+
+
+GstPwAudioTap* gst_pw_audio_tap_new(gsize capacity)
+{
+	GstPwAudioTap *tap;
+
+	g_assert(capacity > 0);
+	g_assert(capacity <= MAX_CAPACITY);
+
+	tap = g_object_new(gst_pw_audio_tap_get_type(), NULL);
+	g_assert(tap != NULL);
+
+	capacity = MAX(capacity, MIN_CAPACITY);
+	/* Round up to the next power of two. */
+	tap->capacity = 1u << g_bit_storage(capacity - 1);
+
+	tap->memory = g_try_malloc(tap->capacity);
+	if (G_UNLIKELY(tap->memory == NULL))
+	{
+		GST_ERROR_OBJECT(tap, "could not allocate %u byte(s) for tap memory", tap->capacity);
+		goto error;
+	}
+
+	GST_DEBUG_OBJECT(tap, "created new tap with a capacity of %u byte(s)", tap->capacity);
+
+	/* Clear the floating flag. */
+	gst_object_ref_sink(GST_OBJECT(tap));
+
+	return tap;
+
+error:
+	if (tap != NULL)
+		gst_object_unref(GST_OBJECT(tap));
+
+	return NULL;
+}
+
+
+void gst_pw_audio_tap_flush(GstPwAudioTap *tap)
+{
+	g_assert(tap != NULL);
+
+	g_atomic_int_set(&(tap->write_position), 0);
+	g_atomic_int_set(&(tap->read_position), 0);
+	g_atomic_int_set(&(tap->num_dropped_blocks), 0);
+	tap->discont_pending = FALSE;
+}
+
+
+gboolean gst_pw_audio_tap_write(GstPwAudioTap *tap, gconstpointer data, gsize num_bytes, GstClockTime pts, GstClockTime duration, gboolean is_gap)
+{
+	/* NOTE: This is called from a realtime thread. Do not allocate
+	 * memory, do not log, and do not block in here. */
+
+	GstPwAudioTapBlockHeader header;
+	guint write_position, read_position;
+	guint num_free_bytes;
+	guint block_size;
+	guint offset, num_tail_bytes;
+	guint num_skipped_bytes;
+
+	g_assert(tap != NULL);
+	g_assert((data != NULL) || (num_bytes == 0));
+
+	/* The write position is only ever modified by this producer, but the
+	 * read position is modified by the consumer. The atomic get of the
+	 * read position ensures that the consumer is done with the bytes
+	 * that it read before the read position was updated. */
+	write_position = (guint)g_atomic_int_get(&(tap->write_position));
+	read_position = (guint)g_atomic_int_get(&(tap->read_position));
+
+	num_free_bytes = tap->capacity - (write_position - read_position);
+
+	if (G_UNLIKELY(num_bytes > (tap->capacity - BLOCK_HEADER_SIZE)))
+		goto drop;
+
+	block_size = ALIGN_BLOCK_SIZE(BLOCK_HEADER_SIZE + num_bytes);
+
+	/* Blocks are never split. If the block does not fit in the rest of the
+	 * memory region, that rest is skipped. */
+	offset = write_position & (tap->capacity - 1);
+	num_tail_bytes = tap->capacity - offset;
+	num_skipped_bytes = (num_tail_bytes < block_size) ? num_tail_bytes : 0;
+
+	if (G_UNLIKELY((num_skipped_bytes + block_size) > num_free_bytes))
+		goto drop;
+
+	if (num_skipped_bytes > 0)
+	{
+		/* If the tail is too small to contain a header, the
+		 * consumer skips it implicitly. Otherwise, write a
+		 * header that tells the consumer to skip it. */
+		if (num_tail_bytes >= BLOCK_HEADER_SIZE)
+		{
+			memset(&header, 0, sizeof(header));
+			header.flags = BLOCK_FLAG_WRAP;
+			memcpy(tap->memory + offset, &header, sizeof(header));
+		}
+
+		write_position += num_skipped_bytes;
+		offset = 0;
+	}
+
+	header.pts = pts;
+	header.duration = duration;
+	header.num_bytes = num_bytes;
+	header.flags = (is_gap ? BLOCK_FLAG_GAP : 0) | (tap->discont_pending ? BLOCK_FLAG_DISCONT : 0);
+
+	memcpy(tap->memory + offset, &header, sizeof(header));
+	if (num_bytes > 0)
+		memcpy(tap->memory + offset + BLOCK_HEADER_SIZE, data, num_bytes);
+
+	tap->discont_pending = FALSE;
+
+	/* Publish the block. The atomic set ensures that the block contents
+	 * are visible to the consumer before the new write position is. */
+	g_atomic_int_set(&(tap->write_position), (gint)(write_position + block_size));
+
+	return TRUE;
+
+drop:
+	tap->discont_pending = TRUE;
+	g_atomic_int_inc(&(tap->num_dropped_blocks));
+	return FALSE;
+}
+
+
+GstBuffer* gst_pw_audio_tap_read(GstPwAudioTap *tap)
+{
+	GstPwAudioTapBlockHeader header;
+	guint write_position, read_position;
+	GstBuffer *buffer = NULL;
+
+	g_assert(tap != NULL);
+
+	read_position = (guint)g_atomic_int_get(&(tap->read_position));
+	write_position = (guint)g_atomic_int_get(&(tap->write_position));
+
+	while (read_position != write_position)
+	{
+		guint offset = read_position & (tap->capacity - 1);
+		guint num_tail_bytes = tap->capacity - offset;
+
+		if (num_tail_bytes < BLOCK_HEADER_SIZE)
+		{
+			read_position += num_tail_bytes;
+			continue;
+		}
+
+		memcpy(&header, tap->memory + offset, sizeof(header));
+
+		if (header.flags & BLOCK_FLAG_WRAP)
+		{
+			read_position += num_tail_bytes;
+			continue;
+		}
+
+		buffer = gst_buffer_new_allocate(NULL, header.num_bytes, NULL);
+		g_assert(buffer != NULL);
+		gst_buffer_fill(buffer, 0, tap->memory + offset + BLOCK_HEADER_SIZE, header.num_bytes);
+
+		GST_BUFFER_PTS(buffer) = header.pts;
+		GST_BUFFER_DURATION(buffer) = header.duration;
+		if (header.flags & BLOCK_FLAG_GAP)
+			GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_GAP);
+		if (header.flags & BLOCK_FLAG_DISCONT)
+			GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+
+		read_position += ALIGN_BLOCK_SIZE(BLOCK_HEADER_SIZE + header.num_bytes);
+		break;
+	}
+
+	/* Hand the bytes that were read back to the producer. This is done
+	 * _after_ the block was copied, so the producer cannot overwrite
+	 * it while the copy is still ongoing. */
+	g_atomic_int_set(&(tap->read_position), (gint)read_position);
+
+	return buffer;
+}
+
+
+guint gst_pw_audio_tap_get_num_dropped_blocks(GstPwAudioTap *tap)
+{
+	g_assert(tap != NULL);
+	return (guint)g_atomic_int_get(&(tap->num_dropped_blocks));
+}
@@ -0,0 +1,138 @@
+/* gst-pipewire-extra
+ *
+ * Copyright © 2022 Carlos Rafael Giani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * SECTION:gstpwaudiotap
+ * @title: GstPwAudioTap
+ * @short_description: Lock-free single-producer single-consumer queue for tapping played audio.
+ *
+ * #GstPwAudioTap is a queue that transports blocks of audio data (typically one
+ * PipeWire quantum each) from a realtime thread to a non-realtime thread. The
+ * producer side (gst_pw_audio_tap_write()) never allocates memory and never
+ * blocks; if there is not enough room for a block, the block is dropped, and
+ * the number of dropped blocks is counted. The consumer side
+ * (gst_pw_audio_tap_read()) wraps each block in a newly allocated #GstBuffer.
+ *
+ * Each block is stored along with a header that contains its timestamp,
+ * duration, and flags. Blocks are never split; if a block does not fit in
+ * the remaining space at the end of the memory region, that space is skipped,
+ * and the block is written at the beginning instead.
+ *
+ * Only one producer thread and one consumer thread may access the tap at the
+ * same time. The read and write positions are exchanged with atomic operations,
+ * so no other synchronization is necessary between these two threads.
+ * gst_pw_audio_tap_flush() is an exception; it must not be called while the
+ * producer or the consumer are active.
+ */
+
+#ifndef __GST_PW_AUDIO_TAP_H__
+#define __GST_PW_AUDIO_TAP_H__
+
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+/**
+ * GstPwAudioTap:
+ *
+ * Opaque #GstPwAudioTap structure.
+ */
+typedef struct _GstPwAudioTap GstPwAudioTap;
+typedef struct _GstPwAudioTapClass GstPwAudioTapClass;
+
+
+#define GST_TYPE_PW_AUDIO_TAP            (gst_pw_audio_tap_get_type())
+#define GST_PW_AUDIO_TAP(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_PW_AUDIO_TAP, GstPwAudioTap))
+#define GST_PW_AUDIO_TAP_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_PW_AUDIO_TAP, GstPwAudioTapClass))
+#define GST_PW_AUDIO_TAP_CAST(obj)       ((GstPwAudioTap *)(obj))
+#define GST_IS_PW_AUDIO_TAP(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_PW_AUDIO_TAP))
+#define GST_IS_PW_AUDIO_TAP_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_PW_AUDIO_TAP))
+
+
+struct _GstPwAudioTap
+{
+	GstObject parent;
+
+	/*< private >*/
+
+	guint8 *memory;
+	/* Size of the memory region in bytes. Always a power of two, so the
+	 * read and write positions can wrap around at G_MAXUINT without
+	 * causing discontinuities in the offsets that are derived from them. */
+	guint capacity;
+
+	/* Monotonically increasing positions (in bytes). The write position is
+	 * only modified by the producer, the read position only by the consumer.
+	 * These are gints, not guints, since they are used by the GLib atomic
+	 * functions. They are interpreted as unsigned values. */
+	gint write_position;
+	gint read_position;
+
+	/* Number of blocks that the producer had to drop because there was not
+	 * enough room for them. Incremented by the producer, and read by any
+	 * thread through gst_pw_audio_tap_get_num_dropped_blocks(). */
+	gint num_dropped_blocks;
+	/* Set by the producer when it drops a block. The next block that is
+	 * written is then marked as discontinuous. Only accessed by the producer. */
+	gboolean discont_pending;
+};
+
+
+struct _GstPwAudioTapClass
+{
+	GstObjectClass parent_class;
+};
+
+
+GType gst_pw_audio_tap_get_type(void);
+
+/* Creates a new tap with room for at least capacity bytes (including the
+ * per-block headers). The capacity is rounded up to the next power of two. */
+GstPwAudioTap* gst_pw_audio_tap_new(gsize capacity);
+
+/* Discards all blocks. Must not be called while the producer or the consumer
+ * are accessing the tap. */
+void gst_pw_audio_tap_flush(GstPwAudioTap *tap);
+
+/* Producer side. Copies num_bytes bytes from data into the tap. If is_gap
+ * is TRUE, the buffer that is later returned by gst_pw_audio_tap_read() gets
+ * the GST_BUFFER_FLAG_GAP flag. Returns FALSE if there was not enough room,
+ * in which case the block is dropped. Never allocates and never blocks. */
+gboolean gst_pw_audio_tap_write(GstPwAudioTap *tap, gconstpointer data, gsize num_bytes, GstClockTime pts, GstClockTime duration, gboolean is_gap);
+
+/* Consumer side. Returns the oldest block as a new GstBuffer, or NULL if
+ * the tap is empty. If blocks were dropped since the last returned block,
+ * the buffer gets the GST_BUFFER_FLAG_DISCONT flag. */
+GstBuffer* gst_pw_audio_tap_read(GstPwAudioTap *tap);
+
+/* Returns the total number of dropped blocks since the last flush. */
+guint gst_pw_audio_tap_get_num_dropped_blocks(GstPwAudioTap *tap);
+
+
+G_END_DECLS
+
+
+#endif /* __GST_PW_AUDIO_TAP_H__ */
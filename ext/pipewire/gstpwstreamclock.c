@@ -94,6 +94,13 @@ struct _GstPwStreamClock
 	 * This field is set to TRUE by add_observation() and to FALSE
 	 * by reset() and freeze(). */
 	gboolean can_extrapolate;
+	/* If TRUE, get_internal_time_unlocked() does not extrapolate
+	 * between observations, and instead returns the driver clock
+	 * time of the last observation. This is used when the graph
+	 * is freewheeling, since the graph time then advances faster
+	 * than the system clock, and does not advance at all between
+	 * graph cycles. See gst_pw_stream_clock_set_follow_graph_time(). */
+	gboolean follow_graph_time;
 	/* The timestamp that was produced by the last get_internal_time_unlocked()
 	 * call. This is initially set to 0, meaning that the timestamps
 	 * that are produced by that function always begin at 0. */
@@ -116,6 +123,8 @@ static GstClockTime gst_pw_stream_clock_get_internal_time(GstClock *clock);
 
 static GstClockTime gst_pw_stream_clock_get_current_monotonic_time(GstPwStreamClock *self);
 static GstClockTime gst_pw_stream_clock_get_internal_time_unlocked(GstPwStreamClock *self);
+static GstClockTime gst_pw_stream_clock_extrapolate_unlocked(GstPwStreamClock *self, GstClockTime system_clock_time);
+static GstClockTime gst_pw_stream_clock_convert_observation(GstPwStreamClock *self, struct pw_time const *observation);
 
 
 static void gst_pw_stream_clock_class_init(GstPwStreamClockClass *klass)
@@ -145,6 +154,7 @@ static void gst_pw_stream_clock_init(GstPwStreamClock *self)
 	self->base_driver_clock_time_offset = 0;
 
 	self->can_extrapolate = FALSE;
+	self->follow_graph_time = FALSE;
 	self->last_timestamp = 0;
 }
 
@@ -193,15 +203,51 @@ static GstClockTime gst_pw_stream_clock_get_internal_time_unlocked(GstPwStreamCl
 	/* This must be called with the object lock taken. */
 
 	GstClockTime system_clock_time, driver_clock_time;
-	GstClockTimeDiff system_clock_time_diff;
 
 	if (G_UNLIKELY(!self->can_extrapolate))
 		return self->last_timestamp;
 
-	g_assert(self->get_sysclock_time_func != NULL);
-	system_clock_time = self->get_sysclock_time_func(self);
+	if (G_UNLIKELY(self->follow_graph_time))
+	{
+		/* The observations are the only source of the graph time
+		 * in this mode; the system clock says nothing about it. */
+		driver_clock_time = self->driver_clock_time_offset;
+	}
+	else
+	{
+		g_assert(self->get_sysclock_time_func != NULL);
+		system_clock_time = self->get_sysclock_time_func(self);
+
+		driver_clock_time = gst_pw_stream_clock_extrapolate_unlocked(self, system_clock_time);
+	}
+
+	/* When new observations are made (by means of add_observation() calls),
+	 * it may turn out that the extrapolations that were made so far actually
+	 * overshot, meaning that some of the latest produced timestamps are then
+	 * ahead of the driver clock time that was part of the add_observation()
+	 * call. If we do not address this, we end up here with driver_clock_time
+	 * values that suddenly go down again. This however is not acceptable;
+	 * the driver_clock_time timestamps must be monotonically increasing.
+	 * To fix this, keep returning last_timestamp until driver_clock_time
+	 * "catches up" with the value of last_timestamp. */
+	if (GST_CLOCK_TIME_IS_VALID(self->last_timestamp) && G_UNLIKELY(self->last_timestamp > driver_clock_time))
+	{
+		GST_LOG_OBJECT(self, "last timestamp %" GST_TIME_FORMAT " was higher than new driver clock time; returning last timestamp to ensure output timestamps remain monotonically increasing", GST_TIME_ARGS(self->last_timestamp));
+		driver_clock_time = self->last_timestamp;
+	}
+	else
+		self->last_timestamp = driver_clock_time;
+
+	return driver_clock_time;
+}
 
-	system_clock_time_diff = GST_CLOCK_DIFF(self->system_clock_time_offset, system_clock_time);
+
+static GstClockTime gst_pw_stream_clock_extrapolate_unlocked(GstPwStreamClock *self, GstClockTime system_clock_time)
+{
+	/* This must be called with the object lock taken. */
+
+	GstClockTime driver_clock_time;
+	GstClockTimeDiff system_clock_time_diff = GST_CLOCK_DIFF(self->system_clock_time_offset, system_clock_time);
 
 	/* Perform piecewise linear extrapolation to get the current driver clock time.
 	 * Sometimes, the last observation - which defines the system_clock_time_offset - can
@@ -237,27 +283,25 @@ static GstClockTime gst_pw_stream_clock_get_internal_time_unlocked(GstPwStreamCl
 		GST_TIME_ARGS(driver_clock_time)
 	);
 
-	/* When new observations are made (by means of add_observation() calls),
-	 * it may turn out that the extrapolations that were made so far actually
-	 * overshot, meaning that some of the latest produced timestamps are then
-	 * ahead of the driver clock time that was part of the add_observation()
-	 * call. If we do not address this, we end up here with driver_clock_time
-	 * values that suddenly go down again. This however is not acceptable;
-	 * the driver_clock_time timestamps must be monotonically increasing.
-	 * To fix this, keep returning last_timestamp until driver_clock_time
-	 * "catches up" with the value of last_timestamp. */
-	if (GST_CLOCK_TIME_IS_VALID(self->last_timestamp) && G_UNLIKELY(self->last_timestamp > driver_clock_time))
-	{
-		GST_LOG_OBJECT(self, "last timestamp %" GST_TIME_FORMAT " was higher than new driver clock time; returning last timestamp to ensure output timestamps remain monotonically increasing", GST_TIME_ARGS(self->last_timestamp));
-		driver_clock_time = self->last_timestamp;
-	}
-	else
-		self->last_timestamp = driver_clock_time;
-
 	return driver_clock_time;
 }
 
 
+static GstClockTime gst_pw_stream_clock_convert_observation(G_GNUC_UNUSED GstPwStreamClock *self, struct pw_time const *observation)
+{
+	/* Translates the driver ticks of the observation to a driver clock timestamp. */
+
+	if (G_UNLIKELY(observation->rate.denom == 0))
+		return GST_CLOCK_TIME_NONE;
+
+	return gst_util_uint64_scale_int_round(
+		(guint64)(observation->ticks) * observation->rate.num,
+		GST_SECOND,
+		observation->rate.denom
+	);
+}
+
+
 GstPwStreamClock* gst_pw_stream_clock_new(GstPwStreamClockGetSysclockTimeFunc get_sysclock_time_func)
 {
 	GstPwStreamClock *stream_clock = GST_PW_STREAM_CLOCK_CAST(g_object_new(GST_TYPE_PW_STREAM_CLOCK, NULL));
@@ -352,11 +396,7 @@ void gst_pw_stream_clock_add_observation(GstPwStreamClock *stream_clock, struct
 	g_assert(observation != NULL);
 
 	system_clock_time = observation->now;
-	driver_clock_time = gst_util_uint64_scale_int_round(
-		(guint64)(observation->ticks) * observation->rate.num,
-		GST_SECOND,
-		observation->rate.denom
-	);
+	driver_clock_time = gst_pw_stream_clock_convert_observation(stream_clock, observation);
 
 	GST_LOG_OBJECT(
 		stream_clock,
@@ -397,3 +437,90 @@ void gst_pw_stream_clock_add_observation(GstPwStreamClock *stream_clock, struct
 finish:
 	GST_OBJECT_UNLOCK(stream_clock);
 }
+
+
+void gst_pw_stream_clock_add_discontinuous_observation(GstPwStreamClock *stream_clock, struct pw_time const *observation)
+{
+	/* When the pw_stream is moved to another driver, or when the driver's
+	 * rate changes, the driver clock time in the observation no longer is
+	 * continuous with that of the previous observations. Passing it to
+	 * add_observation() would cause a jump in the produced timestamps, and
+	 * the driver clock rate would be computed across the discontinuity.
+	 *
+	 * Instead, extrapolate the driver clock time that the current piece of
+	 * the piecewise linear reconstruction yields for the observation's system
+	 * clock time, and make that the start of the new piece. The previous
+	 * observation is discarded, so the driver clock rate that was computed
+	 * so far stays in effect until the next regular observation arrives.
+	 * If the clock cannot extrapolate right now, this is not necessary,
+	 * since add_observation() continues at last_timestamp in that case. */
+
+	GstClockTime system_clock_time, driver_clock_time;
+	GstClockTime continued_driver_clock_time;
+
+	g_assert(stream_clock != NULL);
+	g_assert(observation != NULL);
+
+	system_clock_time = observation->now;
+	driver_clock_time = gst_pw_stream_clock_convert_observation(stream_clock, observation);
+
+	GST_OBJECT_LOCK(stream_clock);
+
+	if (G_UNLIKELY(!GST_CLOCK_TIME_IS_VALID(driver_clock_time)))
+		goto finish;
+
+	if (stream_clock->can_extrapolate)
+	{
+		if (stream_clock->follow_graph_time)
+			continued_driver_clock_time = stream_clock->driver_clock_time_offset;
+		else
+			continued_driver_clock_time = gst_pw_stream_clock_extrapolate_unlocked(stream_clock, system_clock_time);
+
+		GST_DEBUG_OBJECT(
+			stream_clock,
+			"add discontinuous observation: driver clock / system clock time %" GST_TIME_FORMAT " / %" GST_TIME_FORMAT "; continuing at driver clock time %" GST_TIME_FORMAT,
+			GST_TIME_ARGS(driver_clock_time), GST_TIME_ARGS(system_clock_time),
+			GST_TIME_ARGS(continued_driver_clock_time)
+		);
+
+		/* last_timestamp is not modified here. If it is ahead of the continued
+		 * driver clock time, get_internal_time_unlocked() keeps returning it
+		 * until the extrapolation catches up, like after regular observations. */
+		stream_clock->base_driver_clock_time_offset = GST_CLOCK_DIFF(driver_clock_time, continued_driver_clock_time);
+		stream_clock->driver_clock_time_offset = continued_driver_clock_time;
+		stream_clock->system_clock_time_offset = system_clock_time;
+	}
+	else
+	{
+		GST_DEBUG_OBJECT(
+			stream_clock,
+			"add discontinuous observation: driver clock / system clock time %" GST_TIME_FORMAT " / %" GST_TIME_FORMAT "; clock is frozen, continuing at last timestamp",
+			GST_TIME_ARGS(driver_clock_time), GST_TIME_ARGS(system_clock_time)
+		);
+
+		stream_clock->base_driver_clock_time_offset = GST_CLOCK_DIFF(driver_clock_time, stream_clock->last_timestamp);
+		stream_clock->driver_clock_time_offset = ((GstClockTimeDiff)driver_clock_time) + stream_clock->base_driver_clock_time_offset;
+		stream_clock->system_clock_time_offset = system_clock_time;
+		stream_clock->can_extrapolate = TRUE;
+	}
+
+	/* Subsequent regular observations compute the driver clock
+	 * rate relative to this one, since it is the first one
+	 * after the discontinuity. */
+	stream_clock->previous_driver_clock_time = driver_clock_time;
+	stream_clock->previous_system_clock_time = system_clock_time;
+
+finish:
+	GST_OBJECT_UNLOCK(stream_clock);
+}
+
+
+void gst_pw_stream_clock_set_follow_graph_time(GstPwStreamClock *stream_clock, gboolean follow_graph_time)
+{
+	g_assert(stream_clock != NULL);
+
+	GST_OBJECT_LOCK(stream_clock);
+	GST_DEBUG_OBJECT(stream_clock, "follow graph time: %d", follow_graph_time);
+	stream_clock->follow_graph_time = follow_graph_time;
+	GST_OBJECT_UNLOCK(stream_clock);
+}
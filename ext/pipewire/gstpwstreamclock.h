@@ -101,6 +101,35 @@ void gst_pw_stream_clock_freeze(GstPwStreamClock *stream_clock);
  */
 void gst_pw_stream_clock_add_observation(GstPwStreamClock *stream_clock, struct pw_time const *observation);
 
+/**
+ * gst_pw_stream_clock_add_discontinuous_observation:
+ * @stream_clock The #GstPwStreamClock.
+ * @observation Observation to add.
+ *
+ * Variant of gst_pw_stream_clock_add_observation() for observations that are
+ * not continuous with the previous ones. This is the case when the pw_stream
+ * was moved to another driver, or when the driver's clock rate changed.
+ * The produced timestamps continue seamlessly from the ones that were
+ * extrapolated before the observation, and the driver clock rate that was
+ * computed previously stays in use until the next regular observation.
+ */
+void gst_pw_stream_clock_add_discontinuous_observation(GstPwStreamClock *stream_clock, struct pw_time const *observation);
+
+/**
+ * gst_pw_stream_clock_set_follow_graph_time:
+ * @stream_clock The #GstPwStreamClock.
+ * @follow_graph_time Whether to follow the graph time.
+ *
+ * If follow_graph_time is TRUE, the clock no longer extrapolates timestamps
+ * between observations with the help of the system clock. Instead, it returns
+ * the driver clock time of the most recent observation. This is meant for
+ * freewheeling graphs, where the driver clock runs as fast as the graph can
+ * process data, so its pace has no relation to that of the system clock.
+ * The produced timestamps remain monotonically increasing when switching
+ * between the two modes.
+ */
+void gst_pw_stream_clock_set_follow_graph_time(GstPwStreamClock *stream_clock, gboolean follow_graph_time);
+
 
 G_END_DECLS
 
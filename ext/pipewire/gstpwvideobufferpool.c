@@ -0,0 +1,711 @@
+/* gst-pipewire-extra
+ *
+ * Copyright © 2022 Carlos Rafael Giani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <gst/gst.h>
+#include <gst/allocators/allocators.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#include <spa/buffer/meta.h>
+#pragma GCC diagnostic pop
+
+#include "gstpwvideobufferpool.h"
+
+GST_DEBUG_CATEGORY(pw_video_buffer_pool_debug);
+#define GST_CAT_DEFAULT pw_video_buffer_pool_debug
+
+
+G_DEFINE_TYPE(GstPwVideoBufferPool, gst_pw_video_buffer_pool, GST_TYPE_BUFFER_POOL)
+
+
+/* Associates a pw_buffer with the GstBuffer that wraps its memory.
+ * Instances are attached to the GstBuffer as qdata, and are freed
+ * together with the GstBuffer. Access requires the pool mutex. */
+typedef struct
+{
+	/* NULL once the pw_buffer was removed from the stream. */
+	struct pw_buffer *pw_buffer;
+	GstBuffer *buffer;
+	/* TRUE while the pw_buffer is in the stream's queue. This is initially
+	 * TRUE, since the stream initially owns all of its buffers. */
+	gboolean queued;
+	/* TRUE while the pool holds the reference to the GstBuffer, that is,
+	 * while the buffer is not acquired. A buffer that was queued can be
+	 * dequeued again before the acquirer released it; in that case, the
+	 * buffer becomes available once that release happens. */
+	gboolean held_by_pool;
+}
+GstPwVideoBufferData;
+
+static GQuark buffer_data_quark;
+
+#define GET_BUFFER_DATA(BUFFER) ((GstPwVideoBufferData *)gst_mini_object_get_qdata(GST_MINI_OBJECT_CAST(BUFFER), buffer_data_quark))
+
+
+static void gst_pw_video_buffer_pool_dispose(GObject *object);
+static void gst_pw_video_buffer_pool_finalize(GObject *object);
+
+static gboolean gst_pw_video_buffer_pool_start(GstBufferPool *pool);
+static GstFlowReturn gst_pw_video_buffer_pool_acquire_buffer(GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params);
+static void gst_pw_video_buffer_pool_reset_buffer(GstBufferPool *pool, GstBuffer *buffer);
+static void gst_pw_video_buffer_pool_release_buffer(GstBufferPool *pool, GstBuffer *buffer);
+static void gst_pw_video_buffer_pool_flush_start(GstBufferPool *pool);
+static void gst_pw_video_buffer_pool_flush_stop(GstBufferPool *pool);
+
+static gboolean gst_pw_video_buffer_pool_wrap_pw_buffer_memory(GstPwVideoBufferPool *self, struct pw_buffer *pw_buffer, GstBuffer *buffer);
+
+
+static void gst_pw_video_buffer_pool_class_init(GstPwVideoBufferPoolClass *klass)
+{
+	GObjectClass *object_class;
+	GstBufferPoolClass *buffer_pool_class;
+
+	object_class = G_OBJECT_CLASS(klass);
+	buffer_pool_class = GST_BUFFER_POOL_CLASS(klass);
+
+	object_class->dispose  = GST_DEBUG_FUNCPTR(gst_pw_video_buffer_pool_dispose);
+	object_class->finalize = GST_DEBUG_FUNCPTR(gst_pw_video_buffer_pool_finalize);
+
+	buffer_pool_class->start          = GST_DEBUG_FUNCPTR(gst_pw_video_buffer_pool_start);
+	buffer_pool_class->acquire_buffer = GST_DEBUG_FUNCPTR(gst_pw_video_buffer_pool_acquire_buffer);
+	buffer_pool_class->reset_buffer   = GST_DEBUG_FUNCPTR(gst_pw_video_buffer_pool_reset_buffer);
+	buffer_pool_class->release_buffer = GST_DEBUG_FUNCPTR(gst_pw_video_buffer_pool_release_buffer);
+	buffer_pool_class->flush_start    = GST_DEBUG_FUNCPTR(gst_pw_video_buffer_pool_flush_start);
+	buffer_pool_class->flush_stop     = GST_DEBUG_FUNCPTR(gst_pw_video_buffer_pool_flush_stop);
+
+	buffer_data_quark = g_quark_from_static_string("GstPwVideoBufferData");
+
+	GST_DEBUG_CATEGORY_INIT(pw_video_buffer_pool_debug, "pwvideobufferpool", 0, "GStreamer PipeWire video buffer pool");
+}
+
+
+static void gst_pw_video_buffer_pool_init(GstPwVideoBufferPool *self)
+{
+	self->loop = NULL;
+	self->stream = NULL;
+	gst_video_info_init(&(self->video_info));
+
+	self->fd_allocator = gst_fd_allocator_new();
+	self->dmabuf_allocator = gst_dmabuf_allocator_new();
+
+	g_queue_init(&(self->available_buffers));
+	self->num_pw_buffers = 0;
+
+	self->flushing = FALSE;
+	self->next_seq_num = 0;
+
+	g_mutex_init(&(self->mutex));
+	g_cond_init(&(self->cond));
+}
+
+
+static void gst_pw_video_buffer_pool_dispose(GObject *object)
+{
+	GstPwVideoBufferPool *self = GST_PW_VIDEO_BUFFER_POOL(object);
+	GstBuffer *buffer;
+
+	/* Normally, the available buffers were already discarded
+	 * when their pw_buffers were removed from the stream. */
+	while ((buffer = g_queue_pop_head(&(self->available_buffers))) != NULL)
+		gst_buffer_unref(buffer);
+
+	if (self->fd_allocator != NULL)
+	{
+		gst_object_unref(GST_OBJECT(self->fd_allocator));
+		self->fd_allocator = NULL;
+	}
+
+	if (self->dmabuf_allocator != NULL)
+	{
+		gst_object_unref(GST_OBJECT(self->dmabuf_allocator));
+		self->dmabuf_allocator = NULL;
+	}
+
+	G_OBJECT_CLASS(gst_pw_video_buffer_pool_parent_class)->dispose(object);
+}
+
+
+static void gst_pw_video_buffer_pool_finalize(GObject *object)
+{
+	GstPwVideoBufferPool *self = GST_PW_VIDEO_BUFFER_POOL(object);
+
+	g_cond_clear(&(self->cond));
+	g_mutex_clear(&(self->mutex));
+
+	G_OBJECT_CLASS(gst_pw_video_buffer_pool_parent_class)->finalize(object);
+}
+
+
+GstPwVideoBufferPool* gst_pw_video_buffer_pool_new(GstPipewireCore *core, struct pw_stream *stream, GstVideoInfo const *video_info)
+{
+	GstPwVideoBufferPool *pool;
+
+	g_assert(core != NULL);
+	g_assert(stream != NULL);
+	g_assert(video_info != NULL);
+
+	pool = g_object_new(gst_pw_video_buffer_pool_get_type(), NULL);
+	g_assert(pool != NULL);
+
+	/* The pool does not keep a reference to the core, since the core's
+	 * owner must release it with gst_pipewire_core_release(). That owner
+	 * detaches the pool before doing so. */
+	pool->loop = core->loop;
+	pool->stream = stream;
+	pool->video_info = *video_info;
+
+	GST_DEBUG_OBJECT(pool, "created new video buffer pool for stream %p", (gpointer)stream);
+
+	/* Clear the floating flag. */
+	gst_object_ref_sink(GST_OBJECT(pool));
+
+	return pool;
+}
+
+
+void gst_pw_video_buffer_pool_add_pw_buffer(GstPwVideoBufferPool *pool, struct pw_buffer *pw_buffer)
+{
+	GstPwVideoBufferData *data;
+	GstBuffer *buffer;
+
+	g_assert(pool != NULL);
+	g_assert(pw_buffer != NULL);
+
+	buffer = gst_buffer_new();
+
+	if (!gst_pw_video_buffer_pool_wrap_pw_buffer_memory(pool, pw_buffer, buffer))
+	{
+		/* The pw_buffer stays unassociated. It is rejected
+		 * if it is dequeued in acquire_buffer(). */
+		gst_buffer_unref(buffer);
+		return;
+	}
+
+	/* Describe the frame layout that was requested in the
+	 * stream's SPA_PARAM_Buffers param to upstream. */
+	gst_buffer_add_video_meta_full(
+		buffer,
+		GST_VIDEO_FRAME_FLAG_NONE,
+		GST_VIDEO_INFO_FORMAT(&(pool->video_info)),
+		GST_VIDEO_INFO_WIDTH(&(pool->video_info)),
+		GST_VIDEO_INFO_HEIGHT(&(pool->video_info)),
+		GST_VIDEO_INFO_N_PLANES(&(pool->video_info)),
+		pool->video_info.offset,
+		pool->video_info.stride
+	);
+
+	/* The meta must survive gst_pw_video_buffer_pool_reset_buffer(). */
+	GST_META_FLAG_SET(gst_buffer_get_video_meta(buffer), GST_META_FLAG_POOLED);
+	GST_META_FLAG_SET(gst_buffer_get_video_meta(buffer), GST_META_FLAG_LOCKED);
+
+	data = g_new0(GstPwVideoBufferData, 1);
+	data->pw_buffer = pw_buffer;
+	data->buffer = buffer;
+	data->queued = TRUE;
+	data->held_by_pool = TRUE;
+
+	gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(buffer), buffer_data_quark, data, g_free);
+
+	g_mutex_lock(&(pool->mutex));
+	pw_buffer->user_data = data;
+	pool->num_pw_buffers++;
+	g_mutex_unlock(&(pool->mutex));
+
+	GST_DEBUG_OBJECT(pool, "added pw_buffer %p as buffer %" GST_PTR_FORMAT, (gpointer)pw_buffer, (gpointer)buffer);
+}
+
+
+void gst_pw_video_buffer_pool_remove_pw_buffer(GstPwVideoBufferPool *pool, struct pw_buffer *pw_buffer)
+{
+	GstPwVideoBufferData *data;
+	GstBuffer *buffer_to_unref = NULL;
+
+	g_assert(pool != NULL);
+	g_assert(pw_buffer != NULL);
+
+	g_mutex_lock(&(pool->mutex));
+
+	data = (GstPwVideoBufferData *)(pw_buffer->user_data);
+	if (data == NULL)
+		goto finish;
+
+	GST_DEBUG_OBJECT(pool, "removing pw_buffer %p (held by pool: %d)", (gpointer)pw_buffer, data->held_by_pool);
+
+	pw_buffer->user_data = NULL;
+	data->pw_buffer = NULL;
+	pool->num_pw_buffers--;
+
+	/* Acquired buffers are discarded once they are released. */
+	if (data->held_by_pool)
+	{
+		g_queue_remove(&(pool->available_buffers), data->buffer);
+		buffer_to_unref = data->buffer;
+	}
+
+finish:
+	g_mutex_unlock(&(pool->mutex));
+
+	/* This also frees data. */
+	if (buffer_to_unref != NULL)
+		gst_buffer_unref(buffer_to_unref);
+}
+
+
+gboolean gst_pw_video_buffer_pool_is_pool_buffer(GstPwVideoBufferPool *pool, GstBuffer *buffer)
+{
+	GstPwVideoBufferData *data;
+	gboolean ret;
+
+	g_assert(pool != NULL);
+	g_assert(buffer != NULL);
+
+	if ((buffer->pool != GST_BUFFER_POOL_CAST(pool)) || GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_TAG_MEMORY))
+		return FALSE;
+
+	g_mutex_lock(&(pool->mutex));
+	data = GET_BUFFER_DATA(buffer);
+	ret = (data != NULL) && (data->pw_buffer != NULL);
+	g_mutex_unlock(&(pool->mutex));
+
+	return ret;
+}
+
+
+gboolean gst_pw_video_buffer_pool_queue_buffer(GstPwVideoBufferPool *pool, GstBuffer *buffer, GstClockTime pts)
+{
+	GstPwVideoBufferData *data;
+	struct spa_buffer *spa_buffer;
+	struct spa_data *spa_data;
+	struct spa_meta_header *header;
+	gboolean ret = FALSE;
+
+	g_assert(pool != NULL);
+	g_assert(buffer != NULL);
+
+	g_mutex_lock(&(pool->mutex));
+
+	data = GET_BUFFER_DATA(buffer);
+	if (G_UNLIKELY((pool->stream == NULL) || (data == NULL) || (data->pw_buffer == NULL) || data->queued))
+		goto finish;
+
+	spa_buffer = data->pw_buffer->buffer;
+
+	/* The entire frame is in one block, laid out as described by the
+	 * video meta that was added in gst_pw_video_buffer_pool_add_pw_buffer(). */
+	spa_data = &(spa_buffer->datas[0]);
+	spa_data->chunk->offset = 0;
+	spa_data->chunk->size = GST_VIDEO_INFO_SIZE(&(pool->video_info));
+	spa_data->chunk->stride = GST_VIDEO_INFO_PLANE_STRIDE(&(pool->video_info), 0);
+	spa_data->chunk->flags = SPA_CHUNK_FLAG_NONE;
+
+	header = spa_buffer_find_meta_data(spa_buffer, SPA_META_Header, sizeof(*header));
+	if (header != NULL)
+	{
+		header->flags = GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT) ? SPA_META_HEADER_FLAG_DISCONT : 0;
+		header->offset = 0;
+		header->pts = GST_CLOCK_TIME_IS_VALID(pts) ? (int64_t)pts : -1;
+		header->dts_offset = 0;
+		header->seq = pool->next_seq_num;
+	}
+
+	pool->next_seq_num++;
+
+	data->queued = TRUE;
+	pw_stream_queue_buffer(pool->stream, data->pw_buffer);
+
+	ret = TRUE;
+
+finish:
+	g_mutex_unlock(&(pool->mutex));
+	return ret;
+}
+
+
+void gst_pw_video_buffer_pool_notify_process(GstPwVideoBufferPool *pool)
+{
+	g_assert(pool != NULL);
+
+	g_mutex_lock(&(pool->mutex));
+	g_cond_broadcast(&(pool->cond));
+	g_mutex_unlock(&(pool->mutex));
+}
+
+
+void gst_pw_video_buffer_pool_detach(GstPwVideoBufferPool *pool)
+{
+	struct pw_thread_loop *loop;
+	GstBuffer *buffer;
+	GQueue buffers_to_unref = G_QUEUE_INIT;
+
+	g_assert(pool != NULL);
+
+	g_mutex_lock(&(pool->mutex));
+	loop = pool->loop;
+	g_mutex_unlock(&(pool->mutex));
+
+	if (loop == NULL)
+		return;
+
+	/* Take the loop lock to wait for any acquire_buffer()
+	 * call that is currently dequeuing a pw_buffer. */
+	pw_thread_loop_lock(loop);
+	g_mutex_lock(&(pool->mutex));
+
+	GST_DEBUG_OBJECT(pool, "detaching from stream %p", (gpointer)(pool->stream));
+
+	pool->loop = NULL;
+	pool->stream = NULL;
+	pool->num_pw_buffers = 0;
+
+	/* Normally, the remove_buffer events already took care of these. */
+	while ((buffer = g_queue_pop_head(&(pool->available_buffers))) != NULL)
+	{
+		GstPwVideoBufferData *data = GET_BUFFER_DATA(buffer);
+		if (data->pw_buffer != NULL)
+		{
+			data->pw_buffer->user_data = NULL;
+			data->pw_buffer = NULL;
+		}
+		g_queue_push_tail(&buffers_to_unref, buffer);
+	}
+
+	g_cond_broadcast(&(pool->cond));
+
+	g_mutex_unlock(&(pool->mutex));
+	pw_thread_loop_unlock(loop);
+
+	while ((buffer = g_queue_pop_head(&buffers_to_unref)) != NULL)
+		gst_buffer_unref(buffer);
+}
+
+
+static gboolean gst_pw_video_buffer_pool_start(GstBufferPool *pool)
+{
+	/* Do not chain up, since the default start() preallocates
+	 * buffers. Here, all buffers come from the pw_stream. */
+	GST_DEBUG_OBJECT(pool, "starting pool");
+	return TRUE;
+}
+
+
+static GstFlowReturn gst_pw_video_buffer_pool_acquire_buffer(GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params)
+{
+	GstPwVideoBufferPool *self = GST_PW_VIDEO_BUFFER_POOL(pool);
+	GstPwVideoBufferData *data = NULL;
+	GstFlowReturn flow_ret = GST_FLOW_OK;
+
+	g_mutex_lock(&(self->mutex));
+
+	while (TRUE)
+	{
+		struct pw_thread_loop *loop = self->loop;
+		struct pw_buffer *pw_buffer;
+
+		if (self->flushing || (loop == NULL))
+		{
+			GST_DEBUG_OBJECT(self, "pool is flushing or detached");
+			flow_ret = GST_FLOW_FLUSHING;
+			break;
+		}
+
+		if (!g_queue_is_empty(&(self->available_buffers)))
+		{
+			data = GET_BUFFER_DATA(g_queue_pop_head(&(self->available_buffers)));
+			break;
+		}
+
+		if (self->num_pw_buffers == 0)
+		{
+			GST_LOG_OBJECT(self, "stream has no buffers yet; producing system memory buffer");
+			*buffer = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(&(self->video_info)), NULL);
+			gst_buffer_add_video_meta_full(
+				*buffer,
+				GST_VIDEO_FRAME_FLAG_NONE,
+				GST_VIDEO_INFO_FORMAT(&(self->video_info)),
+				GST_VIDEO_INFO_WIDTH(&(self->video_info)),
+				GST_VIDEO_INFO_HEIGHT(&(self->video_info)),
+				GST_VIDEO_INFO_N_PLANES(&(self->video_info)),
+				self->video_info.offset,
+				self->video_info.stride
+			);
+			break;
+		}
+
+		/* Respect the lock order (see the pool documentation). The loop stays
+		 * valid in between, since detach() is the only function that resets
+		 * it, and it takes the loop lock. Re-check the states afterwards,
+		 * since they may have changed while the mutex was unlocked. */
+		g_mutex_unlock(&(self->mutex));
+		pw_thread_loop_lock(loop);
+		g_mutex_lock(&(self->mutex));
+
+		if (self->flushing || (self->stream == NULL) || !g_queue_is_empty(&(self->available_buffers)))
+		{
+			pw_thread_loop_unlock(loop);
+			continue;
+		}
+
+		pw_buffer = pw_stream_dequeue_buffer(self->stream);
+		pw_thread_loop_unlock(loop);
+
+		if (pw_buffer != NULL)
+		{
+			data = (GstPwVideoBufferData *)(pw_buffer->user_data);
+			if (G_UNLIKELY(data == NULL))
+			{
+				GST_ERROR_OBJECT(self, "dequeued pw_buffer %p has no associated GstBuffer", (gpointer)pw_buffer);
+				flow_ret = GST_FLOW_ERROR;
+				break;
+			}
+
+			data->queued = FALSE;
+
+			/* The previous acquirer still holds this buffer. It becomes
+			 * available once that acquirer releases it. */
+			if (!data->held_by_pool)
+			{
+				data = NULL;
+				continue;
+			}
+
+			break;
+		}
+
+		if ((params != NULL) && (params->flags & GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT))
+		{
+			flow_ret = GST_FLOW_EOS;
+			break;
+		}
+
+		/* The mutex was held since the dequeue attempt, so a notification
+		 * from the process event cannot get lost in between. */
+		g_cond_wait(&(self->cond), &(self->mutex));
+	}
+
+	if (data != NULL)
+	{
+		data->held_by_pool = FALSE;
+		*buffer = data->buffer;
+	}
+
+	g_mutex_unlock(&(self->mutex));
+
+	return flow_ret;
+}
+
+
+static gboolean remove_unpooled_meta(G_GNUC_UNUSED GstBuffer *buffer, GstMeta **meta, G_GNUC_UNUSED gpointer user_data)
+{
+	if (!GST_META_FLAG_IS_SET(*meta, GST_META_FLAG_POOLED))
+	{
+		GST_META_FLAG_UNSET(*meta, GST_META_FLAG_LOCKED);
+		*meta = NULL;
+	}
+
+	return TRUE;
+}
+
+
+static void gst_pw_video_buffer_pool_reset_buffer(GstBufferPool *pool, GstBuffer *buffer)
+{
+	GstPwVideoBufferPool *self = GST_PW_VIDEO_BUFFER_POOL(pool);
+
+	/* This is like the default reset_buffer(), except that the buffer is resized
+	 * to the frame size instead of the size from the pool config. That config
+	 * is set by upstream, and has no influence on the size of the pw_buffers. */
+
+	GST_BUFFER_FLAGS(buffer) &= GST_BUFFER_FLAG_TAG_MEMORY;
+	GST_BUFFER_PTS(buffer) = GST_CLOCK_TIME_NONE;
+	GST_BUFFER_DTS(buffer) = GST_CLOCK_TIME_NONE;
+	GST_BUFFER_DURATION(buffer) = GST_CLOCK_TIME_NONE;
+	GST_BUFFER_OFFSET(buffer) = GST_BUFFER_OFFSET_NONE;
+	GST_BUFFER_OFFSET_END(buffer) = GST_BUFFER_OFFSET_NONE;
+
+	gst_buffer_foreach_meta(buffer, remove_unpooled_meta, NULL);
+
+	if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_TAG_MEMORY))
+		gst_buffer_set_size(buffer, GST_VIDEO_INFO_SIZE(&(self->video_info)));
+}
+
+
+static void gst_pw_video_buffer_pool_release_buffer(GstBufferPool *pool, GstBuffer *buffer)
+{
+	GstPwVideoBufferPool *self = GST_PW_VIDEO_BUFFER_POOL(pool);
+	GstPwVideoBufferData *data;
+	gboolean discard = FALSE;
+
+	g_mutex_lock(&(self->mutex));
+
+	data = GET_BUFFER_DATA(buffer);
+
+	/* System memory buffers from acquire_buffer() are not reused. */
+	if (data == NULL)
+	{
+		discard = TRUE;
+		goto finish;
+	}
+
+	data->held_by_pool = TRUE;
+
+	if (data->pw_buffer == NULL)
+	{
+		discard = TRUE;
+		goto finish;
+	}
+
+	/* Upstream replaced the memory of the buffer. Restore it, so
+	 * the buffer refers to the pw_buffer's memory again. */
+	if (G_UNLIKELY(GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_TAG_MEMORY)))
+	{
+		GST_DEBUG_OBJECT(self, "memory of buffer %" GST_PTR_FORMAT " was replaced; restoring", (gpointer)buffer);
+
+		gst_buffer_remove_all_memory(buffer);
+		if (!gst_pw_video_buffer_pool_wrap_pw_buffer_memory(self, data->pw_buffer, buffer))
+		{
+			/* Leave the pw_buffer unassociated. */
+			data->pw_buffer->user_data = NULL;
+			data->pw_buffer = NULL;
+			self->num_pw_buffers--;
+			discard = TRUE;
+			goto finish;
+		}
+	}
+
+	if (!data->queued)
+	{
+		g_queue_push_tail(&(self->available_buffers), buffer);
+		g_cond_broadcast(&(self->cond));
+	}
+
+finish:
+	g_mutex_unlock(&(self->mutex));
+
+	if (discard)
+		gst_buffer_unref(buffer);
+}
+
+
+static void gst_pw_video_buffer_pool_flush_start(GstBufferPool *pool)
+{
+	GstPwVideoBufferPool *self = GST_PW_VIDEO_BUFFER_POOL(pool);
+
+	g_mutex_lock(&(self->mutex));
+	self->flushing = TRUE;
+	g_cond_broadcast(&(self->cond));
+	g_mutex_unlock(&(self->mutex));
+}
+
+
+static void gst_pw_video_buffer_pool_flush_stop(GstBufferPool *pool)
+{
+	GstPwVideoBufferPool *self = GST_PW_VIDEO_BUFFER_POOL(pool);
+
+	g_mutex_lock(&(self->mutex));
+	self->flushing = FALSE;
+	g_mutex_unlock(&(self->mutex));
+}
+
+
+static gboolean gst_pw_video_buffer_pool_wrap_pw_buffer_memory(GstPwVideoBufferPool *self, struct pw_buffer *pw_buffer, GstBuffer *buffer)
+{
+	struct spa_buffer *spa_buffer = pw_buffer->buffer;
+	struct spa_data *spa_data;
+	GstMemory *memory = NULL;
+	gsize frame_size = GST_VIDEO_INFO_SIZE(&(self->video_info));
+
+	/* The stream's SPA_PARAM_Buffers param requests exactly one block. */
+	if (G_UNLIKELY(spa_buffer->n_datas != 1))
+	{
+		GST_ERROR_OBJECT(self, "pw_buffer %p has %" G_GUINT32_FORMAT " blocks; expected 1", (gpointer)pw_buffer, spa_buffer->n_datas);
+		return FALSE;
+	}
+
+	spa_data = &(spa_buffer->datas[0]);
+
+	if (G_UNLIKELY(spa_data->maxsize < frame_size))
+	{
+		GST_ERROR_OBJECT(
+			self,
+			"pw_buffer %p is too small for a frame: %" G_GUINT32_FORMAT " byte(s) < %" G_GSIZE_FORMAT " byte(s)",
+			(gpointer)pw_buffer,
+			spa_data->maxsize, frame_size
+		);
+		return FALSE;
+	}
+
+	switch (spa_data->type)
+	{
+		case SPA_DATA_MemFd:
+		case SPA_DATA_DmaBuf:
+		{
+			/* The allocators take ownership over the FD they are given, while
+			 * the FD in spa_data stays owned by the stream. Hand over a duplicate. */
+			int fd = dup(spa_data->fd);
+			gsize total_size = spa_data->mapoffset + spa_data->maxsize;
+
+			if (G_UNLIKELY(fd < 0))
+			{
+				GST_ERROR_OBJECT(self, "could not duplicate FD of pw_buffer %p: %s (%d)", (gpointer)pw_buffer, strerror(errno), errno);
+				return FALSE;
+			}
+
+			/* Keep the memory mapped once it was mapped for the first time.
+			 * Otherwise, each frame would be mapped and unmapped again. */
+			if (spa_data->type == SPA_DATA_DmaBuf)
+				memory = gst_dmabuf_allocator_alloc_with_flags(self->dmabuf_allocator, fd, total_size, GST_FD_MEMORY_FLAG_KEEP_MAPPED);
+			else
+				memory = gst_fd_allocator_alloc(self->fd_allocator, fd, total_size, GST_FD_MEMORY_FLAG_KEEP_MAPPED);
+
+			if (G_UNLIKELY(memory == NULL))
+			{
+				GST_ERROR_OBJECT(self, "could not wrap FD of pw_buffer %p", (gpointer)pw_buffer);
+				close(fd);
+				return FALSE;
+			}
+
+			gst_memory_resize(memory, spa_data->mapoffset, frame_size);
+
+			break;
+		}
+
+		case SPA_DATA_MemPtr:
+			memory = gst_memory_new_wrapped(0, spa_data->data, spa_data->maxsize, 0, frame_size, NULL, NULL);
+			break;
+
+		default:
+			GST_ERROR_OBJECT(self, "pw_buffer %p has unsupported data type %" G_GUINT32_FORMAT, (gpointer)pw_buffer, spa_data->type);
+			return FALSE;
+	}
+
+	gst_buffer_append_memory(buffer, memory);
+
+	/* Appending memory tags the buffer, which would otherwise make
+	 * it look as if upstream had replaced the buffer's memory. */
+	GST_BUFFER_FLAG_UNSET(buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+
+	return TRUE;
+}
@@ -0,0 +1,220 @@
+/* gst-pipewire-extra
+ *
+ * Copyright © 2022 Carlos Rafael Giani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * SECTION:gstpwvideobufferpool
+ * @title: GstPwVideoBufferPool
+ * @short_description: Buffer pool that hands out the buffers of a PipeWire output stream.
+ *
+ * #GstPwVideoBufferPool makes the buffers of a pw_stream available to
+ * upstream elements as ordinary #GstBuffer instances. This lets upstream
+ * render video frames directly into memory that is shared with the PipeWire
+ * graph, so that handing a frame over to the graph does not involve copying
+ * it. The pw_stream allocates these buffers (typically as memfd memory) once
+ * the stream's format was negotiated. Their file descriptors are wrapped in
+ * #GstFdMemory (or #GstDmaBufMemory, if the buffers are DMA-BUFs).
+ *
+ * The pool does not allocate any buffers by itself. Instead, the owner of
+ * the pw_stream forwards the stream's add_buffer and remove_buffer events to
+ * gst_pw_video_buffer_pool_add_pw_buffer() and gst_pw_video_buffer_pool_remove_pw_buffer().
+ * Acquiring a buffer dequeues a pw_buffer from the stream, blocking until one
+ * is available. The owner must therefore call gst_pw_video_buffer_pool_notify_process()
+ * in the stream's process event. gst_pw_video_buffer_pool_queue_buffer() passes
+ * the frame in an acquired buffer to the graph. Acquired buffers that are
+ * released without having been queued are kept for subsequent acquisitions.
+ *
+ * Until the stream has buffers (that is, until it is linked and its format is
+ * negotiated), acquisitions produce system memory buffers instead of blocking.
+ * Otherwise, upstream would be blocked until a consumer shows up. Such buffers
+ * are not pool buffers as far as gst_pw_video_buffer_pool_is_pool_buffer() is
+ * concerned.
+ *
+ * The pool's internal states are protected by its own mutex. When both that
+ * mutex and the pw_thread_loop lock are needed, the pw_thread_loop lock is
+ * taken first, since the stream events are emitted with that lock held.
+ */
+
+#ifndef __GST_PW_VIDEO_BUFFER_POOL_H__
+#define __GST_PW_VIDEO_BUFFER_POOL_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#include <pipewire/pipewire.h>
+
+#pragma GCC diagnostic pop
+
+#include "gstpipewirecore.h"
+
+
+G_BEGIN_DECLS
+
+
+/**
+ * GstPwVideoBufferPool:
+ *
+ * Opaque #GstPwVideoBufferPool structure.
+ */
+typedef struct _GstPwVideoBufferPool GstPwVideoBufferPool;
+typedef struct _GstPwVideoBufferPoolClass GstPwVideoBufferPoolClass;
+
+
+#define GST_TYPE_PW_VIDEO_BUFFER_POOL            (gst_pw_video_buffer_pool_get_type())
+#define GST_PW_VIDEO_BUFFER_POOL(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_PW_VIDEO_BUFFER_POOL, GstPwVideoBufferPool))
+#define GST_PW_VIDEO_BUFFER_POOL_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_PW_VIDEO_BUFFER_POOL, GstPwVideoBufferPoolClass))
+#define GST_PW_VIDEO_BUFFER_POOL_CAST(obj)       ((GstPwVideoBufferPool *)(obj))
+#define GST_IS_PW_VIDEO_BUFFER_POOL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_PW_VIDEO_BUFFER_POOL))
+#define GST_IS_PW_VIDEO_BUFFER_POOL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_PW_VIDEO_BUFFER_POOL))
+
+
+struct _GstPwVideoBufferPool
+{
+	GstBufferPool parent;
+
+	/*< private >*/
+
+	/* The loop and stream pointers are set to NULL by gst_pw_video_buffer_pool_detach(). */
+	struct pw_thread_loop *loop;
+	struct pw_stream *stream;
+	GstVideoInfo video_info;
+
+	GstAllocator *fd_allocator;
+	GstAllocator *dmabuf_allocator;
+
+	/* Buffers that were acquired and then released without having been
+	 * queued in the stream. They are handed out again before any more
+	 * pw_buffers are dequeued. */
+	GQueue available_buffers;
+	/* Number of pw_buffers that are associated with a GstBuffer. */
+	guint num_pw_buffers;
+
+	/* TRUE while acquiring buffers must not block. */
+	gboolean flushing;
+
+	/* Sequence number for the SPA header meta of the next queued buffer. */
+	guint64 next_seq_num;
+
+	/* Protects the states above. The cond is signaled when
+	 * new buffers may have become available, or when flushing. */
+	GMutex mutex;
+	GCond cond;
+};
+
+
+struct _GstPwVideoBufferPoolClass
+{
+	GstBufferPoolClass parent_class;
+};
+
+
+GType gst_pw_video_buffer_pool_get_type(void);
+
+/**
+ * gst_pw_video_buffer_pool_new:
+ * @core: #GstPipewireCore whose pw_thread_loop runs the stream's events.
+ * @stream: pw_stream whose buffers to hand out.
+ * @video_info: Video format of the stream.
+ *
+ * Creates a new #GstPwVideoBufferPool. The pool is initially empty; buffers
+ * are added once the stream's add_buffer events are forwarded to the pool.
+ *
+ * Returns: (transfer full): new #GstPwVideoBufferPool instance.
+ */
+GstPwVideoBufferPool* gst_pw_video_buffer_pool_new(GstPipewireCore *core, struct pw_stream *stream, GstVideoInfo const *video_info);
+
+/**
+ * gst_pw_video_buffer_pool_add_pw_buffer:
+ * @pool: The #GstPwVideoBufferPool.
+ * @pw_buffer: pw_buffer from the stream's add_buffer event.
+ *
+ * Wraps the memory of the pw_buffer in a #GstBuffer and associates the two.
+ * Must be called with the pw_thread_loop lock taken.
+ */
+void gst_pw_video_buffer_pool_add_pw_buffer(GstPwVideoBufferPool *pool, struct pw_buffer *pw_buffer);
+
+/**
+ * gst_pw_video_buffer_pool_remove_pw_buffer:
+ * @pool: The #GstPwVideoBufferPool.
+ * @pw_buffer: pw_buffer from the stream's remove_buffer event.
+ *
+ * Dissociates the pw_buffer from its #GstBuffer. If that #GstBuffer is
+ * currently acquired, it stays valid until it is released, but it can
+ * no longer be queued. Must be called with the pw_thread_loop lock taken.
+ */
+void gst_pw_video_buffer_pool_remove_pw_buffer(GstPwVideoBufferPool *pool, struct pw_buffer *pw_buffer);
+
+/**
+ * gst_pw_video_buffer_pool_is_pool_buffer:
+ * @pool: The #GstPwVideoBufferPool.
+ * @buffer: #GstBuffer to check.
+ *
+ * Returns: TRUE if the buffer was acquired from this pool, its memory was
+ * not replaced, and its pw_buffer still belongs to the stream.
+ */
+gboolean gst_pw_video_buffer_pool_is_pool_buffer(GstPwVideoBufferPool *pool, GstBuffer *buffer);
+
+/**
+ * gst_pw_video_buffer_pool_queue_buffer:
+ * @pool: The #GstPwVideoBufferPool.
+ * @buffer: #GstBuffer that was acquired from this pool.
+ * @pts: Presentation timestamp to store in the SPA header meta, in nanoseconds.
+ *
+ * Queues the pw_buffer that is associated with the buffer in the stream,
+ * which passes the frame on to the PipeWire graph without copying it.
+ * The buffer must not be modified after this call. Must be called with
+ * the pw_thread_loop lock taken.
+ *
+ * Returns: TRUE if the buffer was queued.
+ */
+gboolean gst_pw_video_buffer_pool_queue_buffer(GstPwVideoBufferPool *pool, GstBuffer *buffer, GstClockTime pts);
+
+/**
+ * gst_pw_video_buffer_pool_notify_process:
+ * @pool: The #GstPwVideoBufferPool.
+ *
+ * Wakes up acquisitions that are waiting for a buffer. Call this in the
+ * stream's process event, since that is when the stream may have a
+ * buffer available for dequeuing again.
+ */
+void gst_pw_video_buffer_pool_notify_process(GstPwVideoBufferPool *pool);
+
+/**
+ * gst_pw_video_buffer_pool_detach:
+ * @pool: The #GstPwVideoBufferPool.
+ *
+ * Detaches the pool from its stream. Call this after the stream was disconnected
+ * (so that its remove_buffer events were forwarded to the pool), and before the
+ * stream is destroyed. Any blocked and subsequent acquisitions return
+ * GST_FLOW_FLUSHING afterwards.
+ */
+void gst_pw_video_buffer_pool_detach(GstPwVideoBufferPool *pool);
+
+
+G_END_DECLS
+
+
+#endif /* __GST_PW_VIDEO_BUFFER_POOL_H__ */
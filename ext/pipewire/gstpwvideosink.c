@@ -0,0 +1,1301 @@
+/* gst-pipewire-extra
+ *
+ * Copyright © 2022 Carlos Rafael Giani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* This sink publishes video frames into a PipeWire graph. To avoid copying
+ * frames, it proposes a GstPwVideoBufferPool to upstream in the ALLOCATION
+ * query. That pool hands out buffers whose memory is that of the pw_stream's
+ * buffers (memfd memory, or DMA-BUF memory if the peer provides such buffers),
+ * so upstream renders directly into memory that is shared with the graph.
+ * show_frame() then only has to queue the pw_buffer in the stream. Frames in
+ * buffers from other sources are copied into a pool buffer first.
+ *
+ * Unlike the audio sink's process callback, the process callback here does not
+ * run in the realtime thread, since it does not have to produce data. It only
+ * updates the stream clock and wakes up threads that wait for a free buffer. */
+
+#include <gst/gst.h>
+/* Turn off -Wdeprecated-declarations to mask the "g_memdup is deprecated"
+ * warning (originating in gst/base/gstbytereader.h) that is present in
+ * many GStreamer installations. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <gst/base/base.h>
+#pragma GCC diagnostic pop
+#include <gst/video/video.h>
+
+#include <stdint.h>
+#include <string.h>
+
+/* Turn off -pedantic to mask the "ISO C forbids braced-groups within expressions"
+ * warnings that occur because PipeWire uses such braced-groups extensively. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#include <pipewire/pipewire.h>
+#include <spa/buffer/meta.h>
+#include <spa/param/video/format-utils.h>
+#pragma GCC diagnostic pop
+
+#include "gstpipewirecore.h"
+#include "gstpwstreamclock.h"
+#include "gstpwvideobufferpool.h"
+#include "gstpwvideosink.h"
+
+
+GST_DEBUG_CATEGORY(pw_video_sink_debug);
+#define GST_CAT_DEFAULT pw_video_sink_debug
+
+
+enum
+{
+	PROP_0,
+
+	PROP_TARGET_OBJECT_ID,
+	PROP_TARGET_NODE_NAME,
+	PROP_STREAM_PROPERTIES,
+	PROP_SOCKET_FD,
+	PROP_APP_NAME,
+	PROP_NODE_NAME,
+	PROP_NODE_DESCRIPTION,
+
+	PROP_LAST
+};
+
+
+#define DEFAULT_TARGET_OBJECT_ID PW_ID_ANY
+#define DEFAULT_TARGET_NODE_NAME NULL
+#define DEFAULT_STREAM_PROPERTIES NULL
+#define DEFAULT_SOCKET_FD (-1)
+#define DEFAULT_APP_NAME NULL
+#define DEFAULT_NODE_NAME NULL
+#define DEFAULT_NODE_DESCRIPTION NULL
+
+/* Range of the number of pw_buffers that the stream asks for in its
+ * SPA_PARAM_Buffers param. Upstream can hold on to some of them while
+ * others are being consumed by the graph, so there should be a few. */
+#define MIN_NUM_BUFFERS 2
+#define DEFAULT_NUM_BUFFERS 8
+#define MAX_NUM_BUFFERS 16
+
+#define SUPPORTED_VIDEO_FORMATS \
+	"{ BGRx, RGBx, xRGB, xBGR, BGRA, RGBA, ARGB, ABGR, RGB, BGR, " \
+	"I420, YV12, NV12, NV21, YUY2, UYVY, YVYU, AYUV, Y41B, Y42B, Y444, GRAY8 }"
+
+
+struct _GstPwVideoSink
+{
+	GstVideoSink parent;
+
+	/*< private >*/
+
+	/** Object properties **/
+
+	uint32_t target_object_id;
+	gchar *target_node_name;
+	GstStructure *stream_properties;
+	int socket_fd;
+	gchar *app_name;
+	gchar *node_name;
+	gchar *node_description;
+
+	/** Video format **/
+
+	GstVideoInfo video_info;
+
+	/** Buffer pool **/
+
+	/* Pool for the buffers of the current stream connection. A new pool is
+	 * created whenever the stream is (re)connected, since the stream's
+	 * buffers are then reallocated. Set in set_caps() and read in
+	 * propose_allocation(), so access requires the object lock. */
+	GstPwVideoBufferPool *pool;
+
+	/** Element clock **/
+
+	/* Element clock based on the pw_stream. Always available, since it gets timestamps
+	 * from the monotonic system clock and adjusts them according to the pw_stream
+	 * feedback (see the process callback). */
+	GstPwStreamClock *stream_clock;
+	/* True if the stream_clock is set as the pipeline clock.
+	 * Access to this field requires the object lock. */
+	gboolean stream_clock_is_pipeline_clock;
+	/* The graph clock rate from the previous process callback. If the
+	 * rate changes, the stream got moved to another driver. Only
+	 * accessed by the process callback. */
+	struct spa_fraction last_graph_clock_rate;
+
+	/** PipeWire specifics **/
+
+	GstPipewireCore *pipewire_core;
+	struct pw_stream *stream;
+	gboolean stream_is_connected;
+	struct spa_hook stream_listener;
+	gboolean stream_listener_added;
+};
+
+
+struct _GstPwVideoSinkClass
+{
+	GstVideoSinkClass parent_class;
+};
+
+
+G_DEFINE_TYPE(GstPwVideoSink, gst_pw_video_sink, GST_TYPE_VIDEO_SINK)
+
+
+static void gst_pw_video_sink_dispose(GObject *object);
+static void gst_pw_video_sink_finalize(GObject *object);
+static void gst_pw_video_sink_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec);
+static void gst_pw_video_sink_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+
+static GstStateChangeReturn gst_pw_video_sink_change_state(GstElement *element, GstStateChange transition);
+static GstClock* gst_pw_video_sink_provide_clock(GstElement *element);
+static gboolean gst_pw_video_sink_set_clock(GstElement *element, GstClock *clock);
+
+static gboolean gst_pw_video_sink_set_caps(GstBaseSink *basesink, GstCaps *caps);
+static gboolean gst_pw_video_sink_propose_allocation(GstBaseSink *basesink, GstQuery *query);
+static gboolean gst_pw_video_sink_start(GstBaseSink *basesink);
+static gboolean gst_pw_video_sink_stop(GstBaseSink *basesink);
+static gboolean gst_pw_video_sink_unlock(GstBaseSink *basesink);
+static gboolean gst_pw_video_sink_unlock_stop(GstBaseSink *basesink);
+
+static GstFlowReturn gst_pw_video_sink_show_frame(GstVideoSink *videosink, GstBuffer *buffer);
+
+static gboolean gst_pw_video_sink_get_spa_video_format(GstVideoFormat video_format, uint32_t *spa_video_format);
+static void gst_pw_video_sink_disconnect_stream(GstPwVideoSink *self);
+static void gst_pw_video_sink_drop_pool(GstPwVideoSink *self);
+
+static void gst_pw_video_sink_pw_state_changed(void *data, enum pw_stream_state old_state, enum pw_stream_state new_state, const char *error);
+static void gst_pw_video_sink_param_changed(void *data, uint32_t id, const struct spa_pod *param);
+static void gst_pw_video_sink_add_buffer(void *data, struct pw_buffer *pw_buffer);
+static void gst_pw_video_sink_remove_buffer(void *data, struct pw_buffer *pw_buffer);
+static void gst_pw_video_sink_on_process_stream(void *data);
+
+
+static const struct pw_stream_events stream_events =
+{
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = gst_pw_video_sink_pw_state_changed,
+	.param_changed = gst_pw_video_sink_param_changed,
+	.add_buffer = gst_pw_video_sink_add_buffer,
+	.remove_buffer = gst_pw_video_sink_remove_buffer,
+	.process = gst_pw_video_sink_on_process_stream,
+};
+
+
+
+
+static void gst_pw_video_sink_class_init(GstPwVideoSinkClass *klass)
+{
+	GObjectClass *object_class;
+	GstElementClass *element_class;
+	GstBaseSinkClass *base_sink_class;
+	GstVideoSinkClass *video_sink_class;
+	GstCaps *template_caps;
+
+	GST_DEBUG_CATEGORY_INIT(pw_video_sink_debug, "pwvideosink", 0, "PipeWire video sink");
+
+	object_class = G_OBJECT_CLASS(klass);
+	element_class = GST_ELEMENT_CLASS(klass);
+	base_sink_class = GST_BASE_SINK_CLASS(klass);
+	video_sink_class = GST_VIDEO_SINK_CLASS(klass);
+
+	template_caps = gst_caps_from_string(GST_VIDEO_CAPS_MAKE(SUPPORTED_VIDEO_FORMATS));
+	gst_element_class_add_pad_template(
+		element_class,
+		gst_pad_template_new(
+			"sink",
+			GST_PAD_SINK,
+			GST_PAD_ALWAYS,
+			template_caps
+		)
+	);
+	gst_caps_unref(template_caps);
+
+	object_class->dispose      = GST_DEBUG_FUNCPTR(gst_pw_video_sink_dispose);
+	object_class->finalize     = GST_DEBUG_FUNCPTR(gst_pw_video_sink_finalize);
+	object_class->set_property = GST_DEBUG_FUNCPTR(gst_pw_video_sink_set_property);
+	object_class->get_property = GST_DEBUG_FUNCPTR(gst_pw_video_sink_get_property);
+
+	element_class->change_state  = GST_DEBUG_FUNCPTR(gst_pw_video_sink_change_state);
+	element_class->provide_clock = GST_DEBUG_FUNCPTR(gst_pw_video_sink_provide_clock);
+	element_class->set_clock     = GST_DEBUG_FUNCPTR(gst_pw_video_sink_set_clock);
+
+	base_sink_class->set_caps           = GST_DEBUG_FUNCPTR(gst_pw_video_sink_set_caps);
+	base_sink_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_pw_video_sink_propose_allocation);
+	base_sink_class->start              = GST_DEBUG_FUNCPTR(gst_pw_video_sink_start);
+	base_sink_class->stop               = GST_DEBUG_FUNCPTR(gst_pw_video_sink_stop);
+	base_sink_class->unlock             = GST_DEBUG_FUNCPTR(gst_pw_video_sink_unlock);
+	base_sink_class->unlock_stop        = GST_DEBUG_FUNCPTR(gst_pw_video_sink_unlock_stop);
+
+	video_sink_class->show_frame = GST_DEBUG_FUNCPTR(gst_pw_video_sink_show_frame);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_TARGET_OBJECT_ID,
+		g_param_spec_uint(
+			"target-object-id",
+			"Target object ID",
+			"PipeWire target object id to connect to (default = let the PipeWire manager select a target)",
+			0, G_MAXUINT,
+			DEFAULT_TARGET_OBJECT_ID,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_TARGET_NODE_NAME,
+		g_param_spec_string(
+			"target-node-name",
+			"Target node name",
+			"Name of the PipeWire node to connect to; takes precedence over target-object-id if set "
+			"(default = use target-object-id)",
+			DEFAULT_TARGET_NODE_NAME,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_STREAM_PROPERTIES,
+		g_param_spec_boxed(
+			"stream-properties",
+			"Stream properties",
+			"List of PipeWire stream properties to add to this sink's client PipeWire node",
+			GST_TYPE_STRUCTURE,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_SOCKET_FD,
+		g_param_spec_int(
+			"socket-fd",
+			"Socket file descriptor",
+			"File descriptor of connected socket to use for communicating with the PipeWire daemon (-1 = open custom internal socket)",
+			-1, G_MAXINT,
+			DEFAULT_SOCKET_FD,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_APP_NAME,
+		g_param_spec_string(
+			"app-name",
+			"App name",
+			"Name of the application that uses this sink; example: \"Screen Recorder\" (NULL = default)",
+			DEFAULT_APP_NAME,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_NODE_NAME,
+		g_param_spec_string(
+			"node-name",
+			"Node name",
+			"Name to use for this sink's client PipeWire node (NULL = default)",
+			DEFAULT_NODE_NAME,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_NODE_DESCRIPTION,
+		g_param_spec_string(
+			"node-description",
+			"Node description",
+			"One-line human readable description of this sink's client PipeWire node; example: \"Rendered scene\" (NULL = default)",
+			DEFAULT_NODE_DESCRIPTION,
+			(GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
+
+	gst_element_class_set_static_metadata(
+		element_class,
+		"pwvideosink",
+		"Sink/Video",
+		"Sink for publishing video frames in a PipeWire graph",
+		"Carlos Rafael Giani <crg7475@mailbox.org>"
+	);
+}
+
+
+static void gst_pw_video_sink_init(GstPwVideoSink *self)
+{
+	self->target_object_id = DEFAULT_TARGET_OBJECT_ID;
+	self->target_node_name = g_strdup(DEFAULT_TARGET_NODE_NAME);
+	self->stream_properties = DEFAULT_STREAM_PROPERTIES;
+	self->socket_fd = DEFAULT_SOCKET_FD;
+	self->app_name = g_strdup(DEFAULT_APP_NAME);
+	self->node_name = g_strdup(DEFAULT_NODE_NAME);
+	self->node_description = g_strdup(DEFAULT_NODE_DESCRIPTION);
+
+	gst_video_info_init(&(self->video_info));
+
+	self->pool = NULL;
+
+	self->stream_clock = gst_pw_stream_clock_new(NULL);
+	g_assert(self->stream_clock != NULL);
+	self->stream_clock_is_pipeline_clock = FALSE;
+	self->last_graph_clock_rate = SPA_FRACTION(0, 0);
+
+	self->pipewire_core = NULL;
+	self->stream = NULL;
+	self->stream_is_connected = FALSE;
+	self->stream_listener_added = FALSE;
+
+	GST_OBJECT_FLAG_SET(self, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
+}
+
+
+static void gst_pw_video_sink_dispose(GObject *object)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(object);
+
+	gst_pw_video_sink_drop_pool(self);
+
+	if (self->stream_clock != NULL)
+	{
+		gst_object_unref(GST_OBJECT(self->stream_clock));
+		self->stream_clock = NULL;
+	}
+
+	G_OBJECT_CLASS(gst_pw_video_sink_parent_class)->dispose(object);
+}
+
+
+static void gst_pw_video_sink_finalize(GObject *object)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(object);
+
+	g_free(self->node_description);
+	g_free(self->node_name);
+	g_free(self->app_name);
+	g_free(self->target_node_name);
+	if (self->stream_properties != NULL)
+		gst_structure_free(self->stream_properties);
+
+	G_OBJECT_CLASS(gst_pw_video_sink_parent_class)->finalize(object);
+}
+
+
+static void gst_pw_video_sink_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(object);
+
+	switch (prop_id)
+	{
+		case PROP_TARGET_OBJECT_ID:
+			GST_OBJECT_LOCK(self);
+			self->target_object_id = g_value_get_uint(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_TARGET_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_free(self->target_node_name);
+			self->target_node_name = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_STREAM_PROPERTIES:
+		{
+			GstStructure const *new_structure;
+
+			GST_OBJECT_LOCK(self);
+
+			if (self->stream_properties != NULL)
+				gst_structure_free(self->stream_properties);
+
+			new_structure = gst_value_get_structure(value);
+
+			if (new_structure != NULL)
+				self->stream_properties = gst_structure_copy(new_structure);
+			else
+				self->stream_properties = NULL;
+
+			GST_OBJECT_UNLOCK(self);
+
+			break;
+		}
+
+		case PROP_SOCKET_FD:
+			GST_OBJECT_LOCK(self);
+			self->socket_fd = g_value_get_int(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_APP_NAME:
+			GST_OBJECT_LOCK(self);
+			g_free(self->app_name);
+			self->app_name = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_free(self->node_name);
+			self->node_name = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_NODE_DESCRIPTION:
+			GST_OBJECT_LOCK(self);
+			g_free(self->node_description);
+			self->node_description = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+static void gst_pw_video_sink_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(object);
+
+	switch (prop_id)
+	{
+		case PROP_TARGET_OBJECT_ID:
+			GST_OBJECT_LOCK(self);
+			g_value_set_uint(value, self->target_object_id);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_TARGET_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->target_node_name);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_STREAM_PROPERTIES:
+			GST_OBJECT_LOCK(self);
+			gst_value_set_structure(value, self->stream_properties);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_SOCKET_FD:
+			GST_OBJECT_LOCK(self);
+			g_value_set_int(value, self->socket_fd);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_APP_NAME:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->app_name);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_NODE_NAME:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->node_name);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		case PROP_NODE_DESCRIPTION:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->node_description);
+			GST_OBJECT_UNLOCK(self);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+static GstStateChangeReturn gst_pw_video_sink_change_state(GstElement *element, GstStateChange transition)
+{
+	GstStateChangeReturn result;
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(element);
+
+	result = GST_ELEMENT_CLASS(gst_pw_video_sink_parent_class)->change_state(element, transition);
+
+	GST_DEBUG_OBJECT(
+		self,
+		"state change %s result: %s",
+		gst_state_change_get_name(transition),
+		gst_element_state_change_return_get_name(result)
+	);
+
+	switch (transition)
+	{
+		case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+			/* Freeze the stream clock to bridge the gap caused by the pause.
+			 * See gst_pw_audio_sink_change_state() for the details. */
+			gst_pw_stream_clock_freeze(self->stream_clock);
+			break;
+
+		default:
+			break;
+	}
+
+	return result;
+}
+
+
+static GstClock* gst_pw_video_sink_provide_clock(GstElement *element)
+{
+	GstClock *clock = NULL;
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(element);
+
+	GST_OBJECT_LOCK(self);
+	clock = GST_CLOCK_CAST(gst_object_ref(self->stream_clock));
+	GST_OBJECT_UNLOCK(self);
+
+	return clock;
+}
+
+
+static gboolean gst_pw_video_sink_set_clock(GstElement *element, GstClock *clock)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(element);
+
+	GST_OBJECT_LOCK(self);
+	self->stream_clock_is_pipeline_clock = (clock == GST_CLOCK_CAST(self->stream_clock));
+	GST_OBJECT_UNLOCK(self);
+
+	GST_DEBUG_OBJECT(
+		self,
+		"pipeline is setting clock %" GST_PTR_FORMAT " as the element's clock; is the PW stream clock %" GST_PTR_FORMAT ": %d",
+		(gpointer)clock,
+		(gpointer)(self->stream_clock),
+		self->stream_clock_is_pipeline_clock
+	);
+
+	return GST_ELEMENT_CLASS(gst_pw_video_sink_parent_class)->set_clock(element, clock);
+}
+
+
+static gboolean gst_pw_video_sink_set_caps(GstBaseSink *basesink, GstCaps *caps)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(basesink);
+	gboolean ret = TRUE;
+	struct spa_pod const *params[1];
+	struct spa_video_info_raw spa_video_info;
+	enum pw_stream_state state;
+	char const *error_str = NULL;
+	uint32_t target_object_id;
+	gchar *target_node_name = NULL;
+	gboolean pw_thread_loop_locked = FALSE;
+	guint8 builder_buffer[1024];
+	struct spa_pod_builder builder = SPA_POD_BUILDER_INIT(builder_buffer, sizeof(builder_buffer));
+	GstPwVideoBufferPool *new_pool;
+
+	GST_DEBUG_OBJECT(self, "got new sink caps %" GST_PTR_FORMAT, (gpointer)caps);
+
+	gst_pw_video_sink_disconnect_stream(self);
+
+	/* Freeze the clock _after_ disconnecting. Otherwise, the process
+	 * callback could update the clock after it was frozen. */
+	gst_pw_stream_clock_freeze(self->stream_clock);
+
+	/* After disconnecting we remove the listener if it was previously added.
+	 * This is important, otherwise the stream accumulates listeners -
+	 * we only want one to be in use. */
+	if (self->stream_listener_added)
+	{
+		spa_hook_remove(&(self->stream_listener));
+		self->stream_listener_added = FALSE;
+	}
+
+	/* The previous pool was detached when the stream was disconnected. */
+	gst_pw_video_sink_drop_pool(self);
+
+	if (!gst_video_info_from_caps(&(self->video_info), caps))
+	{
+		GST_ERROR_OBJECT(self, "could not convert caps to video info");
+		goto error;
+	}
+
+	memset(&spa_video_info, 0, sizeof(spa_video_info));
+
+	if (!gst_pw_video_sink_get_spa_video_format(GST_VIDEO_INFO_FORMAT(&(self->video_info)), &(spa_video_info.format)))
+	{
+		GST_ERROR_OBJECT(self, "unsupported video format %s", gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&(self->video_info))));
+		goto error;
+	}
+
+	spa_video_info.size = SPA_RECTANGLE(GST_VIDEO_INFO_WIDTH(&(self->video_info)), GST_VIDEO_INFO_HEIGHT(&(self->video_info)));
+	spa_video_info.framerate = SPA_FRACTION(GST_VIDEO_INFO_FPS_N(&(self->video_info)), GST_VIDEO_INFO_FPS_D(&(self->video_info)));
+
+	params[0] = spa_format_video_raw_build(&builder, SPA_PARAM_EnumFormat, &spa_video_info);
+	if (G_UNLIKELY(params[0] == NULL))
+	{
+		GST_ERROR_OBJECT(self, "could not build SPA video format POD");
+		goto error;
+	}
+
+	/* The pool must exist before connecting, since
+	 * the add_buffer events are forwarded to it. */
+	new_pool = gst_pw_video_buffer_pool_new(self->pipewire_core, self->stream, &(self->video_info));
+	GST_OBJECT_LOCK(self);
+	self->pool = new_pool;
+	GST_OBJECT_UNLOCK(self);
+
+	/* Get GObject property values. */
+	GST_OBJECT_LOCK(self);
+	target_object_id = self->target_object_id;
+	target_node_name = g_strdup(self->target_node_name);
+	GST_OBJECT_UNLOCK(self);
+
+	/* See gst_pw_audio_sink_set_caps() for why a
+	 * target node name disables the target object ID. */
+	if (target_node_name != NULL)
+		target_object_id = PW_ID_ANY;
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+	pw_thread_loop_locked = TRUE;
+
+	state = pw_stream_get_state(self->stream, &error_str);
+	if (state == PW_STREAM_STATE_ERROR)
+	{
+		GST_ERROR_OBJECT(self, "cannot start stream - PW stream is in an error state: %s", error_str);
+		goto error;
+	}
+
+	pw_stream_add_listener(
+		self->stream,
+		&(self->stream_listener),
+		&stream_events,
+		self
+	);
+	self->stream_listener_added = TRUE;
+
+	if (target_node_name != NULL)
+	{
+		struct spa_dict_item items[1];
+
+		GST_DEBUG_OBJECT(self, "setting the target.object property to \"%s\"", target_node_name);
+		items[0] = SPA_DICT_ITEM_INIT(PW_KEY_TARGET_OBJECT, target_node_name);
+		pw_stream_update_properties(self->stream, &SPA_DICT_INIT(items, 1));
+	}
+
+	/* Pick the stream connection flags.
+	 *
+	 * - PW_STREAM_FLAG_AUTOCONNECT to tell the session manager to link this client to a consumer.
+	 *
+	 * PW_STREAM_FLAG_MAP_BUFFERS is deliberately not used. The pw_buffers' memory is
+	 * mapped by the GstFdMemory / GstDmaBufMemory instances that wrap it instead.
+	 * PW_STREAM_FLAG_RT_PROCESS is not used either, since the process callback does
+	 * not produce any data, so there is no need to run it in the realtime thread.
+	 */
+	pw_stream_connect(
+		self->stream,
+		PW_DIRECTION_OUTPUT,
+		target_object_id,
+		PW_STREAM_FLAG_AUTOCONNECT,
+		params, 1
+	);
+
+	state = pw_stream_get_state(self->stream, &error_str);
+	if (state == PW_STREAM_STATE_ERROR)
+	{
+		GST_ERROR_OBJECT(self, "cannot start stream - PW stream is in an error state: %s", error_str);
+		goto error;
+	}
+
+	self->stream_is_connected = TRUE;
+
+finish:
+	if (pw_thread_loop_locked)
+		pw_thread_loop_unlock(self->pipewire_core->loop);
+	g_free(target_node_name);
+	return ret;
+
+error:
+	ret = FALSE;
+	goto finish;
+}
+
+
+static gboolean gst_pw_video_sink_propose_allocation(GstBaseSink *basesink, GstQuery *query)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(basesink);
+	GstCaps *caps;
+	gboolean need_pool;
+	GstVideoInfo video_info;
+	GstPwVideoBufferPool *pool = NULL;
+
+	gst_query_parse_allocation(query, &caps, &need_pool);
+
+	if (G_UNLIKELY(caps == NULL))
+	{
+		GST_DEBUG_OBJECT(self, "no caps in allocation query");
+		return FALSE;
+	}
+
+	if (!gst_video_info_from_caps(&video_info, caps))
+	{
+		GST_DEBUG_OBJECT(self, "could not convert allocation query caps to video info");
+		return FALSE;
+	}
+
+	GST_OBJECT_LOCK(self);
+	if (self->pool != NULL)
+		pool = GST_PW_VIDEO_BUFFER_POOL(gst_object_ref(GST_OBJECT(self->pool)));
+	GST_OBJECT_UNLOCK(self);
+
+	/* The pool only contains buffers for the current format,
+	 * so it is only proposed if the query is about that format. */
+	if (need_pool && (pool != NULL) && gst_video_info_is_equal(&video_info, &(self->video_info)))
+	{
+		GST_DEBUG_OBJECT(self, "proposing PipeWire video buffer pool %" GST_PTR_FORMAT, (gpointer)pool);
+		gst_query_add_allocation_pool(query, GST_BUFFER_POOL_CAST(pool), GST_VIDEO_INFO_SIZE(&video_info), MIN_NUM_BUFFERS, 0);
+	}
+
+	if (pool != NULL)
+		gst_object_unref(GST_OBJECT(pool));
+
+	gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+
+	return TRUE;
+}
+
+
+static gboolean copy_stream_properties_to_pw_props(GQuark field_id, GValue const *value, gpointer data)
+{
+	struct pw_properties *pw_props = (struct pw_properties *)data;
+	GValue stringified_gvalue = G_VALUE_INIT;
+
+	if (g_value_type_transformable(G_VALUE_TYPE(value), G_TYPE_STRING))
+	{
+		g_value_init(&stringified_gvalue, G_TYPE_STRING);
+
+		if (g_value_transform(value, &stringified_gvalue))
+			pw_properties_set(pw_props, g_quark_to_string(field_id), g_value_get_string(&stringified_gvalue));
+
+		g_value_unset(&stringified_gvalue);
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_pw_video_sink_start(GstBaseSink *basesink)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(basesink);
+	gboolean retval = TRUE;
+	int socket_fd;
+	struct pw_properties *pw_props;
+	gchar *stream_media_name = NULL;
+
+	GST_OBJECT_LOCK(self);
+
+	/* Get GObject property values. */
+	socket_fd = self->socket_fd;
+
+	self->pipewire_core = gst_pipewire_core_get(socket_fd);
+
+	GST_OBJECT_UNLOCK(self);
+
+	if (G_UNLIKELY(self->pipewire_core == NULL))
+	{
+		GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ_WRITE, ("Could not get PipeWire core"), (NULL));
+		goto error;
+	}
+
+	GST_DEBUG_OBJECT(self, "creating new PipeWire stream");
+
+	/* Announce the stream as a video source, so that consumers
+	 * (like screen sharing clients) can find and link to it. */
+	pw_props = pw_properties_new(
+		PW_KEY_MEDIA_TYPE, "Video",
+		PW_KEY_MEDIA_CATEGORY, "Playback",
+		PW_KEY_MEDIA_CLASS, "Video/Source",
+		NULL
+	);
+
+	GST_OBJECT_LOCK(self);
+
+	if (self->app_name != NULL)
+	{
+		pw_properties_set(pw_props, PW_KEY_APP_NAME, self->app_name);
+		GST_DEBUG_OBJECT(self, "app name for the new PipeWire stream: %s", self->app_name);
+	}
+
+	if (self->node_name != NULL)
+	{
+		pw_properties_set(pw_props, PW_KEY_NODE_NAME, self->node_name);
+		GST_DEBUG_OBJECT(self, "node name for the new PipeWire stream: %s", self->node_name);
+	}
+
+	if (self->node_description != NULL)
+	{
+		pw_properties_set(pw_props, PW_KEY_NODE_DESCRIPTION, self->node_description);
+		GST_DEBUG_OBJECT(self, "node description for the new PipeWire stream: %s", self->node_description);
+	}
+
+	if (self->stream_properties != NULL)
+	{
+		gst_structure_foreach(self->stream_properties, copy_stream_properties_to_pw_props, pw_props);
+		GST_DEBUG_OBJECT(self, "extra properties for the new PipeWire stream: %" GST_PTR_FORMAT, (gpointer)(self->stream_properties));
+	}
+
+	/* Reuse the node name as the stream name. */
+	stream_media_name = g_strdup(self->node_name);
+
+	GST_OBJECT_UNLOCK(self);
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+	self->stream = pw_stream_new(self->pipewire_core->core, stream_media_name, pw_props);
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+	if (G_UNLIKELY(self->stream == NULL))
+	{
+		GST_ERROR_OBJECT(self, "could not create PipeWire stream");
+		goto error;
+	}
+
+	GST_DEBUG_OBJECT(self, "PipeWire stream successfully created");
+
+finish:
+	g_free(stream_media_name);
+	return retval;
+
+error:
+	gst_pw_video_sink_stop(basesink);
+	retval = FALSE;
+	goto finish;
+}
+
+
+static gboolean gst_pw_video_sink_stop(GstBaseSink *basesink)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(basesink);
+	gboolean stream_clock_is_pipeline_clock;
+
+	if (self->stream != NULL)
+	{
+		GST_DEBUG_OBJECT(self, "disconnecting and destroying PipeWire stream");
+		gst_pw_video_sink_disconnect_stream(self);
+
+		pw_thread_loop_lock(self->pipewire_core->loop);
+		pw_stream_destroy(self->stream);
+		pw_thread_loop_unlock(self->pipewire_core->loop);
+
+		self->stream = NULL;
+	}
+
+	gst_pw_video_sink_drop_pool(self);
+
+	if (self->pipewire_core != NULL)
+	{
+		GST_DEBUG_OBJECT(self, "releasing PipeWire core");
+		gst_pipewire_core_release(self->pipewire_core);
+		self->pipewire_core = NULL;
+	}
+
+	GST_OBJECT_LOCK(self);
+	stream_clock_is_pipeline_clock = self->stream_clock_is_pipeline_clock;
+	self->stream_clock_is_pipeline_clock = FALSE;
+	GST_OBJECT_UNLOCK(self);
+
+	/* Recreate the stream clock. This is the only way
+	 * to fully reset _all_ internal states, including
+	 * the states of the clock base classes. */
+	if (self->stream_clock != NULL)
+	{
+		/* Announce to the pipeline that the previous clock
+		 * is lost and not valid anymore. See the equivalent
+		 * code in gst_pw_audio_sink_stop() for details. */
+		if (stream_clock_is_pipeline_clock)
+		{
+			gst_element_post_message(
+				GST_ELEMENT_CAST(self),
+				gst_message_new_clock_lost(
+					GST_OBJECT_CAST(self),
+					GST_CLOCK_CAST(self->stream_clock)
+				)
+			);
+		}
+
+		gst_object_unref(GST_OBJECT(self->stream_clock));
+		self->stream_clock = gst_pw_stream_clock_new(NULL);
+		g_assert(self->stream_clock != NULL);
+	}
+
+	self->last_graph_clock_rate = SPA_FRACTION(0, 0);
+	self->stream_listener_added = FALSE;
+
+	return TRUE;
+}
+
+
+static gboolean gst_pw_video_sink_unlock(GstBaseSink *basesink)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(basesink);
+	GstBufferPool *pool = NULL;
+
+	/* Upstream, as well as show_frame(), may be waiting for
+	 * a free buffer from the pool. Wake them up. */
+
+	GST_OBJECT_LOCK(self);
+	if (self->pool != NULL)
+		pool = GST_BUFFER_POOL_CAST(gst_object_ref(GST_OBJECT(self->pool)));
+	GST_OBJECT_UNLOCK(self);
+
+	if (pool != NULL)
+	{
+		GST_DEBUG_OBJECT(self, "setting buffer pool to flushing");
+		if (gst_buffer_pool_is_active(pool))
+			gst_buffer_pool_set_flushing(pool, TRUE);
+		gst_object_unref(GST_OBJECT(pool));
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_pw_video_sink_unlock_stop(GstBaseSink *basesink)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(basesink);
+	GstBufferPool *pool = NULL;
+
+	GST_OBJECT_LOCK(self);
+	if (self->pool != NULL)
+		pool = GST_BUFFER_POOL_CAST(gst_object_ref(GST_OBJECT(self->pool)));
+	GST_OBJECT_UNLOCK(self);
+
+	if (pool != NULL)
+	{
+		GST_DEBUG_OBJECT(self, "setting buffer pool to not flushing");
+		if (gst_buffer_pool_is_active(pool))
+			gst_buffer_pool_set_flushing(pool, FALSE);
+		gst_object_unref(GST_OBJECT(pool));
+	}
+
+	return TRUE;
+}
+
+
+static GstFlowReturn gst_pw_video_sink_show_frame(GstVideoSink *videosink, GstBuffer *buffer)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK(videosink);
+	GstBaseSink *basesink = GST_BASE_SINK(videosink);
+	GstBufferPool *pool;
+	GstBuffer *frame_buffer = NULL;
+	GstClockTime pts;
+	GstFlowReturn flow_ret = GST_FLOW_OK;
+	gboolean queued;
+
+	if (G_UNLIKELY(!self->stream_is_connected || (self->pool == NULL)))
+	{
+		GST_ELEMENT_ERROR(self, CORE, NEGOTIATION, ("Stream not connected"), ("caps were not set"));
+		return GST_FLOW_NOT_NEGOTIATED;
+	}
+
+	pool = GST_BUFFER_POOL_CAST(self->pool);
+
+	if (gst_pw_video_buffer_pool_is_pool_buffer(self->pool, buffer))
+	{
+		/* Upstream rendered the frame directly into a pw_buffer. */
+		frame_buffer = gst_buffer_ref(buffer);
+	}
+	else
+	{
+		GstBufferPoolAcquireParams acquire_params = { 0 };
+		GstVideoFrame src_frame, dest_frame;
+		gboolean copied;
+
+		if (!gst_buffer_pool_is_active(pool) && !gst_buffer_pool_set_active(pool, TRUE))
+		{
+			GST_ELEMENT_ERROR(self, RESOURCE, SETTINGS, ("Could not activate buffer pool"), (NULL));
+			return GST_FLOW_ERROR;
+		}
+
+		/* Do not wait for a free buffer. Frames that arrive while all pw_buffers
+		 * are in use (or while the stream has none, because it is not linked
+		 * yet) are dropped, like a display would skip them. */
+		acquire_params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+		flow_ret = gst_buffer_pool_acquire_buffer(pool, &frame_buffer, &acquire_params);
+		if (flow_ret == GST_FLOW_EOS)
+		{
+			GST_LOG_OBJECT(self, "no free pw_buffer; dropping frame");
+			return GST_FLOW_OK;
+		}
+		else if (flow_ret != GST_FLOW_OK)
+		{
+			GST_DEBUG_OBJECT(self, "could not acquire buffer from pool: %s", gst_flow_get_name(flow_ret));
+			return flow_ret;
+		}
+
+		if (!gst_pw_video_buffer_pool_is_pool_buffer(self->pool, frame_buffer))
+		{
+			GST_LOG_OBJECT(self, "stream has no pw_buffers yet; dropping frame");
+			gst_buffer_unref(frame_buffer);
+			return GST_FLOW_OK;
+		}
+
+		if (!gst_video_frame_map(&src_frame, &(self->video_info), buffer, GST_MAP_READ))
+		{
+			GST_ERROR_OBJECT(self, "could not map input frame");
+			gst_buffer_unref(frame_buffer);
+			return GST_FLOW_ERROR;
+		}
+
+		if (!gst_video_frame_map(&dest_frame, &(self->video_info), frame_buffer, GST_MAP_WRITE))
+		{
+			GST_ERROR_OBJECT(self, "could not map pw_buffer frame");
+			gst_video_frame_unmap(&src_frame);
+			gst_buffer_unref(frame_buffer);
+			return GST_FLOW_ERROR;
+		}
+
+		copied = gst_video_frame_copy(&dest_frame, &src_frame);
+
+		gst_video_frame_unmap(&dest_frame);
+		gst_video_frame_unmap(&src_frame);
+
+		if (G_UNLIKELY(!copied))
+		{
+			GST_ERROR_OBJECT(self, "could not copy frame into pw_buffer");
+			gst_buffer_unref(frame_buffer);
+			return GST_FLOW_ERROR;
+		}
+
+		if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT))
+			GST_BUFFER_FLAG_SET(frame_buffer, GST_BUFFER_FLAG_DISCONT);
+
+		GST_LOG_OBJECT(self, "copied frame from non-pool buffer %" GST_PTR_FORMAT, (gpointer)buffer);
+	}
+
+	/* Consumers expect the timestamps in the SPA header meta to be in
+	 * the clock time domain, so translate the PTS to clock time. */
+	pts = GST_BUFFER_PTS(buffer);
+	if (GST_CLOCK_TIME_IS_VALID(pts))
+	{
+		pts = gst_segment_to_running_time(&(basesink->segment), GST_FORMAT_TIME, pts);
+		if (GST_CLOCK_TIME_IS_VALID(pts))
+			pts += gst_element_get_base_time(GST_ELEMENT_CAST(self));
+	}
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+
+	queued = gst_pw_video_buffer_pool_queue_buffer(self->pool, frame_buffer, pts);
+
+	/* If no other node drives the graph, this stream does, and
+	 * it has to trigger the graph cycle that consumes the frame. */
+	if (queued && pw_stream_is_driving(self->stream))
+		pw_stream_trigger_process(self->stream);
+
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+
+	if (queued)
+		GST_LOG_OBJECT(self, "queued frame with PTS %" GST_TIME_FORMAT, GST_TIME_ARGS(pts));
+	else
+		GST_DEBUG_OBJECT(self, "could not queue frame; dropping it");
+
+	gst_buffer_unref(frame_buffer);
+
+	return GST_FLOW_OK;
+}
+
+
+static gboolean gst_pw_video_sink_get_spa_video_format(GstVideoFormat video_format, uint32_t *spa_video_format)
+{
+	switch (video_format)
+	{
+		case GST_VIDEO_FORMAT_BGRx: *spa_video_format = SPA_VIDEO_FORMAT_BGRx; break;
+		case GST_VIDEO_FORMAT_RGBx: *spa_video_format = SPA_VIDEO_FORMAT_RGBx; break;
+		case GST_VIDEO_FORMAT_xRGB: *spa_video_format = SPA_VIDEO_FORMAT_xRGB; break;
+		case GST_VIDEO_FORMAT_xBGR: *spa_video_format = SPA_VIDEO_FORMAT_xBGR; break;
+		case GST_VIDEO_FORMAT_BGRA: *spa_video_format = SPA_VIDEO_FORMAT_BGRA; break;
+		case GST_VIDEO_FORMAT_RGBA: *spa_video_format = SPA_VIDEO_FORMAT_RGBA; break;
+		case GST_VIDEO_FORMAT_ARGB: *spa_video_format = SPA_VIDEO_FORMAT_ARGB; break;
+		case GST_VIDEO_FORMAT_ABGR: *spa_video_format = SPA_VIDEO_FORMAT_ABGR; break;
+		case GST_VIDEO_FORMAT_RGB: *spa_video_format = SPA_VIDEO_FORMAT_RGB; break;
+		case GST_VIDEO_FORMAT_BGR: *spa_video_format = SPA_VIDEO_FORMAT_BGR; break;
+		case GST_VIDEO_FORMAT_I420: *spa_video_format = SPA_VIDEO_FORMAT_I420; break;
+		case GST_VIDEO_FORMAT_YV12: *spa_video_format = SPA_VIDEO_FORMAT_YV12; break;
+		case GST_VIDEO_FORMAT_NV12: *spa_video_format = SPA_VIDEO_FORMAT_NV12; break;
+		case GST_VIDEO_FORMAT_NV21: *spa_video_format = SPA_VIDEO_FORMAT_NV21; break;
+		case GST_VIDEO_FORMAT_YUY2: *spa_video_format = SPA_VIDEO_FORMAT_YUY2; break;
+		case GST_VIDEO_FORMAT_UYVY: *spa_video_format = SPA_VIDEO_FORMAT_UYVY; break;
+		case GST_VIDEO_FORMAT_YVYU: *spa_video_format = SPA_VIDEO_FORMAT_YVYU; break;
+		case GST_VIDEO_FORMAT_AYUV: *spa_video_format = SPA_VIDEO_FORMAT_AYUV; break;
+		case GST_VIDEO_FORMAT_Y41B: *spa_video_format = SPA_VIDEO_FORMAT_Y41B; break;
+		case GST_VIDEO_FORMAT_Y42B: *spa_video_format = SPA_VIDEO_FORMAT_Y42B; break;
+		case GST_VIDEO_FORMAT_Y444: *spa_video_format = SPA_VIDEO_FORMAT_Y444; break;
+		case GST_VIDEO_FORMAT_GRAY8: *spa_video_format = SPA_VIDEO_FORMAT_GRAY8; break;
+		default: return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static void gst_pw_video_sink_disconnect_stream(GstPwVideoSink *self)
+{
+	if (!self->stream_is_connected)
+		return;
+
+	/* Disconnecting emits the remove_buffer events, which are forwarded
+	 * to the pool. Detach the pool afterwards, since the pool must not
+	 * access the stream anymore once it is disconnected. */
+
+	pw_thread_loop_lock(self->pipewire_core->loop);
+	pw_stream_disconnect(self->stream);
+	pw_thread_loop_unlock(self->pipewire_core->loop);
+
+	if (self->pool != NULL)
+		gst_pw_video_buffer_pool_detach(self->pool);
+
+	self->stream_is_connected = FALSE;
+}
+
+
+static void gst_pw_video_sink_drop_pool(GstPwVideoSink *self)
+{
+	GstPwVideoBufferPool *pool;
+
+	GST_OBJECT_LOCK(self);
+	pool = self->pool;
+	self->pool = NULL;
+	GST_OBJECT_UNLOCK(self);
+
+	if (pool == NULL)
+		return;
+
+	/* Upstream may still hold a reference to the pool and to some of
+	 * its buffers. These stay valid, since their memory is kept alive by
+	 * the wrapped FDs, but they can no longer be passed to the graph. */
+	gst_pw_video_buffer_pool_detach(pool);
+	gst_object_unref(GST_OBJECT(pool));
+}
+
+
+static void gst_pw_video_sink_pw_state_changed(void *data, enum pw_stream_state old_state, enum pw_stream_state new_state, const char *error)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK_CAST(data);
+
+	GST_DEBUG_OBJECT(
+		self,
+		"PipeWire state changed:  old: %s  new: %s  error: \"%s\"",
+		pw_stream_state_as_string(old_state),
+		pw_stream_state_as_string(new_state),
+		(error == NULL) ? "<none>" : error
+	);
+
+	if (new_state == PW_STREAM_STATE_ERROR)
+		GST_ELEMENT_ERROR(self, RESOURCE, WRITE, ("PipeWire stream error"), ("%s", (error == NULL) ? "<unknown>" : error));
+}
+
+
+static void gst_pw_video_sink_param_changed(void *data, uint32_t id, const struct spa_pod *param)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK_CAST(data);
+	struct spa_pod const *params[2];
+	guint8 builder_buffer[1024];
+	struct spa_pod_builder builder = SPA_POD_BUILDER_INIT(builder_buffer, sizeof(builder_buffer));
+
+	if ((id != SPA_PARAM_Format) || (param == NULL))
+		return;
+
+	/* The EnumFormat param contains exactly one fixed format, so the
+	 * negotiated format is the one from the caps. Now that it is set,
+	 * request buffers that fit an entire frame in one block, laid out
+	 * as described by the video info. MemFd and DmaBuf memory can be
+	 * shared without copying, and are wrapped in GstFdMemory and
+	 * GstDmaBufMemory respectively by the pool. MemPtr is accepted as
+	 * a fallback; such memory is wrapped directly. Also request header
+	 * metas, since these carry the frame timestamps. */
+
+	params[0] = spa_pod_builder_add_object(
+		&builder,
+		SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+		SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(DEFAULT_NUM_BUFFERS, MIN_NUM_BUFFERS, MAX_NUM_BUFFERS),
+		SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
+		SPA_PARAM_BUFFERS_size, SPA_POD_Int(GST_VIDEO_INFO_SIZE(&(self->video_info))),
+		SPA_PARAM_BUFFERS_stride, SPA_POD_Int(GST_VIDEO_INFO_PLANE_STRIDE(&(self->video_info), 0)),
+		SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int((1 << SPA_DATA_MemFd) | (1 << SPA_DATA_DmaBuf) | (1 << SPA_DATA_MemPtr))
+	);
+
+	params[1] = spa_pod_builder_add_object(
+		&builder,
+		SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+		SPA_PARAM_META_type, SPA_POD_Id(SPA_META_Header),
+		SPA_PARAM_META_size, SPA_POD_Int(sizeof(struct spa_meta_header))
+	);
+
+	GST_DEBUG_OBJECT(self, "format param set; requesting buffers with %" G_GSIZE_FORMAT " byte(s) each", GST_VIDEO_INFO_SIZE(&(self->video_info)));
+
+	pw_stream_update_params(self->stream, params, 2);
+}
+
+
+static void gst_pw_video_sink_add_buffer(void *data, struct pw_buffer *pw_buffer)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK_CAST(data);
+	gst_pw_video_buffer_pool_add_pw_buffer(self->pool, pw_buffer);
+}
+
+
+static void gst_pw_video_sink_remove_buffer(void *data, struct pw_buffer *pw_buffer)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK_CAST(data);
+	gst_pw_video_buffer_pool_remove_pw_buffer(self->pool, pw_buffer);
+}
+
+
+static void gst_pw_video_sink_on_process_stream(void *data)
+{
+	GstPwVideoSink *self = GST_PW_VIDEO_SINK_CAST(data);
+	struct pw_time stream_time;
+
+	/* pw_stream_get_time() is deprecated since version 0.3.50. */
+#if PW_CHECK_VERSION(0, 3, 50)
+	pw_stream_get_time_n(self->stream, &stream_time, sizeof(stream_time));
+#else
+	pw_stream_get_time(self->stream, &stream_time);
+#endif
+
+	/* A different graph clock rate means that the stream got moved
+	 * to another driver. The stream clock must then continue
+	 * seamlessly instead of jumping to the new driver's timeline. */
+	if (stream_time.rate.denom != 0)
+	{
+		if (G_UNLIKELY((self->last_graph_clock_rate.denom != 0)
+		            && ((stream_time.rate.num != self->last_graph_clock_rate.num) || (stream_time.rate.denom != self->last_graph_clock_rate.denom))))
+			gst_pw_stream_clock_add_discontinuous_observation(self->stream_clock, &stream_time);
+		else
+			gst_pw_stream_clock_add_observation(self->stream_clock, &stream_time);
+
+		self->last_graph_clock_rate = stream_time.rate;
+	}
+
+	/* The graph may have consumed a frame, so a pw_buffer
+	 * may be available for dequeuing again. */
+	gst_pw_video_buffer_pool_notify_process(self->pool);
+}
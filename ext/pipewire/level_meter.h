@@ -0,0 +1,204 @@
+#ifndef __GST_PIPEWIRE_LEVEL_METER_H__
+#define __GST_PIPEWIRE_LEVEL_METER_H__
+
+#include <math.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+
+/* Per-channel peak and RMS meter for interleaved PCM audio.
+ *
+ * Call level_meter_init() on a LevelMeter instance before using. Then pass
+ * blocks of interleaved samples to level_meter_process(). The peak and the
+ * sum of squares of each channel are accumulated until level_meter_reset()
+ * is called. The results are queried in dB full scale (0 dB is the maximum
+ * amplitude) with level_meter_get_peak_db() and level_meter_get_rms_db().
+ *
+ * The samples are processed in blocks of up to LEVEL_METER_NUM_LANES samples.
+ * Each sample of a block is accumulated in its own lane, so that the inner
+ * loop has no dependencies between consecutive samples, and walks contiguous
+ * arrays. This allows the compiler to vectorize it with whatever SIMD
+ * instructions are available. Each block contains a whole number of frames,
+ * so lane #i always receives samples from channel #(i % num_channels). The
+ * lanes are folded into the per-channel results at the end of each call.
+ *
+ * level_meter_process() does not allocate memory and does not block,
+ * so it can be called from a realtime thread.
+ */
+
+
+#define LEVEL_METER_MAX_NUM_CHANNELS 64
+#define LEVEL_METER_NUM_LANES 64
+
+/* Lower bound for the dB values. Silence would otherwise yield -inf. */
+#define LEVEL_METER_MIN_DB (-200.0)
+
+
+typedef struct
+{
+	guint num_channels;
+	/* Number of frames that were accumulated since the last reset. */
+	guint64 num_frames;
+	/* Linear peak amplitudes, in the 0.0 - 1.0 range for non-clipping signals. */
+	gdouble peak[LEVEL_METER_MAX_NUM_CHANNELS];
+	gdouble sum_of_squares[LEVEL_METER_MAX_NUM_CHANNELS];
+}
+LevelMeter;
+
+
+static inline void level_meter_reset(LevelMeter *meter)
+{
+	g_assert(meter != NULL);
+
+	meter->num_frames = 0;
+	memset(meter->peak, 0, sizeof(meter->peak));
+	memset(meter->sum_of_squares, 0, sizeof(meter->sum_of_squares));
+}
+
+
+static inline void level_meter_init(LevelMeter *meter, guint num_channels)
+{
+	g_assert(meter != NULL);
+	g_assert((num_channels > 0) && (num_channels <= LEVEL_METER_MAX_NUM_CHANNELS));
+
+	meter->num_channels = num_channels;
+	level_meter_reset(meter);
+}
+
+
+static inline gboolean level_meter_format_is_supported(GstAudioFormat format)
+{
+	switch (format)
+	{
+		case GST_AUDIO_FORMAT_S16:
+		case GST_AUDIO_FORMAT_S32:
+		case GST_AUDIO_FORMAT_F32:
+		case GST_AUDIO_FORMAT_F64:
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+
+static inline void level_meter_fold_lanes(LevelMeter *meter, gfloat const *lane_peaks, gfloat const *lane_sums_of_squares, guint num_lanes)
+{
+	guint lane;
+
+	for (lane = 0; lane < num_lanes; ++lane)
+	{
+		guint channel = lane % meter->num_channels;
+		meter->peak[channel] = MAX(meter->peak[channel], lane_peaks[lane]);
+		meter->sum_of_squares[channel] += lane_sums_of_squares[lane];
+	}
+}
+
+
+#define LEVEL_METER_ACCUMULATE_LANES(SAMPLE_TYPE, SCALE, BLOCK, NUM_LANES) \
+	G_STMT_START { \
+		gsize lane; \
+		for (lane = 0; lane < (NUM_LANES); ++lane) \
+		{ \
+			gfloat value = ((gfloat)((BLOCK)[lane])) * (SCALE); \
+			gfloat magnitude = fabsf(value); \
+			lane_peaks[lane] = (magnitude > lane_peaks[lane]) ? magnitude : lane_peaks[lane]; \
+			lane_sums_of_squares[lane] += value * value; \
+		} \
+	} G_STMT_END
+
+/* Defines a level_meter_process_<SUFFIX>() function for samples of the given
+ * type. SCALE normalizes the samples to the -1.0 .. +1.0 range. Blocks that
+ * use all lanes are handled separately, since the constant number of lanes
+ * lets the compiler vectorize that loop without a scalar remainder. This is
+ * the common case, since the usual channel counts evenly divide the number
+ * of lanes. */
+#define LEVEL_METER_DEFINE_PROCESS_FUNC(SUFFIX, SAMPLE_TYPE, SCALE) \
+	static inline void level_meter_process_ ## SUFFIX(LevelMeter *meter, SAMPLE_TYPE const *samples, gsize num_frames) \
+	{ \
+		gfloat lane_peaks[LEVEL_METER_NUM_LANES] = { 0.0f }; \
+		gfloat lane_sums_of_squares[LEVEL_METER_NUM_LANES] = { 0.0f }; \
+		gsize num_block_samples = (LEVEL_METER_NUM_LANES / meter->num_channels) * meter->num_channels; \
+		gsize num_samples = num_frames * meter->num_channels; \
+		gsize sample_index = 0; \
+		\
+		while (sample_index < num_samples) \
+		{ \
+			gsize num_lanes = MIN(num_block_samples, num_samples - sample_index); \
+			SAMPLE_TYPE const *block = samples + sample_index; \
+			\
+			if (num_lanes == LEVEL_METER_NUM_LANES) \
+				LEVEL_METER_ACCUMULATE_LANES(SAMPLE_TYPE, SCALE, block, LEVEL_METER_NUM_LANES); \
+			else \
+				LEVEL_METER_ACCUMULATE_LANES(SAMPLE_TYPE, SCALE, block, num_lanes); \
+			\
+			sample_index += num_lanes; \
+		} \
+		\
+		level_meter_fold_lanes(meter, lane_peaks, lane_sums_of_squares, MIN(num_block_samples, num_samples)); \
+		meter->num_frames += num_frames; \
+	}
+
+LEVEL_METER_DEFINE_PROCESS_FUNC(s16, gint16, 1.0f / 32768.0f)
+LEVEL_METER_DEFINE_PROCESS_FUNC(s32, gint32, 1.0f / 2147483648.0f)
+LEVEL_METER_DEFINE_PROCESS_FUNC(f32, gfloat, 1.0f)
+LEVEL_METER_DEFINE_PROCESS_FUNC(f64, gdouble, 1.0f)
+
+
+/* Accumulates num_frames frames of the given format. If data is NULL,
+ * the frames are treated as silence. Returns FALSE if the format is
+ * not supported (see level_meter_format_is_supported()). */
+static inline gboolean level_meter_process(LevelMeter *meter, GstAudioFormat format, gconstpointer data, gsize num_frames)
+{
+	g_assert(meter != NULL);
+
+	if (data == NULL)
+	{
+		meter->num_frames += num_frames;
+		return TRUE;
+	}
+
+	switch (format)
+	{
+		case GST_AUDIO_FORMAT_S16: level_meter_process_s16(meter, data, num_frames); return TRUE;
+		case GST_AUDIO_FORMAT_S32: level_meter_process_s32(meter, data, num_frames); return TRUE;
+		case GST_AUDIO_FORMAT_F32: level_meter_process_f32(meter, data, num_frames); return TRUE;
+		case GST_AUDIO_FORMAT_F64: level_meter_process_f64(meter, data, num_frames); return TRUE;
+		default: return FALSE;
+	}
+}
+
+
+static inline gdouble level_meter_get_peak_db(LevelMeter const *meter, guint channel)
+{
+	g_assert(meter != NULL);
+	g_assert(channel < meter->num_channels);
+
+	if (meter->peak[channel] <= 0.0)
+		return LEVEL_METER_MIN_DB;
+
+	return MAX(20.0 * log10(meter->peak[channel]), LEVEL_METER_MIN_DB);
+}
+
+
+static inline gdouble level_meter_get_rms_db(LevelMeter const *meter, guint channel)
+{
+	gdouble mean_square;
+
+	g_assert(meter != NULL);
+	g_assert(channel < meter->num_channels);
+
+	if (meter->num_frames == 0)
+		return LEVEL_METER_MIN_DB;
+
+	mean_square = meter->sum_of_squares[channel] / meter->num_frames;
+	if (mean_square <= 0.0)
+		return LEVEL_METER_MIN_DB;
+
+	/* 10 * log10(x) instead of 20 * log10(sqrt(x)) to avoid the sqrt. */
+	return MAX(10.0 * log10(mean_square), LEVEL_METER_MIN_DB);
+}
+
+
+#endif /* __GST_PIPEWIRE_LEVEL_METER_H__ */
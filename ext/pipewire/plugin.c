@@ -32,7 +32,13 @@
 #pragma GCC diagnostic pop
 
 #include <gst/gst.h>
+#include "gstpwaudiodeviceprovider.h"
 #include "gstpwaudiosink.h"
+#include "gstpwaudiosrc.h"
+#ifdef HAVE_PWVIDEOSINK
+#include "gstpwvideosink.h"
+#endif
+#include "rt_safety_checker.h"
 
 
 GST_DEBUG_CATEGORY(pw_audio_format_debug);
@@ -44,8 +50,16 @@ static gboolean plugin_init(GstPlugin *plugin)
 
 	pw_init(NULL, NULL);
 
+	RT_SAFETY_CHECKER_INIT();
+
 	gboolean ret = TRUE;
 	ret = ret && gst_element_register(plugin, "pwaudiosink", GST_RANK_NONE, gst_pw_audio_sink_get_type());
+	ret = ret && gst_element_register(plugin, "pwaudiosrc", GST_RANK_NONE, gst_pw_audio_src_get_type());
+#ifdef HAVE_PWVIDEOSINK
+	ret = ret && gst_element_register(plugin, "pwvideosink", GST_RANK_NONE, gst_pw_video_sink_get_type());
+#endif
+	/* Device monitors ignore providers whose rank is below MARGINAL. */
+	ret = ret && gst_device_provider_register(plugin, "pwaudiodeviceprovider", GST_RANK_MARGINAL, gst_pw_audio_device_provider_get_type());
 	return ret;
 }
 
@@ -0,0 +1,395 @@
+/* gst-pipewire-extra
+ *
+ * Copyright © 2022 Carlos Rafael Giani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* This file is built as its own shared library, since the allocator and
+ * syscall interposers below only take effect if they come before the C
+ * library in the symbol lookup order. The plugin only uses it if the
+ * rt-safety-checks meson option is enabled. See rt_safety_checker.h. */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <gst/gst.h>
+#include "rt_safety_checker.h"
+
+
+#define MAX_BACKTRACE_DEPTH 64
+
+
+/* The glibc allocator entrypoints. The interposers forward to these
+ * instead of using dlsym(), since dlsym() itself may allocate memory. */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t num_members, size_t size);
+extern void* __libc_realloc(void *ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+
+typedef int (*ClockGettimeFunc)(clockid_t clock_id, struct timespec *tp);
+typedef int (*NanosleepFunc)(struct timespec const *req, struct timespec *rem);
+typedef int (*ClockNanosleepFunc)(clockid_t clock_id, int flags, struct timespec const *req, struct timespec *rem);
+typedef int (*UsleepFunc)(useconds_t usec);
+typedef int (*SchedYieldFunc)(void);
+
+static ClockGettimeFunc real_clock_gettime = NULL;
+static NanosleepFunc real_nanosleep = NULL;
+static ClockNanosleepFunc real_clock_nanosleep = NULL;
+static UsleepFunc real_usleep = NULL;
+static SchedYieldFunc real_sched_yield = NULL;
+
+static gboolean abort_on_violation = FALSE;
+static gint num_violations = 0;
+
+/* Nesting depth of the realtime sections the current thread is in. */
+static __thread gint rt_section_depth = 0;
+static __thread char const *rt_section_name = NULL;
+/* Only the first violation of each section gets a full backtrace.
+ * Once something went wrong in a section, it typically causes a cascade
+ * of further violations (logging allocates memory, for example), and
+ * printing backtraces for all of them would bury the first one. */
+static __thread gboolean rt_section_backtrace_printed = FALSE;
+/* Set by rt_safety_checker_permit_waits() until the outermost section is left. */
+static __thread gboolean rt_section_waits_permitted = FALSE;
+/* Set while a violation is reported. Reporting itself is not
+ * realtime safe, and must not cause recursive reports. */
+static __thread gboolean reporting_violation = FALSE;
+
+
+#define RESOLVE_REAL_FUNC(VAR, TYPE, NAME) \
+	G_STMT_START { \
+		if (G_UNLIKELY((VAR) == NULL)) \
+			(VAR) = (TYPE)dlsym(RTLD_NEXT, (NAME)); \
+		g_assert((VAR) != NULL); \
+	} G_STMT_END
+
+
+static void write_to_stderr(char const *str)
+{
+	ssize_t ret G_GNUC_UNUSED;
+	ret = write(STDERR_FILENO, str, strlen(str));
+}
+
+
+static void report_violation(char const *description)
+{
+	char message[512];
+
+	if (G_LIKELY(rt_section_depth == 0) || reporting_violation)
+		return;
+
+	reporting_violation = TRUE;
+
+	g_atomic_int_inc(&num_violations);
+
+	/* snprintf() and backtrace_symbols_fd() are used here, since they
+	 * do not allocate memory. backtrace() may allocate memory the first
+	 * time it is called, which is why it is primed in the constructor. */
+	snprintf(
+		message, sizeof(message),
+		"RT SAFETY VIOLATION in realtime section \"%s\": %s\n",
+		(rt_section_name != NULL) ? rt_section_name : "<unnamed>",
+		description
+	);
+	write_to_stderr(message);
+
+	if (!rt_section_backtrace_printed)
+	{
+		void *backtrace_entries[MAX_BACKTRACE_DEPTH];
+		int num_backtrace_entries;
+
+		num_backtrace_entries = backtrace(backtrace_entries, MAX_BACKTRACE_DEPTH);
+		backtrace_symbols_fd(backtrace_entries, num_backtrace_entries, STDERR_FILENO);
+		rt_section_backtrace_printed = TRUE;
+	}
+
+	if (abort_on_violation)
+		abort();
+
+	reporting_violation = FALSE;
+}
+
+
+static void rt_safety_checker_log_function(GstDebugCategory *category, GstDebugLevel level, gchar const *file, gchar const *function, gint line, GObject *object, GstDebugMessage *message, gpointer user_data)
+{
+	char description[256];
+
+	(void)category;
+	(void)level;
+	(void)line;
+	(void)object;
+	(void)message;
+	(void)user_data;
+
+	if (G_LIKELY(rt_section_depth == 0))
+		return;
+
+	snprintf(description, sizeof(description), "debug log message formatting in %s (%s)", function, file);
+	report_violation(description);
+}
+
+
+__attribute__((constructor)) static void rt_safety_checker_constructor(void)
+{
+	void *dummy_backtrace_entries[1];
+	char const *abort_env;
+
+	RESOLVE_REAL_FUNC(real_clock_gettime, ClockGettimeFunc, "clock_gettime");
+	RESOLVE_REAL_FUNC(real_nanosleep, NanosleepFunc, "nanosleep");
+	RESOLVE_REAL_FUNC(real_clock_nanosleep, ClockNanosleepFunc, "clock_nanosleep");
+	RESOLVE_REAL_FUNC(real_usleep, UsleepFunc, "usleep");
+	RESOLVE_REAL_FUNC(real_sched_yield, SchedYieldFunc, "sched_yield");
+
+	/* The first backtrace() call loads libgcc_s, which allocates memory.
+	 * Get that out of the way here, outside of any realtime section. */
+	backtrace(dummy_backtrace_entries, 1);
+
+	abort_env = getenv("GST_PW_RT_SAFETY_ABORT");
+	abort_on_violation = (abort_env != NULL) && (strcmp(abort_env, "1") == 0);
+}
+
+
+__attribute__((destructor)) static void rt_safety_checker_destructor(void)
+{
+	guint total_num_violations = (guint)g_atomic_int_get(&num_violations);
+
+	if (total_num_violations > 0)
+		fprintf(stderr, "RT SAFETY: %u violation(s) were detected in realtime sections\n", total_num_violations);
+}
+
+
+void rt_safety_checker_init(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		gst_debug_add_log_function(rt_safety_checker_log_function, NULL, NULL);
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+
+void rt_safety_checker_enter(char const *section_name)
+{
+	if (rt_section_depth == 0)
+	{
+		rt_section_name = section_name;
+		rt_section_backtrace_printed = FALSE;
+	}
+
+	rt_section_depth++;
+}
+
+
+void rt_safety_checker_leave(void)
+{
+	g_assert(rt_section_depth > 0);
+
+	rt_section_depth--;
+	if (rt_section_depth == 0)
+	{
+		rt_section_name = NULL;
+		rt_section_waits_permitted = FALSE;
+	}
+}
+
+
+gboolean rt_safety_checker_is_in_rt_section(void)
+{
+	return rt_section_depth > 0;
+}
+
+
+void rt_safety_checker_mutex_lock(GMutex *mutex)
+{
+	if (G_LIKELY(rt_section_depth == 0))
+	{
+		g_mutex_lock(mutex);
+		return;
+	}
+
+	if (g_mutex_trylock(mutex))
+		return;
+
+	report_violation("waiting for a contended mutex");
+	g_mutex_lock(mutex);
+}
+
+
+void rt_safety_checker_permit_waits(void)
+{
+	if (rt_section_depth > 0)
+		rt_section_waits_permitted = TRUE;
+}
+
+
+gboolean rt_safety_checker_cond_wait_until(GCond *cond, GMutex *mutex, gint64 end_time)
+{
+	if (!rt_section_waits_permitted)
+		report_violation("waiting on a condition variable");
+
+	return g_cond_wait_until(cond, mutex, end_time);
+}
+
+
+guint rt_safety_checker_get_num_violations(void)
+{
+	return (guint)g_atomic_int_get(&num_violations);
+}
+
+
+void rt_safety_checker_reset_num_violations(void)
+{
+	g_atomic_int_set(&num_violations, 0);
+}
+
+
+/* Allocator interposers. */
+
+void* malloc(size_t size)
+{
+	report_violation("malloc()");
+	return __libc_malloc(size);
+}
+
+
+void* calloc(size_t num_members, size_t size)
+{
+	report_violation("calloc()");
+	return __libc_calloc(num_members, size);
+}
+
+
+void* realloc(void *ptr, size_t size)
+{
+	report_violation("realloc()");
+	return __libc_realloc(ptr, size);
+}
+
+
+void* memalign(size_t alignment, size_t size)
+{
+	report_violation("memalign()");
+	return __libc_memalign(alignment, size);
+}
+
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+	report_violation("aligned_alloc()");
+	return __libc_memalign(alignment, size);
+}
+
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	void *ptr;
+
+	report_violation("posix_memalign()");
+
+	if ((alignment < sizeof(void *)) || ((alignment & (alignment - 1)) != 0))
+		return EINVAL;
+
+	ptr = __libc_memalign(alignment, size);
+	if (ptr == NULL)
+		return ENOMEM;
+
+	*memptr = ptr;
+	return 0;
+}
+
+
+void free(void *ptr)
+{
+	/* free(NULL) is a no-op, and therefore realtime safe. */
+	if (ptr != NULL)
+		report_violation("free()");
+	__libc_free(ptr);
+}
+
+
+/* Syscall interposers. */
+
+int clock_gettime(clockid_t clock_id, struct timespec *tp)
+{
+	switch (clock_id)
+	{
+		/* These are served by the vDSO without entering the kernel. */
+		case CLOCK_REALTIME:
+		case CLOCK_REALTIME_COARSE:
+		case CLOCK_MONOTONIC:
+		case CLOCK_MONOTONIC_RAW:
+		case CLOCK_MONOTONIC_COARSE:
+		case CLOCK_BOOTTIME:
+		case CLOCK_TAI:
+			break;
+
+		default:
+			report_violation("clock_gettime() with a clock that is not served by the vDSO");
+			break;
+	}
+
+	RESOLVE_REAL_FUNC(real_clock_gettime, ClockGettimeFunc, "clock_gettime");
+	return real_clock_gettime(clock_id, tp);
+}
+
+
+int nanosleep(struct timespec const *req, struct timespec *rem)
+{
+	report_violation("nanosleep()");
+	RESOLVE_REAL_FUNC(real_nanosleep, NanosleepFunc, "nanosleep");
+	return real_nanosleep(req, rem);
+}
+
+
+int clock_nanosleep(clockid_t clock_id, int flags, struct timespec const *req, struct timespec *rem)
+{
+	report_violation("clock_nanosleep()");
+	RESOLVE_REAL_FUNC(real_clock_nanosleep, ClockNanosleepFunc, "clock_nanosleep");
+	return real_clock_nanosleep(clock_id, flags, req, rem);
+}
+
+
+int usleep(useconds_t usec)
+{
+	report_violation("usleep()");
+	RESOLVE_REAL_FUNC(real_usleep, UsleepFunc, "usleep");
+	return real_usleep(usec);
+}
+
+
+int sched_yield(void)
+{
+	report_violation("sched_yield()");
+	RESOLVE_REAL_FUNC(real_sched_yield, SchedYieldFunc, "sched_yield");
+	return real_sched_yield();
+}
@@ -0,0 +1,96 @@
+#ifndef __GST_PIPEWIRE_RT_SAFETY_CHECKER_H__
+#define __GST_PIPEWIRE_RT_SAFETY_CHECKER_H__
+
+#include <gst/gst.h>
+
+
+/* Debug instrumentation for code that runs in the PipeWire realtime thread.
+ *
+ * This is only active if the plugin is built with the rt-safety-checks
+ * meson option enabled, which defines GST_PW_RT_SAFETY_CHECKS. Otherwise,
+ * the macros below compile to nothing (or to a plain g_mutex_lock() call).
+ *
+ * Code that must be realtime safe is enclosed in RT_SAFETY_CHECKER_ENTER()
+ * and RT_SAFETY_CHECKER_LEAVE() calls. While a thread is inside such a
+ * section, the checker reports:
+ *
+ * - Memory allocations and deallocations. The checker library interposes
+ *   malloc(), free() and friends. GLib's g_malloc() and g_free() and
+ *   therefore also GstBuffer allocation and deallocation end up in these.
+ * - Mutex waits. Mutexes that are locked with RT_SAFETY_CHECKER_MUTEX_LOCK()
+ *   are first tried with g_mutex_trylock(). If that fails, the thread would
+ *   have to wait for another thread, which is reported. Locking uncontended
+ *   mutexes is not reported, since the process callbacks rely on short
+ *   critical sections that are shared with the streaming thread.
+ * - Condition variable waits. Waits that go through
+ *   RT_SAFETY_CHECKER_COND_WAIT_UNTIL() are reported, unless the current
+ *   section explicitly permits waiting with RT_SAFETY_CHECKER_PERMIT_WAITS().
+ *   That is meant for code paths that block deliberately, like the
+ *   process callback of pwaudiosink in freewheel mode. The permission
+ *   ends when the outermost section is left.
+ *   Signalling a condition variable only wakes up waiting threads and
+ *   never blocks, so RT_SAFETY_CHECKER_COND_SIGNAL() and
+ *   RT_SAFETY_CHECKER_COND_BROADCAST() are not reported. Realtime code
+ *   uses them anyway, to make clear that these calls were reviewed.
+ * - Syscalls that may block or that enter the kernel: sleeps, yields, and
+ *   clock_gettime() with clocks that are not served by the vDSO.
+ *   (CLOCK_MONOTONIC and CLOCK_REALTIME are served by the vDSO, so they
+ *   do not enter the kernel and are not reported.)
+ * - Debug log message formatting. This is detected by a GStreamer log
+ *   function, which is only invoked if a message passes the debug
+ *   threshold, that is, only if the message is actually formatted.
+ *
+ * Each violation is printed to stderr along with a backtrace. If the
+ * GST_PW_RT_SAFETY_ABORT environment variable is set to 1, the process
+ * is aborted at the first violation instead. The number of violations
+ * can also be queried with rt_safety_checker_get_num_violations(); the
+ * unit tests use that to fail if the realtime paths regress.
+ *
+ * For the interposition of the allocator and syscall functions to work,
+ * the checker library has to come before the C library in the symbol
+ * lookup order. The unit tests link against it directly. For pipelines
+ * that load the plugin at runtime (for example with gst-launch-1.0),
+ * preload the library with LD_PRELOAD=libgstpwrtsafetychecker.so.
+ */
+
+
+#ifdef GST_PW_RT_SAFETY_CHECKS
+
+/* Installs the debug log function. Call this after gst_init(). */
+void rt_safety_checker_init(void);
+
+void rt_safety_checker_enter(char const *section_name);
+void rt_safety_checker_leave(void);
+gboolean rt_safety_checker_is_in_rt_section(void);
+
+void rt_safety_checker_mutex_lock(GMutex *mutex);
+
+void rt_safety_checker_permit_waits(void);
+gboolean rt_safety_checker_cond_wait_until(GCond *cond, GMutex *mutex, gint64 end_time);
+
+guint rt_safety_checker_get_num_violations(void);
+void rt_safety_checker_reset_num_violations(void);
+
+#define RT_SAFETY_CHECKER_INIT() rt_safety_checker_init()
+#define RT_SAFETY_CHECKER_ENTER(SECTION_NAME) rt_safety_checker_enter(SECTION_NAME)
+#define RT_SAFETY_CHECKER_LEAVE() rt_safety_checker_leave()
+#define RT_SAFETY_CHECKER_MUTEX_LOCK(MUTEX) rt_safety_checker_mutex_lock(MUTEX)
+#define RT_SAFETY_CHECKER_PERMIT_WAITS() rt_safety_checker_permit_waits()
+#define RT_SAFETY_CHECKER_COND_WAIT_UNTIL(COND, MUTEX, END_TIME) rt_safety_checker_cond_wait_until((COND), (MUTEX), (END_TIME))
+
+#else
+
+#define RT_SAFETY_CHECKER_INIT() G_STMT_START { } G_STMT_END
+#define RT_SAFETY_CHECKER_ENTER(SECTION_NAME) G_STMT_START { } G_STMT_END
+#define RT_SAFETY_CHECKER_LEAVE() G_STMT_START { } G_STMT_END
+#define RT_SAFETY_CHECKER_MUTEX_LOCK(MUTEX) g_mutex_lock(MUTEX)
+#define RT_SAFETY_CHECKER_PERMIT_WAITS() G_STMT_START { } G_STMT_END
+#define RT_SAFETY_CHECKER_COND_WAIT_UNTIL(COND, MUTEX, END_TIME) g_cond_wait_until((COND), (MUTEX), (END_TIME))
+
+#endif
+
+#define RT_SAFETY_CHECKER_COND_SIGNAL(COND) g_cond_signal(COND)
+#define RT_SAFETY_CHECKER_COND_BROADCAST(COND) g_cond_broadcast(COND)
+
+
+#endif /* __GST_PIPEWIRE_RT_SAFETY_CHECKER_H__ */
@@ -122,4 +122,52 @@ static inline guint64 ringbuffer_metrics_write(ringbuffer_metrics *metrics, guin
 }
 
 
+/* Size of a CPU cache line in bytes. This is correct for x86-64 and for most
+ * ARM64 cores (some ARM64 cores use 128 byte lines, which this does not cover). */
+#define CACHE_LINE_SIZE 64
+
+/* Declares a struct field that is as large as one cache line. Placing this
+ * between two groups of fields that are written by different threads ensures
+ * that the two groups never share a cache line, even if the struct itself is
+ * not aligned to a cache line boundary (which is typically the case with
+ * GObject instances and with other heap allocations). */
+#define CACHE_LINE_PADDING(NAME) guint8 NAME[CACHE_LINE_SIZE]
+
+
+/* Minimal sequence lock for data that has one writer and that is read
+ * frequently by other threads which must not take a lock (and must not
+ * be able to block the writer). The sequence number is odd while the
+ * writer is modifying the data. Readers copy the data, and then check
+ * with seqlock_read_retry() whether the copy is consistent. If multiple
+ * threads can write, the writers must be serialized by other means. */
+
+static inline void seqlock_write_begin(gint *seqnum)
+{
+	/* This is a full barrier; the data modifications that follow
+	 * cannot become visible before the odd sequence number. */
+	g_atomic_int_inc(seqnum);
+}
+
+
+static inline void seqlock_write_end(gint *seqnum)
+{
+	g_atomic_int_inc(seqnum);
+}
+
+
+static inline gint seqlock_read_begin(gint *seqnum)
+{
+	return g_atomic_int_get(seqnum);
+}
+
+
+static inline gboolean seqlock_read_retry(gint *seqnum, gint begin_seqnum)
+{
+	/* Make sure the data was fully copied before the
+	 * sequence number is loaded again. */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return (begin_seqnum & 1) || (g_atomic_int_get(seqnum) != begin_seqnum);
+}
+
+
 #endif /* __GST_PIPEWIRE_UTILS_H__ */
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+#include "discontinuity_accumulator.h"
+
+
+#define ALIGNMENT_THRESHOLD (GST_MSECOND * 40)
+#define BUFFER_DURATION (GST_MSECOND * 10)
+
+
+typedef struct
+{
+	GstClockTime total_silence;
+	GstClockTime total_clipped;
+	guint num_compensations;
+	guint num_dropped_buffers;
+	/* End of the data in the output timeline. */
+	GstClockTime output_end;
+}
+RenderResults;
+
+
+/* Passes a buffer through the accumulator the same way the render_raw()
+ * function of pwaudiosink does, and records the compensations. */
+static void render_buffer(DiscontinuityAccumulator *accumulator, GstClockTime pts, GstClockTime duration, gboolean force, RenderResults *results)
+{
+	GstClockTimeDiff discontinuity;
+	GstClockTime output_pts;
+
+	if (discontinuity_accumulator_check(accumulator, pts, ALIGNMENT_THRESHOLD, force, &discontinuity))
+	{
+		results->num_compensations++;
+
+		if (discontinuity > 0)
+		{
+			results->total_silence += discontinuity;
+		}
+		else if ((GstClockTime)(-discontinuity) >= duration)
+		{
+			/* The buffer is fully clipped, so it is dropped. */
+			results->total_clipped += duration;
+			results->num_dropped_buffers++;
+			return;
+		}
+		else
+		{
+			results->total_clipped += -discontinuity;
+			duration -= -discontinuity;
+		}
+	}
+
+	output_pts = discontinuity_accumulator_get_output_pts(accumulator, pts, discontinuity);
+	discontinuity_accumulator_advance(accumulator, output_pts, duration);
+	results->output_end = output_pts + duration;
+}
+
+
+/* Renders num_buffers buffers with BUFFER_DURATION, beginning with the
+ * one at index first_index. The PTS of buffer #i is i * BUFFER_DURATION
+ * plus pts_shift plus a jitter value that is taken from the jitter array. */
+static void render_buffers(DiscontinuityAccumulator *accumulator, guint first_index, guint num_buffers, GstClockTimeDiff pts_shift, GstClockTimeDiff const *jitter, guint jitter_length, RenderResults *results)
+{
+	guint i;
+
+	for (i = first_index; i < (first_index + num_buffers); ++i)
+	{
+		GstClockTimeDiff pts = (GstClockTimeDiff)(i * BUFFER_DURATION) + pts_shift;
+		if (jitter != NULL)
+			pts += jitter[i % jitter_length];
+		render_buffer(accumulator, pts, BUFFER_DURATION, FALSE, results);
+	}
+}
+
+
+static GstClockTimeDiff const small_jitter[] = {
+	+1 * GST_MSECOND, +2 * GST_MSECOND, 0, -1 * GST_MSECOND,
+	-2 * GST_MSECOND, +1 * GST_MSECOND, -1 * GST_MSECOND, 0
+};
+
+
+GST_START_TEST(alternating_jitter_is_not_compensated)
+{
+	/* Jitter that alternates between positive and negative values
+	 * must never cause a compensation, even if the individual
+	 * discontinuities exceed the threshold. */
+
+	static GstClockTimeDiff const large_jitter[] = { 0, +50 * GST_MSECOND };
+	static GstClockTimeDiff const alternating_jitter[] = { -50 * GST_MSECOND, +50 * GST_MSECOND };
+
+	DiscontinuityAccumulator accumulator;
+	RenderResults results = { 0, 0, 0, 0, 0 };
+
+	discontinuity_accumulator_init(&accumulator);
+
+	render_buffers(&accumulator, 0, 100, 0, large_jitter, G_N_ELEMENTS(large_jitter), &results);
+	render_buffers(&accumulator, 100, 100, 0, alternating_jitter, G_N_ELEMENTS(alternating_jitter), &results);
+	/* Small jitter with an irregular pattern must not cause it either. */
+	render_buffers(&accumulator, 200, 100, 0, small_jitter, G_N_ELEMENTS(small_jitter), &results);
+
+	assert_equals_int(results.num_compensations, 0);
+	assert_equals_uint64(results.output_end, 300 * BUFFER_DURATION);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(gap_is_compensated_once)
+{
+	/* A gap in jittered timestamps must be filled with silence once.
+	 * Subsequent buffers must not be clipped to compensate for
+	 * the same gap again. */
+
+	DiscontinuityAccumulator accumulator;
+	RenderResults results = { 0, 0, 0, 0, 0 };
+
+	discontinuity_accumulator_init(&accumulator);
+
+	render_buffers(&accumulator, 0, 20, 0, small_jitter, G_N_ELEMENTS(small_jitter), &results);
+	assert_equals_int(results.num_compensations, 0);
+
+	render_buffers(&accumulator, 20, 100, 100 * GST_MSECOND, small_jitter, G_N_ELEMENTS(small_jitter), &results);
+
+	assert_equals_int(results.num_compensations, 1);
+	fail_unless(ABS((GstClockTimeDiff)(results.total_silence) - 100 * GST_MSECOND) <= 2 * GST_MSECOND);
+	assert_equals_uint64(results.total_clipped, 0);
+
+	/* The output timeline must end where the timestamps say it should. */
+	fail_unless(ABS(GST_CLOCK_DIFF(120 * BUFFER_DURATION + 100 * GST_MSECOND, results.output_end)) <= 2 * GST_MSECOND);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(overlap_is_compensated_once)
+{
+	DiscontinuityAccumulator accumulator;
+	RenderResults results = { 0, 0, 0, 0, 0 };
+	guint i;
+
+	discontinuity_accumulator_init(&accumulator);
+
+	/* Use 100 ms long buffers here, so that the overlap can be
+	 * compensated for by clipping one buffer. */
+	for (i = 0; i < 10; ++i)
+		render_buffer(&accumulator, i * 100 * GST_MSECOND, 100 * GST_MSECOND, FALSE, &results);
+	/* From here on, the buffers overlap the earlier ones by 61 ms. */
+	for (i = 10; i < 30; ++i)
+		render_buffer(&accumulator, i * 100 * GST_MSECOND - 61 * GST_MSECOND, 100 * GST_MSECOND, FALSE, &results);
+
+	assert_equals_int(results.num_compensations, 1);
+	assert_equals_int(results.num_dropped_buffers, 0);
+	assert_equals_uint64(results.total_silence, 0);
+	assert_equals_uint64(results.total_clipped, 61 * GST_MSECOND);
+	assert_equals_uint64(results.output_end, 3000 * GST_MSECOND - 61 * GST_MSECOND);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(overlap_longer_than_buffers)
+{
+	/* If the overlap is longer than a buffer, the buffers that are fully
+	 * clipped are dropped, and compensation continues with the next
+	 * buffers until the deviation is within the threshold again. */
+
+	DiscontinuityAccumulator accumulator;
+	RenderResults results = { 0, 0, 0, 0, 0 };
+
+	discontinuity_accumulator_init(&accumulator);
+
+	render_buffers(&accumulator, 0, 20, 0, NULL, 0, &results);
+	render_buffers(&accumulator, 20, 100, -61 * GST_MSECOND, NULL, 0, &results);
+
+	assert_equals_uint64(results.total_silence, 0);
+	fail_unless(results.num_dropped_buffers > 0);
+	fail_unless(ABS(accumulator.deviation) <= ALIGNMENT_THRESHOLD);
+	fail_unless(ABS(GST_CLOCK_DIFF(120 * BUFFER_DURATION - 61 * GST_MSECOND, results.output_end)) <= ALIGNMENT_THRESHOLD);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(repeated_gaps_are_compensated_individually)
+{
+	/* Each gap must be compensated for exactly by its own size. */
+
+	DiscontinuityAccumulator accumulator;
+	RenderResults results = { 0, 0, 0, 0, 0 };
+
+	discontinuity_accumulator_init(&accumulator);
+
+	render_buffers(&accumulator, 0, 20, 0, NULL, 0, &results);
+	render_buffers(&accumulator, 20, 20, 60 * GST_MSECOND, NULL, 0, &results);
+	render_buffers(&accumulator, 40, 20, 60 * GST_MSECOND + 80 * GST_MSECOND, NULL, 0, &results);
+
+	assert_equals_int(results.num_compensations, 2);
+	assert_equals_uint64(results.total_silence, 140 * GST_MSECOND);
+	assert_equals_uint64(results.total_clipped, 0);
+	assert_equals_uint64(results.output_end, 60 * BUFFER_DURATION + 140 * GST_MSECOND);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(small_discontinuities_add_up)
+{
+	/* Discontinuities that are individually below the threshold must
+	 * add up, no matter how many buffers lie between them. */
+
+	DiscontinuityAccumulator accumulator;
+	RenderResults results = { 0, 0, 0, 0, 0 };
+
+	discontinuity_accumulator_init(&accumulator);
+
+	render_buffers(&accumulator, 0, 10, 0, NULL, 0, &results);
+	render_buffers(&accumulator, 10, 30, 30 * GST_MSECOND, NULL, 0, &results);
+	assert_equals_int(results.num_compensations, 0);
+	assert_equals_int64(accumulator.deviation, 30 * GST_MSECOND);
+
+	render_buffers(&accumulator, 40, 30, 50 * GST_MSECOND, NULL, 0, &results);
+	assert_equals_int(results.num_compensations, 1);
+	assert_equals_uint64(results.total_silence, 50 * GST_MSECOND);
+	assert_equals_int64(accumulator.deviation, 0);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(forced_handling_and_reset)
+{
+	DiscontinuityAccumulator accumulator;
+	RenderResults results = { 0, 0, 0, 0, 0 };
+
+	discontinuity_accumulator_init(&accumulator);
+
+	/* Without an output timeline, nothing can be compensated for,
+	 * not even if the handling is forced. */
+	render_buffer(&accumulator, 5 * BUFFER_DURATION, BUFFER_DURATION, TRUE, &results);
+	assert_equals_int(results.num_compensations, 0);
+	assert_equals_uint64(results.output_end, 6 * BUFFER_DURATION);
+
+	/* A forced handling compensates right away, even below the threshold. */
+	render_buffer(&accumulator, 6 * BUFFER_DURATION + GST_MSECOND, BUFFER_DURATION, TRUE, &results);
+	assert_equals_int(results.num_compensations, 1);
+	assert_equals_uint64(results.total_silence, GST_MSECOND);
+	assert_equals_uint64(results.output_end, 7 * BUFFER_DURATION + GST_MSECOND);
+
+	/* After a reset, the next buffer starts a new output timeline. */
+	discontinuity_accumulator_reset(&accumulator);
+	assert_equals_uint64(accumulator.expected_next_pts, GST_CLOCK_TIME_NONE);
+	render_buffers(&accumulator, 1000, 10, 0, NULL, 0, &results);
+	assert_equals_int(results.num_compensations, 1);
+	assert_equals_uint64(results.output_end, 1010 * BUFFER_DURATION);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(zero_threshold)
+{
+	/* With a zero threshold, alternating jitter still must not
+	 * cause compensation, but any persistent offset must. */
+
+	DiscontinuityAccumulator accumulator;
+	GstClockTimeDiff discontinuity;
+	gboolean compensate;
+
+	discontinuity_accumulator_init(&accumulator);
+	discontinuity_accumulator_advance(&accumulator, 0, BUFFER_DURATION);
+
+	compensate = discontinuity_accumulator_check(&accumulator, BUFFER_DURATION + GST_MSECOND, 0, FALSE, &discontinuity);
+	fail_if(compensate);
+	compensate = discontinuity_accumulator_check(&accumulator, BUFFER_DURATION - GST_MSECOND, 0, FALSE, &discontinuity);
+	fail_if(compensate);
+	compensate = discontinuity_accumulator_check(&accumulator, BUFFER_DURATION + 1, 0, FALSE, &discontinuity);
+	fail_if(compensate);
+	compensate = discontinuity_accumulator_check(&accumulator, BUFFER_DURATION + 1, 0, FALSE, &discontinuity);
+	fail_unless(compensate);
+	assert_equals_int64(discontinuity, 1);
+}
+GST_END_TEST;
+
+
+static Suite * discontinuity_accumulator_suite(void)
+{
+	Suite *s = suite_create("discontinuity_accumulator");
+	TCase *tc = tcase_create("general");
+
+	suite_add_tcase(s, tc);
+	tcase_add_test(tc, alternating_jitter_is_not_compensated);
+	tcase_add_test(tc, gap_is_compensated_once);
+	tcase_add_test(tc, overlap_is_compensated_once);
+	tcase_add_test(tc, overlap_longer_than_buffers);
+	tcase_add_test(tc, repeated_gaps_are_compensated_individually);
+	tcase_add_test(tc, small_discontinuities_add_up);
+	tcase_add_test(tc, forced_handling_and_reset);
+	tcase_add_test(tc, zero_threshold);
+
+	return s;
+}
+
+GST_CHECK_MAIN(discontinuity_accumulator)
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+#include "level_meter.h"
+
+
+#define DB_TOLERANCE 0.01
+
+
+static void check_db(gdouble actual, gdouble expected)
+{
+	fail_unless(fabs(actual - expected) < DB_TOLERANCE, "expected %f dB, got %f dB", expected, actual);
+}
+
+
+GST_START_TEST(constant_signals)
+{
+	/* Each channel gets a constant signal of a different amplitude
+	 * and sign. For a constant signal, peak and RMS are equal. */
+
+	LevelMeter meter;
+	gfloat samples[1000 * 2];
+	guint i;
+
+	for (i = 0; i < 1000; ++i)
+	{
+		samples[i * 2 + 0] = 0.5f;
+		samples[i * 2 + 1] = -0.25f;
+	}
+
+	level_meter_init(&meter, 2);
+	fail_unless(level_meter_process(&meter, GST_AUDIO_FORMAT_F32, samples, 1000));
+
+	assert_equals_uint64(meter.num_frames, 1000);
+	check_db(level_meter_get_peak_db(&meter, 0), 20.0 * log10(0.5));
+	check_db(level_meter_get_rms_db(&meter, 0), 20.0 * log10(0.5));
+	check_db(level_meter_get_peak_db(&meter, 1), 20.0 * log10(0.25));
+	check_db(level_meter_get_rms_db(&meter, 1), 20.0 * log10(0.25));
+}
+GST_END_TEST;
+
+
+GST_START_TEST(peak_and_rms_differ)
+{
+	/* A single full scale impulse in otherwise silent audio. The peak is
+	 * 0 dB, while the RMS is that of 1 nonzero frame out of 100. This
+	 * also uses a channel count that does not evenly divide the number
+	 * of lanes, and a number of frames that does not fill the last
+	 * block, to verify that the lanes map to the correct channels. */
+
+	LevelMeter meter;
+	gint16 samples[100 * 6];
+	guint channel;
+
+	memset(samples, 0, sizeof(samples));
+	samples[57 * 6 + 4] = G_MININT16;
+
+	level_meter_init(&meter, 6);
+	fail_unless(level_meter_process(&meter, GST_AUDIO_FORMAT_S16, samples, 100));
+
+	for (channel = 0; channel < 6; ++channel)
+	{
+		if (channel == 4)
+		{
+			check_db(level_meter_get_peak_db(&meter, channel), 0.0);
+			check_db(level_meter_get_rms_db(&meter, channel), 10.0 * log10(1.0 / 100.0));
+		}
+		else
+		{
+			check_db(level_meter_get_peak_db(&meter, channel), LEVEL_METER_MIN_DB);
+			check_db(level_meter_get_rms_db(&meter, channel), LEVEL_METER_MIN_DB);
+		}
+	}
+}
+GST_END_TEST;
+
+
+GST_START_TEST(accumulation_and_reset)
+{
+	/* Results accumulate across calls, including silent ones,
+	 * until the meter is reset. */
+
+	LevelMeter meter;
+	gint32 samples[50];
+	gdouble samples_f64[50];
+	guint i;
+
+	for (i = 0; i < 50; ++i)
+	{
+		samples[i] = G_MAXINT32 / 2;
+		samples_f64[i] = 0.125;
+	}
+
+	level_meter_init(&meter, 1);
+	fail_unless(level_meter_process(&meter, GST_AUDIO_FORMAT_S32, samples, 50));
+	/* NULL data is treated as silence. */
+	fail_unless(level_meter_process(&meter, GST_AUDIO_FORMAT_S32, NULL, 50));
+
+	assert_equals_uint64(meter.num_frames, 100);
+	check_db(level_meter_get_peak_db(&meter, 0), 20.0 * log10(0.5));
+	check_db(level_meter_get_rms_db(&meter, 0), 10.0 * log10(0.5 * 0.5 / 2.0));
+
+	level_meter_reset(&meter);
+	assert_equals_uint64(meter.num_frames, 0);
+	check_db(level_meter_get_peak_db(&meter, 0), LEVEL_METER_MIN_DB);
+
+	fail_unless(level_meter_process(&meter, GST_AUDIO_FORMAT_F64, samples_f64, 50));
+	check_db(level_meter_get_peak_db(&meter, 0), 20.0 * log10(0.125));
+	check_db(level_meter_get_rms_db(&meter, 0), 20.0 * log10(0.125));
+
+	/* Unsupported formats are rejected and do not modify the results. */
+	fail_if(level_meter_process(&meter, GST_AUDIO_FORMAT_S24, samples, 10));
+	assert_equals_uint64(meter.num_frames, 50);
+}
+GST_END_TEST;
+
+
+static Suite * level_meter_suite(void)
+{
+	Suite *s = suite_create("level_meter");
+	TCase *tc = tcase_create("general");
+
+	suite_add_tcase(s, tc);
+	tcase_add_test(tc, constant_signals);
+	tcase_add_test(tc, peak_and_rms_differ);
+	tcase_add_test(tc, accumulation_and_reset);
+
+	return s;
+}
+
+GST_CHECK_MAIN(level_meter)
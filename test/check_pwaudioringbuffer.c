@@ -56,7 +56,9 @@ GST_START_TEST(creation_and_initial_states)
 	assert_equals_uint64(ring_buffer->metrics.write_position, 0);
 	assert_equals_uint64(ring_buffer->current_fill_level, 0);
 	fail_if(GST_CLOCK_TIME_IS_VALID(ring_buffer->oldest_frame_pts));
-	assert_equals_int(ring_buffer->num_pts_delta_history_entries, 0);
+	assert_equals_uint64(ring_buffer->num_cursors, 1);
+	fail_unless(ring_buffer->cursors[0].active);
+	assert_equals_int(ring_buffer->cursors[0].num_pts_delta_history_entries, 0);
 
 	gst_object_unref(GST_OBJECT(ring_buffer));
 }
@@ -486,11 +488,11 @@ GST_START_TEST(basic_timestamped_io)
 	 * duration of 1ms = 12ms, but we actually pass a timestamp of 15 ms,
 	 * and 15-12 = 3.) This "hole" should *not* affect placement - the
 	 * frames are still expected to be placed right after the already buffered
-	 * ones. push_frames() only looks at the PTS in the very beginning, when
-	 * oldest_frame_pts is set to GST_CLOCK_TIME_NONE. Afterwards it assumes
-	 * that the PCM stream has no "holes". Any such holes need to be dealt with
-	 * by the caller prior to calling push_frames() (for example by inserting
-	 * silence frames). */
+	 * ones, and oldest_frame_pts must not change. The ring buffer does not fill
+	 * such holes by itself; they need to be dealt with by the caller prior to
+	 * calling push_frames() (for example by inserting silence frames). The
+	 * PTS of the new frames is only recorded as the beginning of a new run
+	 * (see the timestamped_runs test). */
 	for (i = 0; i < num_frames_for_1ms; ++i)
 		frames[i] = i + 200;
 	num_silence_frames_to_prepend = 0;
@@ -624,6 +626,7 @@ GST_START_TEST(buffered_frames_fully_in_the_past)
 	gint16 frames[num_frames * NUM_CHANNELS];
 	GstClockTimeDiff buffered_frames_to_retrieval_pts_delta;
 	GstPwAudioRingBufferRetrievalResult retrieval_result;
+	GstClockTime expired_pts, expired_lateness;
 	guint i;
 
 	gst_audio_info_set_format(
@@ -679,6 +682,13 @@ GST_START_TEST(buffered_frames_fully_in_the_past)
 	assert_equals_uint64(ring_buffer->metrics.current_num_buffered_frames, 0);
 	assert_equals_uint64(ring_buffer->oldest_frame_pts, GST_CLOCK_TIME_NONE);
 
+	/* All buffered frames expired. The oldest one was 90ms late. */
+	expired_pts = GST_CLOCK_TIME_NONE;
+	expired_lateness = 0;
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_last_expired_frames(ring_buffer, 0, &expired_pts, &expired_lateness), num_frames_for_1ms);
+	assert_equals_uint64(expired_pts, GST_MSECOND * 10);
+	assert_equals_uint64(expired_lateness, GST_MSECOND * 90);
+
 	gst_object_unref(GST_OBJECT(ring_buffer));
 }
 GST_END_TEST
@@ -782,6 +792,7 @@ GST_START_TEST(buffered_frames_partially_in_the_past)
 	gint16 frames[num_frames * NUM_CHANNELS];
 	GstClockTimeDiff buffered_frames_to_retrieval_pts_delta;
 	GstPwAudioRingBufferRetrievalResult retrieval_result;
+	GstClockTime expired_pts, expired_lateness;
 	guint i;
 
 	gst_audio_info_set_format(
@@ -840,6 +851,26 @@ GST_START_TEST(buffered_frames_partially_in_the_past)
 	for (i = 0; i < (num_frames_for_1ms * 3); ++i)
 		assert_equals_int(frames[i], i + 10 + num_frames_for_1ms);
 
+	/* The skipped 1ms of frames must be reported as expired. */
+	expired_pts = GST_CLOCK_TIME_NONE;
+	expired_lateness = 0;
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_last_expired_frames(ring_buffer, 0, &expired_pts, &expired_lateness), num_frames_for_1ms);
+	assert_equals_uint64(expired_pts, GST_MSECOND * 10);
+	assert_equals_uint64(expired_lateness, GST_MSECOND * 1);
+
+	/* The next retrieval is in sync, so nothing expires. */
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(
+		ring_buffer,
+		frames,
+		num_frames_for_1ms * 3,
+		GST_MSECOND * 14,
+		0,
+		GST_MSECOND * 0,
+		&buffered_frames_to_retrieval_pts_delta
+	);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_last_expired_frames(ring_buffer, 0, NULL, NULL), 0);
+
 	gst_object_unref(GST_OBJECT(ring_buffer));
 }
 GST_END_TEST
@@ -930,6 +961,533 @@ GST_START_TEST(buffered_frames_partially_in_the_future_within_skew_threshold)
 GST_END_TEST
 
 
+GST_START_TEST(multiple_cursors)
+{
+	/* Test that cursors read independently from the same ring buffer,
+	 * and that the write side is limited by the slowest active cursor. */
+
+	GstPwAudioFormat format = {
+		.audio_type = GST_PIPEWIRE_AUDIO_TYPE_PCM,
+	};
+	GstPwAudioRingBuffer *ring_buffer;
+	gsize push_result;
+	gsize num_silence_frames_to_prepend;
+	GstClockTimeDiff buffered_frames_to_retrieval_pts_delta;
+	GstPwAudioRingBufferRetrievalResult retrieval_result;
+	enum { num_frames = CALC_NUM_FRAMES_FOR_MSECS(20) };
+	enum { num_frames_for_10ms = CALC_NUM_FRAMES_FOR_MSECS(10) };
+	gint16 frames[num_frames * NUM_CHANNELS];
+	gint cursor_index;
+	guint i;
+
+	gst_audio_info_set_format(
+		&(format.info.pcm_audio_info),
+		PCM_SAMPLE_FORMAT,
+		PCM_SAMPLE_RATE,
+		NUM_CHANNELS,
+		NULL
+	);
+
+	/* Create a ring buffer with room for exactly 20 ms of data. */
+	ring_buffer = gst_pw_audio_ring_buffer_new(&format, GST_MSECOND * 20);
+	fail_if(ring_buffer == NULL);
+	assert_equals_uint64(ring_buffer->metrics.capacity, num_frames);
+
+	cursor_index = gst_pw_audio_ring_buffer_add_cursor(ring_buffer);
+	assert_equals_int(cursor_index, 1);
+	assert_equals_uint64(ring_buffer->num_cursors, 2);
+	fail_if(ring_buffer->cursors[1].active);
+	gst_pw_audio_ring_buffer_set_cursor_active(ring_buffer, 1, TRUE);
+	fail_unless(ring_buffer->cursors[1].active);
+
+	/* Push 10 ms of data. Both cursors must see these frames. */
+	for (i = 0; i < num_frames_for_10ms; ++i)
+		frames[i] = i + 10;
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(
+		ring_buffer,
+		frames,
+		num_frames_for_10ms,
+		&num_silence_frames_to_prepend,
+		GST_CLOCK_TIME_NONE
+	);
+	assert_equals_uint64(push_result, num_frames_for_10ms);
+	assert_equals_uint64(ring_buffer->cursors[0].metrics.current_num_buffered_frames, num_frames_for_10ms);
+	assert_equals_uint64(ring_buffer->cursors[1].metrics.current_num_buffered_frames, num_frames_for_10ms);
+	assert_equals_uint64(ring_buffer->metrics.current_num_buffered_frames, num_frames_for_10ms);
+
+	/* Retrieve all of these frames through cursor #0. Cursor #1 still has
+	 * not read them, so they must remain in the ring buffer. */
+	memset(frames, 0, sizeof(frames));
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(
+		ring_buffer,
+		frames,
+		num_frames_for_10ms,
+		GST_CLOCK_TIME_NONE,
+		0,
+		0,
+		&buffered_frames_to_retrieval_pts_delta
+	);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < num_frames_for_10ms; ++i)
+		assert_equals_int(frames[i], i + 10);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_fill_level(ring_buffer, 0), 0);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_fill_level(ring_buffer, 1), GST_MSECOND * 10);
+	assert_equals_uint64(ring_buffer->metrics.current_num_buffered_frames, num_frames_for_10ms);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_current_fill_level(ring_buffer), GST_MSECOND * 10);
+
+	/* Try to push 20 ms of data. Since cursor #1 still occupies
+	 * 10 ms worth of space, only 10 ms can actually be pushed. */
+	for (i = 0; i < num_frames; ++i)
+		frames[i] = i + 1000;
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(
+		ring_buffer,
+		frames,
+		num_frames,
+		&num_silence_frames_to_prepend,
+		GST_CLOCK_TIME_NONE
+	);
+	assert_equals_uint64(push_result, num_frames_for_10ms);
+	assert_equals_uint64(ring_buffer->cursors[0].metrics.current_num_buffered_frames, num_frames_for_10ms);
+	assert_equals_uint64(ring_buffer->cursors[1].metrics.current_num_buffered_frames, num_frames);
+	assert_equals_uint64(ring_buffer->metrics.current_num_buffered_frames, num_frames);
+
+	/* Retrieve the oldest 10 ms through cursor #1. These must be
+	 * the frames that were pushed first. */
+	memset(frames, 0, sizeof(frames));
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames_with_cursor(
+		ring_buffer,
+		1,
+		frames,
+		num_frames_for_10ms,
+		GST_CLOCK_TIME_NONE,
+		0,
+		0,
+		&buffered_frames_to_retrieval_pts_delta
+	);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < num_frames_for_10ms; ++i)
+		assert_equals_int(frames[i], i + 10);
+	assert_equals_uint64(ring_buffer->metrics.current_num_buffered_frames, num_frames_for_10ms);
+
+	/* Push another 10 ms; now, this fits. Then deactivate cursor #1.
+	 * Afterwards, only cursor #0 must be taken into account. */
+	for (i = 0; i < num_frames_for_10ms; ++i)
+		frames[i] = i + 2000;
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(
+		ring_buffer,
+		frames,
+		num_frames_for_10ms,
+		&num_silence_frames_to_prepend,
+		GST_CLOCK_TIME_NONE
+	);
+	assert_equals_uint64(push_result, num_frames_for_10ms);
+	assert_equals_uint64(ring_buffer->metrics.current_num_buffered_frames, num_frames);
+
+	memset(frames, 0, sizeof(frames));
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(
+		ring_buffer,
+		frames,
+		num_frames,
+		GST_CLOCK_TIME_NONE,
+		0,
+		0,
+		&buffered_frames_to_retrieval_pts_delta
+	);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < num_frames_for_10ms; ++i)
+		assert_equals_int(frames[i], i + 1000);
+	for (i = 0; i < num_frames_for_10ms; ++i)
+		assert_equals_int(frames[i + num_frames_for_10ms], i + 2000);
+	assert_equals_uint64(ring_buffer->metrics.current_num_buffered_frames, num_frames);
+
+	gst_pw_audio_ring_buffer_set_cursor_active(ring_buffer, 1, FALSE);
+	assert_equals_uint64(ring_buffer->metrics.current_num_buffered_frames, 0);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_current_fill_level(ring_buffer), 0);
+
+	/* Test that setting the oldest frame PTS shifts the cursors by the
+	 * same amount instead of setting all of them to the same value.
+	 * Push 20 ms of timestamped data, and let cursor #0 read 10 ms of
+	 * it, so that the two cursors are at different positions. */
+	gst_pw_audio_ring_buffer_flush(ring_buffer);
+	gst_pw_audio_ring_buffer_set_cursor_active(ring_buffer, 1, TRUE);
+	for (i = 0; i < num_frames; ++i)
+		frames[i] = i;
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(
+		ring_buffer,
+		frames,
+		num_frames,
+		&num_silence_frames_to_prepend,
+		GST_MSECOND * 100
+	);
+	assert_equals_uint64(push_result, num_frames);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(
+		ring_buffer,
+		frames,
+		num_frames_for_10ms,
+		GST_CLOCK_TIME_NONE,
+		0,
+		0,
+		&buffered_frames_to_retrieval_pts_delta
+	);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_oldest_frame_pts(ring_buffer, 0), GST_MSECOND * 110);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_oldest_frame_pts(ring_buffer, 1), GST_MSECOND * 100);
+
+	/* Move cursor #0 back by 60 ms. Cursor #1 and the run must
+	 * be moved back by 60 ms as well. */
+	gst_pw_audio_ring_buffer_set_oldest_frame_pts(ring_buffer, GST_MSECOND * 50);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_oldest_frame_pts(ring_buffer, 0), GST_MSECOND * 50);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_oldest_frame_pts(ring_buffer, 1), GST_MSECOND * 40);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_oldest_frame_pts(ring_buffer), GST_MSECOND * 40);
+	assert_equals_uint64(ring_buffer->num_runs, 1);
+	assert_equals_uint64(ring_buffer->runs[0].pts, GST_MSECOND * 40);
+
+	/* Reading the rest through cursor #1 must continue from the shifted PTS. */
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames_with_cursor(
+		ring_buffer,
+		1,
+		frames,
+		num_frames_for_10ms,
+		GST_CLOCK_TIME_NONE,
+		0,
+		0,
+		&buffered_frames_to_retrieval_pts_delta
+	);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_cursor_oldest_frame_pts(ring_buffer, 1), GST_MSECOND * 50);
+
+	gst_object_unref(GST_OBJECT(ring_buffer));
+}
+GST_END_TEST
+
+
+GST_START_TEST(gap_frames)
+{
+	/* Test that gap frames are retrieved as silence without being
+	 * written into memory, and that retrievals that only produce
+	 * gap frames are reported as such. */
+
+	GstPwAudioFormat format = {
+		.audio_type = GST_PIPEWIRE_AUDIO_TYPE_PCM,
+	};
+	GstPwAudioRingBuffer *ring_buffer;
+	gsize push_result;
+	gsize num_silence_frames_to_prepend;
+	GstClockTimeDiff buffered_frames_to_retrieval_pts_delta;
+	GstPwAudioRingBufferRetrievalResult retrieval_result;
+	enum { num_frames = CALC_NUM_FRAMES_FOR_MSECS(10) };
+	gint16 frames[num_frames * 2 * NUM_CHANNELS];
+	guint i;
+
+	gst_audio_info_set_format(
+		&(format.info.pcm_audio_info),
+		PCM_SAMPLE_FORMAT,
+		PCM_SAMPLE_RATE,
+		NUM_CHANNELS,
+		NULL
+	);
+
+	ring_buffer = gst_pw_audio_ring_buffer_new(&format, GST_SECOND);
+	fail_if(ring_buffer == NULL);
+
+	/* Fill the memory block with nonzero values to be able to check
+	 * that gap frames are not written, but still retrieved as silence. */
+	memset(ring_buffer->buffered_frames, 0x55, ring_buffer->stride * ring_buffer->metrics.capacity);
+
+	/* Push 10 ms of data, then 10 ms of gap frames, then 10 ms of data. */
+	for (i = 0; i < num_frames; ++i)
+		frames[i] = i + 10;
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, num_frames, &num_silence_frames_to_prepend, GST_CLOCK_TIME_NONE);
+	assert_equals_uint64(push_result, num_frames);
+
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_gap_frames(ring_buffer, num_frames, &num_silence_frames_to_prepend, GST_CLOCK_TIME_NONE);
+	assert_equals_uint64(push_result, num_frames);
+	/* Data without a PTS is not tracked as a run, so only the gap is. */
+	assert_equals_uint64(ring_buffer->num_runs, 1);
+	fail_unless(ring_buffer->runs[0].is_gap);
+	for (i = 0; i < num_frames * ring_buffer->stride; ++i)
+		assert_equals_int(ring_buffer->buffered_frames[num_frames * ring_buffer->stride + i], 0x55);
+
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, num_frames, &num_silence_frames_to_prepend, GST_CLOCK_TIME_NONE);
+	assert_equals_uint64(push_result, num_frames);
+	assert_equals_uint64(ring_buffer->metrics.current_num_buffered_frames, num_frames * 3);
+
+	/* The first 10 ms are regular data. */
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, frames, num_frames, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < num_frames; ++i)
+		assert_equals_int(frames[i], i + 10);
+
+	/* The next 10 ms consist only of gap frames, which must be silent. */
+	memset(frames, 0x55, sizeof(frames));
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, frames, num_frames, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES);
+	for (i = 0; i < num_frames; ++i)
+		assert_equals_int(frames[i], 0);
+
+	/* The gap frames were read, so the gap run must be gone. */
+	assert_equals_uint64(ring_buffer->num_runs, 0);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, frames, num_frames, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < num_frames; ++i)
+		assert_equals_int(frames[i], i + 10);
+
+	/* Retrievals that cover both gap frames and regular data
+	 * must not be reported as gap-only retrievals. */
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_gap_frames(ring_buffer, num_frames, &num_silence_frames_to_prepend, GST_CLOCK_TIME_NONE);
+	assert_equals_uint64(push_result, num_frames);
+	for (i = 0; i < num_frames; ++i)
+		frames[i] = i + 10;
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, num_frames, &num_silence_frames_to_prepend, GST_CLOCK_TIME_NONE);
+	assert_equals_uint64(push_result, num_frames);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, frames, num_frames * 2, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < num_frames; ++i)
+		assert_equals_int(frames[i], 0);
+	for (i = 0; i < num_frames; ++i)
+		assert_equals_int(frames[i + num_frames], i + 10);
+
+	/* Flushing must discard all runs. */
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_gap_frames(ring_buffer, num_frames, &num_silence_frames_to_prepend, GST_CLOCK_TIME_NONE);
+	assert_equals_uint64(push_result, num_frames);
+	assert_equals_uint64(ring_buffer->num_runs, 1);
+	gst_pw_audio_ring_buffer_flush(ring_buffer);
+	assert_equals_uint64(ring_buffer->num_runs, 0);
+	assert_equals_uint64(ring_buffer->total_num_written_frames, 0);
+
+	gst_object_unref(GST_OBJECT(ring_buffer));
+}
+GST_END_TEST
+
+
+GST_START_TEST(timestamped_runs)
+{
+	/* Test that the oldest frame PTS is re-anchored to the PTS of
+	 * the run that the retrieval enters, instead of just being
+	 * incremented by the retrieved duration. */
+
+	GstPwAudioFormat format = {
+		.audio_type = GST_PIPEWIRE_AUDIO_TYPE_PCM,
+	};
+	GstPwAudioRingBuffer *ring_buffer;
+	gsize push_result;
+	gsize num_silence_frames_to_prepend;
+	GstClockTimeDiff buffered_frames_to_retrieval_pts_delta;
+	GstPwAudioRingBufferRetrievalResult retrieval_result;
+	enum { num_frames = CALC_NUM_FRAMES_FOR_MSECS(10) };
+	gint16 frames[num_frames * NUM_CHANNELS];
+	guint i;
+
+	gst_audio_info_set_format(
+		&(format.info.pcm_audio_info),
+		PCM_SAMPLE_FORMAT,
+		PCM_SAMPLE_RATE,
+		NUM_CHANNELS,
+		NULL
+	);
+
+	ring_buffer = gst_pw_audio_ring_buffer_new(&format, GST_SECOND);
+	fail_if(ring_buffer == NULL);
+
+	for (i = 0; i < num_frames; ++i)
+		frames[i] = i + 10;
+
+	/* Push 10 ms of data at PTS 0 ms, 10 ms of gap frames at PTS 10 ms,
+	 * and 10 ms of data at PTS 25 ms. The last chunk is not contiguous
+	 * with the gap, and no silence is prepended to compensate. */
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, num_frames, &num_silence_frames_to_prepend, 0);
+	assert_equals_uint64(push_result, num_frames);
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_gap_frames(ring_buffer, num_frames, &num_silence_frames_to_prepend, 10 * GST_MSECOND);
+	assert_equals_uint64(push_result, num_frames);
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, num_frames, &num_silence_frames_to_prepend, 25 * GST_MSECOND);
+	assert_equals_uint64(push_result, num_frames);
+
+	assert_equals_uint64(ring_buffer->num_runs, 3);
+	assert_equals_uint64(ring_buffer->oldest_frame_pts, 0);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, frames, num_frames, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	assert_equals_uint64(ring_buffer->oldest_frame_pts, 10 * GST_MSECOND);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, frames, num_frames, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK_ONLY_GAP_FRAMES);
+	/* Without re-anchoring, this would be 20 ms. */
+	assert_equals_uint64(ring_buffer->oldest_frame_pts, 25 * GST_MSECOND);
+
+	/* Shifting the oldest frame PTS must shift the run PTS as well. */
+	gst_pw_audio_ring_buffer_set_oldest_frame_pts(ring_buffer, 125 * GST_MSECOND);
+	assert_equals_uint64(ring_buffer->runs[ring_buffer->num_runs - 1].pts, 125 * GST_MSECOND);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, frames, num_frames / 2, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	assert_equals_uint64(ring_buffer->oldest_frame_pts, 130 * GST_MSECOND);
+	for (i = 0; i < num_frames / 2; ++i)
+		assert_equals_int(frames[i], i + 10);
+
+	/* Contiguous data chunks must only be merged into one run if their
+	 * PTS continue the run's timeline. Push 10 ms of data at PTS 0 ms,
+	 * 10 ms at PTS 10 ms, and 10 ms at PTS 40 ms. The second chunk
+	 * continues the first one; the third one must start a new run. */
+	gst_pw_audio_ring_buffer_flush(ring_buffer);
+	for (i = 0; i < num_frames; ++i)
+		frames[i] = i + 10;
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, num_frames, &num_silence_frames_to_prepend, 0);
+	assert_equals_uint64(push_result, num_frames);
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, num_frames, &num_silence_frames_to_prepend, 10 * GST_MSECOND);
+	assert_equals_uint64(push_result, num_frames);
+	assert_equals_uint64(ring_buffer->num_runs, 1);
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, num_frames, &num_silence_frames_to_prepend, 40 * GST_MSECOND);
+	assert_equals_uint64(push_result, num_frames);
+	assert_equals_uint64(ring_buffer->num_runs, 2);
+	assert_equals_uint64(ring_buffer->runs[1].pts, 40 * GST_MSECOND);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, frames, num_frames, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	assert_equals_uint64(ring_buffer->oldest_frame_pts, 10 * GST_MSECOND);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, frames, num_frames, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	/* If the chunks had been merged, this would be 20 ms. */
+	assert_equals_uint64(ring_buffer->oldest_frame_pts, 40 * GST_MSECOND);
+
+	gst_object_unref(GST_OBJECT(ring_buffer));
+}
+GST_END_TEST
+
+
+GST_START_TEST(channel_delays)
+{
+	/* Test that delayed channels are read from older frames,
+	 * that silence is read for frames before the first one,
+	 * and that the frames the delayed channels still need are
+	 * not overwritten when the memory block wraps around. */
+
+	GstPwAudioFormat format = {
+		.audio_type = GST_PIPEWIRE_AUDIO_TYPE_PCM,
+	};
+	GstPwAudioRingBuffer *ring_buffer;
+	gsize push_result;
+	gsize num_silence_frames_to_prepend;
+	GstClockTimeDiff buffered_frames_to_retrieval_pts_delta;
+	GstPwAudioRingBufferRetrievalResult retrieval_result;
+	guint const delays[] = { 0, 5, 7 };
+	enum { num_channels = 2, num_frames = 100, delay = 5 };
+	gint16 frames[num_frames * num_channels];
+	gint16 retrieved_frames[num_frames * num_channels];
+	guint i;
+
+	gst_audio_info_set_format(
+		&(format.info.pcm_audio_info),
+		PCM_SAMPLE_FORMAT,
+		PCM_SAMPLE_RATE,
+		num_channels,
+		NULL
+	);
+
+	/* Use a ring buffer length of 1 ms (48 frames) to be able to test
+	 * the wrap-around. The delay of the nonexistent third channel must
+	 * be ignored, so 5 extra frames are expected. */
+	ring_buffer = gst_pw_audio_ring_buffer_new_with_channel_delays(&format, GST_MSECOND, delays, G_N_ELEMENTS(delays));
+	fail_if(ring_buffer == NULL);
+	assert_equals_uint64(ring_buffer->metrics.capacity, CALC_NUM_FRAMES_FOR_MSECS(1) + delay);
+	assert_equals_uint64(gst_pw_audio_ring_buffer_get_capacity(ring_buffer), CALC_NUM_FRAMES_FOR_MSECS(1));
+
+	for (i = 0; i < num_frames; ++i)
+	{
+		frames[i * num_channels + 0] = i;
+		frames[i * num_channels + 1] = 1000 + i;
+	}
+
+	/* Only as many frames as the ring buffer length covers can be pushed. */
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, num_frames, &num_silence_frames_to_prepend, GST_CLOCK_TIME_NONE);
+	assert_equals_uint64(push_result, CALC_NUM_FRAMES_FOR_MSECS(1));
+
+	/* The first frames of the delayed channel lie before the first
+	 * frame, and must be silent. */
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, retrieved_frames, 20, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < 20; ++i)
+	{
+		assert_equals_int(retrieved_frames[i * num_channels + 0], i);
+		assert_equals_int(retrieved_frames[i * num_channels + 1], (i < delay) ? 0 : (gint)(1000 + i - delay));
+	}
+
+	/* 20 frames were read, so 20 can be pushed again. These wrap around
+	 * the end of the memory block, but must not overwrite the last
+	 * 5 frames that were read, since the delayed channel needs them. */
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(
+		ring_buffer,
+		frames + CALC_NUM_FRAMES_FOR_MSECS(1) * num_channels,
+		num_frames - CALC_NUM_FRAMES_FOR_MSECS(1),
+		&num_silence_frames_to_prepend,
+		GST_CLOCK_TIME_NONE
+	);
+	assert_equals_uint64(push_result, 20);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, retrieved_frames, CALC_NUM_FRAMES_FOR_MSECS(1), GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < CALC_NUM_FRAMES_FOR_MSECS(1); ++i)
+	{
+		assert_equals_int(retrieved_frames[i * num_channels + 0], 20 + i);
+		assert_equals_int(retrieved_frames[i * num_channels + 1], 1000 + 20 + i - delay);
+	}
+
+	/* Gap frames must be written into memory, since the delayed
+	 * channel reads them after the gap run is gone. Also, since the
+	 * delayed channel still carries data, the retrieval must not be
+	 * reported as one that only produced gap frames. */
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_gap_frames(ring_buffer, delay * 2, &num_silence_frames_to_prepend, GST_CLOCK_TIME_NONE);
+	assert_equals_uint64(push_result, delay * 2);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, retrieved_frames, delay * 2, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < delay * 2; ++i)
+	{
+		assert_equals_int(retrieved_frames[i * num_channels + 0], 0);
+		assert_equals_int(retrieved_frames[i * num_channels + 1], (i < delay) ? (gint)(1000 + 68 - delay + i) : 0);
+	}
+
+	/* After a flush, the delayed channel must not read old frames. */
+	gst_pw_audio_ring_buffer_flush(ring_buffer);
+	num_silence_frames_to_prepend = 0;
+	push_result = gst_pw_audio_ring_buffer_push_frames(ring_buffer, frames, delay, &num_silence_frames_to_prepend, GST_CLOCK_TIME_NONE);
+	assert_equals_uint64(push_result, delay);
+
+	retrieval_result = gst_pw_audio_ring_buffer_retrieve_frames(ring_buffer, retrieved_frames, delay, GST_CLOCK_TIME_NONE, 0, 0, &buffered_frames_to_retrieval_pts_delta);
+	assert_equals_int(retrieval_result, GST_PW_AUDIO_RING_BUFFER_RETRIEVAL_RESULT_OK);
+	for (i = 0; i < delay; ++i)
+	{
+		assert_equals_int(retrieved_frames[i * num_channels + 0], i);
+		assert_equals_int(retrieved_frames[i * num_channels + 1], 0);
+	}
+
+	gst_object_unref(GST_OBJECT(ring_buffer));
+}
+GST_END_TEST
+
+
 static Suite * gst_pw_audio_ring_buffer_suite(void)
 {
 	Suite *s = suite_create("gst_pipewire_dsd_convert");
@@ -947,6 +1505,10 @@ static Suite * gst_pw_audio_ring_buffer_suite(void)
 	tcase_add_test(tc, buffered_frames_partially_in_the_future);
 	tcase_add_test(tc, buffered_frames_partially_in_the_past);
 	tcase_add_test(tc, buffered_frames_partially_in_the_future_within_skew_threshold);
+	tcase_add_test(tc, multiple_cursors);
+	tcase_add_test(tc, gap_frames);
+	tcase_add_test(tc, timestamped_runs);
+	tcase_add_test(tc, channel_delays);
 
 	return s;
 }
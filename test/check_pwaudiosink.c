@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#include <pipewire/pipewire.h>
+
+#pragma GCC diagnostic pop
+
+
+/* These tests need a running PipeWire daemon. If none can be reached,
+ * the whole suite is skipped. The pwaudiosink element is loaded from
+ * the plugin in the build directory (see GST_PLUGIN_PATH in meson.build). */
+
+
+#define SAMPLE_RATE 48000
+#define NUM_CHANNELS 2
+#define STRIDE (NUM_CHANNELS * 2)
+#define NUM_FRAMES_PER_BUFFER (SAMPLE_RATE / 100)
+#define BUFFER_DURATION (GST_MSECOND * 10)
+
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE(
+	"src",
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS("audio/x-raw, format = (string) S16LE, layout = (string) interleaved, rate = (int) 48000, channels = (int) 2")
+);
+
+
+static gboolean pipewire_daemon_is_available(void)
+{
+	struct pw_main_loop *main_loop;
+	struct pw_context *context;
+	struct pw_core *core;
+	gboolean available;
+
+	pw_init(NULL, NULL);
+
+	main_loop = pw_main_loop_new(NULL);
+	context = pw_context_new(pw_main_loop_get_loop(main_loop), NULL, 0);
+	core = pw_context_connect(context, NULL, 0);
+	available = (core != NULL);
+
+	if (core != NULL)
+		pw_core_disconnect(core);
+	pw_context_destroy(context);
+	pw_main_loop_destroy(main_loop);
+
+	return available;
+}
+
+
+static guint get_num_idle_suspensions(GstElement *sink)
+{
+	GstStructure *stats;
+	guint num_idle_suspensions = 0;
+
+	g_object_get(G_OBJECT(sink), "stats", &stats, NULL);
+	fail_unless(gst_structure_get_uint(stats, "num-idle-suspensions", &num_idle_suspensions));
+	gst_structure_free(stats);
+
+	return num_idle_suspensions;
+}
+
+
+static void push_silence(GstPad *srcpad, guint num_buffers, guint *buffer_index)
+{
+	guint i;
+
+	for (i = 0; i < num_buffers; ++i)
+	{
+		GstBuffer *buffer = gst_buffer_new_allocate(NULL, NUM_FRAMES_PER_BUFFER * STRIDE, NULL);
+		gst_buffer_memset(buffer, 0, 0, NUM_FRAMES_PER_BUFFER * STRIDE);
+		GST_BUFFER_PTS(buffer) = (*buffer_index) * BUFFER_DURATION;
+		GST_BUFFER_DURATION(buffer) = BUFFER_DURATION;
+		(*buffer_index)++;
+
+		fail_unless_equals_int(gst_pad_push(srcpad, buffer), GST_FLOW_OK);
+	}
+}
+
+
+static gboolean wait_for_idle_suspension(GstElement *sink, guint num_expected_suspensions)
+{
+	gint64 end_time = g_get_monotonic_time() + 10 * G_TIME_SPAN_SECOND;
+
+	while (g_get_monotonic_time() < end_time)
+	{
+		if (get_num_idle_suspensions(sink) >= num_expected_suspensions)
+			return TRUE;
+		g_usleep(10 * G_TIME_SPAN_MILLISECOND);
+	}
+
+	return FALSE;
+}
+
+
+GST_START_TEST(idle_suspension_in_freewheel_mode)
+{
+	GstElement *sink;
+	GstPad *srcpad;
+	GstCaps *caps;
+	GstStateChangeReturn state_change_ret;
+	guint buffer_index = 0;
+
+	sink = gst_check_setup_element("pwaudiosink");
+	g_object_set(G_OBJECT(sink), "freewheel", TRUE, "idle-timeout", (guint)50, "sync", FALSE, NULL);
+
+	srcpad = gst_check_setup_src_pad(sink, &srctemplate);
+	gst_pad_set_active(srcpad, TRUE);
+
+	caps = gst_static_pad_template_get_caps(&srctemplate);
+	gst_check_setup_events(srcpad, sink, caps, GST_FORMAT_TIME);
+	gst_caps_unref(caps);
+
+	state_change_ret = gst_element_set_state(sink, GST_STATE_PLAYING);
+	fail_unless(state_change_ret != GST_STATE_CHANGE_FAILURE);
+
+	/* In freewheel mode, the process callback waits for data while
+	 * the ring buffer is empty. Once that wait times out for longer
+	 * than the idle timeout, the stream is suspended. Then, pushing
+	 * more data must resume the stream. This is done twice to make
+	 * sure that suspending and resuming do not deadlock with the
+	 * freewheel wait, and that the stream gets suspended again after
+	 * it was resumed. */
+
+	push_silence(srcpad, 20, &buffer_index);
+	fail_unless(wait_for_idle_suspension(sink, 1));
+
+	push_silence(srcpad, 20, &buffer_index);
+	fail_unless(wait_for_idle_suspension(sink, 2));
+
+	push_silence(srcpad, 20, &buffer_index);
+	fail_unless(gst_pad_push_event(srcpad, gst_event_new_eos()));
+
+	fail_unless_equals_int(gst_element_set_state(sink, GST_STATE_NULL), GST_STATE_CHANGE_SUCCESS);
+
+	gst_pad_set_active(srcpad, FALSE);
+	gst_check_teardown_src_pad(sink);
+	gst_check_teardown_element(sink);
+}
+GST_END_TEST;
+
+
+static Suite * pw_audio_sink_suite(void)
+{
+	Suite *s = suite_create("pw_audio_sink");
+	TCase *tc = tcase_create("general");
+
+	suite_add_tcase(s, tc);
+	tcase_set_timeout(tc, 60);
+	tcase_add_test(tc, idle_suspension_in_freewheel_mode);
+
+	return s;
+}
+
+
+int main(int argc, char **argv)
+{
+	Suite *s;
+
+	gst_check_init(&argc, &argv);
+
+	if (!pipewire_daemon_is_available())
+	{
+		g_print("no PipeWire daemon available; skipping pwaudiosink tests\n");
+		/* 77 is the exit code that tells meson that the test was skipped. */
+		return 77;
+	}
+
+	s = pw_audio_sink_suite();
+
+	return gst_check_run_suite(s, "pw_audio_sink", __FILE__);
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+#include "gstpwaudiotap.h"
+
+
+static void fill_block(guint8 *block, gsize num_bytes, guint8 first_value)
+{
+	gsize i;
+	for (i = 0; i < num_bytes; ++i)
+		block[i] = (guint8)(first_value + i);
+}
+
+
+static void check_buffer(GstBuffer *buffer, guint8 const *expected_block, gsize num_bytes, GstClockTime expected_pts, GstClockTime expected_duration)
+{
+	fail_unless(buffer != NULL);
+	assert_equals_uint64(gst_buffer_get_size(buffer), num_bytes);
+	fail_unless(gst_buffer_memcmp(buffer, 0, expected_block, num_bytes) == 0);
+	assert_equals_uint64(GST_BUFFER_PTS(buffer), expected_pts);
+	assert_equals_uint64(GST_BUFFER_DURATION(buffer), expected_duration);
+}
+
+
+GST_START_TEST(write_and_read_blocks)
+{
+	GstPwAudioTap *tap;
+	guint8 block1[100], block2[37];
+	GstBuffer *buffer;
+
+	tap = gst_pw_audio_tap_new(1024);
+	fail_unless(tap != NULL);
+
+	/* An empty tap must not produce buffers. */
+	fail_unless(gst_pw_audio_tap_read(tap) == NULL);
+
+	fill_block(block1, sizeof(block1), 0);
+	fill_block(block2, sizeof(block2), 100);
+
+	fail_unless(gst_pw_audio_tap_write(tap, block1, sizeof(block1), 1000, 50, FALSE));
+	fail_unless(gst_pw_audio_tap_write(tap, block2, sizeof(block2), 1050, 20, TRUE));
+
+	/* Blocks must come out in the order they were written in. */
+	buffer = gst_pw_audio_tap_read(tap);
+	check_buffer(buffer, block1, sizeof(block1), 1000, 50);
+	fail_if(GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_GAP));
+	fail_if(GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT));
+	gst_buffer_unref(buffer);
+
+	buffer = gst_pw_audio_tap_read(tap);
+	check_buffer(buffer, block2, sizeof(block2), 1050, 20);
+	fail_unless(GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_GAP));
+	gst_buffer_unref(buffer);
+
+	fail_unless(gst_pw_audio_tap_read(tap) == NULL);
+	assert_equals_int(gst_pw_audio_tap_get_num_dropped_blocks(tap), 0);
+
+	gst_object_unref(GST_OBJECT(tap));
+}
+GST_END_TEST;
+
+
+GST_START_TEST(blocks_wrap_around)
+{
+	/* Write and read many blocks of varying sizes that do not evenly
+	 * divide the capacity. This forces the blocks to wrap around the
+	 * end of the memory region at different offsets, which must not
+	 * corrupt the data. */
+
+	GstPwAudioTap *tap;
+	guint8 block[200];
+	GstBuffer *buffer;
+	guint i;
+
+	tap = gst_pw_audio_tap_new(512);
+	fail_unless(tap != NULL);
+
+	for (i = 0; i < 1000; ++i)
+	{
+		gsize num_bytes = 1 + (i * 37) % sizeof(block);
+
+		fill_block(block, num_bytes, i);
+		fail_unless(gst_pw_audio_tap_write(tap, block, num_bytes, i * 10, 10, FALSE));
+
+		buffer = gst_pw_audio_tap_read(tap);
+		check_buffer(buffer, block, num_bytes, i * 10, 10);
+		gst_buffer_unref(buffer);
+	}
+
+	fail_unless(gst_pw_audio_tap_read(tap) == NULL);
+	assert_equals_int(gst_pw_audio_tap_get_num_dropped_blocks(tap), 0);
+
+	gst_object_unref(GST_OBJECT(tap));
+}
+GST_END_TEST;
+
+
+GST_START_TEST(full_tap_drops_blocks)
+{
+	/* If the consumer does not keep up, the producer must drop blocks
+	 * instead of overwriting unread ones, and the first block after
+	 * the dropped ones must be marked as discontinuous. */
+
+	GstPwAudioTap *tap;
+	guint8 block[100];
+	GstBuffer *buffer;
+	guint num_written_blocks = 0;
+	guint i;
+
+	tap = gst_pw_audio_tap_new(512);
+	fail_unless(tap != NULL);
+
+	for (i = 0; i < 10; ++i)
+	{
+		fill_block(block, sizeof(block), i);
+		if (gst_pw_audio_tap_write(tap, block, sizeof(block), i, 1, FALSE))
+			num_written_blocks++;
+	}
+
+	fail_unless(num_written_blocks > 0);
+	fail_unless(num_written_blocks < 10);
+	assert_equals_int(gst_pw_audio_tap_get_num_dropped_blocks(tap), 10 - num_written_blocks);
+
+	/* The written blocks must be intact. */
+	for (i = 0; i < num_written_blocks; ++i)
+	{
+		fill_block(block, sizeof(block), i);
+		buffer = gst_pw_audio_tap_read(tap);
+		check_buffer(buffer, block, sizeof(block), i, 1);
+		fail_if(GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT));
+		gst_buffer_unref(buffer);
+	}
+
+	fail_unless(gst_pw_audio_tap_read(tap) == NULL);
+
+	/* Now that there is room again, the next block must be written,
+	 * and marked as discontinuous. The one after it must not. */
+	fill_block(block, sizeof(block), 50);
+	fail_unless(gst_pw_audio_tap_write(tap, block, sizeof(block), 50, 1, FALSE));
+	fail_unless(gst_pw_audio_tap_write(tap, block, sizeof(block), 51, 1, FALSE));
+
+	buffer = gst_pw_audio_tap_read(tap);
+	check_buffer(buffer, block, sizeof(block), 50, 1);
+	fail_unless(GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT));
+	gst_buffer_unref(buffer);
+
+	buffer = gst_pw_audio_tap_read(tap);
+	check_buffer(buffer, block, sizeof(block), 51, 1);
+	fail_if(GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT));
+	gst_buffer_unref(buffer);
+
+	/* Flushing discards everything, including the drop counter. */
+	fail_unless(gst_pw_audio_tap_write(tap, block, sizeof(block), 52, 1, FALSE));
+	gst_pw_audio_tap_flush(tap);
+	fail_unless(gst_pw_audio_tap_read(tap) == NULL);
+	assert_equals_int(gst_pw_audio_tap_get_num_dropped_blocks(tap), 0);
+
+	/* Blocks that are larger than the entire tap are always dropped. */
+	{
+		static guint8 oversized_block[600];
+		fail_if(gst_pw_audio_tap_write(tap, oversized_block, sizeof(oversized_block), 60, 1, FALSE));
+		fail_unless(gst_pw_audio_tap_read(tap) == NULL);
+		assert_equals_int(gst_pw_audio_tap_get_num_dropped_blocks(tap), 1);
+	}
+
+	gst_object_unref(GST_OBJECT(tap));
+}
+GST_END_TEST;
+
+
+static Suite * pw_audio_tap_suite(void)
+{
+	Suite *s = suite_create("pw_audio_tap");
+	TCase *tc = tcase_create("general");
+
+	suite_add_tcase(s, tc);
+	tcase_add_test(tc, write_and_read_blocks);
+	tcase_add_test(tc, blocks_wrap_around);
+	tcase_add_test(tc, full_tap_drops_blocks);
+
+	return s;
+}
+
+GST_CHECK_MAIN(pw_audio_tap)
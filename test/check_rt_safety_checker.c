@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#include <pipewire/pipewire.h>
+
+#pragma GCC diagnostic pop
+
+#include "gstpwaudiotap.h"
+#include "level_meter.h"
+#include "rt_safety_checker.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(rt_safety_checker_test_debug);
+
+
+/* This test is linked against an instrumented, statically registered build
+ * of the plugin (see meson.build), so the process callbacks of the actual
+ * elements run through the checker as well. Those tests need a running
+ * PipeWire daemon, and are left out if none can be reached. */
+GST_PLUGIN_STATIC_DECLARE(pipewireextra);
+
+
+#define SAMPLE_RATE 48000
+#define NUM_CHANNELS 2
+#define STRIDE (NUM_CHANNELS * 2)
+#define NUM_FRAMES_PER_BUFFER (SAMPLE_RATE / 100)
+#define BUFFER_DURATION (GST_MSECOND * 10)
+#define PROCESSING_DURATION (G_TIME_SPAN_MILLISECOND * 500)
+
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE(
+	"src",
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS("audio/x-raw, format = (string) S16LE, layout = (string) interleaved, rate = (int) 48000, channels = (int) 2")
+);
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE(
+	"sink",
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_STATIC_CAPS("audio/x-raw, format = (string) S16LE, layout = (string) interleaved, rate = (int) 48000, channels = (int) 2")
+);
+
+
+static void setup(void)
+{
+	GST_DEBUG_CATEGORY_INIT(rt_safety_checker_test_debug, "rtsafetycheckertest", 0, "RT safety checker test");
+	rt_safety_checker_init();
+	rt_safety_checker_reset_num_violations();
+}
+
+
+GST_START_TEST(allocations_are_detected)
+{
+	gpointer ptr;
+
+	/* Allocations outside of realtime sections are fine. */
+	ptr = g_malloc(100);
+	g_free(ptr);
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+
+	rt_safety_checker_enter("test section");
+	fail_unless(rt_safety_checker_is_in_rt_section());
+	ptr = g_malloc(100);
+	g_free(ptr);
+	rt_safety_checker_leave();
+
+	fail_if(rt_safety_checker_is_in_rt_section());
+	assert_equals_int(rt_safety_checker_get_num_violations(), 2);
+
+	/* Freeing NULL is a no-op and therefore allowed. */
+	rt_safety_checker_reset_num_violations();
+	rt_safety_checker_enter("test section");
+	free(NULL);
+	rt_safety_checker_leave();
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(nested_sections)
+{
+	gpointer ptr;
+
+	/* Leaving a nested section must not end the outer one. */
+	rt_safety_checker_enter("outer section");
+	rt_safety_checker_enter("inner section");
+	rt_safety_checker_leave();
+	ptr = g_malloc(100);
+	rt_safety_checker_leave();
+
+	g_free(ptr);
+	assert_equals_int(rt_safety_checker_get_num_violations(), 1);
+}
+GST_END_TEST;
+
+
+static GMutex contended_mutex;
+
+static gpointer lock_contended_mutex(G_GNUC_UNUSED gpointer data)
+{
+	rt_safety_checker_enter("mutex test section");
+	rt_safety_checker_mutex_lock(&contended_mutex);
+	g_mutex_unlock(&contended_mutex);
+	rt_safety_checker_leave();
+	return NULL;
+}
+
+GST_START_TEST(mutex_waits_are_detected)
+{
+	GThread *thread;
+	gint64 deadline;
+
+	g_mutex_init(&contended_mutex);
+
+	/* Locking an uncontended mutex does not involve waiting. */
+	rt_safety_checker_enter("mutex test section");
+	rt_safety_checker_mutex_lock(&contended_mutex);
+	g_mutex_unlock(&contended_mutex);
+	rt_safety_checker_leave();
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+
+	/* Hold the mutex while the other thread tries to lock it. The
+	 * violation is reported before that thread starts waiting. */
+	g_mutex_lock(&contended_mutex);
+	thread = g_thread_new("contender", lock_contended_mutex, NULL);
+
+	deadline = g_get_monotonic_time() + 5 * G_TIME_SPAN_SECOND;
+	while ((rt_safety_checker_get_num_violations() == 0) && (g_get_monotonic_time() < deadline))
+		g_usleep(1000);
+
+	g_mutex_unlock(&contended_mutex);
+	g_thread_join(thread);
+
+	assert_equals_int(rt_safety_checker_get_num_violations(), 1);
+
+	g_mutex_clear(&contended_mutex);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(cond_waits_are_detected)
+{
+	GMutex mutex;
+	GCond cond;
+
+	g_mutex_init(&mutex);
+	g_cond_init(&cond);
+	g_mutex_lock(&mutex);
+
+	/* Signalling never blocks, and is therefore allowed. */
+	rt_safety_checker_enter("cond test section");
+	RT_SAFETY_CHECKER_COND_SIGNAL(&cond);
+	RT_SAFETY_CHECKER_COND_BROADCAST(&cond);
+	rt_safety_checker_leave();
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+
+	rt_safety_checker_enter("cond test section");
+	rt_safety_checker_cond_wait_until(&cond, &mutex, g_get_monotonic_time() + G_TIME_SPAN_MILLISECOND);
+	rt_safety_checker_leave();
+	assert_equals_int(rt_safety_checker_get_num_violations(), 1);
+
+	/* Waits are not reported once the section permits them,
+	 * even in nested sections ... */
+	rt_safety_checker_reset_num_violations();
+	rt_safety_checker_enter("cond test section");
+	rt_safety_checker_permit_waits();
+	rt_safety_checker_enter("inner section");
+	rt_safety_checker_cond_wait_until(&cond, &mutex, g_get_monotonic_time() + G_TIME_SPAN_MILLISECOND);
+	rt_safety_checker_leave();
+	rt_safety_checker_leave();
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+
+	/* ... but the permission ends with the outermost section. */
+	rt_safety_checker_enter("cond test section");
+	rt_safety_checker_cond_wait_until(&cond, &mutex, g_get_monotonic_time() + G_TIME_SPAN_MILLISECOND);
+	rt_safety_checker_leave();
+	assert_equals_int(rt_safety_checker_get_num_violations(), 1);
+
+	g_mutex_unlock(&mutex);
+	g_cond_clear(&cond);
+	g_mutex_clear(&mutex);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(syscalls_are_detected)
+{
+	struct timespec ts;
+
+	/* Clocks that are served by the vDSO do not enter the kernel. */
+	rt_safety_checker_enter("test section");
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	clock_gettime(CLOCK_REALTIME, &ts);
+	rt_safety_checker_leave();
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+
+	rt_safety_checker_enter("test section");
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	sched_yield();
+	rt_safety_checker_leave();
+	assert_equals_int(rt_safety_checker_get_num_violations(), 2);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(logging_is_detected)
+{
+	/* Log messages below the threshold are not formatted,
+	 * and are therefore not reported. */
+	gst_debug_set_threshold_for_name("rtsafetycheckertest", GST_LEVEL_NONE);
+	rt_safety_checker_enter("test section");
+	GST_CAT_LOG(rt_safety_checker_test_debug, "this is not formatted");
+	rt_safety_checker_leave();
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+
+	gst_debug_set_threshold_for_name("rtsafetycheckertest", GST_LEVEL_LOG);
+	rt_safety_checker_enter("test section");
+	GST_CAT_LOG(rt_safety_checker_test_debug, "this is formatted");
+	rt_safety_checker_leave();
+	gst_debug_set_threshold_for_name("rtsafetycheckertest", GST_LEVEL_NONE);
+
+	/* Formatting also allocates memory, which is reported as well. */
+	fail_unless(rt_safety_checker_get_num_violations() >= 1);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(realtime_producer_paths_are_rt_safe)
+{
+	/* Run the code that the process callbacks use for producing audio
+	 * data through the checker. This fails if any of these functions
+	 * starts allocating memory, blocking, or logging. */
+
+	GstPwAudioTap *tap;
+	LevelMeter meter;
+	gint16 samples[256 * 2];
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(samples); ++i)
+		samples[i] = (gint16)(i * 100);
+
+	tap = gst_pw_audio_tap_new(4096);
+	fail_unless(tap != NULL);
+	level_meter_init(&meter, 2);
+
+	rt_safety_checker_enter("producer test section");
+	/* This writes more blocks than the tap can hold,
+	 * so the code path for dropping blocks is covered too. */
+	for (i = 0; i < 10; ++i)
+	{
+		gst_pw_audio_tap_write(tap, samples, sizeof(samples), i * 1000, 1000, FALSE);
+		level_meter_process(&meter, GST_AUDIO_FORMAT_S16, samples, 256);
+	}
+	rt_safety_checker_leave();
+
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+	fail_unless(gst_pw_audio_tap_get_num_dropped_blocks(tap) > 0);
+
+	gst_object_unref(GST_OBJECT(tap));
+}
+GST_END_TEST;
+
+
+static gboolean pipewire_daemon_is_available(void)
+{
+	struct pw_main_loop *main_loop;
+	struct pw_context *context;
+	struct pw_core *core;
+	gboolean available;
+
+	pw_init(NULL, NULL);
+
+	main_loop = pw_main_loop_new(NULL);
+	context = pw_context_new(pw_main_loop_get_loop(main_loop), NULL, 0);
+	core = pw_context_connect(context, NULL, 0);
+	available = (core != NULL);
+
+	if (core != NULL)
+		pw_core_disconnect(core);
+	pw_context_destroy(context);
+	pw_main_loop_destroy(main_loop);
+
+	return available;
+}
+
+
+static void run_pw_audio_sink(gboolean freewheel)
+{
+	GstElement *sink;
+	GstPad *srcpad;
+	GstCaps *caps;
+	guint i;
+
+	sink = gst_check_setup_element("pwaudiosink");
+	g_object_set(G_OBJECT(sink), "freewheel", freewheel, "sync", FALSE, NULL);
+
+	srcpad = gst_check_setup_src_pad(sink, &srctemplate);
+	gst_pad_set_active(srcpad, TRUE);
+
+	caps = gst_static_pad_template_get_caps(&srctemplate);
+	gst_check_setup_events(srcpad, sink, caps, GST_FORMAT_TIME);
+	gst_caps_unref(caps);
+
+	fail_unless(gst_element_set_state(sink, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+
+	/* Push less data than the ring buffer can hold, so that pushing
+	 * never blocks, even if the stream is not being driven. The process
+	 * callback then plays this data, followed by silence. */
+	for (i = 0; i < 5; ++i)
+	{
+		GstBuffer *buffer = gst_buffer_new_allocate(NULL, NUM_FRAMES_PER_BUFFER * STRIDE, NULL);
+		gst_buffer_memset(buffer, 0, 0, NUM_FRAMES_PER_BUFFER * STRIDE);
+		GST_BUFFER_PTS(buffer) = i * BUFFER_DURATION;
+		GST_BUFFER_DURATION(buffer) = BUFFER_DURATION;
+		fail_unless_equals_int(gst_pad_push(srcpad, buffer), GST_FLOW_OK);
+	}
+
+	g_usleep(PROCESSING_DURATION);
+
+	fail_unless_equals_int(gst_element_set_state(sink, GST_STATE_NULL), GST_STATE_CHANGE_SUCCESS);
+
+	gst_pad_set_active(srcpad, FALSE);
+	gst_check_teardown_src_pad(sink);
+	gst_check_teardown_element(sink);
+}
+
+
+GST_START_TEST(pw_audio_sink_process_callback_is_rt_safe)
+{
+	run_pw_audio_sink(FALSE);
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(pw_audio_sink_freewheel_process_callback_is_rt_safe)
+{
+	/* In freewheel mode, the process callback waits for data,
+	 * which is permitted; anything else must still be reported. */
+	run_pw_audio_sink(TRUE);
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(pw_audio_src_process_callback_is_rt_safe)
+{
+	GstElement *src;
+	GstPad *sinkpad;
+
+	src = gst_check_setup_element("pwaudiosrc");
+
+	sinkpad = gst_check_setup_sink_pad(src, &sinktemplate);
+	gst_pad_set_active(sinkpad, TRUE);
+
+	fail_unless(gst_element_set_state(src, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+	g_usleep(PROCESSING_DURATION);
+	fail_unless_equals_int(gst_element_set_state(src, GST_STATE_NULL), GST_STATE_CHANGE_SUCCESS);
+
+	gst_check_drop_buffers();
+	gst_pad_set_active(sinkpad, FALSE);
+	gst_check_teardown_sink_pad(src);
+	gst_check_teardown_element(src);
+
+	assert_equals_int(rt_safety_checker_get_num_violations(), 0);
+}
+GST_END_TEST;
+
+
+static Suite * rt_safety_checker_suite(gboolean pipewire_daemon_available)
+{
+	Suite *s = suite_create("rt_safety_checker");
+	TCase *tc = tcase_create("general");
+
+	suite_add_tcase(s, tc);
+	tcase_add_checked_fixture(tc, setup, NULL);
+	tcase_add_test(tc, allocations_are_detected);
+	tcase_add_test(tc, nested_sections);
+	tcase_add_test(tc, mutex_waits_are_detected);
+	tcase_add_test(tc, cond_waits_are_detected);
+	tcase_add_test(tc, syscalls_are_detected);
+	tcase_add_test(tc, logging_is_detected);
+	tcase_add_test(tc, realtime_producer_paths_are_rt_safe);
+
+	if (pipewire_daemon_available)
+	{
+		TCase *tc_elements = tcase_create("elements");
+
+		suite_add_tcase(s, tc_elements);
+		tcase_set_timeout(tc_elements, 30);
+		tcase_add_checked_fixture(tc_elements, setup, NULL);
+		tcase_add_test(tc_elements, pw_audio_sink_process_callback_is_rt_safe);
+		tcase_add_test(tc_elements, pw_audio_sink_freewheel_process_callback_is_rt_safe);
+		tcase_add_test(tc_elements, pw_audio_src_process_callback_is_rt_safe);
+	}
+	else
+		g_print("no PipeWire daemon available; skipping the element process callback tests\n");
+
+	return s;
+}
+
+
+int main(int argc, char **argv)
+{
+	Suite *s;
+
+	gst_check_init(&argc, &argv);
+	GST_PLUGIN_STATIC_REGISTER(pipewireextra);
+
+	s = rt_safety_checker_suite(pipewire_daemon_is_available());
+
+	return gst_check_run_suite(s, "rt_safety_checker", __FILE__);
+}
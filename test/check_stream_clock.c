@@ -215,6 +215,115 @@ GST_START_TEST(extrapolation_overshoot)
 GST_END_TEST;
 
 
+GST_START_TEST(discontinuous_observation)
+{
+	GstPwStreamClock *clock;
+	GstClockTime t;
+
+	/* Create our pwstreamclock when the simulated sysclock is at timestamp 1000
+	 * and add two observations to establish a driver clock rate of 1/2. */
+	test_sysclock_time = 1000;
+	clock = gst_pw_stream_clock_new(get_test_sysclock_time);
+	ADD_OBSERVATION(clock, 500, 1000);
+	test_sysclock_time = 2000;
+	ADD_OBSERVATION(clock, 1000, 2000);
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 500);
+
+	/* Simulate a driver change. The new driver's clock is at 900000, which
+	 * is not continuous with the previous observations. We expect the clock
+	 * to continue where the extrapolation would have been at sysclock time
+	 * 3000, that is: (3000 - 2000) * 0.5 + 500 = 1000. */
+	{
+		struct pw_time t = {
+			.now = 3000,
+			.ticks = 900000,
+			.rate = { .num = 1, .denom = GST_SECOND }
+		};
+		gst_pw_stream_clock_add_discontinuous_observation(clock, &t);
+	}
+	test_sysclock_time = 3000;
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 1000);
+
+	/* The previous driver clock rate of 1/2 stays in use. */
+	test_sysclock_time = 3200;
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 1100);
+
+	/* A regular observation from the new driver now establishes the new
+	 * driver clock rate. This one is 1/1: (901000 - 900000) / (4000 - 3000).
+	 * The driver clock time must continue at: 1000 + (901000 - 900000) = 2000. */
+	test_sysclock_time = 4000;
+	ADD_OBSERVATION(clock, 901000, 4000);
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 2000);
+
+	test_sysclock_time = 4100;
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 2100);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(follow_graph_time)
+{
+	GstPwStreamClock *clock;
+	GstClockTime t;
+
+	/* Establish a driver clock rate of 1/2 with two regular observations. */
+	test_sysclock_time = 1000;
+	clock = gst_pw_stream_clock_new(get_test_sysclock_time);
+	ADD_OBSERVATION(clock, 500, 1000);
+	test_sysclock_time = 2000;
+	ADD_OBSERVATION(clock, 1000, 2000);
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 500);
+
+	/* In graph time mode, no extrapolation takes place, so advancing
+	 * the sysclock must not change the produced timestamps. */
+	gst_pw_stream_clock_set_follow_graph_time(clock, TRUE);
+	test_sysclock_time = 3000;
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 500);
+
+	/* A freewheeling graph produces cycles much faster than real time.
+	 * Here, the driver clock advances by 10000 while the sysclock only
+	 * advances by 10. The produced timestamps must follow the driver. */
+	ADD_OBSERVATION(clock, 11000, 3010);
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 10500);
+	ADD_OBSERVATION(clock, 21000, 3020);
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 20500);
+
+	/* Discontinuous observations continue at the last graph time. */
+	{
+		struct pw_time t = {
+			.now = 3030,
+			.ticks = 900000,
+			.rate = { .num = 1, .denom = GST_SECOND }
+		};
+		gst_pw_stream_clock_add_discontinuous_observation(clock, &t);
+	}
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 20500);
+	ADD_OBSERVATION(clock, 901000, 3040);
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 21500);
+
+	/* Switching back to extrapolation must not cause the timestamps to
+	 * go backwards. The rate is now (901000 - 900000) / (3040 - 3030) = 100,
+	 * so at sysclock time 3050, the extrapolated time is 21500 + 10 * 100. */
+	gst_pw_stream_clock_set_follow_graph_time(clock, FALSE);
+	test_sysclock_time = 3050;
+	t = gst_clock_get_internal_time(GST_CLOCK(clock));
+	assert_equals_uint64(t, 22500);
+
+}
+GST_END_TEST;
+
+
 static Suite * gst_pw_stream_clock_suite(void)
 {
 	Suite *s = suite_create("GstPwStreamClock");
@@ -224,6 +333,8 @@ static Suite * gst_pw_stream_clock_suite(void)
 	tcase_add_test(tc, initial_behavior);
 	tcase_add_test(tc, frozen_clock);
 	tcase_add_test(tc, extrapolation_overshoot);
+	tcase_add_test(tc, discontinuous_observation);
+	tcase_add_test(tc, follow_graph_time);
 
 	return s;
 }